@@ -0,0 +1,113 @@
+#include "atlas_cache.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+
+#include "hash.h"
+
+atlas_key make_atlas_key(std::uint64_t image_hash, const palette_lut &lut)
+{
+    const auto *bytes = reinterpret_cast<const std::uint8_t *>(lut.data());
+    return {image_hash, hash_bytes({bytes, sizeof(lut)})};
+}
+
+std::filesystem::path atlas_cache_path(const std::filesystem::path &directory, const atlas_key &key)
+{
+    char name[64]{};
+    std::snprintf(name, sizeof(name), "%016" PRIx64 "-%016" PRIx64 ".atlas", key.image, key.palette);
+    return directory / name;
+}
+
+bool atlas_cache_open(
+    const std::filesystem::path &path,
+    const atlas_key &key,
+    std::uint32_t width,
+    std::uint32_t height,
+    mapped_file &file)
+{
+    if (!map_file(path.string().c_str(), file))
+    {
+        return false;
+    }
+
+    // the name already carries the key, but a file could have been truncated or copied in from elsewhere
+    atlas_header header{};
+    const auto pixel_bytes = static_cast<std::size_t>(width) * height * sizeof(std::uint32_t);
+    auto valid = file.size == sizeof(header) + pixel_bytes;
+    if (valid)
+    {
+        std::memcpy(&header, file.data, sizeof(header));
+        valid = std::memcmp(header.magic, atlas_magic, sizeof(atlas_magic)) == 0 && header.version == atlas_version &&
+                header.width == width && header.height == height && header.image_hash == key.image &&
+                header.palette_hash == key.palette;
+    }
+
+    if (!valid)
+    {
+        unmap_file(file);
+    }
+    return valid;
+}
+
+void atlas_cache_copy(const mapped_file &file, const bgra_view &dst)
+{
+    atlas_header header{};
+    std::memcpy(&header, file.data, sizeof(header));
+
+    const auto *pixels = file.data + sizeof(header);
+    const auto row_bytes = static_cast<std::size_t>(header.width) * sizeof(std::uint32_t);
+    const auto copy_bytes = std::min<std::size_t>(header.width, dst.width) * sizeof(std::uint32_t);
+    const auto rows = std::min(header.height, dst.height);
+
+    for (std::uint32_t y = 0; y < rows; ++y)
+    {
+        std::memcpy(dst.pixels + y * dst.pitch, pixels + y * row_bytes, copy_bytes);
+    }
+}
+
+bool atlas_cache_store(const std::filesystem::path &path, const atlas_key &key, const bgra_view &pixels)
+{
+    std::error_code error{};
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    auto temporary = path;
+    temporary += ".tmp";
+
+    auto *file = std::fopen(temporary.string().c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    atlas_header header{};
+    std::copy(std::begin(atlas_magic), std::end(atlas_magic), header.magic);
+    header.version = atlas_version;
+    header.width = pixels.width;
+    header.height = pixels.height;
+    header.image_hash = key.image;
+    header.palette_hash = key.palette;
+
+    auto ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+
+    const auto row_bytes = static_cast<std::size_t>(pixels.width) * sizeof(std::uint32_t);
+    for (std::uint32_t y = 0; ok && y < pixels.height; ++y)
+    {
+        ok = std::fwrite(pixels.pixels + y * pixels.pitch, row_bytes, 1, file) == 1;
+    }
+
+    ok = std::fclose(file) == 0 && ok;
+
+    if (ok)
+    {
+        std::filesystem::rename(temporary, path, error);
+        ok = !error;
+    }
+    if (!ok)
+    {
+        std::filesystem::remove(temporary, error);
+    }
+    return ok;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+#include "mapped_file.h"
+#include "palette_convert.h"
+
+// on-disk cache of image surfaces already converted to BGRA, so a launch with the same asset and palette as a
+// previous one can fill the surface with a copy out of a mapped file instead of a palette conversion
+// file layout: atlas_header followed by height rows of width BGRA pixels, top row first, no padding
+
+struct atlas_key
+{
+    // hash_bytes of the whole .bmp file
+    std::uint64_t image;
+    // hash_bytes of the palette_lut the atlas was converted with
+    std::uint64_t palette;
+};
+
+struct atlas_header
+{
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint64_t image_hash;
+    std::uint64_t palette_hash;
+};
+static_assert(sizeof(atlas_header) == 32);
+
+inline constexpr char atlas_magic[4]{'B', 'A', 'T', 'L'};
+inline constexpr std::uint32_t atlas_version = 1;
+
+atlas_key make_atlas_key(std::uint64_t image_hash, const palette_lut &lut);
+
+// where the atlas for key lives inside directory
+std::filesystem::path atlas_cache_path(const std::filesystem::path &directory, const atlas_key &key);
+
+// map the cached atlas for key, false on a miss or if the file doesn't match key and the expected size
+bool atlas_cache_open(
+    const std::filesystem::path &path,
+    const atlas_key &key,
+    std::uint32_t width,
+    std::uint32_t height,
+    mapped_file &file);
+
+// copy an opened atlas into dst, which can have any pitch
+void atlas_cache_copy(const mapped_file &file, const bgra_view &dst);
+
+// write pixels as the atlas for key, through a temporary file so a crash or a second instance never leaves a torn
+// atlas behind, false if it couldn't be written
+bool atlas_cache_store(const std::filesystem::path &path, const atlas_key &key, const bgra_view &pixels);
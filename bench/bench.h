@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string_view>
+#include <vector>
+
+// tiny benchmark harness, each bench_*.cpp registers a suite which main() runs (optionally filtered by name)
+
+struct bench_suite
+{
+    const char *name;
+    void (*run)();
+};
+
+std::vector<bench_suite> &bench_suites();
+
+struct bench_registrar
+{
+    bench_registrar(const char *name, void (*run)())
+    {
+        bench_suites().push_back({name, run});
+    }
+};
+
+#define BLOCKS_BENCH_SUITE(name, fn) static const bench_registrar name##_registrar{#name, fn}
+
+inline volatile std::uint8_t g_bench_sink{};
+
+// stop the optimiser from throwing away a result we never look at
+template <class T>
+void bench_keep(const T &value)
+{
+    g_bench_sink = *reinterpret_cast<const volatile std::uint8_t *>(&value);
+}
+
+// run fn until at least min_seconds have passed and return the best seconds per call seen
+template <class F>
+double bench_time(F &&fn, double min_seconds = 0.25)
+{
+    using clock = std::chrono::steady_clock;
+
+    fn(); // warm caches and page in buffers
+
+    auto best = 1e30;
+    auto total = 0.0;
+    auto runs = 0;
+    while (total < min_seconds || runs < 3)
+    {
+        const auto start = clock::now();
+        fn();
+        const auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        best = elapsed < best ? elapsed : best;
+        total += elapsed;
+        ++runs;
+    }
+    return best;
+}
+
+// print one result line as items/s in millions, e.g. Mpixels/s
+inline void bench_report(
+    std::string_view name,
+    std::string_view variant,
+    double items,
+    double seconds,
+    const char *unit)
+{
+    std::printf(
+        "%-32.*s %-12.*s %10.3f ms %12.1f M%s/s\n",
+        static_cast<int>(name.size()),
+        name.data(),
+        static_cast<int>(variant.size()),
+        variant.data(),
+        seconds * 1e3,
+        items / seconds / 1e6,
+        unit);
+}
@@ -0,0 +1,140 @@
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "../blit_batch.h"
+#include "../raster.h"
+#include "bench.h"
+
+namespace
+{
+
+struct test_surface
+{
+    std::vector<std::uint8_t> storage;
+    raster_surface view;
+
+    test_surface(std::uint32_t width, std::uint32_t height)
+        : storage(static_cast<std::size_t>(width) * height * 4)
+        , view{storage.data(), static_cast<std::ptrdiff_t>(width * 4), width, height, pixel_format::argb8888}
+    {
+    }
+};
+
+void run(const raster_surface &dst, const raster_surface &src, std::span<const blit_command> commands)
+{
+    for (const auto &command : commands)
+    {
+        if (command.src == nullptr)
+        {
+            raster_fill(dst, &command.dst_rect, command.fill_color);
+        }
+        else
+        {
+            const auto *key = command.keyed ? &command.key : nullptr;
+            raster_blt(dst, &command.dst_rect, src, &command.src_rect, {.source_key = key});
+        }
+    }
+}
+
+void run_blit_batch_benchmarks()
+{
+    test_surface sheet{1024, 1024};
+    test_surface back_buffer{640, 480};
+    for (std::size_t i = 0; i < sheet.storage.size(); i += 4)
+    {
+        const auto pixel = static_cast<std::uint32_t>(i / 4);
+        const auto keyed = pixel % 7 < 2;
+        sheet.storage[i] = keyed ? 0xff : static_cast<std::uint8_t>(pixel);
+        sheet.storage[i + 1] = keyed ? 0x00 : static_cast<std::uint8_t>(pixel >> 8);
+        sheet.storage[i + 2] = keyed ? 0xff : 0x40;
+    }
+
+    const raster_color_key key{0x00ff00ff, 0x00ff00ff};
+    const raster_rect screen{0, 0, 640, 480};
+
+    // a frame the way the game draws one: clear, background, then the board's tiles in board order with the
+    // sprites picked from all over the sheet, and some pieces on top that overlap the tiles
+    const auto frame = [&](std::int32_t tile)
+    {
+        std::mt19937 rng{1};
+        std::vector<blit_command> commands{};
+        commands.push_back({.dst = &back_buffer, .dst_rect = screen, .opaque = true});
+        commands.push_back(
+            {.dst = &back_buffer, .src = &sheet, .dst_rect = screen, .src_rect = screen, .opaque = true});
+
+        const auto sprites_per_row = 1024 / tile;
+        for (std::int32_t y = 0; y < 480 / tile; ++y)
+        {
+            for (std::int32_t x = 0; x < 640 / tile; ++x)
+            {
+                const auto sprite = static_cast<std::int32_t>(rng() % (sprites_per_row * (sprites_per_row / 2)));
+                const auto left = (sprite % sprites_per_row) * tile;
+                const auto top = 512 + (sprite / sprites_per_row) * tile;
+                commands.push_back({
+                    .dst = &back_buffer,
+                    .src = &sheet,
+                    .dst_rect = {x * tile, y * tile, (x + 1) * tile, (y + 1) * tile},
+                    .src_rect = {left, top, left + tile, top + tile},
+                    .keyed = true,
+                    .key = key,
+                });
+            }
+        }
+        for (auto i = 0; i < 64; ++i)
+        {
+            const auto x = static_cast<std::int32_t>(rng() % (640 - tile));
+            const auto y = static_cast<std::int32_t>(rng() % (480 - tile));
+            const auto left = static_cast<std::int32_t>(rng() % (1024 - tile));
+            const auto top = 512 + static_cast<std::int32_t>(rng() % (512 - tile));
+            commands.push_back({
+                .dst = &back_buffer,
+                .src = &sheet,
+                .dst_rect = {x, y, x + tile, y + tile},
+                .src_rect = {left, top, left + tile, top + tile},
+                .keyed = true,
+                .key = key,
+            });
+        }
+        return commands;
+    };
+
+    constexpr std::int32_t tiles[]{8, 32};
+    for (const auto tile : tiles)
+    {
+        const auto commands = frame(tile);
+        const auto name = tile == 8 ? std::string_view{"batch 8x8 tiles"} : std::string_view{"batch 32x32 tiles"};
+        const auto count = static_cast<double>(commands.size());
+
+        blit_batch batch{};
+        const auto schedule = bench_time(
+            [&]
+            {
+                for (const auto &command : commands)
+                {
+                    batch_add(batch, command);
+                }
+                bench_keep(batch_schedule(batch).size());
+            });
+        bench_report(name, "schedule", count, schedule, "blits");
+
+        const auto in_order = bench_time([&] { run(back_buffer.view, sheet.view, commands); });
+        bench_keep(back_buffer.storage[0]);
+        bench_report(name, "call order", count, in_order, "blits");
+
+        for (const auto &command : commands)
+        {
+            batch_add(batch, command);
+        }
+        const auto order = batch_schedule(batch);
+        const std::vector<blit_command> scheduled{order.begin(), order.end()};
+        const auto batched = bench_time([&] { run(back_buffer.view, sheet.view, scheduled); });
+        bench_keep(back_buffer.storage[0]);
+        bench_report(name, "scheduled", count, batched, "blits");
+    }
+}
+
+}
+
+BLOCKS_BENCH_SUITE(blit_batch, run_blit_batch_benchmarks);
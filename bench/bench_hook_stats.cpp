@@ -0,0 +1,40 @@
+#include <cstdint>
+
+#include "../hook_stats.h"
+#include "bench.h"
+
+namespace
+{
+
+// stands in for a forwarded DirectDraw call so only the bookkeeping around it is measured
+std::uint32_t fake_original(std::uint32_t value)
+{
+    return value * 2654435761u;
+}
+
+void run_hook_stats_benchmarks()
+{
+    constexpr auto calls = 1'000'000;
+
+    const auto hooked_calls = [&]
+    {
+        std::uint32_t result = 0;
+        for (auto i = 0; i < calls; ++i)
+        {
+            hook_scope scope{trace_event::blt};
+            result += scope.driver([&] { return fake_original(static_cast<std::uint32_t>(i)); });
+        }
+        bench_keep(result);
+    };
+
+    g_hook_stats_enabled.store(false);
+    bench_report("hook_scope + driver", "disabled", calls, bench_time(hooked_calls), "calls");
+
+    hook_stats_start();
+    bench_report("hook_scope + driver", "enabled", calls, bench_time(hooked_calls), "calls");
+    g_hook_stats_enabled.store(false);
+}
+
+}
+
+BLOCKS_BENCH_SUITE(hook_stats, run_hook_stats_benchmarks);
@@ -0,0 +1,143 @@
+#include <cstdint>
+#include <vector>
+
+#include "../palette_convert.h"
+#include "../palette_index.h"
+#include "../thread_pool.h"
+#include "bench.h"
+
+namespace
+{
+
+struct sheet_size
+{
+    const char *name;
+    std::uint32_t width;
+    std::uint32_t height;
+};
+
+constexpr sheet_size sheet_sizes[]{
+    {"640x480", 640, 480},
+    {"sprite sheet 2048x2048", 2048, 2048},
+    {"sprite sheet 4096x4096", 4096, 4096},
+};
+
+void run_palette_benchmarks()
+{
+    palette_entry palette[256]{};
+    for (auto i = 0; i < 256; ++i)
+    {
+        palette[i] = {
+            static_cast<std::uint8_t>(i),
+            static_cast<std::uint8_t>(255 - i),
+            static_cast<std::uint8_t>(i * 7),
+            0};
+    }
+
+    palette_lut lut{};
+    build_palette_lut(palette, lut);
+
+    thread_pool pool{};
+    pool_start(pool, 0);
+
+    for (const auto &size : sheet_sizes)
+    {
+        // cheap lcg so the indices aren't trivially predictable
+        std::vector<std::uint8_t> indices(static_cast<std::size_t>(size.width) * size.height);
+        auto seed = 0x12345678u;
+        for (auto &index : indices)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            index = static_cast<std::uint8_t>(seed >> 24);
+        }
+
+        // pad the destination rows like a driver would so pitch != width * 4
+        const auto pitch = static_cast<std::size_t>(size.width) * 4 + 64;
+        std::vector<std::uint8_t> surface(pitch * size.height);
+
+        const auto src = bottom_up_view(indices.data(), size.width, size.height, size.width);
+        const bgra_view dst{surface.data(), static_cast<std::ptrdiff_t>(pitch), size.width, size.height};
+        const auto pixels = static_cast<double>(size.width) * size.height;
+
+        for (const auto level : {simd_level::scalar, simd_level::sse2, simd_level::avx2})
+        {
+            if (level > detect_simd_level())
+            {
+                continue;
+            }
+
+            const auto seconds = bench_time([&] { convert_indexed_to_bgra(src, dst, lut, level); });
+            bench_keep(surface[pitch]);
+            bench_report(size.name, simd_level_name(level), pixels, seconds, "pixels");
+        }
+
+        // the best kernel in bands of rows over every core, the way Flip converts with [parallel] threads=0
+        const auto parallel = [&]
+        {
+            pool_for_rows(
+                pool,
+                size.height,
+                size.width * 4,
+                [&](std::uint32_t first, std::uint32_t last)
+                {
+                    convert_indexed_to_bgra(
+                        indexed_subview(src, 0, first, size.width, last - first),
+                        bgra_subview(dst, 0, first, size.width, last - first),
+                        lut);
+                });
+        };
+        const auto seconds = bench_time(parallel);
+        bench_keep(surface[pitch]);
+        bench_report(size.name, "pool", pixels, seconds, "pixels");
+    }
+
+    pool_stop(pool);
+}
+
+// a palette cycle of 8 entries on a sheet of solid 16x16 blocks, full reconversion vs span rewrite
+// throughput is in changed pixels so the two numbers compare directly
+void run_palette_cycle_benchmarks()
+{
+    palette_entry palette[256]{};
+    palette_lut lut{};
+    build_palette_lut(palette, lut);
+
+    for (const auto &size : sheet_sizes)
+    {
+        std::vector<std::uint8_t> indices(static_cast<std::size_t>(size.width) * size.height);
+        for (std::uint32_t y = 0; y < size.height; ++y)
+        {
+            for (std::uint32_t x = 0; x < size.width; ++x)
+            {
+                const auto block = (x / 16 + y / 16) % 64;
+                indices[static_cast<std::size_t>(y) * size.width + x] = static_cast<std::uint8_t>(block);
+            }
+        }
+
+        const auto pitch = static_cast<std::size_t>(size.width) * 4;
+        std::vector<std::uint8_t> surface(pitch * size.height);
+
+        const auto src = bottom_up_view(indices.data(), size.width, size.height, size.width);
+        const bgra_view dst{surface.data(), static_cast<std::ptrdiff_t>(pitch), size.width, size.height};
+        const auto index = build_palette_pixel_index(src);
+
+        palette_changes changes{};
+        for (auto i = 0; i < 8; ++i)
+        {
+            changes.set(i);
+        }
+        const auto pixels = static_cast<double>(pixels_affected(index, changes));
+
+        const auto full = bench_time([&] { convert_indexed_to_bgra(src, dst, lut); });
+        bench_report(size.name, "full", pixels, full, "pixels");
+
+        const auto incremental = bench_time([&] { apply_palette_changes(index, changes, lut, dst); });
+        bench_keep(surface[pitch]);
+        bench_report(size.name, "incremental", pixels, incremental, "pixels");
+    }
+}
+
+}
+
+BLOCKS_BENCH_SUITE(palette, run_palette_benchmarks);
+BLOCKS_BENCH_SUITE(palette_cycle, run_palette_cycle_benchmarks);
@@ -0,0 +1,131 @@
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "../overlay.h"
+#include "../raster.h"
+#include "bench.h"
+
+namespace
+{
+
+struct test_surface
+{
+    std::vector<std::uint8_t> storage;
+    raster_surface view;
+
+    test_surface(std::uint32_t width, std::uint32_t height, pixel_format format)
+        : storage(static_cast<std::size_t>(width) * height * bytes_per_pixel(format))
+        , view{storage.data(), static_cast<std::ptrdiff_t>(width * bytes_per_pixel(format)), width, height, format}
+    {
+    }
+};
+
+// sprite sheet of 32x32 blocks with a magenta-ish key colour around a solid middle, like the game's tiles
+void fill_sheet(test_surface &sheet, std::uint32_t key)
+{
+    const auto bytes = bytes_per_pixel(sheet.view.format);
+    for (std::uint32_t y = 0; y < sheet.view.height; ++y)
+    {
+        for (std::uint32_t x = 0; x < sheet.view.width; ++x)
+        {
+            const auto margin = x % 32 < 6 || x % 32 >= 26 || y % 32 < 6 || y % 32 >= 26;
+            const auto value = margin ? key : 0x00102030u + x + y;
+            for (std::uint32_t b = 0; b < bytes; ++b)
+            {
+                sheet.storage[y * sheet.view.pitch + x * bytes + b] = static_cast<std::uint8_t>(value >> (8 * b));
+            }
+        }
+    }
+}
+
+void run_raster_benchmarks()
+{
+    struct format_case
+    {
+        const char *name;
+        pixel_format format;
+        std::uint32_t key;
+    };
+
+    constexpr format_case formats[]{
+        {"32bpp", pixel_format::argb8888, 0x00ff00ff},
+        {"24bpp", pixel_format::rgb888, 0x00ff00ff},
+        {"16bpp 565", pixel_format::rgb565, 0xf81f},
+        {"8bpp indexed", pixel_format::indexed8, 0xff},
+    };
+
+    for (const auto &format : formats)
+    {
+        test_surface sheet{512, 512, format.format};
+        test_surface back_buffer{640, 480, format.format};
+        fill_sheet(sheet, format.key);
+
+        const raster_color_key key{format.key, format.key};
+
+        // a frame's worth of 32x32 tiles, 20x15 of them cover the whole 640x480 back buffer
+        const auto tile_frame = [&](const raster_color_key *source_key, const raster_span_table *spans = nullptr)
+        {
+            for (std::int32_t ty = 0; ty < 15; ++ty)
+            {
+                for (std::int32_t tx = 0; tx < 20; ++tx)
+                {
+                    const auto sprite = (tx + ty * 20) % 256;
+                    const auto left = (sprite % 16) * 32;
+                    const auto top = (sprite / 16) * 32;
+                    const raster_rect src_rect{left, top, left + 32, top + 32};
+                    raster_blt_fast(back_buffer.view, tx * 32, ty * 32, sheet.view, &src_rect, source_key, spans);
+                }
+            }
+        };
+
+        const auto pixels = 640.0 * 480.0;
+
+        const auto copy = bench_time([&] { tile_frame(nullptr); });
+        bench_keep(back_buffer.storage[0]);
+        bench_report(std::string_view{format.name}, "tiles", pixels, copy, "pixels");
+
+        const auto keyed = bench_time([&] { tile_frame(&key); });
+        bench_keep(back_buffer.storage[0]);
+        bench_report(std::string_view{format.name}, "tiles keyed", pixels, keyed, "pixels");
+
+        // the same blits copying the opaque runs found up front, the scan is paid once per sheet
+        raster_span_table spans{};
+        const auto build = bench_time([&] { spans = raster_build_spans(sheet.view, key); });
+        bench_report(std::string_view{format.name}, "build spans", 512.0 * 512.0, build, "pixels");
+
+        const auto spanned = bench_time([&] { tile_frame(&key, &spans); });
+        bench_keep(back_buffer.storage[0]);
+        bench_report(std::string_view{format.name}, "keyed spans", pixels, spanned, "pixels");
+
+        // 320x240 -> 640x480 nearest neighbour
+        const raster_rect half{0, 0, 320, 240};
+        const auto stretch = bench_time([&] { raster_blt(back_buffer.view, nullptr, sheet.view, &half); });
+        bench_keep(back_buffer.storage[0]);
+        bench_report(std::string_view{format.name}, "stretch 2x", pixels, stretch, "pixels");
+
+        const auto fill = bench_time([&] { raster_fill(back_buffer.view, nullptr, 0); });
+        bench_keep(back_buffer.storage[0]);
+        bench_report(std::string_view{format.name}, "fill", pixels, fill, "pixels");
+
+        // what [overlay] adds to every Flip, keeping what's under the panel, drawing it and putting it back
+        overlay_stats stats{};
+        const std::array<palette_entry, 256> palette{};
+        const auto panel = overlay_rect(640, 480);
+        overlay_backup backup{};
+        const auto overlay = bench_time(
+            [&]
+            {
+                overlay_save(backup, back_buffer.view, panel);
+                overlay_draw(back_buffer.view, stats, overlay_colors_for(format.format, palette));
+                overlay_restore(backup, back_buffer.view);
+            });
+        bench_keep(back_buffer.storage[0]);
+        const auto panel_pixels = static_cast<double>(panel.right - panel.left) * (panel.bottom - panel.top);
+        bench_report(std::string_view{format.name}, "overlay", panel_pixels, overlay, "pixels");
+    }
+}
+
+}
+
+BLOCKS_BENCH_SUITE(raster, run_raster_benchmarks);
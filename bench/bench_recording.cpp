@@ -0,0 +1,118 @@
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+
+#include "../png.h"
+#include "../recording.h"
+#include "bench.h"
+
+namespace
+{
+
+void run_recording_benchmarks()
+{
+    constexpr std::uint32_t width = 640;
+    constexpr std::uint32_t height = 480;
+    constexpr auto pixels = static_cast<double>(width) * height;
+
+    // an 8 bit frame like the game's, a tiled board with a few sprites moving around on it from frame to frame
+    std::vector<std::uint8_t> frame(static_cast<std::size_t>(width) * height);
+    const raster_surface view{frame.data(), width, width, height, pixel_format::indexed8};
+    const auto draw = [&](std::uint32_t number)
+    {
+        for (std::uint32_t y = 0; y < height; ++y)
+        {
+            for (std::uint32_t x = 0; x < width; ++x)
+            {
+                frame[y * width + x] = static_cast<std::uint8_t>((x / 32 + y / 32) % 16);
+            }
+        }
+        for (std::uint32_t sprite = 0; sprite < 6; ++sprite)
+        {
+            const auto left = (number * 3 + sprite * 97) % (width - 32);
+            const auto top = (number * 2 + sprite * 61) % (height - 32);
+            for (std::uint32_t y = 0; y < 32; ++y)
+            {
+                for (std::uint32_t x = 0; x < 32; ++x)
+                {
+                    frame[(top + y) * width + left + x] = static_cast<std::uint8_t>(200 + sprite);
+                }
+            }
+        }
+    };
+
+    std::array<palette_entry, 256> palette{};
+    for (std::size_t i = 0; i < palette.size(); ++i)
+    {
+        palette[i] = {static_cast<std::uint8_t>(i), static_cast<std::uint8_t>(i * 3), static_cast<std::uint8_t>(~i), 0};
+    }
+
+    const auto path = (std::filesystem::temp_directory_path() / "blocks_bench_recording.bin").string();
+
+    // what Flip pays, the copy into a free buffer, the encoder's share is below so the ring is just emptied here
+    frame_recorder recorder{};
+    if (!recording_start(recorder, path.c_str(), width, height, pixel_format::indexed8, 8))
+    {
+        std::printf("can't create %s\n", path.c_str());
+        return;
+    }
+
+    draw(0);
+    std::uint64_t number = 0;
+    bench_report(
+        "recording submit 640x480x8",
+        "",
+        pixels,
+        bench_time(
+            [&]
+            {
+                recording_submit(recorder, view, palette, number++);
+                recorder.tail.store(recorder.head.load());
+            }),
+        "pixels");
+    recording_stop(recorder);
+
+    // the encoder's side, a frame that moved a few sprites against the one before
+    std::vector<std::uint8_t> previous(frame.size());
+    std::vector<std::uint8_t> delta;
+    draw(1);
+    previous = frame;
+    draw(2);
+    bench_report(
+        "recording delta",
+        "sprites moved",
+        pixels,
+        bench_time(
+            [&]
+            {
+                delta.clear();
+                recording_delta(previous, frame, delta);
+            }),
+        "pixels");
+    std::printf("    %zu bytes for a %zu byte frame\n", delta.size(), frame.size());
+
+    bench_report(
+        "recording delta",
+        "unchanged",
+        pixels,
+        bench_time(
+            [&]
+            {
+                delta.clear();
+                recording_delta(frame, frame, delta);
+            }),
+        "pixels");
+
+    // blocks_recording_export, per frame
+    std::vector<std::uint8_t> png;
+    bench_report("png encode 640x480x8", "", pixels, bench_time([&] { png = png_encode(view, palette); }), "pixels");
+    std::printf("    %zu bytes\n", png.size());
+
+    std::filesystem::remove(path);
+}
+
+}
+
+BLOCKS_BENCH_SUITE(recording, run_recording_benchmarks);
@@ -0,0 +1,207 @@
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../scale.h"
+#include "../scale_filter.h"
+#include "../thread_pool.h"
+#include "bench.h"
+
+namespace
+{
+
+struct test_frame
+{
+    std::vector<std::uint32_t> storage;
+    raster_surface view;
+
+    test_frame(std::uint32_t width, std::uint32_t height)
+        : storage(static_cast<std::size_t>(width) * height)
+        , view{
+              reinterpret_cast<std::uint8_t *>(storage.data()),
+              static_cast<std::ptrdiff_t>(width * sizeof(std::uint32_t)),
+              width,
+              height,
+              pixel_format::argb8888}
+    {
+    }
+};
+
+void run_scale_benchmarks()
+{
+    test_frame frame{640, 480};
+    for (std::size_t i = 0; i < frame.storage.size(); ++i)
+    {
+        frame.storage[i] = static_cast<std::uint32_t>(i * 2654435761u);
+    }
+    const raster_rect frame_rect{0, 0, 640, 480};
+
+    struct window_case
+    {
+        const char *name;
+        std::uint32_t width;
+        std::uint32_t height;
+    };
+
+    constexpr window_case windows[]{
+        {"1280x960", 1280, 960},
+        {"1920x1080", 1920, 1080},
+        {"2560x1440", 2560, 1440},
+        {"2560x1920", 2560, 1920},
+        {"3840x2160", 3840, 2160},
+    };
+
+    // the pixel art filters only do real work on edges, the noise above would be all edge, so they get a frame more
+    // like the game's, flat tiles with diagonal shapes on them
+    test_frame art{640, 480};
+    for (std::uint32_t y = 0; y < 480; ++y)
+    {
+        for (std::uint32_t x = 0; x < 640; ++x)
+        {
+            const auto tile = (x / 32 + y / 32) % 4;
+            const auto shape = (x % 32) + (y % 32) < 24 || (x % 32) > (y % 32) + 12;
+            art.storage[y * 640 + x] = shape ? 0xff203040u + tile * 0x101010u : 0xffc08040u - tile * 0x080808u;
+        }
+    }
+
+    thread_pool single{};
+    pool_start(single, 1);
+
+    thread_pool pool{};
+    pool_start(pool, 0);
+
+    for (const auto &window : windows)
+    {
+        test_frame target{window.width, window.height};
+
+        const auto integer = scale_layout(scale_mode::integer, 640, 480, window.width, window.height);
+        const auto fit = scale_layout(scale_mode::fit, 640, 480, window.width, window.height);
+
+        const auto pixels = [](const raster_rect &rect)
+        { return static_cast<double>(rect.right - rect.left) * (rect.bottom - rect.top); };
+
+        const auto name = std::string_view{window.name};
+
+        bench_report(
+            name,
+            "nearest",
+            pixels(integer),
+            bench_time([&] { scale_nearest(target.view, integer, frame.view, frame_rect); }),
+            "pixels");
+
+        for (const auto level : {simd_level::scalar, simd_level::sse2})
+        {
+            if (level > detect_simd_level())
+            {
+                continue;
+            }
+
+            bench_report(
+                name,
+                level == simd_level::scalar ? "bilinear" : "bilinear sse2",
+                pixels(fit),
+                bench_time([&] { scale_bilinear(target.view, fit, frame.view, frame_rect, level); }),
+                "pixels");
+        }
+
+        // both again in bands of rows over every core, like present_scaled with [parallel] threads=0
+        const auto bands = [&](const raster_rect &rect, auto &&scale_rows)
+        {
+            pool_for_rows(
+                pool,
+                static_cast<std::uint32_t>(rect.bottom - rect.top),
+                static_cast<std::size_t>(rect.right - rect.left) * sizeof(std::uint32_t),
+                scale_rows);
+        };
+
+        bench_report(
+            name,
+            "nearest pool",
+            pixels(integer),
+            bench_time(
+                [&]
+                {
+                    bands(
+                        integer,
+                        [&](std::uint32_t first, std::uint32_t last)
+                        { scale_nearest_rows(target.view, integer, frame.view, frame_rect, first, last); });
+                }),
+            "pixels");
+
+        bench_report(
+            name,
+            "bilinear pool",
+            pixels(fit),
+            bench_time(
+                [&]
+                {
+                    bands(
+                        fit,
+                        [&](std::uint32_t first, std::uint32_t last)
+                        {
+                            scale_bilinear_rows(
+                                target.view,
+                                fit,
+                                frame.view,
+                                frame_rect,
+                                first,
+                                last,
+                                detect_simd_level());
+                        });
+                }),
+            "pixels");
+
+        // present_scaled's path for the pixel art modes, scalar and sse2 on one thread then sse2 over every core
+        constexpr scale_mode filters[]{scale_mode::scale2x, scale_mode::scale3x, scale_mode::xbr};
+        constexpr const char *filter_names[]{"scale2x", "scale3x", "xbr"};
+        scale_filter_frames frames{};
+        for (std::size_t f = 0; f < std::size(filters); ++f)
+        {
+            const auto mode = filters[f];
+            const auto rect = scale_layout(mode, 640, 480, window.width, window.height);
+            const auto factor = static_cast<std::uint32_t>(rect.right - rect.left) / 640;
+            if (scale_filter_passes(mode, factor) == 0)
+            {
+                continue;
+            }
+
+            const auto filter_name = std::string{name} + " " + filter_names[f];
+            const auto label = [&](const char *path) { return std::to_string(factor) + "x " + path; };
+
+            for (const auto level : {simd_level::scalar, simd_level::sse2})
+            {
+                if (level > detect_simd_level())
+                {
+                    continue;
+                }
+
+                bench_report(
+                    filter_name,
+                    label(level == simd_level::scalar ? "scalar" : "sse2"),
+                    pixels(rect),
+                    bench_time(
+                        [&] { scale_filter(single, frames, mode, target.view, rect, art.view, frame_rect, level); }),
+                    "pixels");
+            }
+
+            bench_report(
+                filter_name,
+                label("pool"),
+                pixels(rect),
+                bench_time(
+                    [&]
+                    {
+                        scale_filter(pool, frames, mode, target.view, rect, art.view, frame_rect, detect_simd_level());
+                    }),
+                "pixels");
+        }
+    }
+
+    pool_stop(pool);
+    pool_stop(single);
+}
+
+}
+
+BLOCKS_BENCH_SUITE(scale, run_scale_benchmarks);
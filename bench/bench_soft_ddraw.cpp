@@ -0,0 +1,169 @@
+#include <cstdint>
+
+#include "../ddraw_vtable.h"
+#include "../soft_ddraw.h"
+#include "bench.h"
+
+namespace
+{
+
+// forwards straight to the original, what every hook in main.cpp costs before it does any work of its own
+HRESULT __stdcall pass_through_blt_fast(
+    void *that,
+    DWORD x,
+    DWORD y,
+    LPDIRECTDRAWSURFACE7 source,
+    LPRECT src_rect,
+    DWORD flags)
+{
+    return surface_method::blt_fast::original(that, x, y, source, src_rect, flags);
+}
+
+template <class Method, class... Args>
+HRESULT call(void *object, Args... args)
+{
+    const auto *vtable = *reinterpret_cast<void *const *const *>(object);
+    return reinterpret_cast<typename Method::function_type>(vtable[Method::index])(object, args...);
+}
+
+void run_soft_ddraw_benchmarks()
+{
+    auto *ddraw = soft_ddraw_create({.display_width = 640, .display_height = 480});
+
+    DDSURFACEDESC2 desc{};
+    desc.dwSize = sizeof(desc);
+    desc.dwFlags = DDSD_CAPS | DDSD_BACKBUFFERCOUNT;
+    desc.ddsCaps.dwCaps = DDSCAPS_PRIMARYSURFACE | DDSCAPS_FLIP | DDSCAPS_COMPLEX;
+    desc.dwBackBufferCount = 1;
+    LPDIRECTDRAWSURFACE7 primary{};
+    call<ddraw_method::create_surface>(ddraw, &desc, &primary, nullptr);
+
+    DDSCAPS2 caps{};
+    caps.dwCaps = DDSCAPS_BACKBUFFER;
+    LPDIRECTDRAWSURFACE7 back_buffer{};
+    call<surface_method::get_attached_surface>(primary, &caps, &back_buffer);
+
+    desc = {};
+    desc.dwSize = sizeof(desc);
+    desc.dwFlags = DDSD_CAPS | DDSD_WIDTH | DDSD_HEIGHT;
+    desc.dwWidth = 512;
+    desc.dwHeight = 512;
+    desc.ddsCaps.dwCaps = DDSCAPS_OFFSCREENPLAIN;
+    LPDIRECTDRAWSURFACE7 sheet{};
+    call<ddraw_method::create_surface>(ddraw, &desc, &sheet, nullptr);
+
+    DDCOLORKEY key{0x00ff00ff, 0x00ff00ff};
+    call<surface_method::set_color_key>(sheet, DDCKEY_SRCBLT, &key);
+
+    // 32x32 tiles with a keyed border, like fill_sheet in bench_raster.cpp
+    DDSURFACEDESC2 locked{};
+    locked.dwSize = sizeof(locked);
+    call<surface_method::lock>(sheet, nullptr, &locked, DDLOCK_WAIT, nullptr);
+    for (DWORD y = 0; y < locked.dwHeight; ++y)
+    {
+        auto *row =
+            reinterpret_cast<std::uint32_t *>(static_cast<std::uint8_t *>(locked.lpSurface) + y * locked.lPitch);
+        for (DWORD x = 0; x < locked.dwWidth; ++x)
+        {
+            const auto margin = x % 32 < 6 || x % 32 >= 26 || y % 32 < 6 || y % 32 >= 26;
+            row[x] = margin ? key.dwColorSpaceLowValue : 0x00102030u + x + y;
+        }
+    }
+    call<surface_method::unlock>(sheet, nullptr);
+
+    // a frame of keyed tiles covering the back buffer, every one of them a BltFast through the vtable
+    // the smaller the tile the more the call itself costs next to the pixels it moves
+    const auto tile_frame = [&](LONG size)
+    {
+        const auto per_row = 512 / size;
+        for (LONG ty = 0; ty < 480 / size; ++ty)
+        {
+            for (LONG tx = 0; tx < 640 / size; ++tx)
+            {
+                const auto sprite = (tx + ty * (640 / size)) % (per_row * per_row);
+                const auto left = (sprite % per_row) * size;
+                const auto top = (sprite / per_row) * size;
+                RECT src_rect{left, top, left + size, top + size};
+                call<surface_method::blt_fast>(
+                    back_buffer,
+                    static_cast<DWORD>(tx * size),
+                    static_cast<DWORD>(ty * size),
+                    sheet,
+                    &src_rect,
+                    DDBLTFAST_SRCCOLORKEY | DDBLTFAST_WAIT);
+            }
+        }
+    };
+
+    struct tile_case
+    {
+        const char *name;
+        LONG size;
+    };
+
+    constexpr tile_case tiles[]{
+        {"soft_ddraw BltFast 8x8", 8},
+        {"soft_ddraw BltFast 32x32", 32},
+        {"soft_ddraw BltFast 128x128", 128},
+    };
+
+    for (const auto &tile : tiles)
+    {
+        const auto blits = static_cast<double>((640 / tile.size) * (480 / tile.size));
+        bench_report(tile.name, "direct", blits, bench_time([&] { tile_frame(tile.size); }), "calls");
+
+        using hooks = vtable_hooks<vtable_hook<surface_method::blt_fast, pass_through_blt_fast>>;
+        hook_set set{};
+        hooks::add(set, back_buffer);
+        hook_set_commit(set, g_writable_memory);
+        bench_report(tile.name, "hooked", blits, bench_time([&] { tile_frame(tile.size); }), "calls");
+        hook_set_rollback(set, g_writable_memory);
+    }
+
+    // the game locks the back buffer once a frame to draw text, the lock itself should be close to free
+    constexpr auto locks = 10'000;
+    const auto lock_unlock = [&]
+    {
+        for (auto i = 0; i < locks; ++i)
+        {
+            call<surface_method::lock>(back_buffer, nullptr, &locked, DDLOCK_WAIT, nullptr);
+            bench_keep(locked.lpSurface);
+            call<surface_method::unlock>(back_buffer, nullptr);
+        }
+    };
+    bench_report("soft_ddraw Lock + Unlock", "", locks, bench_time(lock_unlock), "calls");
+
+    const auto flips = [&]
+    {
+        for (auto i = 0; i < locks; ++i)
+        {
+            call<surface_method::flip>(primary, nullptr, DDFLIP_WAIT);
+        }
+    };
+    bench_report("soft_ddraw Flip", "", locks, bench_time(flips), "calls");
+
+    // CreateSurface_hook queues about 30 slots over three surfaces, which share one vtable and so one page
+    alignas(4096) static std::uintptr_t table[64]{};
+    constexpr std::size_t slots = 30;
+    const auto commit_rollback = [&]
+    {
+        hook_set set{};
+        for (std::size_t i = 0; i < slots; ++i)
+        {
+            hook_set_add(set, reinterpret_cast<std::uintptr_t>(&table[i]), i + 1);
+        }
+        hook_set_commit(set, g_writable_memory);
+        hook_set_rollback(set, g_writable_memory);
+    };
+    bench_report("hook set commit + rollback", "", slots, bench_time(commit_rollback), "slots");
+
+    using release = vtable_method<IUnknown, 2, ULONG(__stdcall *)(void *)>;
+    call<release>(sheet);
+    call<release>(back_buffer);
+    call<release>(primary);
+    call<release>(ddraw);
+}
+
+}
+
+BLOCKS_BENCH_SUITE(soft_ddraw, run_soft_ddraw_benchmarks);
@@ -0,0 +1,97 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "../write_watch.h"
+#include "bench.h"
+
+namespace
+{
+
+void run_write_watch_benchmarks()
+{
+    constexpr std::uint32_t width = 640;
+    constexpr std::uint32_t height = 480;
+    constexpr std::size_t pitch = width * 4;
+
+    write_watch back_buffer{};
+    if (!write_watch_alloc(back_buffer, pitch * height))
+    {
+        std::printf("no write watch here\n");
+        return;
+    }
+    std::vector<std::uint8_t> screen(pitch * height);
+    std::vector<std::size_t> pages;
+
+    // the game locks the whole back buffer once a frame to draw a line of text, rows of glyph pixels
+    const auto draw_text = [&](std::uint32_t rows)
+    {
+        for (std::uint32_t y = 0; y < rows; ++y)
+        {
+            for (std::uint32_t x = 16; x < 16 + 200; x += 3)
+            {
+                back_buffer.data[(440 + y) * pitch + x * 4] = static_cast<std::uint8_t>(x);
+            }
+        }
+    };
+
+    const auto copy_rows = [&](const raster_rect &rect)
+    {
+        for (auto y = rect.top; y < rect.bottom; ++y)
+        {
+            std::memcpy(screen.data() + y * pitch, back_buffer.data + y * pitch, pitch);
+        }
+    };
+
+    struct text_case
+    {
+        const char *name;
+        std::uint32_t rows;
+    };
+
+    constexpr text_case texts[]{
+        {"lock + 1 row + present", 1},
+        {"lock + 8 rows + present", 8},
+        {"lock + 32 rows + present", 32},
+    };
+
+    // per pixel of the locked surface
+    constexpr auto pixels = static_cast<double>(width) * height;
+
+    for (const auto &[name, rows] : texts)
+    {
+        // what Unlock assumes without the watch, everything locked was drawn
+        bench_report(
+            name,
+            "whole lock",
+            pixels,
+            bench_time(
+                [&]
+                {
+                    draw_text(rows);
+                    copy_rows({0, 0, static_cast<std::int32_t>(width), static_cast<std::int32_t>(height)});
+                }),
+            "pixels");
+
+        bench_report(
+            name,
+            "write watch",
+            pixels,
+            bench_time(
+                [&]
+                {
+                    write_watch_reset(back_buffer);
+                    draw_text(rows);
+                    write_watch_pages(back_buffer, pages);
+                    for (const auto &rect : write_watch_rows(pages, back_buffer.page_size, pitch, width, height))
+                    {
+                        copy_rows(rect);
+                    }
+                }),
+            "pixels");
+    }
+}
+
+}
+
+BLOCKS_BENCH_SUITE(write_watch, run_write_watch_benchmarks);
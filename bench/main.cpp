@@ -0,0 +1,32 @@
+#include <cstdio>
+#include <string_view>
+
+#include "../simd.h"
+#include "bench.h"
+
+std::vector<bench_suite> &bench_suites()
+{
+    static std::vector<bench_suite> suites{};
+    return suites;
+}
+
+// usage: blocks_bench [filter], runs every suite whose name contains filter
+int main(int argc, char **argv)
+{
+    const std::string_view filter = argc > 1 ? argv[1] : "";
+
+    std::printf("simd level: %s\n", simd_level_name(detect_simd_level()));
+
+    for (const auto &suite : bench_suites())
+    {
+        if (!std::string_view{suite.name}.contains(filter))
+        {
+            continue;
+        }
+
+        std::printf("\n[%s]\n", suite.name);
+        suite.run();
+    }
+
+    return 0;
+}
@@ -0,0 +1,211 @@
+#include "blit_batch.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <utility>
+
+namespace
+{
+
+bool contains(const raster_rect &outer, const raster_rect &inner)
+{
+    return inner.left >= outer.left && inner.top >= outer.top && inner.right <= outer.right &&
+           inner.bottom <= outer.bottom;
+}
+
+std::int64_t area(const raster_rect &rect)
+{
+    return raster_rect_empty(rect) ? 0
+                                   : static_cast<std::int64_t>(rect.right - rect.left) * (rect.bottom - rect.top);
+}
+
+// opaque blits that come later than the one being looked at, the biggest few are enough to catch the fills and
+// backgrounds that get drawn over a whole frame
+constexpr std::size_t occluder_count = 16;
+
+struct occluders
+{
+    std::array<const blit_command *, occluder_count> commands{};
+    std::size_t count{};
+};
+
+void add_occluder(occluders &list, const blit_command &command)
+{
+    if (list.count < occluder_count)
+    {
+        list.commands[list.count++] = &command;
+        return;
+    }
+
+    auto *smallest = std::ranges::min_element(
+        list.commands,
+        {},
+        [](const blit_command *occluder) { return area(occluder->dst_rect); });
+    if (area((*smallest)->dst_rect) < area(command.dst_rect))
+    {
+        *smallest = &command;
+    }
+}
+
+// a blit reading from surface can't be drawn over by anything after it before it has run
+void forget_occluders(occluders &list, const void *surface)
+{
+    const auto end = std::remove_if(
+        list.commands.begin(),
+        list.commands.begin() + list.count,
+        [surface](const blit_command *occluder) { return occluder->dst == surface; });
+    list.count = static_cast<std::size_t>(end - list.commands.begin());
+}
+
+bool hidden(const occluders &list, const blit_command &command)
+{
+    return std::any_of(
+        list.commands.begin(),
+        list.commands.begin() + list.count,
+        [&](const blit_command *occluder)
+        { return occluder->dst == command.dst && contains(occluder->dst_rect, command.dst_rect); });
+}
+
+// conflicts are tracked on a coarse grid per destination, two blits sharing a cell count as overlapping which only
+// costs some reordering, coordinates past the grid are clamped onto its edge cells
+constexpr std::int32_t cell_size = 32;
+constexpr std::int32_t grid_cells = 64;
+
+struct surface_levels
+{
+    const void *surface;
+    // highest level that wrote to each cell
+    std::array<std::uint32_t, grid_cells * grid_cells> cells;
+    // highest level that read from the surface at all
+    std::uint32_t read;
+    std::uint32_t written;
+};
+
+struct cell_range
+{
+    std::int32_t left, top, right, bottom;
+};
+
+cell_range cells_of(const raster_rect &rect)
+{
+    const auto cell = [](std::int32_t coordinate) { return std::clamp(coordinate / cell_size, 0, grid_cells - 1); };
+    return {cell(rect.left), cell(rect.top), cell(rect.right - 1), cell(rect.bottom - 1)};
+}
+
+// index of the surface's entry, added on first use
+std::size_t levels_of(std::vector<surface_levels> &surfaces, const void *surface)
+{
+    const auto found = std::ranges::find(surfaces, surface, &surface_levels::surface);
+    if (found == surfaces.end())
+    {
+        surfaces.push_back({.surface = surface, .cells = {}, .read = 0, .written = 0});
+        return surfaces.size() - 1;
+    }
+    return static_cast<std::size_t>(found - surfaces.begin());
+}
+
+}
+
+std::span<const blit_command> batch_schedule(blit_batch &batch)
+{
+    auto &commands = batch.commands;
+    batch.scheduled.clear();
+
+    // walking backwards, anything a later opaque blit covers completely is never seen
+    occluders later{};
+    std::vector<bool> keep(commands.size());
+    for (auto i = commands.size(); i-- > 0;)
+    {
+        const auto &command = commands[i];
+        if (raster_rect_empty(command.dst_rect) || hidden(later, command))
+        {
+            continue;
+        }
+
+        keep[i] = true;
+        if (command.src != nullptr)
+        {
+            forget_occluders(later, command.src);
+        }
+        if (command.opaque)
+        {
+            add_occluder(later, command);
+        }
+    }
+
+    // a blit's level is one past every earlier blit it depends on: one drawing to the same cells, one writing the
+    // surface it reads or one reading the surface it writes, blits on the same level can go in any order
+    std::vector<surface_levels> surfaces{};
+    batch.levels.assign(commands.size(), 0);
+    for (std::size_t i = 0; i < commands.size(); ++i)
+    {
+        if (!keep[i])
+        {
+            continue;
+        }
+
+        const auto &command = commands[i];
+
+        // both looked up before holding on to either, adding one may move the other
+        const auto src_index = command.src != nullptr ? levels_of(surfaces, command.src) : 0;
+        const auto dst_index = levels_of(surfaces, command.dst);
+        auto &dst = surfaces[dst_index];
+        const auto range = cells_of(command.dst_rect);
+
+        auto level = dst.read;
+        for (auto y = range.top; y <= range.bottom; ++y)
+        {
+            for (auto x = range.left; x <= range.right; ++x)
+            {
+                level = std::max(level, dst.cells[y * grid_cells + x]);
+            }
+        }
+        if (command.src != nullptr)
+        {
+            level = std::max(level, surfaces[src_index].written);
+        }
+        ++level;
+
+        for (auto y = range.top; y <= range.bottom; ++y)
+        {
+            for (auto x = range.left; x <= range.right; ++x)
+            {
+                dst.cells[y * grid_cells + x] = level;
+            }
+        }
+        dst.written = std::max(dst.written, level);
+        if (command.src != nullptr)
+        {
+            surfaces[src_index].read = std::max(surfaces[src_index].read, level);
+        }
+
+        batch.levels[i] = level;
+    }
+
+    // within a level walk each source top to bottom, left to right, so consecutive blits read neighbouring rows
+    // level, then source row, then source column, with the index breaking ties so equal blits keep their order
+    auto &order = batch.order;
+    order.clear();
+    for (std::uint32_t i = 0; i < commands.size(); ++i)
+    {
+        if (keep[i])
+        {
+            const auto coordinate = [](std::int32_t value)
+            { return static_cast<std::uint64_t>(std::clamp(value, 0, 0xffff)); };
+            const auto &source = commands[i].src_rect;
+            const auto key = static_cast<std::uint64_t>(batch.levels[i]) << 32 | coordinate(source.top) << 16 |
+                             coordinate(source.left);
+            order.emplace_back(key, i);
+        }
+    }
+    std::ranges::sort(order);
+
+    for (const auto &[key, i] : order)
+    {
+        batch.scheduled.push_back(commands[i]);
+    }
+    commands.clear();
+
+    return batch.scheduled;
+}
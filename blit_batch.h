@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "raster.h"
+
+// blits collected over a frame instead of run one call at a time, see [raster] batch in settings.h
+// before running them the batch drops blits a later opaque one draws over completely and regroups the rest so
+// blits that don't touch each other run in source order, blits that do keep the order they were made in
+
+struct blit_command
+{
+    // the surfaces as whatever handle the caller uses, src is null for a colour fill
+    void *dst{};
+    void *src{};
+    raster_rect dst_rect{};
+    raster_rect src_rect{};
+    std::uint32_t fill_color{};
+    bool keyed{};
+    raster_color_key key{};
+    // every pixel of dst_rect gets written, set by the caller only when it knows the blit can't fail
+    bool opaque{};
+};
+
+struct blit_batch
+{
+    std::vector<blit_command> commands{};
+
+    // batch_schedule's working memory, kept between frames
+    std::vector<std::uint32_t> levels{};
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> order{};
+    std::vector<blit_command> scheduled{};
+};
+
+// a frame of 8x8 tiles is around 5000 blits, past this many the batch should be flushed before adding more
+inline constexpr std::size_t blit_batch_capacity = 8192;
+
+inline void batch_add(blit_batch &batch, const blit_command &command)
+{
+    batch.commands.push_back(command);
+}
+
+// the commands to run in the order to run them in, valid until the next call, the batch is empty afterwards
+std::span<const blit_command> batch_schedule(blit_batch &batch);
@@ -0,0 +1,105 @@
+#include "bmp.h"
+
+namespace
+{
+
+// BITMAPFILEHEADER is 14 bytes and BITMAPINFOHEADER 40, later header versions only add fields after those 40
+constexpr std::size_t file_header_size = 14;
+constexpr std::size_t info_header_size = 40;
+constexpr std::uint32_t bi_rgb = 0;
+
+std::uint16_t read_u16(const std::uint8_t *p)
+{
+    return static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+}
+
+std::uint32_t read_u32(const std::uint8_t *p)
+{
+    return static_cast<std::uint32_t>(p[0]) | (static_cast<std::uint32_t>(p[1]) << 8) |
+           (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+}
+
+const char *bmp_error_name(bmp_error error)
+{
+    switch (error)
+    {
+        case bmp_error::none: return "none";
+        case bmp_error::truncated: return "truncated";
+        case bmp_error::not_a_bitmap: return "not a bitmap";
+        case bmp_error::unsupported_header: return "unsupported header";
+        case bmp_error::unsupported_format: return "unsupported format";
+        case bmp_error::bad_palette: return "bad palette";
+        case bmp_error::bad_pixel_offset: return "bad pixel offset";
+    }
+    return "?";
+}
+
+bmp_error parse_bmp(std::span<const std::uint8_t> file, bmp_image &image)
+{
+    if (file.size() < file_header_size + info_header_size)
+    {
+        return bmp_error::truncated;
+    }
+
+    const auto *bytes = file.data();
+    if (bytes[0] != 'B' || bytes[1] != 'M')
+    {
+        return bmp_error::not_a_bitmap;
+    }
+
+    const auto pixel_offset = static_cast<std::size_t>(read_u32(bytes + 10));
+
+    // BITMAPCOREHEADER (12 bytes, os/2) has 16 bit sizes and a 3 byte colour table, nothing we load uses it
+    const auto *info = bytes + file_header_size;
+    const auto header_size = static_cast<std::size_t>(read_u32(info));
+    if (header_size < info_header_size || header_size > file.size() - file_header_size)
+    {
+        return bmp_error::unsupported_header;
+    }
+
+    const auto width = static_cast<std::int32_t>(read_u32(info + 4));
+    const auto height = static_cast<std::int32_t>(read_u32(info + 8));
+    const auto planes = read_u16(info + 12);
+    const auto bits = read_u16(info + 14);
+    const auto compression = read_u32(info + 16);
+    const auto colors_used = read_u32(info + 32);
+
+    // negative heights are top-down, INT32_MIN has no positive counterpart
+    if (width <= 0 || height == 0 || height == INT32_MIN || planes != 1 || bits != 8 || compression != bi_rgb)
+    {
+        return bmp_error::unsupported_format;
+    }
+
+    // a zero colour count means the full 2^bits table
+    const auto colors = colors_used == 0 ? 256u : colors_used;
+    const auto palette_offset = file_header_size + header_size;
+    if (colors > 256 || palette_offset + colors * sizeof(bmp_color) > file.size())
+    {
+        return bmp_error::bad_palette;
+    }
+
+    // size_t is 32 bits in the dll, a huge width could wrap the pixel plane's size around to something small, the
+    // product of two 32 bit values always fits in 64
+    const auto rows = static_cast<std::uint32_t>(height < 0 ? -height : height);
+    const auto row_bytes = (static_cast<std::uint64_t>(width) * bits + 31) / 32 * 4;
+    if (pixel_offset < palette_offset + colors * sizeof(bmp_color) || pixel_offset > file.size() ||
+        row_bytes * rows > file.size() - pixel_offset)
+    {
+        return bmp_error::bad_pixel_offset;
+    }
+    const auto stride = static_cast<std::size_t>(row_bytes);
+
+    image.info = info;
+    image.width = static_cast<std::uint32_t>(width);
+    image.height = rows;
+    image.bottom_up = height > 0;
+    image.stride = stride;
+    image.pixel_offset = pixel_offset;
+    image.pixels = image.bottom_up
+                       ? bottom_up_view(bytes + pixel_offset, image.width, rows, stride)
+                       : indexed_view{bytes + pixel_offset, static_cast<std::ptrdiff_t>(stride), image.width, rows};
+    image.palette = {reinterpret_cast<const bmp_color *>(bytes + palette_offset), colors};
+    return bmp_error::none;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "palette_convert.h"
+
+// parser for the 8bpp uncompressed .bmp files the game loads, everything it hands out points into the file's bytes
+
+// RGBQUAD, the layout of a DIB colour table entry
+struct bmp_color
+{
+    std::uint8_t blue;
+    std::uint8_t green;
+    std::uint8_t red;
+    std::uint8_t reserved;
+};
+
+enum class bmp_error
+{
+    none,
+    truncated,
+    not_a_bitmap,
+    unsupported_header,
+    unsupported_format,
+    bad_palette,
+    bad_pixel_offset
+};
+
+struct bmp_image
+{
+    // BITMAPINFOHEADER (or a larger version of it) followed by the colour table, what CreateDIBSection wants
+    const std::uint8_t *info{};
+    std::uint32_t width{};
+    std::uint32_t height{};
+    // bottom-up DIBs are stored last row first, pixels below always runs top to bottom
+    bool bottom_up{};
+    // bytes per stored row, each row is padded to a multiple of 4
+    std::size_t stride{};
+    // offset of the first stored row from the start of the file
+    std::size_t pixel_offset{};
+    // the index plane, top row first (negative pitch for bottom-up files)
+    indexed_view pixels{};
+    std::span<const bmp_color> palette{};
+};
+
+const char *bmp_error_name(bmp_error error);
+
+// validate the headers of file and describe it in image, image is left untouched on error
+bmp_error parse_bmp(std::span<const std::uint8_t> file, bmp_image &image);
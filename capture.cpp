@@ -0,0 +1,163 @@
+#include "capture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+
+#include "trace.h"
+
+namespace
+{
+
+struct capture_state
+{
+    // the game only draws from one thread, the lock is there for the odd call from another one
+    std::mutex mutex{};
+    std::FILE *file{};
+};
+
+capture_state &state()
+{
+    static capture_state instance{};
+    return instance;
+}
+
+thread_local std::uint32_t t_depth{};
+
+}
+
+bool capture_start(const char *path)
+{
+    auto &s = state();
+    std::lock_guard lock{s.mutex};
+
+    if (s.file != nullptr)
+    {
+        return true;
+    }
+
+    s.file = std::fopen(path, "wb");
+    if (s.file == nullptr)
+    {
+        return false;
+    }
+
+    // lock payloads can be whole frames, a big buffer keeps that to a handful of writes
+    std::setvbuf(s.file, nullptr, _IOFBF, 4 << 20);
+
+    capture_file_header header{};
+    std::copy(std::begin(capture_magic), std::end(capture_magic), header.magic);
+    header.version = capture_version;
+    std::fwrite(&header, sizeof(header), 1, s.file);
+
+    g_capture_enabled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void capture_stop()
+{
+    auto &s = state();
+    g_capture_enabled.store(false, std::memory_order_relaxed);
+
+    std::lock_guard lock{s.mutex};
+    if (s.file != nullptr)
+    {
+        std::fclose(s.file);
+        s.file = nullptr;
+    }
+}
+
+void capture_write(capture_call call, std::span<const std::span<const std::uint8_t>> parts)
+{
+    capture_record record{.size = sizeof(capture_record), .call = call, .reserved = 0, .timestamp = trace_now()};
+    for (const auto &part : parts)
+    {
+        record.size += static_cast<std::uint32_t>(part.size());
+    }
+
+    auto &s = state();
+    std::lock_guard lock{s.mutex};
+    if (s.file == nullptr)
+    {
+        return;
+    }
+
+    std::fwrite(&record, sizeof(record), 1, s.file);
+    for (const auto &part : parts)
+    {
+        std::fwrite(part.data(), 1, part.size(), s.file);
+    }
+}
+
+capture_scope::capture_scope()
+{
+    ++t_depth;
+}
+
+capture_scope::~capture_scope()
+{
+    --t_depth;
+}
+
+bool capture_scope::outermost() const
+{
+    return t_depth == 1;
+}
+
+bool capture_open(std::span<const std::uint8_t> file, std::span<const std::uint8_t> &records)
+{
+    capture_file_header header{};
+    if (file.size() < sizeof(header))
+    {
+        return false;
+    }
+
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (!std::equal(std::begin(capture_magic), std::end(capture_magic), header.magic) ||
+        header.version != capture_version)
+    {
+        return false;
+    }
+
+    records = file.subspan(sizeof(header));
+    return true;
+}
+
+bool capture_next(std::span<const std::uint8_t> &records, capture_entry &entry)
+{
+    if (records.size() < sizeof(capture_record))
+    {
+        return false;
+    }
+
+    std::memcpy(&entry.record, records.data(), sizeof(capture_record));
+    if (entry.record.size < sizeof(capture_record) || entry.record.size > records.size())
+    {
+        return false;
+    }
+
+    entry.body = records.subspan(sizeof(capture_record), entry.record.size - sizeof(capture_record));
+    records = records.subspan(entry.record.size);
+    return true;
+}
+
+const char *capture_call_name(capture_call call)
+{
+    switch (call)
+    {
+        case capture_call::create_window: return "CreateWindowExA";
+        case capture_call::direct_draw_create: return "DirectDrawCreate";
+        case capture_call::create_surface: return "CreateSurface";
+        case capture_call::create_palette: return "CreatePalette";
+        case capture_call::set_entries: return "SetEntries";
+        case capture_call::blt: return "Blt";
+        case capture_call::blt_fast: return "BltFast";
+        case capture_call::flip: return "Flip";
+        case capture_call::lock: return "Lock";
+        case capture_call::unlock: return "Unlock";
+        case capture_call::set_color_key: return "SetColorKey";
+        case capture_call::load_image: return "LoadImageA";
+        case capture_call::count: break;
+    }
+    return "?";
+}
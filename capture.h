@@ -0,0 +1,274 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#include "palette_convert.h"
+#include "raster.h"
+
+// record and replay
+// with capture on, every hooked call the game makes is written to a file with its arguments and whatever they point
+// at (palette entries, rects, the pixels written through a lock, the image files), enough for tools/replay.cpp to
+// drive the same frames through the cpu raster engine on any machine without the game or DirectDraw
+// unlike the trace, which only keeps raw argument words, a capture is self contained
+
+// file layout: capture_file_header, then capture_record until the end of the file, each record followed by the args
+// struct for its call and then any payload, size covers all three
+struct capture_file_header
+{
+    char magic[4];
+    std::uint32_t version;
+};
+
+inline constexpr char capture_magic[4]{'B', 'C', 'A', 'P'};
+inline constexpr std::uint32_t capture_version = 1;
+
+enum class capture_call : std::uint16_t
+{
+    create_window,
+    direct_draw_create,
+    create_surface,
+    create_palette,
+    set_entries,
+    blt,
+    blt_fast,
+    flip,
+    lock,
+    unlock,
+    set_color_key,
+    load_image,
+    count
+};
+
+struct capture_record
+{
+    std::uint32_t size;
+    capture_call call;
+    std::uint16_t reserved;
+    std::uint64_t timestamp;
+};
+static_assert(sizeof(capture_record) == 16);
+
+// objects are identified by the pointer the game saw, the replayer maps them to its own
+using capture_handle = std::uint64_t;
+
+// what a surface is for, the patcher swaps the game's surfaces for its own so the replayer needs to know which is which
+enum class capture_surface_role : std::uint32_t
+{
+    primary,
+    back_buffer,
+    image
+};
+
+// a pixel_format the raster engine can't handle
+inline constexpr std::uint32_t capture_unknown_format = ~0u;
+
+struct capture_create_window
+{
+    std::uint32_t ex_style;
+    std::uint32_t style;
+    std::int32_t x;
+    std::int32_t y;
+    std::int32_t width;
+    std::int32_t height;
+};
+
+struct capture_direct_draw_create
+{
+    capture_handle ddraw;
+};
+
+// the surfaces as the patcher created them, not as the game asked for them
+struct capture_create_surface
+{
+    capture_handle surface;
+    capture_surface_role role;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t bits;
+    // pixel_format or capture_unknown_format
+    std::uint32_t format;
+    std::uint32_t reserved;
+};
+
+// payload: 256 palette_entry when the game passed initial entries
+struct capture_create_palette
+{
+    capture_handle palette;
+    std::uint32_t flags;
+    std::uint32_t reserved;
+};
+
+// payload: count palette_entry
+struct capture_set_entries
+{
+    capture_handle palette;
+    std::uint32_t first;
+    std::uint32_t count;
+};
+
+// the DirectDraw flag values the replayer acts on, so it doesn't need ddraw.h
+inline constexpr std::uint32_t capture_blt_colorfill = 0x00000400;
+inline constexpr std::uint32_t capture_blt_keysrc = 0x00008000;
+inline constexpr std::uint32_t capture_blt_keysrcoverride = 0x00010000;
+inline constexpr std::uint32_t capture_bltfast_srccolorkey = 0x00000001;
+inline constexpr std::uint32_t capture_lock_readonly = 0x00000010;
+
+enum capture_rect_flags : std::uint32_t
+{
+    capture_has_dst_rect = 1,
+    capture_has_src_rect = 2,
+};
+
+// also used for every entry of a BltBatch
+struct capture_blt
+{
+    capture_handle dst;
+    capture_handle src;
+    raster_rect dst_rect;
+    raster_rect src_rect;
+    std::uint32_t rects;
+    std::uint32_t flags;
+    // from DDBLTFX, only meaningful with DDBLT_COLORFILL / DDBLT_KEYSRCOVERRIDE
+    std::uint32_t fill_color;
+    raster_color_key key;
+    std::uint32_t reserved;
+};
+
+struct capture_blt_fast
+{
+    capture_handle dst;
+    capture_handle src;
+    std::int32_t x;
+    std::int32_t y;
+    raster_rect src_rect;
+    std::uint32_t rects;
+    std::uint32_t flags;
+};
+
+struct capture_flip
+{
+    capture_handle surface;
+    std::uint32_t flags;
+    std::uint32_t reserved;
+};
+
+struct capture_lock
+{
+    capture_handle surface;
+    raster_rect rect;
+    std::uint32_t rects;
+    std::uint32_t flags;
+};
+
+// written when the lock is released, once the game is done writing
+// payload: the locked rect's rows, row_bytes each, top to bottom
+struct capture_unlock
+{
+    capture_handle surface;
+    raster_rect rect;
+    std::uint32_t row_bytes;
+    std::uint32_t rows;
+};
+
+// the key the patcher actually set, after translating the game's one to the surface format
+struct capture_set_color_key
+{
+    capture_handle surface;
+    std::uint32_t flags;
+    raster_color_key key;
+    std::uint32_t reserved;
+};
+
+// payload: name_length bytes of name, then file_size bytes of the .bmp file
+struct capture_load_image
+{
+    std::int32_t cx;
+    std::int32_t cy;
+    std::uint32_t name_length;
+    std::uint32_t file_size;
+};
+
+inline capture_handle capture_handle_of(const void *object)
+{
+    return reinterpret_cast<std::uintptr_t>(object);
+}
+
+inline std::atomic<bool> g_capture_enabled{};
+
+// open path and write the header, returns false if the file can't be created
+bool capture_start(const char *path);
+
+// flush and close the file, safe to call from DLL_PROCESS_DETACH
+void capture_stop();
+
+void capture_write(capture_call call, std::span<const std::span<const std::uint8_t>> parts);
+
+// hooks call each other and the patcher calls hooked methods on its own surfaces (locking for a software blit,
+// converting the image in Flip), only the outermost call on a thread is the game's, a capture_scope at the top of
+// each hook keeps track of that
+struct capture_scope
+{
+    capture_scope();
+    ~capture_scope();
+
+    capture_scope(const capture_scope &) = delete;
+    capture_scope &operator=(const capture_scope &) = delete;
+
+    // true when this is the outermost hook on the thread
+    bool outermost() const;
+};
+
+template <class T>
+std::span<const std::uint8_t> capture_bytes(const T &value)
+{
+    return {reinterpret_cast<const std::uint8_t *>(&value), sizeof(value)};
+}
+
+template <class T, class... Payload>
+void capture(const capture_scope &scope, capture_call call, const T &args, const Payload &...payload)
+{
+    if (!g_capture_enabled.load(std::memory_order_relaxed) || !scope.outermost())
+    {
+        return;
+    }
+
+    const std::array<std::span<const std::uint8_t>, 1 + sizeof...(Payload)> parts{
+        capture_bytes(args),
+        std::span<const std::uint8_t>{payload}...};
+    capture_write(call, parts);
+}
+
+// reading a capture back
+
+struct capture_entry
+{
+    capture_record record;
+    // args struct and payload
+    std::span<const std::uint8_t> body;
+};
+
+// check the header and return the records that follow it, false if this isn't a capture this build understands
+bool capture_open(std::span<const std::uint8_t> file, std::span<const std::uint8_t> &records);
+
+// take the next record off records, false at the end or on a truncated record
+bool capture_next(std::span<const std::uint8_t> &records, capture_entry &entry);
+
+// split a record body into its args struct and payload, false if the body is too short
+template <class T>
+bool capture_args(const capture_entry &entry, T &args, std::span<const std::uint8_t> &payload)
+{
+    if (entry.body.size() < sizeof(T))
+    {
+        return false;
+    }
+
+    std::memcpy(&args, entry.body.data(), sizeof(T));
+    payload = entry.body.subspan(sizeof(T));
+    return true;
+}
+
+const char *capture_call_name(capture_call call);
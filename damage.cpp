@@ -0,0 +1,182 @@
+#include "damage.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+
+std::int64_t area(const raster_rect &rect)
+{
+    return raster_rect_empty(rect) ? 0
+                                   : static_cast<std::int64_t>(rect.right - rect.left) * (rect.bottom - rect.top);
+}
+
+raster_rect bounding(const raster_rect &a, const raster_rect &b)
+{
+    return {
+        std::min(a.left, b.left),
+        std::min(a.top, b.top),
+        std::max(a.right, b.right),
+        std::max(a.bottom, b.bottom),
+    };
+}
+
+bool contains(const raster_rect &outer, const raster_rect &inner)
+{
+    return inner.left >= outer.left && inner.top >= outer.top && inner.right <= outer.right &&
+           inner.bottom <= outer.bottom;
+}
+
+// two rects whose bounding box covers nothing extra, e.g. neighbouring tiles in a row or column
+bool merges_exactly(const raster_rect &a, const raster_rect &b)
+{
+    const auto same_rows = a.top == b.top && a.bottom == b.bottom && a.left <= b.right && b.left <= a.right;
+    const auto same_columns = a.left == b.left && a.right == b.right && a.top <= b.bottom && b.top <= a.bottom;
+    return same_rows || same_columns;
+}
+
+// how much area that wasn't drawn would get copied by presenting the bounding box instead of both rects
+std::int64_t merge_cost(const raster_rect &a, const raster_rect &b)
+{
+    return area(bounding(a, b)) - area(a) - area(b) + area(raster_intersect(a, b));
+}
+
+// repeatedly combine the cheapest pair until at most count rects remain
+void merge_down(std::vector<raster_rect> &rects, std::size_t count)
+{
+    while (rects.size() > count)
+    {
+        auto best_cost = std::numeric_limits<std::int64_t>::max();
+        std::size_t best_a = 0;
+        std::size_t best_b = 1;
+
+        for (std::size_t a = 0; a < rects.size(); ++a)
+        {
+            for (auto b = a + 1; b < rects.size(); ++b)
+            {
+                const auto cost = merge_cost(rects[a], rects[b]);
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_a = a;
+                    best_b = b;
+                }
+            }
+        }
+
+        rects[best_a] = bounding(rects[best_a], rects[best_b]);
+        rects.erase(rects.begin() + static_cast<std::ptrdiff_t>(best_b));
+    }
+}
+
+}
+
+void damage_reset(damage_list &damage, std::uint32_t width, std::uint32_t height)
+{
+    damage.rects.clear();
+    damage.bounds = {0, 0, static_cast<std::int32_t>(width), static_cast<std::int32_t>(height)};
+    damage.full = false;
+}
+
+void damage_add(damage_list &damage, const raster_rect &rect)
+{
+    if (damage.full)
+    {
+        return;
+    }
+
+    auto pending = raster_intersect(rect, damage.bounds);
+    if (raster_rect_empty(pending))
+    {
+        return;
+    }
+
+    if (std::ranges::any_of(damage.rects, [&](const raster_rect &existing) { return contains(existing, pending); }))
+    {
+        return;
+    }
+
+    // swallow anything the new rect covers or lines up with exactly, growing it as we go
+    for (auto merged = true; merged;)
+    {
+        merged = false;
+        for (auto it = damage.rects.begin(); it != damage.rects.end();)
+        {
+            if (contains(pending, *it) || merges_exactly(pending, *it))
+            {
+                pending = bounding(pending, *it);
+                it = damage.rects.erase(it);
+                merged = true;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    if (pending.left == damage.bounds.left && pending.top == damage.bounds.top &&
+        pending.right == damage.bounds.right && pending.bottom == damage.bounds.bottom)
+    {
+        damage_add_full(damage);
+        return;
+    }
+
+    damage.rects.push_back(pending);
+    merge_down(damage.rects, damage_capacity);
+}
+
+void damage_add_full(damage_list &damage)
+{
+    damage.rects.assign(1, damage.bounds);
+    damage.full = true;
+}
+
+void damage_add_list(damage_list &damage, const damage_list &other)
+{
+    if (other.full)
+    {
+        damage_add_full(damage);
+        return;
+    }
+
+    for (const auto &rect : other.rects)
+    {
+        damage_add(damage, rect);
+    }
+}
+
+std::int64_t damage_area(const damage_list &damage)
+{
+    std::int64_t total = 0;
+    for (const auto &rect : damage.rects)
+    {
+        total += area(rect);
+    }
+    return total;
+}
+
+std::vector<raster_rect> damage_present_rects(const damage_list &damage, std::size_t max_rects, double full_threshold)
+{
+    if (damage.full)
+    {
+        return {damage.bounds};
+    }
+
+    auto rects = damage.rects;
+    merge_down(rects, std::max<std::size_t>(max_rects, 1));
+
+    std::int64_t covered = 0;
+    for (const auto &rect : rects)
+    {
+        covered += area(rect);
+    }
+
+    if (static_cast<double>(covered) > full_threshold * static_cast<double>(area(damage.bounds)))
+    {
+        return {damage.bounds};
+    }
+
+    return rects;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "raster.h"
+
+// per-frame record of the back buffer areas that were drawn to, so a present only has to copy those
+
+struct damage_list
+{
+    std::vector<raster_rect> rects{};
+    raster_rect bounds{};
+    bool full{};
+};
+
+// rects kept while a frame is collecting, past this the two cheapest to combine get merged on every add
+inline constexpr std::size_t damage_capacity = 64;
+
+// start a new frame for a width x height surface
+void damage_reset(damage_list &damage, std::uint32_t width, std::uint32_t height);
+
+void damage_add(damage_list &damage, const raster_rect &rect);
+
+void damage_add_full(damage_list &damage);
+
+// fold another frame's damage into this one, for when that frame is dropped before it reaches the screen
+void damage_add_list(damage_list &damage, const damage_list &other);
+
+std::int64_t damage_area(const damage_list &damage);
+
+// merge the frame's rects down to at most max_rects, if they'd cover more than full_threshold (0..1) of the surface
+// a single rect for the whole surface is returned instead as one big copy beats many smaller ones
+std::vector<raster_rect> damage_present_rects(const damage_list &damage, std::size_t max_rects, double full_threshold);
@@ -0,0 +1,316 @@
+#pragma once
+
+// the DirectDraw types and constants this project uses
+// on windows that's just the real headers, elsewhere it's a copy of the subset we need with the same layout, so the
+// vtable descriptions and soft_ddraw build on any platform
+
+#if defined(_WIN32)
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#include <ddraw.h>
+
+#else
+
+#include <cstdint>
+
+#define __stdcall
+#define WINAPI
+
+using BOOL = std::int32_t;
+using BYTE = std::uint8_t;
+using WORD = std::uint16_t;
+using DWORD = std::uint32_t;
+using LONG = std::int32_t;
+using ULONG = std::uint32_t;
+using HRESULT = std::int32_t;
+using LPVOID = void *;
+using LPDWORD = DWORD *;
+using LPLONG = LONG *;
+using HANDLE = void *;
+using HWND = struct HWND__ *;
+using HDC = struct HDC__ *;
+
+struct GUID
+{
+    std::uint32_t Data1;
+    std::uint16_t Data2;
+    std::uint16_t Data3;
+    std::uint8_t Data4[8];
+};
+using REFIID = const GUID &;
+using REFGUID = const GUID &;
+
+struct RECT
+{
+    LONG left;
+    LONG top;
+    LONG right;
+    LONG bottom;
+};
+using LPRECT = RECT *;
+
+struct RGNDATAHEADER
+{
+    DWORD dwSize;
+    DWORD iType;
+    DWORD nCount;
+    DWORD nRgnSize;
+    RECT rcBound;
+};
+
+struct RGNDATA
+{
+    RGNDATAHEADER rdh;
+    char Buffer[1];
+};
+using LPRGNDATA = RGNDATA *;
+
+struct PALETTEENTRY
+{
+    BYTE peRed;
+    BYTE peGreen;
+    BYTE peBlue;
+    BYTE peFlags;
+};
+using LPPALETTEENTRY = PALETTEENTRY *;
+
+// only ever handled through pointers, the vtable is the first thing in each object
+struct IUnknown;
+struct IDirectDraw;
+struct IDirectDrawSurface;
+struct IDirectDrawSurface7;
+struct IDirectDrawPalette;
+struct IDirectDrawClipper;
+
+using LPUNKNOWN = IUnknown *;
+using LPDIRECTDRAW = IDirectDraw *;
+using LPDIRECTDRAWSURFACE = IDirectDrawSurface *;
+using LPDIRECTDRAWSURFACE7 = IDirectDrawSurface7 *;
+using LPDIRECTDRAWPALETTE = IDirectDrawPalette *;
+using LPDIRECTDRAWCLIPPER = IDirectDrawClipper *;
+
+struct DDCOLORKEY
+{
+    DWORD dwColorSpaceLowValue;
+    DWORD dwColorSpaceHighValue;
+};
+using LPDDCOLORKEY = DDCOLORKEY *;
+
+struct DDPIXELFORMAT
+{
+    DWORD dwSize;
+    DWORD dwFlags;
+    DWORD dwFourCC;
+    DWORD dwRGBBitCount;
+    DWORD dwRBitMask;
+    DWORD dwGBitMask;
+    DWORD dwBBitMask;
+    DWORD dwRGBAlphaBitMask;
+};
+using LPDDPIXELFORMAT = DDPIXELFORMAT *;
+
+struct DDSCAPS2
+{
+    DWORD dwCaps;
+    DWORD dwCaps2;
+    DWORD dwCaps3;
+    DWORD dwCaps4;
+};
+using LPDDSCAPS2 = DDSCAPS2 *;
+
+struct DDSURFACEDESC2
+{
+    DWORD dwSize;
+    DWORD dwFlags;
+    DWORD dwHeight;
+    DWORD dwWidth;
+    LONG lPitch;
+    DWORD dwBackBufferCount;
+    DWORD dwRefreshRate;
+    DWORD dwAlphaBitDepth;
+    DWORD dwReserved;
+    LPVOID lpSurface;
+    DDCOLORKEY ddckCKDestOverlay;
+    DDCOLORKEY ddckCKDestBlt;
+    DDCOLORKEY ddckCKSrcOverlay;
+    DDCOLORKEY ddckCKSrcBlt;
+    DDPIXELFORMAT ddpfPixelFormat;
+    DDSCAPS2 ddsCaps;
+    DWORD dwTextureStage;
+};
+using LPDDSURFACEDESC2 = DDSURFACEDESC2 *;
+
+struct DDBLTFX
+{
+    DWORD dwSize;
+    DWORD dwDDFX;
+    DWORD dwROP;
+    DWORD dwDDROP;
+    DWORD dwRotationAngle;
+    DWORD dwZBufferOpCode;
+    DWORD dwZBufferLow;
+    DWORD dwZBufferHigh;
+    DWORD dwZBufferBaseDest;
+    DWORD dwZDestConstBitDepth;
+    union
+    {
+        DWORD dwZDestConst;
+        LPDIRECTDRAWSURFACE lpDDSZBufferDest;
+    };
+    DWORD dwZSrcConstBitDepth;
+    union
+    {
+        DWORD dwZSrcConst;
+        LPDIRECTDRAWSURFACE lpDDSZBufferSrc;
+    };
+    DWORD dwAlphaEdgeBlendBitDepth;
+    DWORD dwAlphaEdgeBlend;
+    DWORD dwReserved;
+    DWORD dwAlphaDestConstBitDepth;
+    union
+    {
+        DWORD dwAlphaDestConst;
+        LPDIRECTDRAWSURFACE lpDDSAlphaDest;
+    };
+    DWORD dwAlphaSrcConstBitDepth;
+    union
+    {
+        DWORD dwAlphaSrcConst;
+        LPDIRECTDRAWSURFACE lpDDSAlphaSrc;
+    };
+    union
+    {
+        DWORD dwFillColor;
+        DWORD dwFillDepth;
+        DWORD dwFillPixel;
+        LPDIRECTDRAWSURFACE lpDDSPattern;
+    };
+    DDCOLORKEY ddckDestColorkey;
+    DDCOLORKEY ddckSrcColorkey;
+};
+using LPDDBLTFX = DDBLTFX *;
+
+struct DDBLTBATCH
+{
+    LPRECT lprDest;
+    LPDIRECTDRAWSURFACE lpDDSSrc;
+    LPRECT lprSrc;
+    DWORD dwFlags;
+    LPDDBLTFX lpDDBltFx;
+};
+using LPDDBLTBATCH = DDBLTBATCH *;
+
+inline constexpr HRESULT make_ddhresult(DWORD code)
+{
+    return static_cast<HRESULT>(0x88760000u | code);
+}
+
+inline constexpr HRESULT DD_OK = 0;
+inline constexpr HRESULT E_NOINTERFACE = static_cast<HRESULT>(0x80004002u);
+inline constexpr HRESULT DDERR_UNSUPPORTED = static_cast<HRESULT>(0x80004001u);
+inline constexpr HRESULT DDERR_INVALIDPARAMS = static_cast<HRESULT>(0x80070057u);
+inline constexpr HRESULT DDERR_OUTOFMEMORY = static_cast<HRESULT>(0x8007000eu);
+inline constexpr HRESULT DDERR_INVALIDOBJECT = make_ddhresult(130);
+inline constexpr HRESULT DDERR_INVALIDPIXELFORMAT = make_ddhresult(145);
+inline constexpr HRESULT DDERR_INVALIDRECT = make_ddhresult(150);
+inline constexpr HRESULT DDERR_NOCLIPLIST = make_ddhresult(205);
+inline constexpr HRESULT DDERR_NOCOLORKEY = make_ddhresult(215);
+inline constexpr HRESULT DDERR_NOTFOUND = make_ddhresult(255);
+inline constexpr HRESULT DDERR_NOPALETTEATTACHED = make_ddhresult(280);
+inline constexpr HRESULT DDERR_NOTFLIPPABLE = make_ddhresult(300);
+inline constexpr HRESULT DDERR_SURFACEBUSY = make_ddhresult(430);
+inline constexpr HRESULT DDERR_NOCLIPPERATTACHED = make_ddhresult(570);
+inline constexpr HRESULT DDERR_NOTLOCKED = make_ddhresult(584);
+
+inline constexpr DWORD DDSD_CAPS = 0x00000001;
+inline constexpr DWORD DDSD_HEIGHT = 0x00000002;
+inline constexpr DWORD DDSD_WIDTH = 0x00000004;
+inline constexpr DWORD DDSD_PITCH = 0x00000008;
+inline constexpr DWORD DDSD_BACKBUFFERCOUNT = 0x00000020;
+inline constexpr DWORD DDSD_LPSURFACE = 0x00000800;
+inline constexpr DWORD DDSD_PIXELFORMAT = 0x00001000;
+inline constexpr DWORD DDSD_CKSRCBLT = 0x00010000;
+
+inline constexpr DWORD DDSCAPS_ALPHA = 0x00000002;
+inline constexpr DWORD DDSCAPS_BACKBUFFER = 0x00000004;
+inline constexpr DWORD DDSCAPS_COMPLEX = 0x00000008;
+inline constexpr DWORD DDSCAPS_FLIP = 0x00000010;
+inline constexpr DWORD DDSCAPS_FRONTBUFFER = 0x00000020;
+inline constexpr DWORD DDSCAPS_OFFSCREENPLAIN = 0x00000040;
+inline constexpr DWORD DDSCAPS_OVERLAY = 0x00000080;
+inline constexpr DWORD DDSCAPS_PALETTE = 0x00000100;
+inline constexpr DWORD DDSCAPS_PRIMARYSURFACE = 0x00000200;
+inline constexpr DWORD DDSCAPS_PRIMARYSURFACELEFT = 0x00000000;
+inline constexpr DWORD DDSCAPS_SYSTEMMEMORY = 0x00000800;
+inline constexpr DWORD DDSCAPS_TEXTURE = 0x00001000;
+inline constexpr DWORD DDSCAPS_3DDEVICE = 0x00002000;
+inline constexpr DWORD DDSCAPS_VIDEOMEMORY = 0x00004000;
+inline constexpr DWORD DDSCAPS_VISIBLE = 0x00008000;
+inline constexpr DWORD DDSCAPS_WRITEONLY = 0x00010000;
+inline constexpr DWORD DDSCAPS_ZBUFFER = 0x00020000;
+inline constexpr DWORD DDSCAPS_OWNDC = 0x00040000;
+inline constexpr DWORD DDSCAPS_LIVEVIDEO = 0x00080000;
+inline constexpr DWORD DDSCAPS_HWCODEC = 0x00100000;
+inline constexpr DWORD DDSCAPS_MODEX = 0x00200000;
+inline constexpr DWORD DDSCAPS_MIPMAP = 0x00400000;
+inline constexpr DWORD DDSCAPS_ALLOCONLOAD = 0x04000000;
+inline constexpr DWORD DDSCAPS_VIDEOPORT = 0x08000000;
+inline constexpr DWORD DDSCAPS_LOCALVIDMEM = 0x10000000;
+inline constexpr DWORD DDSCAPS_NONLOCALVIDMEM = 0x20000000;
+inline constexpr DWORD DDSCAPS_STANDARDVGAMODE = 0x40000000;
+inline constexpr DWORD DDSCAPS_OPTIMIZED = 0x80000000;
+
+inline constexpr DWORD DDPF_ALPHAPIXELS = 0x00000001;
+inline constexpr DWORD DDPF_PALETTEINDEXED8 = 0x00000020;
+inline constexpr DWORD DDPF_RGB = 0x00000040;
+
+inline constexpr DWORD DDBLT_ASYNC = 0x00000200;
+inline constexpr DWORD DDBLT_COLORFILL = 0x00000400;
+inline constexpr DWORD DDBLT_KEYSRC = 0x00008000;
+inline constexpr DWORD DDBLT_KEYSRCOVERRIDE = 0x00010000;
+inline constexpr DWORD DDBLT_WAIT = 0x01000000;
+inline constexpr DWORD DDBLT_DONOTWAIT = 0x08000000;
+
+inline constexpr DWORD DDBLTFAST_NOCOLORKEY = 0x00000000;
+inline constexpr DWORD DDBLTFAST_SRCCOLORKEY = 0x00000001;
+inline constexpr DWORD DDBLTFAST_WAIT = 0x00000010;
+
+inline constexpr DWORD DDLOCK_WAIT = 0x00000001;
+inline constexpr DWORD DDLOCK_READONLY = 0x00000010;
+inline constexpr DWORD DDLOCK_WRITEONLY = 0x00000020;
+
+inline constexpr DWORD DDCKEY_SRCBLT = 0x00000008;
+
+inline constexpr DWORD DDPCAPS_4BIT = 0x00000001;
+inline constexpr DWORD DDPCAPS_8BITENTRIES = 0x00000002;
+inline constexpr DWORD DDPCAPS_8BIT = 0x00000004;
+inline constexpr DWORD DDPCAPS_PRIMARYSURFACE = 0x00000010;
+inline constexpr DWORD DDPCAPS_PRIMARYSURFACELEFT = 0x00000020;
+inline constexpr DWORD DDPCAPS_ALLOW256 = 0x00000040;
+inline constexpr DWORD DDPCAPS_VSYNC = 0x00000080;
+inline constexpr DWORD DDPCAPS_1BIT = 0x00000100;
+inline constexpr DWORD DDPCAPS_2BIT = 0x00000200;
+inline constexpr DWORD DDPCAPS_ALPHA = 0x00000400;
+
+inline constexpr DWORD DDSCL_FULLSCREEN = 0x00000001;
+inline constexpr DWORD DDSCL_NORMAL = 0x00000008;
+inline constexpr DWORD DDSCL_EXCLUSIVE = 0x00000010;
+inline constexpr DWORD DDSCL_MULTITHREADED = 0x00000400;
+
+inline constexpr DWORD DDFLIP_WAIT = 0x00000001;
+
+// LoadImage flags from WinUser.h, for decoding the game's LoadImageA calls
+inline constexpr DWORD LR_DEFAULTCOLOR = 0x00000000;
+inline constexpr DWORD LR_MONOCHROME = 0x00000001;
+inline constexpr DWORD LR_LOADFROMFILE = 0x00000010;
+inline constexpr DWORD LR_LOADTRANSPARENT = 0x00000020;
+inline constexpr DWORD LR_DEFAULTSIZE = 0x00000040;
+inline constexpr DWORD LR_VGACOLOR = 0x00000080;
+inline constexpr DWORD LR_LOADMAP3DCOLORS = 0x00001000;
+inline constexpr DWORD LR_CREATEDIBSECTION = 0x00002000;
+inline constexpr DWORD LR_SHARED = 0x00008000;
+
+#endif
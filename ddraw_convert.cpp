@@ -0,0 +1,127 @@
+#include "ddraw_convert.h"
+
+static_assert(capture_blt_colorfill == DDBLT_COLORFILL);
+static_assert(capture_blt_keysrc == DDBLT_KEYSRC);
+static_assert(capture_blt_keysrcoverride == DDBLT_KEYSRCOVERRIDE);
+static_assert(capture_bltfast_srccolorkey == DDBLTFAST_SRCCOLORKEY);
+static_assert(capture_lock_readonly == DDLOCK_READONLY);
+
+std::optional<pixel_format> to_pixel_format(const DDPIXELFORMAT &format)
+{
+    if (format.dwFlags & DDPF_PALETTEINDEXED8)
+    {
+        return pixel_format::indexed8;
+    }
+    if (!(format.dwFlags & DDPF_RGB))
+    {
+        return std::nullopt;
+    }
+
+    switch (format.dwRGBBitCount)
+    {
+        case 15: return pixel_format::rgb555;
+        case 16: return format.dwGBitMask == 0x03e0 ? pixel_format::rgb555 : pixel_format::rgb565;
+        case 24: return pixel_format::rgb888;
+        case 32: return pixel_format::argb8888;
+        default: return std::nullopt;
+    }
+}
+
+DDPIXELFORMAT to_ddpixelformat(pixel_format format)
+{
+    DDPIXELFORMAT result{};
+    result.dwSize = sizeof(result);
+    result.dwFlags = DDPF_RGB;
+
+    switch (format)
+    {
+        case pixel_format::rgb555:
+            result.dwRGBBitCount = 16;
+            result.dwRBitMask = 0x7c00;
+            result.dwGBitMask = 0x03e0;
+            result.dwBBitMask = 0x001f;
+            break;
+        case pixel_format::rgb565:
+            result.dwRGBBitCount = 16;
+            result.dwRBitMask = 0xf800;
+            result.dwGBitMask = 0x07e0;
+            result.dwBBitMask = 0x001f;
+            break;
+        case pixel_format::rgb888:
+        case pixel_format::argb8888:
+            result.dwRGBBitCount = format == pixel_format::rgb888 ? 24 : 32;
+            result.dwRBitMask = 0x00ff0000;
+            result.dwGBitMask = 0x0000ff00;
+            result.dwBBitMask = 0x000000ff;
+            break;
+        case pixel_format::indexed8:
+            result.dwFlags = DDPF_PALETTEINDEXED8 | DDPF_RGB;
+            result.dwRGBBitCount = 8;
+            break;
+    }
+    return result;
+}
+
+raster_rect to_raster_rect(const RECT &rect)
+{
+    return {rect.left, rect.top, rect.right, rect.bottom};
+}
+
+RECT to_rect(const raster_rect &rect)
+{
+    return {rect.left, rect.top, rect.right, rect.bottom};
+}
+
+raster_color_key to_raster_color_key(const DDCOLORKEY &key)
+{
+    return {key.dwColorSpaceLowValue, key.dwColorSpaceHighValue};
+}
+
+std::vector<raster_rect> region_rects(const RGNDATA &region)
+{
+    std::vector<raster_rect> rects{};
+    rects.reserve(region.rdh.nCount);
+
+    const auto *first = reinterpret_cast<const RECT *>(region.Buffer);
+    for (DWORD i = 0; i < region.rdh.nCount; ++i)
+    {
+        rects.push_back(to_raster_rect(first[i]));
+    }
+    return rects;
+}
+
+capture_blt capture_blt_args(
+    void *dst,
+    const RECT *dst_rect,
+    void *src,
+    const RECT *src_rect,
+    DWORD flags,
+    const DDBLTFX *fx)
+{
+    capture_blt args{
+        .dst = capture_handle_of(dst),
+        .src = capture_handle_of(src),
+        .dst_rect = {},
+        .src_rect = {},
+        .rects = 0,
+        .flags = flags,
+        .fill_color = 0,
+        .key = {},
+        .reserved = 0};
+    if (dst_rect != nullptr)
+    {
+        args.dst_rect = to_raster_rect(*dst_rect);
+        args.rects |= capture_has_dst_rect;
+    }
+    if (src_rect != nullptr)
+    {
+        args.src_rect = to_raster_rect(*src_rect);
+        args.rects |= capture_has_src_rect;
+    }
+    if (fx != nullptr)
+    {
+        args.fill_color = fx->dwFillColor;
+        args.key = to_raster_color_key(fx->ddckSrcColorkey);
+    }
+    return args;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "capture.h"
+#include "ddraw_compat.h"
+#include "raster.h"
+
+// DirectDraw structs to and from the portable types the raster engine and the capture format use, shared by the hooks
+// in main.cpp and by soft_ddraw
+
+// 15 and 16 bpp with a 5 bit green mask are rgb555, nullopt for fourcc, 1/2/4 bit palettes and other odd formats
+std::optional<pixel_format> to_pixel_format(const DDPIXELFORMAT &format);
+
+DDPIXELFORMAT to_ddpixelformat(pixel_format format);
+
+raster_rect to_raster_rect(const RECT &rect);
+
+RECT to_rect(const raster_rect &rect);
+
+raster_color_key to_raster_color_key(const DDCOLORKEY &key);
+
+// the rects of a clip list as GetClipList returns it
+std::vector<raster_rect> region_rects(const RGNDATA &region);
+
+// a Blt as the replayer needs it, rects and the parts of DDBLTFX the raster engine uses copied in
+capture_blt capture_blt_args(
+    void *dst,
+    const RECT *dst_rect,
+    void *src,
+    const RECT *src_rect,
+    DWORD flags,
+    const DDBLTFX *fx);
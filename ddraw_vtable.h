@@ -0,0 +1,106 @@
+#pragma once
+
+#include "ddraw_compat.h"
+#include "vtable.h"
+
+// the DirectDraw methods this project patches, by vtable slot, byte offsets in the comments are for the x86 build
+
+namespace ddraw_method
+{
+
+using create_palette = vtable_method<
+    IDirectDraw,
+    5, // 0x14
+    HRESULT(__stdcall *)(void *, DWORD, LPPALETTEENTRY, LPDIRECTDRAWPALETTE *, IUnknown *)>;
+
+using create_surface = vtable_method<
+    IDirectDraw,
+    6, // 0x18
+    HRESULT(__stdcall *)(void *, LPDDSURFACEDESC2, LPDIRECTDRAWSURFACE7 *, IUnknown *)>;
+
+using set_cooperative_level = vtable_method<
+    IDirectDraw,
+    20, // 0x50
+    HRESULT(__stdcall *)(void *, HWND, DWORD)>;
+
+using set_display_mode = vtable_method<
+    IDirectDraw,
+    21, // 0x54
+    HRESULT(__stdcall *)(void *, DWORD, DWORD, DWORD)>;
+
+}
+
+namespace surface_method
+{
+
+using blt = vtable_method<
+    IDirectDrawSurface7,
+    5, // 0x14
+    HRESULT(__stdcall *)(void *, LPRECT, LPDIRECTDRAWSURFACE7, LPRECT, DWORD, LPDDBLTFX)>;
+
+using blt_batch = vtable_method<
+    IDirectDrawSurface7,
+    6, // 0x18
+    HRESULT(__stdcall *)(void *, LPDDBLTBATCH, DWORD, DWORD)>;
+
+using blt_fast = vtable_method<
+    IDirectDrawSurface7,
+    7, // 0x1c
+    HRESULT(__stdcall *)(void *, DWORD, DWORD, LPDIRECTDRAWSURFACE7, LPRECT, DWORD)>;
+
+using flip = vtable_method<
+    IDirectDrawSurface7,
+    11, // 0x2c
+    HRESULT(__stdcall *)(void *, LPDIRECTDRAWSURFACE7, DWORD)>;
+
+using get_attached_surface = vtable_method<
+    IDirectDrawSurface7,
+    12, // 0x30
+    HRESULT(__stdcall *)(void *, LPDDSCAPS2, LPDIRECTDRAWSURFACE7 *)>;
+
+using get_pixel_format = vtable_method<
+    IDirectDrawSurface7,
+    21, // 0x54
+    HRESULT(__stdcall *)(void *, LPDDPIXELFORMAT)>;
+
+using lock = vtable_method<
+    IDirectDrawSurface7,
+    25, // 0x64
+    HRESULT(__stdcall *)(void *, LPRECT, LPDDSURFACEDESC2, DWORD, HANDLE)>;
+
+using set_color_key = vtable_method<
+    IDirectDrawSurface7,
+    29, // 0x74
+    HRESULT(__stdcall *)(void *, DWORD, LPDDCOLORKEY)>;
+
+using set_palette = vtable_method<
+    IDirectDrawSurface7,
+    31, // 0x7c
+    HRESULT(__stdcall *)(void *, LPDIRECTDRAWPALETTE)>;
+
+using unlock = vtable_method<
+    IDirectDrawSurface7,
+    32, // 0x80
+    HRESULT(__stdcall *)(void *, LPRECT)>;
+
+}
+
+namespace palette_method
+{
+
+using set_entries = vtable_method<
+    IDirectDrawPalette,
+    6, // 0x18
+    HRESULT(__stdcall *)(void *, DWORD, DWORD, DWORD, LPPALETTEENTRY)>;
+
+}
+
+#if defined(_M_IX86)
+static_assert(ddraw_method::create_surface::offset == 0x18);
+static_assert(ddraw_method::set_cooperative_level::offset == 0x50);
+static_assert(surface_method::blt::offset == 0x14);
+static_assert(surface_method::flip::offset == 0x2c);
+static_assert(surface_method::lock::offset == 0x64);
+static_assert(surface_method::unlock::offset == 0x80);
+static_assert(palette_method::set_entries::offset == 0x18);
+#endif
@@ -0,0 +1,94 @@
+#include "flags.h"
+
+#include <tuple>
+#include <vector>
+
+#include "ddraw_compat.h"
+
+namespace
+{
+
+std::vector<std::tuple<std::uint32_t, std::string>> ddcaps_map{
+    {DDSCAPS_3DDEVICE, "DDSCAPS_3DDEVICE"},
+    {DDSCAPS_ALLOCONLOAD, "DDSCAPS_ALLOCONLOAD"},
+    {DDSCAPS_ALPHA, "DDSCAPS_ALPHA"},
+    {DDSCAPS_BACKBUFFER, "DDSCAPS_BACKBUFFER"},
+    {DDSCAPS_COMPLEX, "DDSCAPS_COMPLEX"},
+    {DDSCAPS_FLIP, "DDSCAPS_FLIP"},
+    {DDSCAPS_FRONTBUFFER, "DDSCAPS_FRONTBUFFER"},
+    {DDSCAPS_HWCODEC, "DDSCAPS_HWCODEC"},
+    {DDSCAPS_LIVEVIDEO, "DDSCAPS_LIVEVIDEO"},
+    {DDSCAPS_LOCALVIDMEM, "DDSCAPS_LOCALVIDMEM"},
+    {DDSCAPS_MIPMAP, "DDSCAPS_MIPMAP"},
+    {DDSCAPS_MODEX, "DDSCAPS_MODEX"},
+    {DDSCAPS_NONLOCALVIDMEM, "DDSCAPS_NONLOCALVIDMEM"},
+    {DDSCAPS_OFFSCREENPLAIN, "DDSCAPS_OFFSCREENPLAIN"},
+    {DDSCAPS_OVERLAY, "DDSCAPS_OVERLAY"},
+    {DDSCAPS_OPTIMIZED, "DDSCAPS_OPTIMIZED"},
+    {DDSCAPS_OWNDC, "DDSCAPS_OWNDC"},
+    {DDSCAPS_PALETTE, "DDSCAPS_PALETTE"},
+    {DDSCAPS_PRIMARYSURFACE, "DDSCAPS_PRIMARYSURFACE"},
+    {DDSCAPS_PRIMARYSURFACELEFT, "DDSCAPS_PRIMARYSURFACELEFT"},
+    {DDSCAPS_STANDARDVGAMODE, "DDSCAPS_STANDARDVGAMODE"},
+    {DDSCAPS_SYSTEMMEMORY, "DDSCAPS_SYSTEMMEMORY"},
+    {DDSCAPS_TEXTURE, "DDSCAPS_TEXTURE"},
+    {DDSCAPS_VIDEOMEMORY, "DDSCAPS_VIDEOMEMORY"},
+    {DDSCAPS_VIDEOPORT, "DDSCAPS_VIDEOPORT"},
+    {DDSCAPS_VISIBLE, "DDSCAPS_VISIBLE"},
+    {DDSCAPS_WRITEONLY, "DDSCAPS_WRITEONLY"},
+    {DDSCAPS_ZBUFFER, "DDSCAPS_ZBUFFER"}};
+
+std::vector<std::tuple<std::uint32_t, std::string>> fuload_map{
+    {LR_CREATEDIBSECTION, "LR_CREATEDIBSECTION"},
+    {LR_DEFAULTCOLOR, "LR_DEFAULTCOLOR"},
+    {LR_DEFAULTSIZE, "LR_DEFAULTSIZE"},
+    {LR_LOADFROMFILE, "LR_LOADFROMFILE"},
+    {LR_LOADMAP3DCOLORS, "LR_LOADMAP3DCOLORS"},
+    {LR_LOADTRANSPARENT, "LR_LOADTRANSPARENT"},
+    {LR_MONOCHROME, "LR_MONOCHROME"},
+    {LR_SHARED, "LR_SHARED"},
+    {LR_VGACOLOR, "LR_VGACOLOR"}};
+
+std::vector<std::tuple<std::uint32_t, std::string>> palette_caps_maps{
+    {DDPCAPS_1BIT, "DDPCAPS_1BIT"},
+    {DDPCAPS_2BIT, "DDPCAPS_2BIT"},
+    {DDPCAPS_4BIT, "DDPCAPS_4BIT"},
+    {DDPCAPS_8BIT, "DDPCAPS_8BIT"},
+    {DDPCAPS_8BITENTRIES, "DDPCAPS_8BITENTRIES"},
+    {DDPCAPS_ALPHA, "DDPCAPS_ALPHA"},
+    {DDPCAPS_ALLOW256, "DDPCAPS_ALLOW256"},
+    {DDPCAPS_PRIMARYSURFACE, "DDPCAPS_PRIMARYSURFACE"},
+    {DDPCAPS_PRIMARYSURFACELEFT, "DDPCAPS_PRIMARYSURFACELEFT"},
+    {DDPCAPS_VSYNC, "DDPCAPS_VSYNC"}};
+
+// a plain loop rather than views::join_with | ranges::to, which older libstdc++ and libc++ don't have yet
+std::string flags_to_string(const auto &map, std::uint32_t flag)
+{
+    std::string result{};
+    for (const auto &[value, name] : map)
+    {
+        if (flag & value)
+        {
+            result += result.empty() ? "" : "|";
+            result += name;
+        }
+    }
+    return result;
+}
+
+}
+
+std::string ddcaps_to_string(std::uint32_t ddcaps)
+{
+    return flags_to_string(ddcaps_map, ddcaps);
+}
+
+std::string fuload_to_string(std::uint32_t fuload)
+{
+    return flags_to_string(fuload_map, fuload);
+}
+
+std::string palette_caps_to_string(std::uint32_t palette_caps)
+{
+    return flags_to_string(palette_caps_maps, palette_caps);
+}
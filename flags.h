@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// render flag words as NAME|NAME|... for logs and the trace decoder
+
+std::string ddcaps_to_string(std::uint32_t ddcaps);
+
+std::string fuload_to_string(std::uint32_t fuload);
+
+std::string palette_caps_to_string(std::uint32_t palette_caps);
@@ -0,0 +1,104 @@
+#include "hash.h"
+
+#include <bit>
+#include <cstring>
+
+namespace
+{
+
+constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87ull;
+constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr std::uint64_t prime3 = 0x165667B19E3779F9ull;
+constexpr std::uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+constexpr std::uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+// the reference implementation reads little endian, which is all this project runs on
+std::uint64_t read_u64(const std::uint8_t *p)
+{
+    std::uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+std::uint32_t read_u32(const std::uint8_t *p)
+{
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+std::uint64_t round(std::uint64_t acc, std::uint64_t input)
+{
+    acc += input * prime2;
+    acc = std::rotl(acc, 31);
+    return acc * prime1;
+}
+
+std::uint64_t merge_round(std::uint64_t acc, std::uint64_t value)
+{
+    acc ^= round(0, value);
+    return acc * prime1 + prime4;
+}
+
+}
+
+std::uint64_t hash_bytes(std::span<const std::uint8_t> bytes, std::uint64_t seed)
+{
+    const auto *p = bytes.data();
+    const auto *end = p + bytes.size();
+
+    std::uint64_t hash{};
+    if (bytes.size() >= 32)
+    {
+        // four independent lanes over 32 byte stripes keep the multiplier busy
+        auto v1 = seed + prime1 + prime2;
+        auto v2 = seed + prime2;
+        auto v3 = seed;
+        auto v4 = seed - prime1;
+
+        for (; p + 32 <= end; p += 32)
+        {
+            v1 = round(v1, read_u64(p));
+            v2 = round(v2, read_u64(p + 8));
+            v3 = round(v3, read_u64(p + 16));
+            v4 = round(v4, read_u64(p + 24));
+        }
+
+        hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        hash = merge_round(hash, v1);
+        hash = merge_round(hash, v2);
+        hash = merge_round(hash, v3);
+        hash = merge_round(hash, v4);
+    }
+    else
+    {
+        hash = seed + prime5;
+    }
+
+    hash += bytes.size();
+
+    for (; p + 8 <= end; p += 8)
+    {
+        hash ^= round(0, read_u64(p));
+        hash = std::rotl(hash, 27) * prime1 + prime4;
+    }
+    if (p + 4 <= end)
+    {
+        hash ^= read_u32(p) * prime1;
+        hash = std::rotl(hash, 23) * prime2 + prime3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+    {
+        hash ^= *p * prime5;
+        hash = std::rotl(hash, 11) * prime1;
+    }
+
+    // final avalanche
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+// xxh64, fast enough to hash a whole asset file on every load and stable across builds and machines, so it can key
+// things written to disk
+std::uint64_t hash_bytes(std::span<const std::uint8_t> bytes, std::uint64_t seed = 0);
@@ -0,0 +1,202 @@
+#include "hook_set.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <span>
+
+namespace
+{
+
+// commits and rollbacks of different sets can share pages, one at a time keeps them from closing a page on each other
+std::mutex g_hook_mutex;
+
+std::atomic_ref<std::uintptr_t> slot_ref(std::uintptr_t slot)
+{
+    return std::atomic_ref<std::uintptr_t>{*reinterpret_cast<std::uintptr_t *>(slot)};
+}
+
+std::uintptr_t page_of(std::uintptr_t slot, const hook_memory &memory)
+{
+    return slot - slot % memory.page_size;
+}
+
+// patches of the set in slot order, of those applied or not
+std::vector<std::size_t> patch_order(const hook_set &set, bool applied)
+{
+    std::vector<std::size_t> order;
+    for (std::size_t i = 0; i < set.patches.size(); ++i)
+    {
+        if (set.patches[i].applied == applied)
+        {
+            order.push_back(i);
+        }
+    }
+    std::ranges::sort(order, {}, [&](std::size_t i) { return set.patches[i].slot; });
+    return order;
+}
+
+// open each page the patches in order sit on once, hand fn the run of them on it and close it again
+template <class F>
+hook_set_error for_each_page(hook_set &set, std::span<const std::size_t> order, const hook_memory &memory, F &&fn)
+{
+    auto error = hook_set_error::none;
+    for (std::size_t first = 0; first < order.size() && error == hook_set_error::none;)
+    {
+        const auto page = page_of(set.patches[order[first]].slot, memory);
+        auto last = first;
+        while (last < order.size() && page_of(set.patches[order[last]].slot, memory) == page)
+        {
+            ++last;
+        }
+        const auto size = set.patches[order[last - 1]].slot + sizeof(std::uintptr_t) - page;
+
+        std::uint32_t old{};
+        if (!memory.unprotect(page, size, old))
+        {
+            return hook_set_error::protect_failed;
+        }
+        ++set.last_pages;
+
+        error = fn(order.subspan(first, last - first));
+
+        if (!memory.restore(page, size, old) && error == hook_set_error::none)
+        {
+            error = hook_set_error::protect_failed;
+        }
+        first = last;
+    }
+    return error;
+}
+
+// put the original back in every applied slot of order that still holds our replacement, a slot something else
+// patched over ours keeps that, putting our original back would unhook it too
+hook_set_error undo(hook_set &set, std::span<const std::size_t> order, const hook_memory &memory)
+{
+    return for_each_page(
+        set,
+        order,
+        memory,
+        [&](std::span<const std::size_t> run)
+        {
+            for (const auto i : run)
+            {
+                auto &patch = set.patches[i];
+                auto expected = patch.replacement;
+                if (patch.applied)
+                {
+                    slot_ref(patch.slot).compare_exchange_strong(expected, patch.original, std::memory_order_acq_rel);
+                    patch.applied = false;
+                }
+            }
+            return hook_set_error::none;
+        });
+}
+
+bool always_writable(std::uintptr_t, std::size_t, std::uint32_t &old)
+{
+    old = 0;
+    return true;
+}
+
+bool nothing_to_restore(std::uintptr_t, std::size_t, std::uint32_t)
+{
+    return true;
+}
+
+}
+
+const hook_memory g_writable_memory{
+    .page_size = 4096,
+    .unprotect = always_writable,
+    .restore = nothing_to_restore,
+};
+
+const char *hook_set_error_name(hook_set_error error)
+{
+    switch (error)
+    {
+        case hook_set_error::none: return "none";
+        case hook_set_error::protect_failed: return "protect failed";
+        case hook_set_error::slot_changed: return "slot changed";
+        case hook_set_error::verify_failed: return "verify failed";
+    }
+    return "?";
+}
+
+bool hook_set_add(hook_set &set, std::uintptr_t slot, std::uintptr_t replacement)
+{
+    if (slot % sizeof(std::uintptr_t) != 0)
+    {
+        return false;
+    }
+
+    const auto current = slot_ref(slot).load(std::memory_order_acquire);
+    if (current == replacement ||
+        std::ranges::any_of(set.patches, [&](const hook_patch &patch) { return patch.slot == slot; }))
+    {
+        return true;
+    }
+
+    set.patches.push_back({.slot = slot, .replacement = replacement, .original = current, .applied = false});
+    return true;
+}
+
+hook_set_error hook_set_commit(hook_set &set, const hook_memory &memory)
+{
+    const std::scoped_lock lock{g_hook_mutex};
+
+    set.last_pages = 0;
+    const auto pending = patch_order(set, false);
+
+    const auto error = for_each_page(
+        set,
+        pending,
+        memory,
+        [&](std::span<const std::size_t> run)
+        {
+            for (const auto i : run)
+            {
+                auto &patch = set.patches[i];
+                auto expected = patch.original;
+                if (!slot_ref(patch.slot).compare_exchange_strong(
+                        expected,
+                        patch.replacement,
+                        std::memory_order_acq_rel))
+                {
+                    return hook_set_error::slot_changed;
+                }
+                patch.applied = true;
+            }
+
+            // read the whole page's worth back before closing it
+            for (const auto i : run)
+            {
+                const auto &patch = set.patches[i];
+                if (slot_ref(patch.slot).load(std::memory_order_acquire) != patch.replacement)
+                {
+                    return hook_set_error::verify_failed;
+                }
+            }
+            return hook_set_error::none;
+        });
+
+    if (error != hook_set_error::none)
+    {
+        undo(set, pending, memory);
+        std::erase_if(set.patches, [](const hook_patch &patch) { return !patch.applied; });
+    }
+    return error;
+}
+
+hook_set_error hook_set_rollback(hook_set &set, const hook_memory &memory)
+{
+    const std::scoped_lock lock{g_hook_mutex};
+
+    set.last_pages = 0;
+    const auto error = undo(set, patch_order(set, true), memory);
+
+    // patches on a page that couldn't be opened stay applied and in the set
+    std::erase_if(set.patches, [](const hook_patch &patch) { return !patch.applied; });
+    return error;
+}
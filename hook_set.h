@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// pointer slots (iat entries, COM vtable slots) to patch, collected first and written together
+// a commit opens each page once however many slots it holds, swaps every slot with a compare exchange against what
+// it held when it was added and reads it back, if any of that fails the slots already written get their old pointer
+// back so a set is either all in or not in at all, the originals stay in the set so it can be rolled back later
+
+// how to open a page for writing and close it again, VirtualProtect in the dll, nothing for the soft_ddraw vtables
+struct hook_memory
+{
+    std::size_t page_size;
+
+    // make [address, address + size) writable, old gets what to hand back to restore
+    bool (*unprotect)(std::uintptr_t address, std::size_t size, std::uint32_t &old);
+    bool (*restore)(std::uintptr_t address, std::size_t size, std::uint32_t old);
+};
+
+// for memory that is always writable
+extern const hook_memory g_writable_memory;
+
+struct hook_patch
+{
+    std::uintptr_t slot;
+    std::uintptr_t replacement;
+    // what the slot held when the patch was added, put back by a rollback
+    std::uintptr_t original;
+    bool applied;
+};
+
+enum class hook_set_error : std::uint8_t
+{
+    none,
+    // a page couldn't be made writable or its protection put back
+    protect_failed,
+    // something else wrote the slot between hook_set_add and the commit
+    slot_changed,
+    // the slot didn't read back as the replacement
+    verify_failed,
+};
+
+const char *hook_set_error_name(hook_set_error error);
+
+struct hook_set
+{
+    std::vector<hook_patch> patches;
+
+    // protection changes the last commit or rollback made, one per page opened
+    std::uint32_t last_pages;
+};
+
+// queue a patch of the pointer at slot with another, useful for IAT hooking but can be abused for other patching
+// needs, false for a slot that isn't pointer aligned
+// a slot that already holds replacement or is queued already is left alone
+bool hook_set_add(hook_set &set, std::uintptr_t slot, std::uintptr_t replacement);
+
+// write every queued patch, on failure the set is as it was before the call and the queued patches are dropped
+hook_set_error hook_set_commit(hook_set &set, const hook_memory &memory);
+
+// put the originals back in every applied slot that still holds our replacement and empty the set
+hook_set_error hook_set_rollback(hook_set &set, const hook_memory &memory);
@@ -0,0 +1,119 @@
+#include "hook_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+std::array<hook_counters, static_cast<std::size_t>(trace_event::count)> g_counters{};
+
+// when hook_stats_start ran, in both clocks
+std::uint64_t g_start_ticks{};
+std::uint64_t g_start_ns{};
+
+}
+
+void latency_record(latency_histogram &histogram, std::uint64_t ticks)
+{
+    histogram.buckets[latency_bucket(ticks)].fetch_add(1, std::memory_order_relaxed);
+    histogram.count.fetch_add(1, std::memory_order_relaxed);
+    histogram.total.fetch_add(ticks, std::memory_order_relaxed);
+
+    auto max = histogram.max.load(std::memory_order_relaxed);
+    while (ticks > max && !histogram.max.compare_exchange_weak(max, ticks, std::memory_order_relaxed))
+    {
+    }
+}
+
+std::uint64_t latency_percentile(const latency_histogram &histogram, double q)
+{
+    const auto count = histogram.count.load(std::memory_order_relaxed);
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    // rank of the sample we want, 1 based so q=0 is the smallest and q=1 the largest
+    const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(count))));
+
+    std::uint64_t seen = 0;
+    for (std::size_t bucket = 0; bucket < latency_bucket_count; ++bucket)
+    {
+        seen += histogram.buckets[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            // the bucket bound can overshoot the real worst case, never report past it
+            return std::min(latency_bucket_upper(bucket), histogram.max.load(std::memory_order_relaxed));
+        }
+    }
+
+    return histogram.max.load(std::memory_order_relaxed);
+}
+
+void hook_stats_start()
+{
+    g_start_ticks = hook_stats_ticks();
+    g_start_ns = trace_now();
+    g_hook_stats_enabled.store(true, std::memory_order_relaxed);
+}
+
+hook_counters &hook_stats_for(trace_event event)
+{
+    return g_counters[static_cast<std::size_t>(event)];
+}
+
+void hook_stats_dump(std::FILE *out, std::uint64_t frames)
+{
+    // the tick rate is measured over the whole session rather than assumed, this relies on the cycle counter running
+    // at a constant rate, which every cpu since the mid 2000s does
+    const auto elapsed_ticks = hook_stats_ticks() - g_start_ticks;
+    const auto us_per_tick =
+        elapsed_ticks != 0 ? static_cast<double>(trace_now() - g_start_ns) / 1000.0 / static_cast<double>(elapsed_ticks)
+                           : 0.0;
+    const auto to_us = [us_per_tick](std::uint64_t ticks) { return static_cast<double>(ticks) * us_per_tick; };
+
+    std::fprintf(out, "hook stats after %llu frames, times in us\n", static_cast<unsigned long long>(frames));
+    std::fprintf(
+        out,
+        "%-20s %10s %9s | %9s %9s %9s %9s | %10s %9s %9s %9s\n",
+        "method",
+        "calls",
+        "per frame",
+        "hook p50",
+        "p99",
+        "max",
+        "mean",
+        "forwarded",
+        "drv p50",
+        "p99",
+        "max");
+
+    for (std::size_t event = 0; event < g_counters.size(); ++event)
+    {
+        const auto &counters = g_counters[event];
+        const auto calls = counters.hook.count.load(std::memory_order_relaxed);
+        if (calls == 0)
+        {
+            continue;
+        }
+
+        const auto total = counters.hook.total.load(std::memory_order_relaxed);
+        std::fprintf(
+            out,
+            "%-20s %10llu %9.2f | %9.1f %9.1f %9.1f %9.1f | %10llu %9.1f %9.1f %9.1f\n",
+            trace_events[event].name,
+            static_cast<unsigned long long>(calls),
+            frames != 0 ? static_cast<double>(calls) / static_cast<double>(frames) : 0.0,
+            to_us(latency_percentile(counters.hook, 0.5)),
+            to_us(latency_percentile(counters.hook, 0.99)),
+            to_us(counters.hook.max.load(std::memory_order_relaxed)),
+            to_us(total) / static_cast<double>(calls),
+            static_cast<unsigned long long>(counters.driver.count.load(std::memory_order_relaxed)),
+            to_us(latency_percentile(counters.driver, 0.5)),
+            to_us(latency_percentile(counters.driver, 0.99)),
+            to_us(counters.driver.max.load(std::memory_order_relaxed)));
+    }
+
+    std::fflush(out);
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "simd.h"
+#include "trace.h"
+#include "trace_events.h"
+
+// per hook call counters and latency histograms
+// every *_hook opens a hook_scope, which times the whole hook and separately the time spent in the original
+// DirectDraw/win32 call, so the dump shows how much of a call is the driver and how much is us, while tracing it also
+// records where the call ended
+
+// timestamps come from the cycle counter where there is one, reading it is several times cheaper than steady_clock,
+// which matters when a frame makes thousands of Blt calls, dumps convert ticks to time
+inline std::uint64_t hook_stats_ticks()
+{
+#if BLOCKS_X86
+    return __rdtsc();
+#else
+    return trace_now();
+#endif
+}
+
+// log-linear buckets: values below 16 ticks get their own bucket, above that each power of two is split into 16 equal
+// sub-buckets, so any bucket is at most ~6% wide, values past 2^40 ticks land in the last bucket
+inline constexpr std::uint32_t latency_sub_bits = 4;
+inline constexpr std::uint32_t latency_max_bits = 40;
+inline constexpr std::size_t latency_bucket_count = (latency_max_bits - latency_sub_bits + 1) << latency_sub_bits;
+
+constexpr std::size_t latency_bucket(std::uint64_t ticks)
+{
+    constexpr auto sub_count = std::uint64_t{1} << latency_sub_bits;
+    if (ticks < sub_count)
+    {
+        return static_cast<std::size_t>(ticks);
+    }
+
+    const auto high_bit = static_cast<std::uint32_t>(std::bit_width(ticks)) - 1;
+    if (high_bit >= latency_max_bits)
+    {
+        return latency_bucket_count - 1;
+    }
+
+    const auto shift = high_bit - latency_sub_bits;
+    const auto mantissa = (ticks >> shift) & (sub_count - 1);
+    return static_cast<std::size_t>(((high_bit - latency_sub_bits + 1) << latency_sub_bits) + mantissa);
+}
+
+// largest value that falls into bucket
+constexpr std::uint64_t latency_bucket_upper(std::size_t bucket)
+{
+    constexpr auto sub_count = std::size_t{1} << latency_sub_bits;
+    if (bucket < sub_count)
+    {
+        return bucket;
+    }
+
+    const auto shift = (bucket >> latency_sub_bits) - 1;
+    const auto lower = (sub_count + (bucket & (sub_count - 1))) << shift;
+    return lower + (std::uint64_t{1} << shift) - 1;
+}
+
+struct latency_histogram
+{
+    std::array<std::atomic<std::uint32_t>, latency_bucket_count> buckets{};
+    std::atomic<std::uint64_t> count{};
+    std::atomic<std::uint64_t> total{};
+    std::atomic<std::uint64_t> max{};
+};
+
+// safe to call from any thread, relaxed atomics only
+void latency_record(latency_histogram &histogram, std::uint64_t ticks);
+
+// upper bound of the bucket holding the q-th quantile (0..1), 0 when nothing was recorded
+std::uint64_t latency_percentile(const latency_histogram &histogram, double q);
+
+struct hook_counters
+{
+    // the whole hook, including the original call
+    latency_histogram hook{};
+    // just the original call, only counted when the hook actually forwarded
+    latency_histogram driver{};
+};
+
+inline std::atomic<bool> g_hook_stats_enabled{};
+
+// start timing hooks, also the reference point the dump uses to work out how long a tick is
+void hook_stats_start();
+
+hook_counters &hook_stats_for(trace_event event);
+
+// write the p50/p99/max table for every hook that was called, frames is used for calls per frame
+void hook_stats_dump(std::FILE *out, std::uint64_t frames);
+
+// times one hook call, open one at the top of a hook and wrap the call to the original function in driver()
+struct hook_scope
+{
+    trace_event event;
+    std::uint64_t start;
+    std::uint64_t driver_ticks;
+    bool forwarded;
+
+    explicit hook_scope(trace_event hooked)
+        : event{hooked}
+        , start{g_hook_stats_enabled.load(std::memory_order_relaxed) ? hook_stats_ticks() : 0}
+        , driver_ticks{}
+        , forwarded{}
+    {
+    }
+
+    hook_scope(const hook_scope &) = delete;
+    hook_scope &operator=(const hook_scope &) = delete;
+
+    ~hook_scope()
+    {
+        // where the call ends on a timeline, see blocks_trace_decode --chrome
+        trace(trace_event::end, event);
+
+        if (start == 0)
+        {
+            return;
+        }
+
+        auto &counters = hook_stats_for(event);
+        latency_record(counters.hook, hook_stats_ticks() - start);
+        if (forwarded)
+        {
+            latency_record(counters.driver, driver_ticks);
+        }
+    }
+
+    template <class F>
+    auto driver(F &&call) -> decltype(call())
+    {
+        if (start == 0)
+        {
+            return call();
+        }
+
+        const auto driver_start = hook_stats_ticks();
+        auto result = call();
+        driver_ticks += hook_stats_ticks() - driver_start;
+        forwarded = true;
+        return result;
+    }
+};
@@ -1,90 +1,130 @@
+#include <algorithm>
+#include <atomic>
+#include <bitset>
 #include <cassert>
+#include <climits>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <format>
 #include <fstream>
+#include <map>
+#include <memory>
+#include <optional>
 #include <print>
 #include <ranges>
 #include <set>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <tuple>
-#include <unordered_map>
 #include <vector>
 
 #define NOMINMAX
 #include <Windows.h>
 #include <ddraw.h>
+#include <windowsx.h>
 
 #pragma comment(lib, "ddraw")
 
-std::vector<std::tuple<std::uint32_t, std::string>> ddcaps_map{
-    {DDSCAPS_3DDEVICE, "DDSCAPS_3DDEVICE"},
-    {DDSCAPS_ALLOCONLOAD, "DDSCAPS_ALLOCONLOAD"},
-    {DDSCAPS_ALPHA, "DDSCAPS_ALPHA"},
-    {DDSCAPS_BACKBUFFER, "DDSCAPS_BACKBUFFER"},
-    {DDSCAPS_COMPLEX, "DDSCAPS_COMPLEX"},
-    {DDSCAPS_FLIP, "DDSCAPS_FLIP"},
-    {DDSCAPS_FRONTBUFFER, "DDSCAPS_FRONTBUFFER"},
-    {DDSCAPS_HWCODEC, "DDSCAPS_HWCODEC"},
-    {DDSCAPS_LIVEVIDEO, "DDSCAPS_LIVEVIDEO"},
-    {DDSCAPS_LOCALVIDMEM, "DDSCAPS_LOCALVIDMEM"},
-    {DDSCAPS_MIPMAP, "DDSCAPS_MIPMAP"},
-    {DDSCAPS_MODEX, "DDSCAPS_MODEX"},
-    {DDSCAPS_NONLOCALVIDMEM, "DDSCAPS_NONLOCALVIDMEM"},
-    {DDSCAPS_OFFSCREENPLAIN, "DDSCAPS_OFFSCREENPLAIN"},
-    {DDSCAPS_OVERLAY, "DDSCAPS_OVERLAY"},
-    {DDSCAPS_OPTIMIZED, "DDSCAPS_OPTIMIZED"},
-    {DDSCAPS_OWNDC, "DDSCAPS_OWNDC"},
-    {DDSCAPS_PALETTE, "DDSCAPS_PALETTE"},
-    {DDSCAPS_PRIMARYSURFACE, "DDSCAPS_PRIMARYSURFACE"},
-    {DDSCAPS_PRIMARYSURFACELEFT, "DDSCAPS_PRIMARYSURFACELEFT"},
-    {DDSCAPS_STANDARDVGAMODE, "DDSCAPS_STANDARDVGAMODE"},
-    {DDSCAPS_SYSTEMMEMORY, "DDSCAPS_SYSTEMMEMORY"},
-    {DDSCAPS_TEXTURE, "DDSCAPS_TEXTURE"},
-    {DDSCAPS_VIDEOMEMORY, "DDSCAPS_VIDEOMEMORY"},
-    {DDSCAPS_VIDEOPORT, "DDSCAPS_VIDEOPORT"},
-    {DDSCAPS_VISIBLE, "DDSCAPS_VISIBLE"},
-    {DDSCAPS_WRITEONLY, "DDSCAPS_WRITEONLY"},
-    {DDSCAPS_ZBUFFER, "DDSCAPS_ZBUFFER"}};
-
-std::vector<std::tuple<std::uint32_t, std::string>> fuload_map{
-    {LR_CREATEDIBSECTION, "LR_CREATEDIBSECTION"},
-    {LR_DEFAULTCOLOR, "LR_DEFAULTCOLOR"},
-    {LR_DEFAULTSIZE, "LR_DEFAULTSIZE"},
-    {LR_LOADFROMFILE, "LR_LOADFROMFILE"},
-    {LR_LOADMAP3DCOLORS, "LR_LOADMAP3DCOLORS"},
-    {LR_LOADTRANSPARENT, "LR_LOADTRANSPARENT"},
-    {LR_MONOCHROME, "LR_MONOCHROME"},
-    {LR_SHARED, "LR_SHARED"},
-    {LR_VGACOLOR, "LR_VGACOLOR"}};
-
-std::vector<std::tuple<std::uint32_t, std::string>> palette_caps_maps{
-    {DDPCAPS_1BIT, "DDPCAPS_1BIT"},
-    {DDPCAPS_2BIT, "DDPCAPS_2BIT"},
-    {DDPCAPS_4BIT, "DDPCAPS_4BIT"},
-    {DDPCAPS_8BIT, "DDPCAPS_8BIT"},
-    {DDPCAPS_8BITENTRIES, "DDPCAPS_8BITENTRIES"},
-    {DDPCAPS_ALPHA, "DDPCAPS_ALPHA"},
-    {DDPCAPS_ALLOW256, "DDPCAPS_ALLOW256"},
-    {DDPCAPS_PRIMARYSURFACE, "DDPCAPS_PRIMARYSURFACE"},
-    {DDPCAPS_PRIMARYSURFACELEFT, "DDPCAPS_PRIMARYSURFACELEFT"},
-    {DDPCAPS_VSYNC, "DDPCAPS_VSYNC"}};
+#include "atlas_cache.h"
+#include "blit_batch.h"
+#include "bmp.h"
+#include "capture.h"
+#include "damage.h"
+#include "ddraw_convert.h"
+#include "ddraw_vtable.h"
+#include "flags.h"
+#include "hash.h"
+#include "hook_set.h"
+#include "hook_stats.h"
+#include "mapped_file.h"
+#include "overlay.h"
+#include "palette_convert.h"
+#include "palette_index.h"
+#include "pe_image.h"
+#include "present_queue.h"
+#include "raster.h"
+#include "recording.h"
+#include "scale.h"
+#include "scale_filter.h"
+#include "settings.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "write_watch.h"
+
+// the size the game renders at, whatever the window ends up being
+constexpr std::uint32_t game_width = 640;
+constexpr std::uint32_t game_height = 480;
 
 std::ofstream g_log{};
+settings g_settings{};
 LPDIRECTDRAW g_ddraw{};
 HWND g_window{};
 LPDIRECTDRAWSURFACE7 g_primary_surface{};
 LPDIRECTDRAWSURFACE7 g_back_buffer_surface{};
 LPDIRECTDRAWSURFACE7 g_image_surface{};
-std::unordered_map<std::string, std::uintptr_t> g_ddraw_hooks{};
-std::unordered_map<std::string, std::uintptr_t> g_surface_hooks{};
-std::unordered_map<std::string, std::uintptr_t> g_palette_hooks{};
+// indexed mode: the back buffer with the palette applied, in the display format, what gets presented
+LPDIRECTDRAWSURFACE7 g_present_surface{};
+std::set<void *> g_software_surfaces{};
 
 PALETTEENTRY g_palette[256]{};
+static_assert(sizeof(PALETTEENTRY) == sizeof(palette_entry));
+palette_lut g_palette_lut{};
+palette_changes g_palette_changes{};
 
 std::uint32_t g_width = ::GetSystemMetrics(SM_CXSCREEN);
 std::uint32_t g_height = ::GetSystemMetrics(SM_CYSCREEN);
-std::vector<BYTE> g_image_pixels{};
+std::vector<mapped_file> g_image_files{};
+bmp_image g_image{};
+std::uint64_t g_image_hash{};
+palette_pixel_index g_image_palette_index{};
+bool g_image_converted{};
+// opaque runs of the image surface for keyed blits out of it, built by the first one after the image changes
+std::optional<raster_span_table> g_image_spans{};
+// palette entries that converted to the key when they were built, rgb image surfaces only
+std::bitset<256> g_image_keyed_entries{};
+damage_list g_back_buffer_damage{};
+blit_batch g_blit_batch{};
+thread_pool g_pool{};
+present_queue g_present_queue{};
+std::vector<LPDIRECTDRAWSURFACE7> g_staging_surfaces{};
+LPDIRECTDRAWSURFACE7 g_scale_surface{};
+scale_filter_frames g_scale_filter_frames{};
+WNDPROC g_game_window_proc{};
+std::uint64_t g_frames{};
+
+// what the game has locked, so Unlock can capture what it wrote
+struct capture_lock_state
+{
+    raster_rect rect;
+    const std::uint8_t *pixels;
+    std::ptrdiff_t pitch;
+    std::uint32_t bytes_per_pixel;
+};
+std::map<void *, capture_lock_state> g_capture_locks{};
+
+// software back buffer memory that notes the pages written to it, see [raster] write_watch
+// never freed, the surface draws into it for as long as it exists, which can be past the dll's globals
+write_watch *g_back_buffer_watch{};
+
+// frames for [record], the encoder thread is never joined, see DLL_PROCESS_DETACH
+frame_recorder g_recorder{};
+
+// [overlay] numbers and the back buffer pixels under it while a frame is presented
+overlay_stats g_overlay{};
+overlay_backup g_overlay_backup{};
+// bytes per pixel of the primary surface, what a presented pixel costs
+std::uint32_t g_display_bytes_per_pixel{4};
+
+// the game's lock of the watched back buffer, the rows it wrote are worked out at Unlock
+struct watched_lock
+{
+    raster_rect rect;
+    std::size_t pitch;
+};
+std::optional<watched_lock> g_watched_lock{};
 
 // simple log function
 template <class... Args>
@@ -94,56 +134,314 @@ void log(std::string_view msg, Args &&...args)
     // g_log << std::vformat(msg, std::make_format_args(args...)) << std::endl;
 }
 
-std::string flags_to_string(const auto &map, std::uint32_t flag)
+// g_palette as the portable type the conversion kernels take
+std::span<const palette_entry, 256> palette_view()
+{
+    return std::span<const palette_entry, 256>{reinterpret_cast<const palette_entry *>(g_palette), 256};
+}
+
+// read blocks_patcher.ini from the working directory, missing keys keep their defaults
+settings load_settings()
+{
+    const auto path = std::filesystem::absolute("blocks_patcher.ini").string();
+
+    settings result{};
+    result.software_raster =
+        ::GetPrivateProfileIntA("raster", "software", result.software_raster, path.c_str()) != 0;
+    result.indexed_back_buffer =
+        ::GetPrivateProfileIntA("raster", "indexed", result.indexed_back_buffer, path.c_str()) != 0;
+    result.software_raster |= result.indexed_back_buffer;
+    result.sprite_spans = ::GetPrivateProfileIntA("raster", "spans", result.sprite_spans, path.c_str()) != 0;
+    result.blit_batching = ::GetPrivateProfileIntA("raster", "batch", result.blit_batching, path.c_str()) != 0;
+    result.write_watch = ::GetPrivateProfileIntA("raster", "write_watch", result.write_watch, path.c_str()) != 0;
+    result.dirty_rects = ::GetPrivateProfileIntA("present", "dirty_rects", result.dirty_rects, path.c_str()) != 0;
+    result.dirty_rect_max = ::GetPrivateProfileIntA("present", "dirty_rect_max", result.dirty_rect_max, path.c_str());
+    result.dirty_rect_threshold =
+        ::GetPrivateProfileIntA("present", "dirty_rect_threshold", result.dirty_rect_threshold, path.c_str());
+    result.async_present = ::GetPrivateProfileIntA("present", "async", result.async_present, path.c_str()) != 0;
+    result.async_queue_depth =
+        ::GetPrivateProfileIntA("present", "async_queue_depth", result.async_queue_depth, path.c_str());
+
+    char backpressure[16]{};
+    ::GetPrivateProfileStringA(
+        "present",
+        "async_backpressure",
+        "drop",
+        backpressure,
+        static_cast<DWORD>(std::size(backpressure)),
+        path.c_str());
+    result.async_backpressure = std::string_view{backpressure} == "block" ? present_backpressure::block
+                                                                          : present_backpressure::drop_oldest;
+
+    char scale[16]{};
+    ::GetPrivateProfileStringA(
+        "scale",
+        "mode",
+        "off",
+        scale,
+        static_cast<DWORD>(std::size(scale)),
+        path.c_str());
+    result.scale = std::string_view{scale} == "integer" ? scale_mode::integer
+                   : std::string_view{scale} == "fit"     ? scale_mode::fit
+                   : std::string_view{scale} == "scale2x" ? scale_mode::scale2x
+                   : std::string_view{scale} == "scale3x" ? scale_mode::scale3x
+                   : std::string_view{scale} == "xbr"     ? scale_mode::xbr
+                                                          : scale_mode::off;
+    result.window_width = ::GetPrivateProfileIntA("scale", "width", result.window_width, path.c_str());
+    result.window_height = ::GetPrivateProfileIntA("scale", "height", result.window_height, path.c_str());
+
+    result.threads = ::GetPrivateProfileIntA("parallel", "threads", result.threads, path.c_str());
+
+    result.atlas_cache = ::GetPrivateProfileIntA("cache", "atlas", result.atlas_cache, path.c_str()) != 0;
+
+    char atlas_cache_dir[MAX_PATH]{};
+    ::GetPrivateProfileStringA(
+        "cache",
+        "dir",
+        result.atlas_cache_dir.c_str(),
+        atlas_cache_dir,
+        static_cast<DWORD>(std::size(atlas_cache_dir)),
+        path.c_str());
+    result.atlas_cache_dir = atlas_cache_dir;
+
+    char import_cache[MAX_PATH]{};
+    ::GetPrivateProfileStringA(
+        "cache",
+        "imports",
+        result.import_cache.c_str(),
+        import_cache,
+        static_cast<DWORD>(std::size(import_cache)),
+        path.c_str());
+    result.import_cache = import_cache;
+
+    result.capture = ::GetPrivateProfileIntA("capture", "enabled", result.capture, path.c_str()) != 0;
+
+    char capture_file[MAX_PATH]{};
+    ::GetPrivateProfileStringA(
+        "capture",
+        "file",
+        result.capture_file.c_str(),
+        capture_file,
+        static_cast<DWORD>(std::size(capture_file)),
+        path.c_str());
+    result.capture_file = capture_file;
+
+    result.trace = ::GetPrivateProfileIntA("trace", "enabled", result.trace, path.c_str()) != 0;
+    result.trace_first_frame = ::GetPrivateProfileIntA("trace", "first_frame", result.trace_first_frame, path.c_str());
+    result.trace_frames = ::GetPrivateProfileIntA("trace", "frames", result.trace_frames, path.c_str());
+
+    char trace_file[MAX_PATH]{};
+    ::GetPrivateProfileStringA(
+        "trace",
+        "file",
+        result.trace_file.c_str(),
+        trace_file,
+        static_cast<DWORD>(std::size(trace_file)),
+        path.c_str());
+    result.trace_file = trace_file;
+
+    result.record = ::GetPrivateProfileIntA("record", "enabled", result.record, path.c_str()) != 0;
+    result.record_buffers = ::GetPrivateProfileIntA("record", "buffers", result.record_buffers, path.c_str());
+
+    char record_file[MAX_PATH]{};
+    ::GetPrivateProfileStringA(
+        "record",
+        "file",
+        result.record_file.c_str(),
+        record_file,
+        static_cast<DWORD>(std::size(record_file)),
+        path.c_str());
+    result.record_file = record_file;
+
+    result.overlay = ::GetPrivateProfileIntA("overlay", "enabled", result.overlay, path.c_str()) != 0;
+
+    result.stats = ::GetPrivateProfileIntA("stats", "enabled", result.stats, path.c_str()) != 0;
+    result.stats_dump_key = ::GetPrivateProfileIntA("stats", "dump_key", result.stats_dump_key, path.c_str());
+
+    char stats_file[MAX_PATH]{};
+    ::GetPrivateProfileStringA(
+        "stats",
+        "file",
+        result.stats_file.c_str(),
+        stats_file,
+        static_cast<DWORD>(std::size(stats_file)),
+        path.c_str());
+    result.stats_file = stats_file;
+
+    return result;
+}
+
+// append the hook stats table to the stats file
+void dump_hook_stats()
+{
+    auto *file = std::fopen(g_settings.stats_file.c_str(), "a");
+    if (file == nullptr)
+    {
+        return;
+    }
+
+    hook_stats_dump(file, g_frames);
+    std::fprintf(file, "\n");
+    std::fclose(file);
+}
+
+// open a page for g_hooks to write, execute stays on while it is, a vtable can share its page with code another
+// thread is running
+bool unprotect_page(std::uintptr_t address, std::size_t size, std::uint32_t &old)
 {
-    return map |                                                                         //
-           std::views::filter([flag](const auto &e) { return flag & std::get<0>(e); }) | //
-           std::views::transform([](const auto &e) { return std::get<1>(e); }) |         //
-           std::views::join_with('|') |                                                  //
-           std::ranges::to<std::string>();
+    DWORD old_protect{};
+    const auto ok =
+        ::VirtualProtect(reinterpret_cast<void *>(address), size, PAGE_EXECUTE_READWRITE, &old_protect) == TRUE;
+    old = old_protect;
+    return ok;
 }
 
-std::string ddcaps_to_string(std::uint32_t ddcaps)
+bool restore_page(std::uintptr_t address, std::size_t size, std::uint32_t old)
 {
-    return flags_to_string(ddcaps_map, ddcaps);
+    DWORD old_protect{};
+    return ::VirtualProtect(reinterpret_cast<void *>(address), size, old, &old_protect) == TRUE;
 }
 
-std::string fuload_to_string(std::uint32_t fuload)
+hook_memory page_memory()
+{
+    SYSTEM_INFO info{};
+    ::GetSystemInfo(&info);
+    return {.page_size = info.dwPageSize, .unprotect = unprotect_page, .restore = restore_page};
+}
+
+const hook_memory g_page_memory = page_memory();
+
+// every slot the patcher has hooked, the exe's imports and the DirectDraw vtables, put back if the dll is unloaded
+hook_set g_hooks{};
+
+// write what was queued in g_hooks since the last commit, all of it or, if any slot fails, none of it
+bool commit_hooks(const char *what)
 {
-    return flags_to_string(fuload_map, fuload);
+    const auto queued = std::ranges::count(g_hooks.patches, false, &hook_patch::applied);
+    const auto error = hook_set_commit(g_hooks, g_page_memory);
+    log("hooked {}: {} slots on {} pages, {}", what, queued, g_hooks.last_pages, hook_set_error_name(error));
+    return error == hook_set_error::none;
 }
 
-std::string palette_caps_to_string(std::uint32_t palette_caps)
+// a function of the game's exe to send to one of ours instead
+struct hooked_import
 {
-    return flags_to_string(palette_caps_maps, palette_caps);
+    const char *dll;
+    const char *function;
+    std::uintptr_t hook;
+};
+
+// the iat slot of import in the exe, by name or, when the exe has no name table, by the address the loader put there
+const pe_import *find_import_slot(const std::uint8_t *base, const pe_image &exe, const hooked_import &import)
+{
+    if (const auto *found = pe_find_import(exe, import.dll, import.function))
+    {
+        return found;
+    }
+
+    const auto *module = ::GetModuleHandleA(import.dll);
+    const auto address = module != nullptr ? reinterpret_cast<std::uintptr_t>(::GetProcAddress(module, import.function))
+                                           : 0;
+    for (const auto &candidate : exe.imports)
+    {
+        std::uintptr_t bound{};
+        std::memcpy(&bound, base + candidate.iat_rva, sizeof(bound));
+        if (address != 0 && candidate.function.empty() && bound == address)
+        {
+            return &candidate;
+        }
+    }
+    return nullptr;
 }
 
-// patch out an address with another, useful for IAT hooking but can be abused for other patching needs
-std::uintptr_t hook(std::uintptr_t iat_addr, std::uintptr_t hook_addr)
+// point the exe's import slots for imports at the hooks, the slots come from the import cache when it was written for
+// this build of the exe, otherwise from walking its import table, which then gets cached for the next start
+void hook_imports(
+    const std::uint8_t *base,
+    std::span<const std::uint8_t> bytes,
+    pe_image &exe,
+    std::span<const hooked_import> imports)
 {
-    log("hooking address at {:#x} with {:#x}", iat_addr, hook_addr);
+    auto slots = g_settings.import_cache.empty()
+                     ? std::nullopt
+                     : pe_import_cache_load(g_settings.import_cache, exe.timestamp, exe.checksum);
+
+    const auto slot_of = [&](const hooked_import &import) -> const pe_import_slot *
+    {
+        const auto found = std::ranges::find_if(
+            *slots,
+            [&](const pe_import_slot &slot) { return slot.dll == import.dll && slot.function == import.function; });
+        return found != slots->end() ? &*found : nullptr;
+    };
 
-    // make hook location writable
-    ::DWORD old_protect;
-    assert(
-        ::VirtualProtect(reinterpret_cast<void *>(iat_addr), sizeof(std::uintptr_t), PAGE_READWRITE, &old_protect) ==
-        TRUE);
+    if (!slots || !std::ranges::all_of(imports, slot_of))
+    {
+        const auto error = pe_read_imports(bytes, pe_layout::mapped, exe);
+        log("walked the import table: {}, {} imports", pe_error_name(error), exe.imports.size());
+
+        slots.emplace();
+        for (const auto &import : imports)
+        {
+            // one this build doesn't have is cached too, with rva 0, or every start would walk the table again
+            const auto *found = find_import_slot(base, exe, import);
+            slots->push_back({import.dll, import.function, found != nullptr ? found->iat_rva : 0});
+        }
 
-    // save off original address
-    std::uintptr_t original_addr{};
-    std::memcpy(&original_addr, reinterpret_cast<void *>(iat_addr), sizeof(std::uintptr_t));
+        if (!g_settings.import_cache.empty())
+        {
+            pe_import_cache_store(g_settings.import_cache, exe.timestamp, exe.checksum, *slots);
+        }
+    }
 
-    // overwrite
-    std::memcpy(reinterpret_cast<void *>(iat_addr), &hook_addr, sizeof(std::uintptr_t));
+    for (const auto &import : imports)
+    {
+        const auto *slot = slot_of(import);
+        if (slot == nullptr || slot->iat_rva == 0 || slot->iat_rva > bytes.size() - sizeof(std::uintptr_t))
+        {
+            log("{} isn't imported from {} by this build, not hooked", import.function, import.dll);
+            continue;
+        }
+        hook_set_add(g_hooks, reinterpret_cast<std::uintptr_t>(base + slot->iat_rva), import.hook);
+    }
+    commit_hooks("imports");
+}
 
-    // restore original protection
-    assert(
-        ::VirtualProtect(reinterpret_cast<void *>(iat_addr), sizeof(std::uintptr_t), old_protect, &old_protect) ==
-        TRUE);
+// where the game's frame sits in the window's client area
+raster_rect scaled_frame_rect()
+{
+    RECT client{};
+    ::GetClientRect(g_window, &client);
+    return scale_layout(
+        g_settings.scale,
+        game_width,
+        game_height,
+        static_cast<std::uint32_t>(client.right),
+        static_cast<std::uint32_t>(client.bottom));
+}
 
-    log("hooked address at {:#x} with {:#x} (original address {:#x})", iat_addr, hook_addr, original_addr);
+// the game thinks its window is 640x480, so mouse positions in a scaled window are mapped back onto the frame
+LRESULT CALLBACK scaled_window_proc(HWND window, UINT message, WPARAM wparam, LPARAM lparam)
+{
+    // the wheel is the only mouse message in this range carrying screen rather than client coordinates
+    if (message >= WM_MOUSEFIRST && message <= WM_MOUSELAST && message != WM_MOUSEWHEEL)
+    {
+        const auto frame = scaled_frame_rect();
+        const auto frame_width = std::max(frame.right - frame.left, 1);
+        const auto frame_height = std::max(frame.bottom - frame.top, 1);
+
+        const auto x = std::clamp(
+            (GET_X_LPARAM(lparam) - frame.left) * static_cast<int>(game_width) / frame_width,
+            0,
+            static_cast<int>(game_width) - 1);
+        const auto y = std::clamp(
+            (GET_Y_LPARAM(lparam) - frame.top) * static_cast<int>(game_height) / frame_height,
+            0,
+            static_cast<int>(game_height) - 1);
+
+        lparam = MAKELPARAM(x, y);
+    }
 
-    return original_addr;
+    return ::CallWindowProcA(g_game_window_proc, window, message, wparam, lparam);
 }
 
 // anything named *_hook is a hook of a real function
@@ -175,11 +473,26 @@ __declspec(dllexport) HWND __stdcall CreateWindowExA_hook(
         reinterpret_cast<void *>(hMenu),
         reinterpret_cast<void *>(hInstance),
         lpParam);
-
-    const auto new_width = 640;
-    const auto new_height = 480;
+    trace(trace_event::create_window_ex, dwExStyle, dwStyle, X, Y, nWidth, nHeight);
+    capture_scope capture_guard{};
+    capture(
+        capture_guard,
+        capture_call::create_window,
+        capture_create_window{dwExStyle, dwStyle, X, Y, nWidth, nHeight});
+
+    auto new_width = static_cast<int>(game_width);
+    auto new_height = static_cast<int>(game_height);
     const auto new_style = dwStyle ^ WS_POPUP;
 
+    // when scaling the configured size is what the game gets drawn into, so make that the client area
+    if (g_settings.scale != scale_mode::off)
+    {
+        RECT frame{0, 0, static_cast<LONG>(g_settings.window_width), static_cast<LONG>(g_settings.window_height)};
+        ::AdjustWindowRectEx(&frame, new_style, FALSE, dwExStyle);
+        new_width = frame.right - frame.left;
+        new_height = frame.bottom - frame.top;
+    }
+
     log("CreateWindowExA_hook {} {} {} {} {} {} {} {} {} {} {} {}",
         dwExStyle,
         lpClassName,
@@ -208,6 +521,12 @@ __declspec(dllexport) HWND __stdcall CreateWindowExA_hook(
         hInstance,
         lpParam);
 
+    if (g_settings.scale != scale_mode::off && g_window != nullptr)
+    {
+        g_game_window_proc = reinterpret_cast<WNDPROC>(
+            ::SetWindowLongPtrA(g_window, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(scaled_window_proc)));
+    }
+
     return g_window;
 }
 
@@ -217,16 +536,18 @@ __declspec(dllexport) HRESULT __stdcall SetCooperativeLevel_hook(void *that, HWN
         that,
         reinterpret_cast<void *>(unnamedParam1),
         reinterpret_cast<void *>(unnamedParam2));
+    trace(trace_event::set_cooperative_level, that, unnamedParam1, unnamedParam2);
 
-    const auto new_unnamed_param2 = DDSCL_NORMAL;
+    // the async present thread blits to the primary surface while the game keeps drawing, which DirectDraw only
+    // allows when told about it up front
+    const DWORD new_unnamed_param2 = DDSCL_NORMAL | (g_settings.async_present ? DDSCL_MULTITHREADED : 0);
 
     log("SetCooperativeLevel_hook {} {} {}",
         that,
         reinterpret_cast<void *>(unnamedParam1),
         reinterpret_cast<void *>(new_unnamed_param2));
 
-    return reinterpret_cast<HRESULT(__stdcall *)(void *, HWND, DWORD)>(
-        g_ddraw_hooks["SetCooperativeLevel"])(that, unnamedParam1, new_unnamed_param2);
+    return ddraw_method::set_cooperative_level::original(that, unnamedParam1, new_unnamed_param2);
 }
 
 __declspec(dllexport) HRESULT __stdcall SetDisplayMode_hook(
@@ -236,6 +557,7 @@ __declspec(dllexport) HRESULT __stdcall SetDisplayMode_hook(
     DWORD unnamedParam3)
 {
     log("SetDisplayMode {} {} {} {}", that, unnamedParam1, unnamedParam2, unnamedParam3);
+    trace(trace_event::set_display_mode, that, unnamedParam1, unnamedParam2, unnamedParam3);
     log("\tskipping");
 
     return DD_OK;
@@ -250,6 +572,7 @@ __declspec(dllexport) HRESULT __stdcall GetAttachedSurface_hook(
         reinterpret_cast<void *>(unnamedParam1),
         ddcaps_to_string(unnamedParam1->dwCaps),
         reinterpret_cast<void *>(unnamedParam2));
+    trace(trace_event::get_attached_surface, that, unnamedParam1->dwCaps, unnamedParam2);
 
     *unnamedParam2 = g_back_buffer_surface;
     return DD_OK;
@@ -268,22 +591,53 @@ __declspec(dllexport) HRESULT __stdcall SetEntries_hook(
         unnamedParam2,
         unnamedParam3,
         reinterpret_cast<void *>(unnamedParam4));
-
-    // save off a copy of the palette entries
-    std::memcpy(g_palette, unnamedParam4, sizeof(g_palette));
+    trace(trace_event::set_entries, that, unnamedParam1, unnamedParam2, unnamedParam3, unnamedParam4);
+    hook_scope scope{trace_event::set_entries};
+    capture_scope capture_guard{};
+
+    // save off a copy of the palette entries the game passed, noting which ones changed so the next present only
+    // has to rewrite the pixels that use them
+    const auto first = std::min<std::size_t>(unnamedParam2, std::size(g_palette));
+    const auto count = std::min<std::size_t>(unnamedParam3, std::size(g_palette) - first);
+
+    g_palette_changes |= diff_palette(
+        palette_view(),
+        first,
+        std::span<const palette_entry>{reinterpret_cast<const palette_entry *>(unnamedParam4), count});
+    std::memcpy(g_palette + first, unnamedParam4, count * sizeof(PALETTEENTRY));
+
+    capture(
+        capture_guard,
+        capture_call::set_entries,
+        capture_set_entries{
+            capture_handle_of(that),
+            static_cast<std::uint32_t>(first),
+            static_cast<std::uint32_t>(count)},
+        std::span{reinterpret_cast<const std::uint8_t *>(g_palette + first), count * sizeof(PALETTEENTRY)});
 
     for (const auto &entry : g_palette)
     {
         log("\t{} {} {} {}", entry.peRed, entry.peGreen, entry.peBlue, entry.peFlags);
     }
 
-    const auto res = reinterpret_cast<HRESULT(__stdcall *)(void *, DWORD, DWORD, DWORD, LPPALETTEENTRY)>(
-        g_palette_hooks["SetEntries"])(that, unnamedParam1, unnamedParam2, unnamedParam3, unnamedParam4);
+    const auto res = scope.driver(
+        [&]
+        {
+            return palette_method::set_entries::original(
+                that,
+                unnamedParam1,
+                unnamedParam2,
+                unnamedParam3,
+                unnamedParam4);
+        });
 
     log("\tSetEntries returned {}", res);
+    trace(trace_event::returned, trace_event::set_entries, res);
     return res;
 }
 
+using palette_hooks = vtable_hooks<vtable_hook<palette_method::set_entries, SetEntries_hook>>;
+
 __declspec(dllexport) HRESULT __stdcall CreatePalette_hook(
     void *that,
     DWORD unnamedParam1,
@@ -297,20 +651,450 @@ __declspec(dllexport) HRESULT __stdcall CreatePalette_hook(
         reinterpret_cast<void *>(unnamedParam2),
         reinterpret_cast<void *>(unnamedParam3),
         reinterpret_cast<void *>(unnamedParam4));
+    trace(trace_event::create_palette, that, unnamedParam1, unnamedParam2, unnamedParam3);
+    capture_scope capture_guard{};
 
     const auto res =
-        reinterpret_cast<HRESULT(__stdcall *)(void *, DWORD, LPPALETTEENTRY, LPDIRECTDRAWPALETTE *, IUnknown *)>(
-            g_ddraw_hooks["CreatePalette"])(that, unnamedParam1, unnamedParam2, unnamedParam3, unnamedParam4);
+        ddraw_method::create_palette::original(that, unnamedParam1, unnamedParam2, unnamedParam3, unnamedParam4);
+
+    palette_hooks::add(g_hooks, *unnamedParam3);
+    commit_hooks("palette");
 
-    const auto original_set_entries = hook(
-        reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(*unnamedParam3)) + 0x18,
-        reinterpret_cast<std::uintptr_t>(SetEntries_hook));
-    g_palette_hooks["SetEntries"] = original_set_entries;
+    // only 8 bit palettes come with a full table of 256 entries
+    const auto initial_entries = unnamedParam2 != nullptr && (unnamedParam1 & DDPCAPS_8BIT) ? 256 : 0;
+    capture(
+        capture_guard,
+        capture_call::create_palette,
+        capture_create_palette{capture_handle_of(*unnamedParam3), unnamedParam1, 0},
+        std::span{reinterpret_cast<const std::uint8_t *>(unnamedParam2), initial_entries * sizeof(PALETTEENTRY)});
 
     log("\tCreatePalette returned {}", res);
+    trace(trace_event::returned, trace_event::create_palette, res);
     return res;
 }
 
+// software raster path
+// surfaces we created in system memory can be blitted on the cpu instead of going through the driver, anything the
+// raster engine doesn't handle returns DDERR_UNSUPPORTED so the hook can fall back to the original function
+
+RECT surface_rect(LPDIRECTDRAWSURFACE7 surface)
+{
+    DDSURFACEDESC2 ddsd{};
+    ddsd.dwSize = sizeof(ddsd);
+    surface->GetSurfaceDesc(&ddsd);
+
+    return {0, 0, static_cast<LONG>(ddsd.dwWidth), static_cast<LONG>(ddsd.dwHeight)};
+}
+
+// note down what a blit/lock is about to change in the back buffer, null means all of it
+void record_back_buffer_damage(void *that, const RECT *rect)
+{
+    if (!g_settings.dirty_rects || that != g_back_buffer_surface)
+    {
+        return;
+    }
+
+    if (rect == nullptr)
+    {
+        damage_add_full(g_back_buffer_damage);
+    }
+    else
+    {
+        damage_add(g_back_buffer_damage, to_raster_rect(*rect));
+    }
+}
+
+// the rows of the locked area the game wrote to while it had the watched back buffer locked were drawn
+void record_watched_damage(const watched_lock &lock)
+{
+    static std::vector<std::size_t> pages;
+    const auto rows =
+        write_watch_damage(*g_back_buffer_watch, lock.pitch, g_width, g_height, lock.rect, g_back_buffer_damage, pages);
+    log("\t{} pages written, {} row ranges", pages.size(), rows);
+}
+
+// anything written into the image surface may punch holes into or fill in its opaque runs
+void forget_image_spans(void *that)
+{
+    if (that == g_image_surface)
+    {
+        g_image_spans.reset();
+    }
+}
+
+// the palette entries whose converted colour falls inside key
+std::bitset<256> keyed_palette_entries(const raster_color_key &key)
+{
+    std::bitset<256> entries{};
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        const auto colour = g_palette_lut[i] & 0xffffff;
+        entries[i] = colour >= key.low && colour <= key.high;
+    }
+    return entries;
+}
+
+// locks a surface for the lifetime of the object and describes it to the raster engine
+struct raster_lock
+{
+    LPDIRECTDRAWSURFACE7 surface{};
+    std::optional<raster_surface> view{};
+
+    explicit raster_lock(LPDIRECTDRAWSURFACE7 surface, DWORD flags = DDLOCK_WAIT)
+        : surface(surface)
+    {
+        DDSURFACEDESC2 ddsd{};
+        ddsd.dwSize = sizeof(ddsd);
+
+        if (surface->Lock(nullptr, &ddsd, flags, nullptr) != DD_OK)
+        {
+            this->surface = nullptr;
+            return;
+        }
+
+        if (const auto format = to_pixel_format(ddsd.ddpfPixelFormat))
+        {
+            view = raster_surface{
+                static_cast<std::uint8_t *>(ddsd.lpSurface),
+                ddsd.lPitch,
+                ddsd.dwWidth,
+                ddsd.dwHeight,
+                *format};
+        }
+    }
+
+    raster_lock(const raster_lock &) = delete;
+    raster_lock &operator=(const raster_lock &) = delete;
+
+    ~raster_lock()
+    {
+        if (surface != nullptr)
+        {
+            surface->Unlock(nullptr);
+        }
+    }
+};
+
+// the clip list of the clipper attached to a surface, if any
+std::optional<std::vector<raster_rect>> clip_list_for(LPDIRECTDRAWSURFACE7 surface)
+{
+    LPDIRECTDRAWCLIPPER clipper{};
+    if (surface->GetClipper(&clipper) != DD_OK)
+    {
+        return std::nullopt;
+    }
+
+    std::vector<raster_rect> clip_list{};
+
+    DWORD size{};
+    if (clipper->GetClipList(nullptr, nullptr, &size) == DD_OK && size != 0)
+    {
+        std::vector<std::byte> buffer(size);
+        auto *region = reinterpret_cast<RGNDATA *>(buffer.data());
+
+        if (clipper->GetClipList(nullptr, region, &size) == DD_OK)
+        {
+            clip_list = region_rects(*region);
+        }
+    }
+
+    clipper->Release();
+    return clip_list;
+}
+
+bool is_software_surface(void *surface)
+{
+    return g_settings.software_raster && g_software_surfaces.contains(surface);
+}
+
+bool software_blt_supported(void *that, LPDIRECTDRAWSURFACE7 src, DWORD flags)
+{
+    constexpr DWORD supported_flags =
+        DDBLT_WAIT | DDBLT_ASYNC | DDBLT_DONOTWAIT | DDBLT_COLORFILL | DDBLT_KEYSRC | DDBLT_KEYSRCOVERRIDE;
+
+    if ((flags & ~supported_flags) != 0 || !is_software_surface(that))
+    {
+        return false;
+    }
+
+    return (flags & DDBLT_COLORFILL) ? true : src != nullptr && is_software_surface(src);
+}
+
+// sprites come out of the image surface with its own key, scan it for opaque runs once instead of testing every
+// pixel of every sprite on every frame, null when [raster] spans is off
+const raster_span_table *image_spans(const raster_surface &image, const raster_color_key &key)
+{
+    if (!g_settings.sprite_spans)
+    {
+        return nullptr;
+    }
+
+    if (!g_image_spans || g_image_spans->key.low != key.low || g_image_spans->key.high != key.high)
+    {
+        g_image_spans = raster_build_spans(image, key);
+        g_image_keyed_entries = keyed_palette_entries(key);
+    }
+    return &*g_image_spans;
+}
+
+HRESULT software_blt(
+    void *that,
+    LPRECT dst_rect,
+    LPDIRECTDRAWSURFACE7 src,
+    LPRECT src_rect,
+    DWORD flags,
+    LPDDBLTFX fx)
+{
+    auto *dst = static_cast<LPDIRECTDRAWSURFACE7>(that);
+
+    const auto clip_list = clip_list_for(dst);
+    if (clip_list && clip_list->empty())
+    {
+        // a clipper that lets nothing through
+        return DD_OK;
+    }
+    const auto clip = clip_list ? std::span<const raster_rect>{*clip_list} : std::span<const raster_rect>{};
+
+    const auto dst_area = dst_rect != nullptr ? std::optional{to_raster_rect(*dst_rect)} : std::nullopt;
+    const auto src_area = src_rect != nullptr ? std::optional{to_raster_rect(*src_rect)} : std::nullopt;
+
+    raster_lock dst_lock{dst};
+    if (!dst_lock.view)
+    {
+        return DDERR_UNSUPPORTED;
+    }
+
+    if (flags & DDBLT_COLORFILL)
+    {
+        if (fx == nullptr)
+        {
+            return DDERR_INVALIDPARAMS;
+        }
+
+        const auto ok = raster_fill(*dst_lock.view, dst_area ? &*dst_area : nullptr, fx->dwFillColor, clip);
+        return ok ? DD_OK : DDERR_INVALIDRECT;
+    }
+
+    std::optional<raster_color_key> key{};
+    if (flags & DDBLT_KEYSRCOVERRIDE)
+    {
+        if (fx == nullptr)
+        {
+            return DDERR_INVALIDPARAMS;
+        }
+        key = to_raster_color_key(fx->ddckSrcColorkey);
+    }
+    else if (flags & DDBLT_KEYSRC)
+    {
+        DDCOLORKEY color_key{};
+        if (src->GetColorKey(DDCKEY_SRCBLT, &color_key) == DD_OK)
+        {
+            key = to_raster_color_key(color_key);
+        }
+    }
+
+    // a surface blitting onto itself can only be locked once
+    std::optional<raster_lock> src_lock{};
+    if (src != dst)
+    {
+        src_lock.emplace(src);
+        if (!src_lock->view)
+        {
+            return DDERR_UNSUPPORTED;
+        }
+    }
+    const auto &src_view = src_lock ? *src_lock->view : *dst_lock.view;
+
+    const raster_span_table *spans{};
+    if (src == g_image_surface && src_lock && key && !(flags & DDBLT_KEYSRCOVERRIDE))
+    {
+        spans = image_spans(src_view, *key);
+    }
+
+    const auto ok = raster_blt(
+        *dst_lock.view,
+        dst_area ? &*dst_area : nullptr,
+        src_view,
+        src_area ? &*src_area : nullptr,
+        {.clip_list = clip, .source_key = key ? &*key : nullptr, .source_spans = spans});
+
+    return ok ? DD_OK : DDERR_INVALIDRECT;
+}
+
+// the whole batch under one lock of the back buffer and one of the image surface, false if either can't be locked
+bool run_blit_batch_software(std::span<const blit_command> commands)
+{
+    const auto clip_list = clip_list_for(g_back_buffer_surface);
+    if (clip_list && clip_list->empty())
+    {
+        return true;
+    }
+    const auto clip = clip_list ? std::span<const raster_rect>{*clip_list} : std::span<const raster_rect>{};
+
+    raster_lock dst_lock{g_back_buffer_surface};
+    raster_lock src_lock{g_image_surface};
+    if (!dst_lock.view || !src_lock.view)
+    {
+        return false;
+    }
+
+    for (const auto &command : commands)
+    {
+        const auto ok =
+            command.src == nullptr
+                ? raster_fill(*dst_lock.view, &command.dst_rect, command.fill_color, clip)
+                : raster_blt(
+                      *dst_lock.view,
+                      &command.dst_rect,
+                      *src_lock.view,
+                      &command.src_rect,
+                      {.clip_list = clip,
+                       .source_key = command.keyed ? &command.key : nullptr,
+                       .source_spans = command.keyed ? image_spans(*src_lock.view, command.key) : nullptr});
+        if (!ok)
+        {
+            log("\tbatched blit failed");
+        }
+    }
+    return true;
+}
+
+// run whatever was batched since the last flush, before anything reads the back buffer or writes the image surface
+void flush_blit_batch()
+{
+    if (g_blit_batch.commands.empty())
+    {
+        return;
+    }
+
+    const auto commands = batch_schedule(g_blit_batch);
+
+    if (is_software_surface(g_back_buffer_surface) && is_software_surface(g_image_surface) &&
+        run_blit_batch_software(commands))
+    {
+        return;
+    }
+
+    // BltBatch was never implemented by DirectDraw, the driver gets the blits one after the other without the hooks
+    for (const auto &command : commands)
+    {
+        DDBLTFX fx{};
+        fx.dwSize = sizeof(fx);
+        DWORD flags = DDBLT_WAIT;
+        if (command.src == nullptr)
+        {
+            flags |= DDBLT_COLORFILL;
+            fx.dwFillColor = command.fill_color;
+        }
+        else if (command.keyed)
+        {
+            flags |= DDBLT_KEYSRCOVERRIDE;
+            fx.ddckSrcColorkey = {command.key.low, command.key.high};
+        }
+
+        auto dst_rect = to_rect(command.dst_rect);
+        auto src_rect = to_rect(command.src_rect);
+        surface_method::blt::original(
+            command.dst,
+            &dst_rect,
+            static_cast<LPDIRECTDRAWSURFACE7>(command.src),
+            command.src != nullptr ? &src_rect : nullptr,
+            flags,
+            &fx);
+    }
+}
+
+// a non-empty rect that lies entirely within bounds
+bool rect_within(const raster_rect &rect, const raster_rect &bounds)
+{
+    return !raster_rect_empty(rect) && rect.left >= bounds.left && rect.top >= bounds.top &&
+           rect.right <= bounds.right && rect.bottom <= bounds.bottom;
+}
+
+// with [raster] batch=1 fills of the back buffer and blits out of the image surface into it wait in g_blit_batch
+// until the next Flip or Lock, returns false for anything else, which has to run straight away
+bool batch_blit(
+    void *that,
+    const RECT *dst_rect,
+    LPDIRECTDRAWSURFACE7 src,
+    const RECT *src_rect,
+    DWORD flags,
+    LPDDBLTFX fx)
+{
+    constexpr DWORD batched_flags =
+        DDBLT_WAIT | DDBLT_ASYNC | DDBLT_DONOTWAIT | DDBLT_COLORFILL | DDBLT_KEYSRC | DDBLT_KEYSRCOVERRIDE;
+
+    if (!g_settings.blit_batching || that != g_back_buffer_surface || (flags & ~batched_flags) != 0)
+    {
+        return false;
+    }
+
+    // without a clipper the driver rejects a rect that sticks out of its surface, the game has to hear that from
+    // the driver rather than get DD_OK for a blit that later never happens, so such blits aren't batched
+    const auto back_buffer_rect = to_raster_rect(surface_rect(g_back_buffer_surface));
+    blit_command command{.dst = that};
+    command.dst_rect = dst_rect != nullptr ? to_raster_rect(*dst_rect) : back_buffer_rect;
+    if (!rect_within(command.dst_rect, back_buffer_rect))
+    {
+        return false;
+    }
+
+    if (flags & DDBLT_COLORFILL)
+    {
+        if (fx == nullptr)
+        {
+            return false;
+        }
+        command.fill_color = fx->dwFillColor;
+        command.opaque = true;
+    }
+    else
+    {
+        if (src != g_image_surface || ((flags & DDBLT_KEYSRCOVERRIDE) && fx == nullptr))
+        {
+            return false;
+        }
+        command.src = src;
+
+        // the key as it is now, a SetColorKey before the flush mustn't change blits made before it
+        DDCOLORKEY color_key{};
+        if (flags & DDBLT_KEYSRCOVERRIDE)
+        {
+            command.keyed = true;
+            command.key = to_raster_color_key(fx->ddckSrcColorkey);
+        }
+        else if ((flags & DDBLT_KEYSRC) && src->GetColorKey(DDCKEY_SRCBLT, &color_key) == DD_OK)
+        {
+            command.keyed = true;
+            command.key = to_raster_color_key(color_key);
+        }
+
+        const auto image_rect = to_raster_rect(surface_rect(src));
+        command.src_rect = src_rect != nullptr ? to_raster_rect(*src_rect) : image_rect;
+        if (!rect_within(command.src_rect, image_rect))
+        {
+            return false;
+        }
+        command.opaque = !command.keyed;
+    }
+
+    if (g_blit_batch.commands.size() >= blit_batch_capacity)
+    {
+        flush_blit_batch();
+    }
+    batch_add(g_blit_batch, command);
+    return true;
+}
+
+// a blit that doesn't get batched still has to see, and be seen after, the batched ones it touches
+void flush_blit_batch_for(void *dst, void *src)
+{
+    if (dst == g_back_buffer_surface || dst == g_image_surface || src == g_back_buffer_surface)
+    {
+        flush_blit_batch();
+    }
+}
+
 __declspec(dllexport) HRESULT __stdcall Blt_hook(
     void *that,
     LPRECT unnamedParam1,
@@ -326,12 +1110,53 @@ __declspec(dllexport) HRESULT __stdcall Blt_hook(
         reinterpret_cast<void *>(unnamedParam3),
         unnamedParam4,
         reinterpret_cast<void *>(unnamedParam5));
+    trace(trace_event::blt, that, unnamedParam1, unnamedParam2, unnamedParam3, unnamedParam4, unnamedParam5);
+    hook_scope scope{trace_event::blt};
+    capture_scope capture_guard{};
+    capture(
+        capture_guard,
+        capture_call::blt,
+        capture_blt_args(that, unnamedParam1, unnamedParam2, unnamedParam3, unnamedParam4, unnamedParam5));
+
+    record_back_buffer_damage(that, unnamedParam1);
+    forget_image_spans(that);
+    if (capture_guard.outermost())
+    {
+        ++g_overlay.frame_blits;
+    }
 
-    const auto res =
-        reinterpret_cast<HRESULT(__stdcall *)(void *, LPRECT, LPDIRECTDRAWSURFACE7, LPRECT, DWORD, LPDDBLTFX)>(
-            g_surface_hooks["Blt"])(that, unnamedParam1, unnamedParam2, unnamedParam3, unnamedParam4, unnamedParam5);
+    if (batch_blit(that, unnamedParam1, unnamedParam2, unnamedParam3, unnamedParam4, unnamedParam5))
+    {
+        trace(trace_event::returned, trace_event::blt, DD_OK);
+        return DD_OK;
+    }
+    flush_blit_batch_for(that, unnamedParam2);
+
+    if (software_blt_supported(that, unnamedParam2, unnamedParam4))
+    {
+        const auto res = software_blt(that, unnamedParam1, unnamedParam2, unnamedParam3, unnamedParam4, unnamedParam5);
+        if (res != DDERR_UNSUPPORTED)
+        {
+            log("\tBlt (software) returned {}", res);
+            trace(trace_event::returned, trace_event::blt, res);
+            return res;
+        }
+    }
+
+    const auto res = scope.driver(
+        [&]
+        {
+            return surface_method::blt::original(
+                that,
+                unnamedParam1,
+                unnamedParam2,
+                unnamedParam3,
+                unnamedParam4,
+                unnamedParam5);
+        });
 
     log("\tBlt returned {}", res);
+    trace(trace_event::returned, trace_event::blt, res);
     return res;
 }
 
@@ -346,89 +1171,694 @@ __declspec(dllexport) HRESULT __stdcall BltBatch_hook(
         reinterpret_cast<void *>(unnamedParam1),
         unnamedParam2,
         unnamedParam3);
+    trace(trace_event::blt_batch, that, unnamedParam1, unnamedParam2, unnamedParam3);
+    hook_scope scope{trace_event::blt_batch};
+    capture_scope capture_guard{};
+
+    for (const auto &entry : std::span{unnamedParam1, unnamedParam1 != nullptr ? unnamedParam2 : 0})
+    {
+        record_back_buffer_damage(that, entry.lprDest);
+        capture(
+            capture_guard,
+            capture_call::blt,
+            capture_blt_args(that, entry.lprDest, entry.lpDDSSrc, entry.lprSrc, entry.dwFlags, entry.lpDDBltFx));
+    }
+    forget_image_spans(that);
+    flush_blit_batch();
+
+    // only take the batch if every entry can be done in software, otherwise leave all of it to the driver
+    const auto batch = std::span{unnamedParam1, unnamedParam1 != nullptr ? unnamedParam2 : 0};
+    const auto supported = [that](const DDBLTBATCH &entry)
+    {
+        return software_blt_supported(that, reinterpret_cast<LPDIRECTDRAWSURFACE7>(entry.lpDDSSrc), entry.dwFlags);
+    };
+    const auto software = !batch.empty() && std::ranges::all_of(batch, supported);
+
+    if (software)
+    {
+        for (const auto &entry : batch)
+        {
+            const auto res = software_blt(
+                that,
+                entry.lprDest,
+                reinterpret_cast<LPDIRECTDRAWSURFACE7>(entry.lpDDSSrc),
+                entry.lprSrc,
+                entry.dwFlags,
+                entry.lpDDBltFx);
+            if (res != DD_OK)
+            {
+                return res;
+            }
+        }
+        return DD_OK;
+    }
+
+    return scope.driver(
+        [&] { return surface_method::blt_batch::original(that, unnamedParam1, unnamedParam2, unnamedParam3); });
+}
+
+__declspec(dllexport) HRESULT __stdcall BltFast_hook(
+    void *that,
+    DWORD unnamedParam1,
+    DWORD unnamedParam2,
+    LPDIRECTDRAWSURFACE7 unnamedParam3,
+    LPRECT unnamedParam4,
+    DWORD unnamedParam5)
+{
+    log("BltFast {} {} {} {} {} {}",
+        reinterpret_cast<void *>(that),
+        unnamedParam1,
+        unnamedParam2,
+        reinterpret_cast<void *>(unnamedParam3),
+        reinterpret_cast<void *>(unnamedParam4),
+        unnamedParam5);
+    trace(trace_event::blt_fast, that, unnamedParam1, unnamedParam2, unnamedParam3, unnamedParam4, unnamedParam5);
+    hook_scope scope{trace_event::blt_fast};
+    capture_scope capture_guard{};
+
+    capture_blt_fast blt_fast_args{
+        .dst = capture_handle_of(that),
+        .src = capture_handle_of(unnamedParam3),
+        .x = static_cast<std::int32_t>(unnamedParam1),
+        .y = static_cast<std::int32_t>(unnamedParam2),
+        .src_rect = {},
+        .rects = 0,
+        .flags = unnamedParam5};
+    if (unnamedParam4 != nullptr)
+    {
+        blt_fast_args.src_rect = to_raster_rect(*unnamedParam4);
+        blt_fast_args.rects = capture_has_src_rect;
+    }
+    capture(capture_guard, capture_call::blt_fast, blt_fast_args);
+    forget_image_spans(that);
+    if (capture_guard.outermost())
+    {
+        ++g_overlay.frame_blits;
+    }
+
+    // BltFast is a Blt with the destination rect implied by the position and no stretching
+    if (unnamedParam3 != nullptr && (g_settings.dirty_rects || g_settings.software_raster || g_settings.blit_batching))
+    {
+        auto src_rect = unnamedParam4 != nullptr ? *unnamedParam4 : surface_rect(unnamedParam3);
+        RECT dst_rect{
+            static_cast<LONG>(unnamedParam1),
+            static_cast<LONG>(unnamedParam2),
+            static_cast<LONG>(unnamedParam1) + (src_rect.right - src_rect.left),
+            static_cast<LONG>(unnamedParam2) + (src_rect.bottom - src_rect.top)};
+
+        record_back_buffer_damage(that, &dst_rect);
+
+        constexpr DWORD supported_fast_flags = DDBLTFAST_WAIT | DDBLTFAST_SRCCOLORKEY;
+        const DWORD flags = (unnamedParam5 & DDBLTFAST_SRCCOLORKEY) ? DDBLT_KEYSRC : 0;
+        if ((unnamedParam5 & ~supported_fast_flags) == 0 &&
+            batch_blit(that, &dst_rect, unnamedParam3, &src_rect, flags, nullptr))
+        {
+            trace(trace_event::returned, trace_event::blt_fast, DD_OK);
+            return DD_OK;
+        }
+        flush_blit_batch_for(that, unnamedParam3);
+
+        if ((unnamedParam5 & ~supported_fast_flags) == 0 && software_blt_supported(that, unnamedParam3, 0))
+        {
+            const auto res = software_blt(that, &dst_rect, unnamedParam3, &src_rect, flags, nullptr);
+            if (res != DDERR_UNSUPPORTED)
+            {
+                log("\tBltFast (software) returned {}", res);
+                trace(trace_event::returned, trace_event::blt_fast, res);
+                return res;
+            }
+        }
+    }
+
+    const auto res = scope.driver(
+        [&]
+        {
+            return surface_method::blt_fast::original(
+                that,
+                unnamedParam1,
+                unnamedParam2,
+                unnamedParam3,
+                unnamedParam4,
+                unnamedParam5);
+        });
+
+    log("\tBltFast returned {}", res);
+    trace(trace_event::returned, trace_event::blt_fast, res);
+    return res;
+}
+
+// the screen under the window only keeps what we presented while nothing covers or moves it, so dirty rect presents
+// fall back to a full copy when the window has moved or has an area waiting to be repainted
+bool window_needs_full_present()
+{
+    static POINT last_origin{LONG_MIN, LONG_MIN};
+
+    POINT origin{};
+    ::ClientToScreen(g_window, &origin);
+
+    const auto moved = origin.x != last_origin.x || origin.y != last_origin.y;
+    last_origin = origin;
+
+    return moved || ::GetUpdateRect(g_window, nullptr, FALSE) != FALSE;
+}
+
+// window sized system memory surface the cpu scalers draw into, remade when the client area changes size
+LPDIRECTDRAWSURFACE7 scale_surface(std::uint32_t width, std::uint32_t height)
+{
+    if (g_scale_surface != nullptr)
+    {
+        DDSURFACEDESC2 ddsd{};
+        ddsd.dwSize = sizeof(ddsd);
+        if (g_scale_surface->GetSurfaceDesc(&ddsd) == DD_OK && ddsd.dwWidth == width && ddsd.dwHeight == height)
+        {
+            return g_scale_surface;
+        }
+
+        g_scale_surface->Release();
+        g_scale_surface = nullptr;
+    }
+
+    DDSURFACEDESC2 ddsd{
+        .dwSize = sizeof(DDSURFACEDESC2),
+        .dwFlags = DDSD_CAPS | DDSD_WIDTH | DDSD_HEIGHT,
+        .dwHeight = height,
+        .dwWidth = width,
+        .ddsCaps = {.dwCaps = DDSCAPS_OFFSCREENPLAIN | DDSCAPS_SYSTEMMEMORY}};
+
+    if (ddraw_method::create_surface::original(g_ddraw, &ddsd, &g_scale_surface, nullptr) != DD_OK)
+    {
+        g_scale_surface = nullptr;
+        return nullptr;
+    }
+
+    // the letterbox bars are never drawn over, clear them once
+    DDBLTFX fx{};
+    fx.dwSize = sizeof(fx);
+    fx.dwFillColor = 0;
+    surface_method::blt::original(g_scale_surface, nullptr, nullptr, nullptr, DDBLT_COLORFILL | DDBLT_WAIT, &fx);
+
+    return g_scale_surface;
+}
+
+// for the [overlay], present_surface runs on the present thread in async mode
+void count_presented(std::int64_t pixels)
+{
+    if (g_settings.overlay)
+    {
+        g_overlay.presented_bytes.fetch_add(
+            static_cast<std::uint64_t>(pixels) * g_display_bytes_per_pixel,
+            std::memory_order_relaxed);
+    }
+}
+
+// scale the game's corner of source up to the window on the cpu and copy the result to the screen
+// scaled presents are always full frames, the scaler would have to redo the whole frame's worth of filtering anyway
+HRESULT present_scaled(LPDIRECTDRAWSURFACE7 source)
+{
+    RECT client{};
+    ::GetClientRect(g_window, &client);
+    POINT origin{};
+    ::ClientToScreen(g_window, &origin);
+
+    const auto frame = scaled_frame_rect();
+    const raster_rect game_rect{0, 0, static_cast<std::int32_t>(game_width), static_cast<std::int32_t>(game_height)};
+
+    auto scaled = false;
+    auto *target = scale_surface(static_cast<std::uint32_t>(client.right), static_cast<std::uint32_t>(client.bottom));
+    if (target != nullptr)
+    {
+        raster_lock src_lock{source, DDLOCK_WAIT | DDLOCK_READONLY};
+        raster_lock dst_lock{target, DDLOCK_WAIT | DDLOCK_WRITEONLY};
+
+        if (src_lock.view && dst_lock.view && scale_filter_factor(g_settings.scale) != 1)
+        {
+            scaled = scale_filter(
+                g_pool,
+                g_scale_filter_frames,
+                g_settings.scale,
+                *dst_lock.view,
+                frame,
+                *src_lock.view,
+                game_rect,
+                detect_simd_level());
+        }
+        else if (src_lock.view && dst_lock.view)
+        {
+            // every band checks the same surfaces and rects, so they all fail or none do
+            std::atomic<bool> ok{true};
+            pool_for_rows(
+                g_pool,
+                static_cast<std::uint32_t>(frame.bottom - frame.top),
+                static_cast<std::size_t>(frame.right - frame.left) * sizeof(std::uint32_t),
+                [&](std::uint32_t first, std::uint32_t last)
+                {
+                    const auto band =
+                        g_settings.scale == scale_mode::integer
+                            ? scale_nearest_rows(*dst_lock.view, frame, *src_lock.view, game_rect, first, last)
+                            : scale_bilinear_rows(
+                                  *dst_lock.view,
+                                  frame,
+                                  *src_lock.view,
+                                  game_rect,
+                                  first,
+                                  last,
+                                  detect_simd_level());
+                    if (!band)
+                    {
+                        ok.store(false, std::memory_order_relaxed);
+                    }
+                });
+            scaled = ok.load(std::memory_order_relaxed);
+        }
+    }
+
+    RECT screen{origin.x, origin.y, origin.x + client.right, origin.y + client.bottom};
+    if (scaled)
+    {
+        count_presented(static_cast<std::int64_t>(client.right) * client.bottom);
+        return surface_method::blt::original(g_primary_surface, &screen, g_scale_surface, nullptr, DDBLT_WAIT, nullptr);
+    }
+
+    // not a format the scalers handle, let the driver stretch it instead
+    RECT src{game_rect.left, game_rect.top, game_rect.right, game_rect.bottom};
+    RECT dst{origin.x + frame.left, origin.y + frame.top, origin.x + frame.right, origin.y + frame.bottom};
+    count_presented(static_cast<std::int64_t>(frame.right - frame.left) * (frame.bottom - frame.top));
+    return surface_method::blt::original(g_primary_surface, &dst, source, &src, DDBLT_WAIT, nullptr);
+}
+
+// copy a finished frame to the window, with dirty rects only the parts that changed since the last present
+HRESULT present_surface(LPDIRECTDRAWSURFACE7 source, const damage_list &damage)
+{
+    if (g_settings.scale != scale_mode::off)
+    {
+        return present_scaled(source);
+    }
+
+    if (!g_settings.dirty_rects || window_needs_full_present())
+    {
+        count_presented(static_cast<std::int64_t>(g_width) * g_height);
+        return surface_method::blt::original(g_primary_surface, nullptr, source, nullptr, DDBLT_WAIT, nullptr);
+    }
+
+    const auto rects =
+        damage_present_rects(damage, g_settings.dirty_rect_max, g_settings.dirty_rect_threshold / 100.0);
+
+    log("\tpresenting {} rects ({} damaged pixels)", rects.size(), damage_area(damage));
+
+    for (const auto &rect : rects)
+    {
+        count_presented(static_cast<std::int64_t>(rect.right - rect.left) * (rect.bottom - rect.top));
+        RECT area{rect.left, rect.top, rect.right, rect.bottom};
+        const auto res = surface_method::blt::original(g_primary_surface, &area, source, &area, DDBLT_WAIT, nullptr);
+        if (res != DD_OK)
+        {
+            return res;
+        }
+    }
+
+    return DD_OK;
+}
+
+// async present mode, takes frames Flip queued and puts them on the screen until the queue is stopped
+void present_thread()
+{
+    // everything this thread does is the patcher's own work, never the game's
+    capture_scope not_captured{};
+
+    std::uint32_t slot{};
+    damage_list damage{};
+
+    while (present_next(g_present_queue, slot, damage))
+    {
+        const auto res = present_surface(g_staging_surfaces[slot], damage);
+        log("\tasync present returned {}", res);
+        present_release(g_present_queue, slot);
+    }
+}
+
+// first conversion after a load, copied out of the atlas cache when this image and palette were seen before
+void convert_image_cached(const bgra_view &dst)
+{
+    const auto key = make_atlas_key(g_image_hash, g_palette_lut);
+    const auto path = atlas_cache_path(g_settings.atlas_cache_dir, key);
+
+    mapped_file atlas{};
+    if (atlas_cache_open(path, key, dst.width, dst.height, atlas))
+    {
+        log("atlas cache hit {}", path.string());
+        atlas_cache_copy(atlas, dst);
+        return;
+    }
+
+    // convert into memory we can read back cheaply, the surface may well be in video memory
+    std::vector<std::uint32_t> pixels(static_cast<std::size_t>(dst.width) * dst.height);
+    const bgra_view converted{
+        reinterpret_cast<std::uint8_t *>(pixels.data()),
+        static_cast<std::ptrdiff_t>(dst.width * sizeof(std::uint32_t)),
+        dst.width,
+        dst.height};
+    convert_parallel(g_image.pixels, converted);
+
+    for (std::uint32_t y = 0; y < dst.height; ++y)
+    {
+        const auto *row = converted.pixels + y * converted.pitch;
+        std::memcpy(dst.pixels + y * dst.pitch, row, dst.width * sizeof(std::uint32_t));
+    }
+
+    const auto stored = atlas_cache_store(path, key, converted);
+    log("atlas cache miss {}, stored {}", path.string(), stored);
+}
+
+// convert_indexed_to_bgra in bands of rows spread over g_pool
+void convert_parallel(const indexed_view &src, const bgra_view &dst)
+{
+    const auto width = std::min(src.width, dst.width);
+    const auto height = std::min(src.height, dst.height);
+
+    pool_for_rows(
+        g_pool,
+        height,
+        width * sizeof(std::uint32_t),
+        [&](std::uint32_t first, std::uint32_t last)
+        {
+            convert_indexed_to_bgra(
+                indexed_subview(src, 0, first, width, last - first),
+                bgra_subview(dst, 0, first, width, last - first),
+                g_palette_lut);
+        });
+}
+
+// indexed mode: the image surface holds the file's indices as they are, so only a new image has to be copied in
+void copy_image_indices()
+{
+    DDSURFACEDESC2 ddsd{};
+    ddsd.dwSize = sizeof(ddsd);
+    if (g_image_surface->Lock(nullptr, &ddsd, DDLOCK_WAIT | DDLOCK_WRITEONLY, nullptr) != DD_OK)
+    {
+        return;
+    }
+
+    copy_indexed(g_image.pixels, static_cast<std::uint8_t *>(ddsd.lpSurface), ddsd.lPitch, ddsd.dwWidth, ddsd.dwHeight);
+    g_image_converted = true;
+    g_image_spans.reset();
+
+    g_image_surface->Unlock(nullptr);
+}
+
+// rgb mode: apply the palette to the image surface, the first time all of it and after that the changed entries
+// a failed lock (a lost surface) leaves the image and the palette changes pending for the next flip
+void convert_image()
+{
+    DDSURFACEDESC2 ddsd{};
+    ddsd.dwSize = sizeof(ddsd);
+    const auto res = g_image_surface->Lock(nullptr, &ddsd, DDLOCK_WAIT, nullptr);
+    if (res != DD_OK)
+    {
+        log("\tlocking the image surface failed {}", res);
+        return;
+    }
+
+    log("pitch: {} width: {} height: {} changed entries: {}",
+        ddsd.lPitch,
+        ddsd.dwWidth,
+        ddsd.dwHeight,
+        g_palette_changes.count());
+
+    build_palette_lut(palette_view(), g_palette_lut);
+
+    // the image was loaded while the back buffer was still going to be 8 bit
+    if (g_image_palette_index.width == 0 && g_image.pixels.width != 0)
+    {
+        g_image_palette_index = build_palette_pixel_index(g_image.pixels);
+    }
+
+    const bgra_view dst{static_cast<std::uint8_t *>(ddsd.lpSurface), ddsd.lPitch, ddsd.dwWidth, ddsd.dwHeight};
+    const auto total_pixels = static_cast<std::size_t>(ddsd.dwWidth) * ddsd.dwHeight;
+
+    // a big fade touches most of the image anyway, at that point a straight conversion is cheaper
+    const auto incremental = g_image_converted && g_image_palette_index.width == ddsd.dwWidth &&
+                             g_image_palette_index.height == ddsd.dwHeight &&
+                             pixels_affected(g_image_palette_index, g_palette_changes) * 2 < total_pixels;
+
+    if (incremental)
+    {
+        apply_palette_changes(g_image_palette_index, g_palette_changes, g_palette_lut, dst);
+    }
+    else if (!g_image_converted && g_settings.atlas_cache)
+    {
+        convert_image_cached(dst);
+    }
+    else
+    {
+        // the view already walks a bottom-up file backwards, so the surface is written top to bottom
+        convert_parallel(g_image.pixels, dst);
+    }
+
+    // runs built before the first conversion saw whatever was in the surface, after that a pixel only turns
+    // transparent or opaque when its entry starts or stops converting to the key
+    if (g_image_spans && (!g_image_converted || keyed_palette_entries(g_image_spans->key) != g_image_keyed_entries))
+    {
+        g_image_spans.reset();
+    }
+
+    g_image_converted = true;
+    g_palette_changes.reset();
+
+    g_image_surface->Unlock(nullptr);
+}
+
+// indexed mode: apply the palette to the back buffer into target, a display format surface
+// with damage only the rects drawn this frame are converted, which is only right when target already holds the
+// previous frame, null converts all of it
+bool convert_back_buffer(LPDIRECTDRAWSURFACE7 target, const damage_list *damage)
+{
+    raster_lock src_lock{g_back_buffer_surface, DDLOCK_WAIT | DDLOCK_READONLY};
+    raster_lock dst_lock{target, DDLOCK_WAIT | DDLOCK_WRITEONLY};
+
+    if (!src_lock.view || !dst_lock.view || src_lock.view->format != pixel_format::indexed8 ||
+        dst_lock.view->format != pixel_format::argb8888)
+    {
+        return false;
+    }
+
+    const auto &src = *src_lock.view;
+    const auto &dst = *dst_lock.view;
+    const indexed_view indices{src.pixels, src.pitch, src.width, src.height};
+    const bgra_view bgra{dst.pixels, dst.pitch, dst.width, dst.height};
+
+    if (damage == nullptr || damage->full)
+    {
+        convert_parallel(indices, bgra);
+        return true;
+    }
+
+    const raster_rect frame{
+        0,
+        0,
+        static_cast<std::int32_t>(std::min(src.width, dst.width)),
+        static_cast<std::int32_t>(std::min(src.height, dst.height))};
+
+    for (const auto &rect : damage->rects)
+    {
+        const auto area = raster_intersect(rect, frame);
+        if (raster_rect_empty(area))
+        {
+            continue;
+        }
+
+        const auto x = static_cast<std::uint32_t>(area.left);
+        const auto y = static_cast<std::uint32_t>(area.top);
+        const auto width = static_cast<std::uint32_t>(area.right - area.left);
+        const auto height = static_cast<std::uint32_t>(area.bottom - area.top);
+        convert_parallel(indexed_subview(indices, x, y, width, height), bgra_subview(bgra, x, y, width, height));
+    }
+    return true;
+}
+
+// draw the [overlay] into the back buffer and have it presented, keeping what was under it
+void draw_overlay()
+{
+    const raster_lock back{g_back_buffer_surface};
+    if (!back.view)
+    {
+        return;
+    }
 
-    return reinterpret_cast<HRESULT(__stdcall *)(void *, LPDDBLTBATCH, DWORD, DWORD)>(
-        g_surface_hooks["BltBatch"])(that, unnamedParam1, unnamedParam2, unnamedParam3);
+    const auto rect = overlay_rect(back.view->width, back.view->height);
+    overlay_save(g_overlay_backup, *back.view, rect);
+    overlay_draw(*back.view, g_overlay, overlay_colors_for(back.view->format, palette_view()));
+    damage_add(g_back_buffer_damage, rect);
 }
 
-__declspec(dllexport) HRESULT __stdcall BltFast_hook(
-    void *that,
-    DWORD unnamedParam1,
-    DWORD unnamedParam2,
-    LPDIRECTDRAWSURFACE7 unnamedParam3,
-    LPRECT unnamedParam4,
-    DWORD unnamedParam5)
+// put back what draw_overlay covered, the game may only redraw part of its next frame
+// runs after the present reset the damage, so the restored pixels go into the next frame's
+void remove_overlay()
 {
-    log("BltFast {} {} {} {} {} {}",
-        reinterpret_cast<void *>(that),
-        unnamedParam1,
-        unnamedParam2,
-        reinterpret_cast<void *>(unnamedParam3),
-        reinterpret_cast<void *>(unnamedParam4),
-        unnamedParam5);
+    const raster_lock back{g_back_buffer_surface};
+    if (back.view)
+    {
+        overlay_restore(g_overlay_backup, *back.view);
+        damage_add(g_back_buffer_damage, g_overlay_backup.rect);
+    }
+}
+
+// [trace] first_frame and frames, switched before Flip traces anything so the trace is whole frames, Flip to Flip
+void trace_frame_window()
+{
+    if (!g_settings.trace)
+    {
+        return;
+    }
 
-    return reinterpret_cast<HRESULT(__stdcall *)(void *, DWORD, DWORD, LPDIRECTDRAWSURFACE7, LPRECT, DWORD)>(
-        g_surface_hooks["BltFast"])(that, unnamedParam1, unnamedParam2, unnamedParam3, unnamedParam4, unnamedParam5);
+    if (g_frames == g_settings.trace_first_frame)
+    {
+        trace_pause(false);
+    }
+    const auto last = std::uint64_t{g_settings.trace_first_frame} + g_settings.trace_frames;
+    if (g_settings.trace_frames != 0 && g_frames == last)
+    {
+        trace_pause(true);
+    }
 }
 
 __declspec(dllexport) HRESULT __stdcall Flip_hook(void *that, LPDIRECTDRAWSURFACE7 unnamedParam1, DWORD unnamedParam2)
 {
+    trace_frame_window();
     log("Flip {} {} {}", that, reinterpret_cast<void *>(unnamedParam1), unnamedParam2);
+    trace(trace_event::flip, that, unnamedParam1, unnamedParam2);
+    hook_scope scope{trace_event::flip};
+    capture_scope capture_guard{};
+    capture(capture_guard, capture_call::flip, capture_flip{capture_handle_of(that), unnamedParam2, 0});
 
-    DDSURFACEDESC2 ddsd{};
-    ddsd.dwSize = sizeof(ddsd);
-
-    static auto once = false;
+    // the frame is finished, everything batched for it goes into the back buffer before it is presented
+    flush_blit_batch();
 
-    //  manually apply palette (once) to the loaded image as palett's don't work as expected in windows mode
+    //  manually apply palette to the loaded image as palett's don't work as expected in windows mode
+    // the first present converts the whole image, after that only pixels using a changed entry are rewritten
 
-    if (!once)
+    if (g_settings.indexed_back_buffer)
     {
-        once = true;
-        assert(g_image_surface->Lock(nullptr, &ddsd, DDLOCK_WAIT, nullptr) == DD_OK);
-
-        auto *pSurfaceMemory = static_cast<BYTE *>(ddsd.lpSurface);
-        const auto pitch = ddsd.lPitch;
+        if (!g_image_converted)
+        {
+            copy_image_indices();
+        }
 
-        log("pitch: {} width: {} height: {}", pitch, ddsd.dwWidth, ddsd.dwHeight);
+        // the palette is applied on the way to the screen, so a change means every pixel on it may be out of date
+        if (g_palette_changes.any())
+        {
+            build_palette_lut(palette_view(), g_palette_lut);
+            g_palette_changes.reset();
+            damage_add_full(g_back_buffer_damage);
+        }
+    }
+    else if (!g_image_converted || g_palette_changes.any())
+    {
+        convert_image();
+    }
 
-        for (auto y = 0; y < ddsd.dwHeight; ++y)
+    // the finished frame as the game drew it, the recorder takes a copy or drops it and never waits on its encoder
+    if (g_settings.record)
+    {
+        const raster_lock frame{g_back_buffer_surface, DDLOCK_WAIT | DDLOCK_READONLY};
+        if (frame.view)
         {
-            for (auto x = 0; x < ddsd.dwWidth; ++x)
-            {
-                auto *pRow = pSurfaceMemory + ((y * ddsd.dwWidth) + x) * 4;
-                auto paletteIndex = g_image_pixels[(ddsd.dwHeight - y - 1) * ddsd.dwWidth + x];
+            recording_submit(g_recorder, *frame.view, palette_view(), g_frames);
+        }
+    }
 
-                log("palette index: {}", paletteIndex);
+    // the overlay goes on top of the finished frame, after the recorder has it, and comes off again once it's presented
+    std::uint64_t overlay_ns{};
+    if (g_settings.overlay)
+    {
+        const auto start = trace_now();
+        draw_overlay();
+        overlay_ns = trace_now() - start;
+    }
 
-                auto colour = g_palette[paletteIndex];
+    // Flip() would internally manage the buffers for us on full screen but not in windowed mode
+    // simulate that by blitting the back buffer to the screen, with dirty rects only the parts drawn this frame
 
-                pRow[0] = colour.peBlue;
-                pRow[1] = colour.peGreen;
-                pRow[2] = colour.peRed;
-                pRow[3] = 0;
+    HRESULT res = DD_OK;
 
-                // for some reason the bitmap image has magenta instead of a white background - so fix that
-                /*
-                if (pRow[0] == 0xff && pRow[1] == 0 && pRow[2] == 0xff)
-                {
-                    pRow[1] = 0xff;
-                }
-                */
+    if (g_settings.async_present)
+    {
+        // hand the frame to the present thread, Flip only pays for a copy into a staging surface
+        std::uint32_t slot{};
+        if (present_acquire(g_present_queue, slot))
+        {
+            // staging surfaces take turns, so with the indexed back buffer each one gets a whole converted frame
+            if (g_settings.indexed_back_buffer)
+            {
+                res = convert_back_buffer(g_staging_surfaces[slot], nullptr) ? DD_OK : DDERR_INVALIDPIXELFORMAT;
+            }
+            else
+            {
+                res = scope.driver(
+                    [&]
+                    {
+                        return surface_method::blt::original(
+                            g_staging_surfaces[slot],
+                            nullptr,
+                            g_back_buffer_surface,
+                            nullptr,
+                            DDBLT_WAIT,
+                            nullptr);
+                    });
+            }
+
+            if (res == DD_OK)
+            {
+                present_submit(g_present_queue, slot, g_back_buffer_damage);
+                damage_reset(g_back_buffer_damage, g_width, g_height);
+            }
+            else
+            {
+                // the slot may have been carrying damage from a dropped frame, repaint everything next time
+                present_release(g_present_queue, slot);
+                damage_add_full(g_back_buffer_damage);
             }
         }
+    }
+    else if (g_settings.indexed_back_buffer)
+    {
+        // the present surface keeps the last frame, so without a palette change only what was drawn is converted
+        const auto *damage = g_settings.dirty_rects ? &g_back_buffer_damage : nullptr;
+        res = convert_back_buffer(g_present_surface, damage)
+                  ? scope.driver([&] { return present_surface(g_present_surface, g_back_buffer_damage); })
+                  : DDERR_INVALIDPIXELFORMAT;
+        damage_reset(g_back_buffer_damage, g_width, g_height);
+    }
+    else
+    {
+        res = scope.driver([&] { return present_surface(g_back_buffer_surface, g_back_buffer_damage); });
+        damage_reset(g_back_buffer_damage, g_width, g_height);
+    }
 
-        g_image_surface->Unlock(nullptr);
+    if (g_settings.overlay)
+    {
+        const auto start = trace_now();
+        remove_overlay();
+        const auto now = trace_now();
+        g_overlay.overlay_ns = overlay_ns + (now - start);
+        overlay_frame(g_overlay, now);
     }
 
-    // Flip() would internally manage the buffers for us on full screen but not in windowed mode
-    // simulate that by blitting the back buffer to the screen
+    ++g_frames;
 
-    const auto res =
-        reinterpret_cast<HRESULT(__stdcall *)(void *, LPRECT, LPDIRECTDRAWSURFACE7, LPRECT, DWORD, LPDDBLTFX)>(
-            g_surface_hooks["Blt"])(that, nullptr, g_back_buffer_surface, nullptr, DDBLT_WAIT, nullptr);
+    // dump on the key going down, not for every frame it's held
+    if (g_settings.stats && g_settings.stats_dump_key != 0)
+    {
+        static bool was_down{};
+        const auto down = (::GetAsyncKeyState(static_cast<int>(g_settings.stats_dump_key)) & 0x8000) != 0;
+        if (down && !was_down)
+        {
+            dump_hook_stats();
+        }
+        was_down = down;
+    }
 
     log("\tFlip(Blt) returned {}", res);
+    trace(trace_event::returned, trace_event::flip, res);
 
     return res;
 }
@@ -446,37 +1876,152 @@ __declspec(dllexport) HRESULT __stdcall Lock_hook(
         reinterpret_cast<void *>(unnamedParam2),
         unnamedParam3,
         reinterpret_cast<void *>(unnamedParam4));
+    trace(trace_event::lock, that, unnamedParam1, unnamedParam2, unnamedParam3);
+    hook_scope scope{trace_event::lock};
+    capture_scope capture_guard{};
+
+    capture_lock lock_args{.surface = capture_handle_of(that), .rect = {}, .rects = 0, .flags = unnamedParam3};
+    if (unnamedParam1 != nullptr)
+    {
+        lock_args.rect = to_raster_rect(*unnamedParam1);
+        lock_args.rects = capture_has_dst_rect;
+    }
+    capture(capture_guard, capture_call::lock, lock_args);
+
+    // there's no telling what the game writes through a lock so the whole locked area counts as drawn, unless the back
+    // buffer is watched and Unlock can tell which rows it was
+    // the patcher's own locks (software blits, the overlay) note down what they change themselves
+    const auto watched = that == g_back_buffer_surface && g_back_buffer_watch != nullptr &&
+                         !(unnamedParam3 & DDLOCK_READONLY) && capture_guard.outermost();
+    if (!(unnamedParam3 & DDLOCK_READONLY) && !watched && capture_guard.outermost())
+    {
+        record_back_buffer_damage(that, unnamedParam1);
+    }
+
+    // the game is about to look at the back buffer or change the image, the batched blits have to have happened
+    if (capture_guard.outermost() && (that == g_back_buffer_surface || that == g_image_surface))
+    {
+        flush_blit_batch();
+    }
+
+    // the patcher's own locks of the image surface are software blits out of it and Flip converting it, which checks
+    // the keyed entries itself, only the game's locks can move the opaque runs
+    if (!(unnamedParam3 & DDLOCK_READONLY) && capture_guard.outermost())
+    {
+        forget_image_spans(that);
+    }
+
+    // after the flush, whatever the batched blits drew is in the damage already
+    if (watched)
+    {
+        write_watch_reset(*g_back_buffer_watch);
+    }
+
+    const auto res = scope.driver(
+        [&]
+        { return surface_method::lock::original(that, unnamedParam1, unnamedParam2, unnamedParam3, unnamedParam4); });
+
+    if (watched && res == DD_OK)
+    {
+        g_watched_lock = watched_lock{
+            .rect = unnamedParam1 != nullptr ? to_raster_rect(*unnamedParam1)
+                                             : raster_rect{
+                                                   0,
+                                                   0,
+                                                   static_cast<std::int32_t>(g_width),
+                                                   static_cast<std::int32_t>(g_height)},
+            .pitch = static_cast<std::size_t>(unnamedParam2->lPitch)};
+    }
+    else if (watched)
+    {
+        record_back_buffer_damage(that, unnamedParam1);
+    }
+
+    // remember where the game is about to write, the pixels are captured once it unlocks
+    const auto capturing = g_capture_enabled.load(std::memory_order_relaxed) && capture_guard.outermost();
+    if (capturing && res == DD_OK && !(unnamedParam3 & DDLOCK_READONLY))
+    {
+        const auto rect = unnamedParam1 != nullptr ? to_raster_rect(*unnamedParam1)
+                                                   : raster_rect{
+                                                         0,
+                                                         0,
+                                                         static_cast<std::int32_t>(unnamedParam2->dwWidth),
+                                                         static_cast<std::int32_t>(unnamedParam2->dwHeight)};
+        const auto format = to_pixel_format(unnamedParam2->ddpfPixelFormat);
+        g_capture_locks[that] = {
+            rect,
+            static_cast<const std::uint8_t *>(unnamedParam2->lpSurface),
+            unnamedParam2->lPitch,
+            format ? bytes_per_pixel(*format) : unnamedParam2->ddpfPixelFormat.dwRGBBitCount / 8};
+    }
 
-    return reinterpret_cast<HRESULT(__stdcall *)(void *, LPRECT, LPDDSURFACEDESC2, DWORD, HANDLE)>(
-        g_surface_hooks["Lock"])(that, unnamedParam1, unnamedParam2, unnamedParam3, unnamedParam4);
+    return res;
 }
 
 __declspec(dllexport) HRESULT __stdcall Unlock_hook(void *that, LPRECT unnamedParam1)
 {
     log("Unlock {} {}", reinterpret_cast<void *>(that), reinterpret_cast<void *>(unnamedParam1));
+    trace(trace_event::unlock, that, unnamedParam1);
+    hook_scope scope{trace_event::unlock};
+    capture_scope capture_guard{};
+
+    if (const auto locked = g_capture_locks.find(that); locked != g_capture_locks.end())
+    {
+        const auto &state = locked->second;
+        const auto row_bytes = static_cast<std::size_t>(state.rect.right - state.rect.left) * state.bytes_per_pixel;
+        const auto rows = static_cast<std::size_t>(state.rect.bottom - state.rect.top);
 
-    return reinterpret_cast<HRESULT(__stdcall *)(void *, LPRECT)>(g_surface_hooks["Unlock"])(that, unnamedParam1);
+        std::vector<std::uint8_t> pixels(row_bytes * rows);
+        for (std::size_t y = 0; y < rows; ++y)
+        {
+            const auto *row = state.pixels + static_cast<std::ptrdiff_t>(y) * state.pitch;
+            std::memcpy(pixels.data() + y * row_bytes, row, row_bytes);
+        }
+
+        capture(
+            capture_guard,
+            capture_call::unlock,
+            capture_unlock{
+                capture_handle_of(that),
+                state.rect,
+                static_cast<std::uint32_t>(row_bytes),
+                static_cast<std::uint32_t>(rows)},
+            std::span<const std::uint8_t>{pixels});
+        g_capture_locks.erase(locked);
+    }
+
+    if (g_watched_lock && that == g_back_buffer_surface && capture_guard.outermost())
+    {
+        record_watched_damage(*g_watched_lock);
+        g_watched_lock.reset();
+    }
+
+    return scope.driver([&] { return surface_method::unlock::original(that, unnamedParam1); });
 }
 
 __declspec(dllexport) HRESULT __stdcall SetPalette_hook(void *that, LPDIRECTDRAWPALETTE unnamedParam1)
 {
     log("SetPalette {} {}", that, reinterpret_cast<void *>(unnamedParam1));
+    trace(trace_event::set_palette, that, unnamedParam1);
+    hook_scope scope{trace_event::set_palette};
 
-    const auto res = reinterpret_cast<HRESULT(__stdcall *)(void *, LPDIRECTDRAWPALETTE)>(
-        g_surface_hooks["SetPalette"])(that, unnamedParam1);
+    const auto res = scope.driver([&] { return surface_method::set_palette::original(that, unnamedParam1); });
 
     log("\tSetPalette returned {}", res);
+    trace(trace_event::returned, trace_event::set_palette, res);
     return res;
 }
 
 __declspec(dllexport) HRESULT __stdcall GetPixelFormat_hook(void *that, LPDDPIXELFORMAT unnamedParam1)
 {
     log("GetPixelFormat {} {}", that, reinterpret_cast<void *>(unnamedParam1));
+    trace(trace_event::get_pixel_format, that, unnamedParam1);
+    hook_scope scope{trace_event::get_pixel_format};
 
-    const auto res = reinterpret_cast<HRESULT(__stdcall *)(void *, LPDDPIXELFORMAT)>(
-        g_surface_hooks["GetPixelFormat"])(that, unnamedParam1);
+    const auto res = scope.driver([&] { return surface_method::get_pixel_format::original(that, unnamedParam1); });
 
     log("\tGetPixelFormat returned {}", res);
+    trace(trace_event::returned, trace_event::get_pixel_format, res);
     return res;
 }
 
@@ -488,6 +2033,9 @@ __declspec(dllexport) HRESULT __stdcall GetPixelFormat_hook(void *that, LPDDPIXE
 __declspec(dllexport) HRESULT __stdcall SetColorKey_hook(void *that, DWORD unnamedParam1, LPDDCOLORKEY unnamedParam2)
 {
     log("SetColorKey {} {} {}", that, unnamedParam1, reinterpret_cast<void *>(unnamedParam2));
+    trace(trace_event::set_color_key, that, unnamedParam1, unnamedParam2);
+    hook_scope scope{trace_event::set_color_key};
+    capture_scope capture_guard{};
 
     DDPIXELFORMAT pixelFormat{};
     pixelFormat.dwSize = sizeof(pixelFormat);
@@ -495,7 +2043,8 @@ __declspec(dllexport) HRESULT __stdcall SetColorKey_hook(void *that, DWORD unnam
 
     DDCOLORKEY colorKey;
 
-    if (pixelFormat.dwFlags & DDPF_RGB)
+    // 8 bit surfaces report DDPF_RGB as well, their keys are palette indices and go through as they are
+    if ((pixelFormat.dwFlags & DDPF_RGB) && !(pixelFormat.dwFlags & DDPF_PALETTEINDEXED8))
     {
         switch (pixelFormat.dwRGBBitCount)
         {
@@ -531,13 +2080,126 @@ __declspec(dllexport) HRESULT __stdcall SetColorKey_hook(void *that, DWORD unnam
         colorKey.dwColorSpaceLowValue = unnamedParam2->dwColorSpaceLowValue;
     }
 
-    const auto res = reinterpret_cast<HRESULT(__stdcall *)(void *, DWORD, LPDDCOLORKEY)>(
-        g_surface_hooks["SetColorKey"])(that, DDCKEY_SRCBLT, &colorKey);
+    capture(
+        capture_guard,
+        capture_call::set_color_key,
+        capture_set_color_key{
+            capture_handle_of(that),
+            DDCKEY_SRCBLT,
+            to_raster_color_key(colorKey),
+            0});
+
+    const auto res =
+        scope.driver([&] { return surface_method::set_color_key::original(that, DDCKEY_SRCBLT, &colorKey); });
 
     log("\tSetColorKey returned {}", res);
+    trace(trace_event::returned, trace_event::set_color_key, res);
     return res;
 }
 
+// every surface we hand out gets the same set of hooks
+using surface_hooks = vtable_hooks<
+    vtable_hook<surface_method::get_attached_surface, GetAttachedSurface_hook>,
+    vtable_hook<surface_method::blt, Blt_hook>,
+    vtable_hook<surface_method::blt_batch, BltBatch_hook>,
+    vtable_hook<surface_method::blt_fast, BltFast_hook>,
+    vtable_hook<surface_method::flip, Flip_hook>,
+    vtable_hook<surface_method::lock, Lock_hook>,
+    vtable_hook<surface_method::unlock, Unlock_hook>,
+    vtable_hook<surface_method::set_palette, SetPalette_hook>,
+    vtable_hook<surface_method::set_color_key, SetColorKey_hook>,
+    vtable_hook<surface_method::get_pixel_format, GetPixelFormat_hook>>;
+
+// where to put the back buffer and image surface, the software raster path needs them in system memory
+DWORD offscreen_memory_caps()
+{
+    return g_settings.software_raster ? DDSCAPS_SYSTEMMEMORY : DDSCAPS_VIDEOMEMORY;
+}
+
+// describe one of the patcher's surfaces to the capture
+void capture_surface(const capture_scope &scope, LPDIRECTDRAWSURFACE7 surface, capture_surface_role role)
+{
+    if (!g_capture_enabled.load(std::memory_order_relaxed) || surface == nullptr)
+    {
+        return;
+    }
+
+    DDSURFACEDESC2 ddsd{};
+    ddsd.dwSize = sizeof(ddsd);
+    surface->GetSurfaceDesc(&ddsd);
+
+    const auto format = to_pixel_format(ddsd.ddpfPixelFormat);
+    capture(
+        scope,
+        capture_call::create_surface,
+        capture_create_surface{
+            .surface = capture_handle_of(surface),
+            .role = role,
+            .width = ddsd.dwWidth,
+            .height = ddsd.dwHeight,
+            .bits = ddsd.ddpfPixelFormat.dwRGBBitCount,
+            .format = format ? static_cast<std::uint32_t>(*format) : capture_unknown_format,
+            .reserved = 0});
+}
+
+// move the back buffer's pixels onto memory that notes the pages written to it, false leaves them where they were
+bool watch_back_buffer()
+{
+    DDSURFACEDESC2 ddsd{};
+    ddsd.dwSize = sizeof(ddsd);
+    if (g_back_buffer_surface->GetSurfaceDesc(&ddsd) != DD_OK)
+    {
+        return false;
+    }
+
+    auto watch = std::make_unique<write_watch>();
+    const auto pitch = (ddsd.dwWidth * ddsd.ddpfPixelFormat.dwRGBBitCount / 8 + 15) & ~15u;
+    if (!write_watch_alloc(*watch, static_cast<std::size_t>(pitch) * ddsd.dwHeight))
+    {
+        return false;
+    }
+
+    // client memory, DirectDraw draws into it and never frees it, which is as well since it lives as long as we do
+    auto client = ddsd;
+    client.dwFlags = DDSD_LPSURFACE | DDSD_PITCH | DDSD_WIDTH | DDSD_HEIGHT | DDSD_PIXELFORMAT;
+    client.lPitch = static_cast<LONG>(pitch);
+    client.lpSurface = watch->data;
+    if (g_back_buffer_surface->SetSurfaceDesc(&client, 0) != DD_OK)
+    {
+        return false;
+    }
+
+    log("back buffer on watched memory, {} pages of {} bytes", watch->size / watch->page_size, watch->page_size);
+    g_back_buffer_watch = watch.release();
+    return true;
+}
+
+// open [record] file for frames of the back buffer's size and format and start its encoder
+bool start_recording()
+{
+    DDSURFACEDESC2 ddsd{};
+    ddsd.dwSize = sizeof(ddsd);
+    if (g_back_buffer_surface->GetSurfaceDesc(&ddsd) != DD_OK)
+    {
+        return false;
+    }
+
+    const auto format = to_pixel_format(ddsd.ddpfPixelFormat);
+    if (!format)
+    {
+        return false;
+    }
+
+    const auto &file = g_settings.record_file;
+    if (!recording_start(g_recorder, file.c_str(), ddsd.dwWidth, ddsd.dwHeight, *format, g_settings.record_buffers))
+    {
+        return false;
+    }
+
+    std::thread{[] { recording_encoder_loop(g_recorder); }}.detach();
+    return true;
+}
+
 __declspec(dllexport) HRESULT __stdcall CreateSurface_hook(
     void *that,
     LPDDSURFACEDESC2 unnamedParam1,
@@ -549,6 +2211,16 @@ __declspec(dllexport) HRESULT __stdcall CreateSurface_hook(
         reinterpret_cast<void *>(unnamedParam1),
         reinterpret_cast<void *>(unnamedParam2),
         reinterpret_cast<void *>(unnamedParam3));
+    trace(
+        trace_event::create_surface,
+        that,
+        unnamedParam1,
+        unnamedParam1->dwWidth,
+        unnamedParam1->dwHeight,
+        unnamedParam1->dwFlags,
+        unnamedParam1->ddsCaps.dwCaps);
+    hook_scope scope{trace_event::create_surface};
+    capture_scope capture_guard{};
 
     log("DDSURFACEDESC2: {} {} {} {} {}",
         unnamedParam1->dwSize,
@@ -583,11 +2255,18 @@ __declspec(dllexport) HRESULT __stdcall CreateSurface_hook(
             ddcaps_to_string(new_unnamed_param1.ddsCaps.dwCaps));
 
         const auto res =
-            reinterpret_cast<HRESULT(__stdcall *)(void *, LPDDSURFACEDESC2, LPDIRECTDRAWSURFACE7 *, IUnknown *)>(
-                g_ddraw_hooks["CreateSurface"])(that, &new_unnamed_param1, unnamedParam2, unnamedParam3);
+            ddraw_method::create_surface::original(that, &new_unnamed_param1, unnamedParam2, unnamedParam3);
 
         g_primary_surface = *unnamedParam2;
 
+        DDSURFACEDESC2 primary_desc{};
+        primary_desc.dwSize = sizeof(primary_desc);
+        if (g_primary_surface->GetSurfaceDesc(&primary_desc) == DD_OK &&
+            primary_desc.ddpfPixelFormat.dwRGBBitCount != 0)
+        {
+            g_display_bytes_per_pixel = primary_desc.ddpfPixelFormat.dwRGBBitCount / 8;
+        }
+
         // constrain rendering to window, otherwise it'll still write to the whole screen
         LPDIRECTDRAWCLIPPER clipper{};
         g_ddraw->CreateClipper(0, &clipper, nullptr);
@@ -598,55 +2277,8 @@ __declspec(dllexport) HRESULT __stdcall CreateSurface_hook(
         // this makes it easy to hook
         // we also save off the original functions
 
-        const auto original_get_attached_surface = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_primary_surface)) + 0x30,
-            reinterpret_cast<std::uintptr_t>(GetAttachedSurface_hook));
-        g_surface_hooks["GetAttachedSurface"] = original_get_attached_surface;
-
-        const auto original_blt = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_primary_surface)) + 0x14,
-            reinterpret_cast<std::uintptr_t>(Blt_hook));
-        g_surface_hooks["Blt"] = original_blt;
-
-        const auto original_blt_batch = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_primary_surface)) + 0x18,
-            reinterpret_cast<std::uintptr_t>(BltBatch_hook));
-        g_surface_hooks["BltBatch"] = original_blt_batch;
-
-        const auto original_blt_fast = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_primary_surface)) + 0x1c,
-            reinterpret_cast<std::uintptr_t>(BltFast_hook));
-        g_surface_hooks["BltFast"] = original_blt_fast;
-
-        const auto original_flip = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_primary_surface)) + 0x2c,
-            reinterpret_cast<std::uintptr_t>(Flip_hook));
-        g_surface_hooks["Flip"] = original_flip;
-
-        const auto original_lock = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_primary_surface)) + 0x64,
-            reinterpret_cast<std::uintptr_t>(Lock_hook));
-        g_surface_hooks["Lock"] = original_lock;
-
-        const auto original_unlock = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_primary_surface)) + 0x80,
-            reinterpret_cast<std::uintptr_t>(Unlock_hook));
-        g_surface_hooks["Unlock"] = original_unlock;
-
-        const auto original_set_palette = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_primary_surface)) + 0x7c,
-            reinterpret_cast<std::uintptr_t>(SetPalette_hook));
-        g_surface_hooks["SetPalette"] = original_set_palette;
-
-        const auto original_set_color_key = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_primary_surface)) + 0x74,
-            reinterpret_cast<std::uintptr_t>(SetColorKey_hook));
-        g_surface_hooks["SetColorKey"] = original_set_color_key;
-
-        const auto original_get_pixel_format = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_primary_surface)) + 0x54,
-            reinterpret_cast<std::uintptr_t>(GetPixelFormat_hook));
-        g_surface_hooks["GetPixelFormat"] = original_get_pixel_format;
+        surface_hooks::add(g_hooks, g_primary_surface);
+        commit_hooks("primary surface");
 
         log("PRIMARY SURFACE {}", reinterpret_cast<void *>(g_primary_surface));
 
@@ -657,7 +2289,7 @@ __declspec(dllexport) HRESULT __stdcall CreateSurface_hook(
                 .dwFlags = DDSD_CAPS | DDSD_WIDTH | DDSD_HEIGHT,
                 .dwHeight = g_height,
                 .dwWidth = g_width,
-                .ddsCaps = {.dwCaps = DDSCAPS_OFFSCREENPLAIN | DDSCAPS_VIDEOMEMORY}};
+                .ddsCaps = {.dwCaps = DDSCAPS_OFFSCREENPLAIN | offscreen_memory_caps()}};
 
             log("new DDSURFACEDESC2: {} {} {} {}",
                 new_unnamed_param1.dwWidth,
@@ -665,59 +2297,101 @@ __declspec(dllexport) HRESULT __stdcall CreateSurface_hook(
                 new_unnamed_param1.dwFlags,
                 ddcaps_to_string(new_unnamed_param1.ddsCaps.dwCaps));
 
-            const auto res =
-                reinterpret_cast<HRESULT(__stdcall *)(void *, LPDDSURFACEDESC2, LPDIRECTDRAWSURFACE7 *, IUnknown *)>(
-                    g_ddraw_hooks["CreateSurface"])(that, &new_unnamed_param1, unnamedParam2, unnamedParam3);
-
-            g_back_buffer_surface = *unnamedParam2;
-
-            // apply COM hooks
-
-            const auto original_get_attached_surface = hook(
-                reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_back_buffer_surface)) + 0x30,
-                reinterpret_cast<std::uintptr_t>(GetAttachedSurface_hook));
+            // the indexed mode's back buffer is 8 bit and gets converted into a display format surface at present
+            HRESULT res = DDERR_UNSUPPORTED;
+            if (g_settings.indexed_back_buffer)
+            {
+                auto indexed_desc = new_unnamed_param1;
+                indexed_desc.dwFlags |= DDSD_PIXELFORMAT;
+                indexed_desc.ddpfPixelFormat = to_ddpixelformat(pixel_format::indexed8);
+
+                res = ddraw_method::create_surface::original(that, &indexed_desc, unnamedParam2, unnamedParam3);
+                if (res == DD_OK &&
+                    ddraw_method::create_surface::original(that, &new_unnamed_param1, &g_present_surface, nullptr) !=
+                        DD_OK)
+                {
+                    (*unnamedParam2)->Release();
+                    res = DDERR_UNSUPPORTED;
+                }
 
-            const auto original_blt = hook(
-                reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_back_buffer_surface)) + 0x14,
-                reinterpret_cast<std::uintptr_t>(Blt_hook));
+                if (res != DD_OK)
+                {
+                    log("couldn't create an 8 bit back buffer, using the display format");
+                    g_settings.indexed_back_buffer = false;
+                }
+            }
+            if (res != DD_OK)
+            {
+                res = ddraw_method::create_surface::original(that, &new_unnamed_param1, unnamedParam2, unnamedParam3);
+            }
 
-            const auto original_blt_batch = hook(
-                reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_back_buffer_surface)) + 0x18,
-                reinterpret_cast<std::uintptr_t>(BltBatch_hook));
+            g_back_buffer_surface = *unnamedParam2;
+            g_software_surfaces.insert(g_back_buffer_surface);
 
-            const auto original_blt_fast = hook(
-                reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_back_buffer_surface)) + 0x1c,
-                reinterpret_cast<std::uintptr_t>(BltFast_hook));
+            // damage is clipped to the bounds of the frame collecting it, and nothing has reached the screen yet
+            damage_reset(g_back_buffer_damage, g_width, g_height);
+            damage_add_full(g_back_buffer_damage);
 
-            const auto original_flip = hook(
-                reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_back_buffer_surface)) + 0x2c,
-                reinterpret_cast<std::uintptr_t>(Flip_hook));
+            if (g_settings.write_watch && g_settings.software_raster && g_settings.dirty_rects &&
+                !watch_back_buffer())
+            {
+                log("couldn't put the back buffer on watched memory, locks count as drawing all they cover");
+            }
 
-            const auto original_lock = hook(
-                reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_back_buffer_surface)) + 0x64,
-                reinterpret_cast<std::uintptr_t>(Lock_hook));
+            if (g_settings.record && !start_recording())
+            {
+                log("couldn't start recording to {}", g_settings.record_file);
+                g_settings.record = false;
+            }
 
-            const auto original_unlock = hook(
-                reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_back_buffer_surface)) + 0x80,
-                reinterpret_cast<std::uintptr_t>(Unlock_hook));
+            // apply COM hooks
+            surface_hooks::add(g_hooks, g_back_buffer_surface);
+            commit_hooks("back buffer");
 
-            const auto original_set_palette = hook(
-                reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_back_buffer_surface)) + 0x7c,
-                reinterpret_cast<std::uintptr_t>(SetPalette_hook));
+            log("BACK BUFFER SURFACE {}", reinterpret_cast<void *>(g_back_buffer_surface));
 
-            const auto original_set_color_key = hook(
-                reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_back_buffer_surface)) + 0x74,
-                reinterpret_cast<std::uintptr_t>(SetColorKey_hook));
+            // staging surfaces for the async present mode, same shape and memory as the back buffer so filling one
+            // is a plain copy
+            if (g_settings.async_present)
+            {
+                present_queue_init(
+                    g_present_queue,
+                    g_settings.async_queue_depth,
+                    g_settings.async_backpressure,
+                    g_width,
+                    g_height);
+
+                g_staging_surfaces.resize(present_slot_count(g_present_queue.depth));
+                for (auto &staging : g_staging_surfaces)
+                {
+                    if (ddraw_method::create_surface::original(that, &new_unnamed_param1, &staging, unnamedParam3) !=
+                        DD_OK)
+                    {
+                        log("couldn't create staging surfaces, presenting from Flip instead");
+                        g_settings.async_present = false;
+                        break;
+                    }
+                }
 
-            const auto original_get_pixel_format = hook(
-                reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_back_buffer_surface)) + 0x54,
-                reinterpret_cast<std::uintptr_t>(GetPixelFormat_hook));
+                // never joined, see DLL_PROCESS_DETACH
+                if (g_settings.async_present)
+                {
+                    std::thread{present_thread}.detach();
+                }
+            }
 
-            log("BACK BUFFER SURFACE {}", reinterpret_cast<void *>(g_back_buffer_surface));
+            // workers for splitting the conversions and scaling, never stopped either
+            if (g_settings.threads != 1 && g_pool.threads == 1)
+            {
+                pool_start(g_pool, g_settings.threads);
+            }
         }
 
         *unnamedParam2 = g_primary_surface;
 
+        capture_surface(capture_guard, g_primary_surface, capture_surface_role::primary);
+        capture_surface(capture_guard, g_back_buffer_surface, capture_surface_role::back_buffer);
+
         return res;
     }
     else
@@ -729,7 +2403,14 @@ __declspec(dllexport) HRESULT __stdcall CreateSurface_hook(
             .dwFlags = DDSD_CAPS | DDSD_WIDTH | DDSD_HEIGHT,
             .dwHeight = unnamedParam1->dwHeight,
             .dwWidth = unnamedParam1->dwWidth,
-            .ddsCaps = {.dwCaps = DDSCAPS_OFFSCREENPLAIN | DDSCAPS_VIDEOMEMORY}};
+            .ddsCaps = {.dwCaps = DDSCAPS_OFFSCREENPLAIN | offscreen_memory_caps()}};
+
+        // the same indices the back buffer uses, blits between the two stay plain byte copies
+        if (g_settings.indexed_back_buffer)
+        {
+            new_unnamed_param1.dwFlags |= DDSD_PIXELFORMAT;
+            new_unnamed_param1.ddpfPixelFormat = to_ddpixelformat(pixel_format::indexed8);
+        }
 
         log("new DDSURFACEDESC2: {} {} {} {}",
             new_unnamed_param1.dwWidth,
@@ -738,90 +2419,47 @@ __declspec(dllexport) HRESULT __stdcall CreateSurface_hook(
             ddcaps_to_string(new_unnamed_param1.ddsCaps.dwCaps));
 
         const auto res =
-            reinterpret_cast<HRESULT(__stdcall *)(void *, LPDDSURFACEDESC2, LPDIRECTDRAWSURFACE7 *, IUnknown *)>(
-                g_ddraw_hooks["CreateSurface"])(that, &new_unnamed_param1, unnamedParam2, unnamedParam3);
+            ddraw_method::create_surface::original(that, &new_unnamed_param1, unnamedParam2, unnamedParam3);
 
         g_image_surface = *unnamedParam2;
+        g_software_surfaces.insert(g_image_surface);
 
         // apply COM hooks
-
-        const auto original_get_attached_surface = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_image_surface)) + 0x30,
-            reinterpret_cast<std::uintptr_t>(GetAttachedSurface_hook));
-
-        const auto original_blt = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_image_surface)) + 0x14,
-            reinterpret_cast<std::uintptr_t>(Blt_hook));
-
-        const auto original_blt_batch = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_image_surface)) + 0x18,
-            reinterpret_cast<std::uintptr_t>(BltBatch_hook));
-
-        const auto original_blt_fast = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_image_surface)) + 0x1c,
-            reinterpret_cast<std::uintptr_t>(BltFast_hook));
-
-        const auto original_flip = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_image_surface)) + 0x2c,
-            reinterpret_cast<std::uintptr_t>(Flip_hook));
-
-        const auto original_lock = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_image_surface)) + 0x64,
-            reinterpret_cast<std::uintptr_t>(Lock_hook));
-
-        const auto original_unlock = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_image_surface)) + 0x80,
-            reinterpret_cast<std::uintptr_t>(Unlock_hook));
-
-        const auto original_set_palette = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_image_surface)) + 0x7c,
-            reinterpret_cast<std::uintptr_t>(SetPalette_hook));
-
-        const auto original_set_color_key = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_image_surface)) + 0x74,
-            reinterpret_cast<std::uintptr_t>(SetColorKey_hook));
-
-        const auto original_get_pixel_format = hook(
-            reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_image_surface)) + 0x54,
-            reinterpret_cast<std::uintptr_t>(GetPixelFormat_hook));
+        surface_hooks::add(g_hooks, g_image_surface);
+        commit_hooks("image surface");
 
         log("IMAGE SURFACE {}", reinterpret_cast<void *>(g_image_surface));
 
+        capture_surface(capture_guard, g_image_surface, capture_surface_role::image);
+
         return res;
     }
 }
 
+using ddraw_hooks = vtable_hooks<
+    vtable_hook<ddraw_method::set_cooperative_level, SetCooperativeLevel_hook>,
+    vtable_hook<ddraw_method::set_display_mode, SetDisplayMode_hook>,
+    vtable_hook<ddraw_method::create_surface, CreateSurface_hook>,
+    vtable_hook<ddraw_method::create_palette, CreatePalette_hook>>;
+
 __declspec(dllexport) HRESULT __stdcall DirectDrawCreate_hook(GUID *lpGUID, LPDIRECTDRAW *lplpDD, IUnknown *pUnkOuter)
 {
     log("DirectDrawCreate {} {} {}",
         reinterpret_cast<void *>(lpGUID),
         reinterpret_cast<void *>(lplpDD),
         reinterpret_cast<void *>(pUnkOuter));
+    trace(trace_event::direct_draw_create, lpGUID, lplpDD, pUnkOuter);
+    capture_scope capture_guard{};
 
     const auto result = ::DirectDrawCreate(lpGUID, lplpDD, pUnkOuter);
 
     g_ddraw = *lplpDD;
     log("DIRECTDRAW {} vtable: {}", reinterpret_cast<void *>(g_ddraw), *reinterpret_cast<void **>(g_ddraw));
 
-    const auto original_set_cooperative_level = hook(
-        reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_ddraw)) + 0x50,
-        reinterpret_cast<std::uintptr_t>(SetCooperativeLevel_hook));
-    g_ddraw_hooks["SetCooperativeLevel"] = original_set_cooperative_level;
-
-    const auto original_set_display_mode = hook(
-        reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_ddraw)) + 0x54,
-        reinterpret_cast<std::uintptr_t>(SetDisplayMode_hook));
-    g_ddraw_hooks["SetDisplayMode"] = original_set_display_mode;
-
-    const auto original_create_surface = hook(
-        reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_ddraw)) + 0x18,
-        reinterpret_cast<std::uintptr_t>(CreateSurface_hook));
-    g_ddraw_hooks["CreateSurface"] = original_create_surface;
+    ddraw_hooks::add(g_hooks, g_ddraw);
+    commit_hooks("direct draw");
 
-    const auto original_create_palette = hook(
-        reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(g_ddraw)) + 0x14,
-        reinterpret_cast<std::uintptr_t>(CreatePalette_hook));
-    g_ddraw_hooks["CreatePalette"] = original_create_palette;
+    capture(capture_guard, capture_call::direct_draw_create, capture_direct_draw_create{capture_handle_of(g_ddraw)});
 
     return result;
 }
@@ -829,6 +2467,7 @@ __declspec(dllexport) HRESULT __stdcall DirectDrawCreate_hook(GUID *lpGUID, LPDI
 __declspec(dllexport) int __stdcall GetSystemMetrics_hook(int nIndex)
 {
     log("GetSystemMetrics {} ", nIndex);
+    trace(trace_event::get_system_metrics, nIndex);
 
     switch (nIndex)
     {
@@ -838,6 +2477,36 @@ __declspec(dllexport) int __stdcall GetSystemMetrics_hook(int nIndex)
     }
 }
 
+// a GDI bitmap of a parsed file, a DIB section can use the file mapping itself as its pixels when they start on a
+// DWORD boundary, otherwise it gets its own copy of the pixel rows
+HBITMAP image_bitmap(const mapped_file &file, const bmp_image &image)
+{
+    const auto *info = reinterpret_cast<const BITMAPINFO *>(image.info);
+    void *bits{};
+
+    if (file.mapping != nullptr && image.pixel_offset % sizeof(DWORD) == 0)
+    {
+        const auto bitmap = ::CreateDIBSection(
+            nullptr,
+            info,
+            DIB_RGB_COLORS,
+            &bits,
+            file.mapping,
+            static_cast<DWORD>(image.pixel_offset));
+        if (bitmap != nullptr)
+        {
+            return bitmap;
+        }
+    }
+
+    const auto bitmap = ::CreateDIBSection(nullptr, info, DIB_RGB_COLORS, &bits, nullptr, 0);
+    if (bitmap != nullptr)
+    {
+        std::memcpy(bits, file.data + image.pixel_offset, image.stride * image.height);
+    }
+    return bitmap;
+}
+
 __declspec(dllexport) HANDLE __stdcall LoadImageA_hook(
     HINSTANCE hInst,
     LPCSTR name,
@@ -854,37 +2523,59 @@ __declspec(dllexport) HANDLE __stdcall LoadImageA_hook(
         cy,
         fuload_to_string(fuLoad),
         fuLoad);
+    trace(trace_event::load_image, hInst, name, type, cx, cy, fuLoad);
+    hook_scope scope{trace_event::load_image};
+    capture_scope capture_guard{};
 
-    std::string name_str = std::format("{}.bmp", name);
-
-    const auto res = (HBITMAP)LoadImage(nullptr, name_str.c_str(), IMAGE_BITMAP, cx, cy, fuLoad | LR_LOADFROMFILE);
-    HDC hdc = GetDC(nullptr);
+    const auto path = std::format("{}.bmp", name);
 
-    BITMAP bmp{};
-    assert(GetObject((HBITMAP)res, sizeof(BITMAP), &bmp) != 0);
-
-    int width = bmp.bmWidth;
-    int height = bmp.bmHeight;
-    int bitCount = bmp.bmBitsPixel;
+    // map the file and read the index plane straight out of it rather than asking GDI for a copy of a copy
+    mapped_file file{};
+    bmp_image image{};
+    const auto error = map_file(path.c_str(), file) ? parse_bmp(file.bytes(), image) : bmp_error::truncated;
+    if (error != bmp_error::none)
+    {
+        log("can't use {} ({}), leaving it to LoadImage", path, bmp_error_name(error));
+        return ::LoadImageA(nullptr, path.c_str(), IMAGE_BITMAP, cx, cy, fuLoad | LR_LOADFROMFILE);
+    }
 
-    log("{} {} {} {} {} {} {} {} {}",
-        reinterpret_cast<void *>(res),
-        width,
-        height,
-        bitCount,
-        bmp.bmPlanes,
-        bmp.bmWidthBytes,
-        bmp.bmType,
-        bmp.bmHeight,
-        bmp.bmWidth);
+    log("{} {}x{} stride {} bottom-up {}", path, image.width, image.height, image.stride, image.bottom_up);
+
+    // the whole file goes into the capture, a load LoadImage had to handle isn't one the patcher converts anyway
+    const std::string_view image_name{name};
+    capture(
+        capture_guard,
+        capture_call::load_image,
+        capture_load_image{
+            cx,
+            cy,
+            static_cast<std::uint32_t>(image_name.size()),
+            static_cast<std::uint32_t>(file.size)},
+        std::span{reinterpret_cast<const std::uint8_t *>(image_name.data()), image_name.size()},
+        file.bytes());
+
+    // the game still wants a bitmap handle back, only a resized load needs GDI to actually decode the file again
+    HANDLE res{};
+    if ((cx != 0 && cx != static_cast<int>(image.width)) || (cy != 0 && cy != static_cast<int>(image.height)))
+    {
+        res = ::LoadImageA(nullptr, path.c_str(), IMAGE_BITMAP, cx, cy, fuLoad | LR_LOADFROMFILE);
+    }
+    else
+    {
+        res = image_bitmap(file, image);
+    }
 
-    int bytesPerPixel = bitCount / 8;
-    int dataSize = width * height * bytesPerPixel;
-    log("dataSize: {}", dataSize);
+    // views into the mapping, which stays open for the life of the process since a DIB section may sit on it
+    g_image = image;
+    g_image_hash = g_settings.atlas_cache ? hash_bytes(file.bytes()) : 0;
+    g_image_files.push_back(std::move(file));
 
-    // save off a copy of the original bitmap data so we can do a palette conversion later
-    g_image_pixels.resize(dataSize * 10);
-    std::memcpy(g_image_pixels.data(), bmp.bmBits, dataSize);
+    // index which pixels use each palette entry so palette animation only has to touch those pixels, an 8 bit image
+    // surface takes the palette at present and never reads it
+    g_image_palette_index =
+        g_settings.indexed_back_buffer ? palette_pixel_index{} : build_palette_pixel_index(g_image.pixels);
+    g_image_converted = false;
+    g_image_spans.reset();
 
     return res;
 }
@@ -893,26 +2584,97 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 {
     if (fdwReason == DLL_PROCESS_ATTACH)
     {
-        // for some reason the game tries to write to the resource section which is loaded as read only - so fix that
-        DWORD old_protect{};
-        assert(
-            ::VirtualProtect(reinterpret_cast<void *>(0x004BE000), 0x0002F000, PAGE_EXECUTE_READWRITE, &old_protect) ==
-            TRUE);
-
         g_log = std::ofstream{"log.txt", std::ios::app};
         assert(g_log);
 
+        g_settings = load_settings();
+
+        if (g_settings.trace)
+        {
+            // see trace_frame_window
+            if (trace_start(g_settings.trace_file.c_str()) && g_settings.trace_first_frame != 0)
+            {
+                trace_pause(true);
+            }
+        }
+
+        if (g_settings.stats)
+        {
+            hook_stats_start();
+        }
+
+        if (g_settings.capture)
+        {
+            capture_start(g_settings.capture_file.c_str());
+        }
+
         log("\nlibrary loaded");
 
+        // the exe as the loader mapped it, its headers say how big that is
+        const auto *base = reinterpret_cast<const std::uint8_t *>(::GetModuleHandleA(nullptr));
+        const auto *nt_headers = reinterpret_cast<const IMAGE_NT_HEADERS *>(
+            base + reinterpret_cast<const IMAGE_DOS_HEADER *>(base)->e_lfanew);
+        const std::span<const std::uint8_t> bytes{base, nt_headers->OptionalHeader.SizeOfImage};
+
+        pe_image exe{};
+        const auto error = pe_parse(bytes, pe_layout::mapped, exe);
+        log("exe timestamp {:#x} checksum {:#x}: {}", exe.timestamp, exe.checksum, pe_error_name(error));
+
+        // for some reason the game tries to write to the resource section which is loaded as read only - so fix that
+        if (const auto *resources = pe_find_section(exe, ".rsrc"))
+        {
+            DWORD old_protect{};
+            if (::VirtualProtect(
+                    const_cast<std::uint8_t *>(base + resources->rva),
+                    resources->virtual_size,
+                    PAGE_EXECUTE_READWRITE,
+                    &old_protect) != TRUE)
+            {
+                log("couldn't make the resource section writable: {}", ::GetLastError());
+            }
+        }
+
         // hook various win32 functions
-        hook(0x419120, reinterpret_cast<std::uintptr_t>(CreateWindowExA_hook));
-        hook(0x419124, reinterpret_cast<std::uintptr_t>(GetSystemMetrics_hook));
-        hook(0x419000, reinterpret_cast<std::uintptr_t>(DirectDrawCreate_hook));
-        hook(0x41910C, reinterpret_cast<std::uintptr_t>(LoadImageA_hook));
+        if (error == pe_error::none)
+        {
+            const hooked_import imports[]{
+                {"user32.dll", "CreateWindowExA", reinterpret_cast<std::uintptr_t>(CreateWindowExA_hook)},
+                {"user32.dll", "GetSystemMetrics", reinterpret_cast<std::uintptr_t>(GetSystemMetrics_hook)},
+                {"ddraw.dll", "DirectDrawCreate", reinterpret_cast<std::uintptr_t>(DirectDrawCreate_hook)},
+                {"user32.dll", "LoadImageA", reinterpret_cast<std::uintptr_t>(LoadImageA_hook)},
+            };
+            hook_imports(base, bytes, exe, imports);
+        }
 
         const auto user32_base = reinterpret_cast<std::uintptr_t>(::GetModuleHandleA("user32.dll"));
         log("user32.dll base: {:x}", user32_base);
     }
+    else if (fdwReason == DLL_PROCESS_DETACH)
+    {
+        // by now the present thread is either gone or stuck behind the loader lock, stopping the queue just makes
+        // sure a surviving one doesn't touch surfaces that are being torn down
+        if (g_settings.async_present)
+        {
+            present_stop(g_present_queue);
+        }
+
+        if (g_settings.stats)
+        {
+            dump_hook_stats();
+        }
+
+        trace_stop();
+        capture_stop();
+        recording_stop(g_recorder);
+
+        // unloaded while the game keeps running, its calls must stop landing in code that is about to go away
+        // at process exit the other threads are already gone and ddraw.dll may be too, so nothing is touched
+        if (lpvReserved == nullptr)
+        {
+            const auto error = hook_set_rollback(g_hooks, g_page_memory);
+            log("unhooked on {} pages, {}", g_hooks.last_pages, hook_set_error_name(error));
+        }
+    }
 
     return TRUE;
 }
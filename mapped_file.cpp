@@ -0,0 +1,150 @@
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+mapped_file::mapped_file(mapped_file &&other) noexcept
+    : data{std::exchange(other.data, nullptr)}
+    , size{std::exchange(other.size, 0)}
+    , mapping{std::exchange(other.mapping, nullptr)}
+{
+}
+
+mapped_file &mapped_file::operator=(mapped_file &&other) noexcept
+{
+    if (this != &other)
+    {
+        unmap_file(*this);
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+        mapping = std::exchange(other.mapping, nullptr);
+    }
+    return *this;
+}
+
+mapped_file::~mapped_file()
+{
+    unmap_file(*this);
+}
+
+#if defined(_WIN32)
+
+bool map_file(const char *path, mapped_file &file)
+{
+    unmap_file(file);
+
+    const auto handle = ::CreateFileA(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size{};
+    if (::GetFileSizeEx(handle, &size) == FALSE || size.QuadPart == 0 ||
+        static_cast<unsigned long long>(size.QuadPart) > SIZE_MAX)
+    {
+        ::CloseHandle(handle);
+        return false;
+    }
+
+    // copy on write rather than read only because CreateDIBSection refuses read only sections, nothing in this
+    // process writes through our own view
+    const auto mapping = ::CreateFileMappingA(handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    ::CloseHandle(handle);
+    if (mapping == nullptr)
+    {
+        return false;
+    }
+
+    const auto *view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+    {
+        ::CloseHandle(mapping);
+        return false;
+    }
+
+    file.data = static_cast<const std::uint8_t *>(view);
+    file.size = static_cast<std::size_t>(size.QuadPart);
+    file.mapping = mapping;
+    return true;
+}
+
+void unmap_file(mapped_file &file)
+{
+    if (file.data != nullptr)
+    {
+        ::UnmapViewOfFile(file.data);
+    }
+    if (file.mapping != nullptr)
+    {
+        ::CloseHandle(file.mapping);
+    }
+
+    file.data = nullptr;
+    file.size = 0;
+    file.mapping = nullptr;
+}
+
+#else
+
+bool map_file(const char *path, mapped_file &file)
+{
+    unmap_file(file);
+
+    const auto fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info{};
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    auto *view = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+    {
+        return false;
+    }
+
+    file.data = static_cast<const std::uint8_t *>(view);
+    file.size = static_cast<std::size_t>(info.st_size);
+    return true;
+}
+
+void unmap_file(mapped_file &file)
+{
+    if (file.data != nullptr)
+    {
+        ::munmap(const_cast<std::uint8_t *>(file.data), file.size);
+    }
+
+    file.data = nullptr;
+    file.size = 0;
+    file.mapping = nullptr;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// a whole file mapped read only into memory, closed when the object goes away
+
+struct mapped_file
+{
+    const std::uint8_t *data{};
+    std::size_t size{};
+
+    // windows only: the file mapping object (copy on write), so GDI can build a DIB section straight on top of it
+    void *mapping{};
+
+    mapped_file() = default;
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+    mapped_file(mapped_file &&other) noexcept;
+    mapped_file &operator=(mapped_file &&other) noexcept;
+    ~mapped_file();
+
+    std::span<const std::uint8_t> bytes() const
+    {
+        return {data, size};
+    }
+};
+
+// map path, false if it can't be opened or is empty
+bool map_file(const char *path, mapped_file &file);
+
+void unmap_file(mapped_file &file);
@@ -0,0 +1,323 @@
+#include "overlay.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace
+{
+
+// distance of the panel from the surface's corner and of its contents from the panel's edge
+constexpr std::int32_t margin = 4;
+constexpr std::int32_t padding = 3;
+constexpr std::int32_t text_lines = 3;
+constexpr std::int32_t graph_height = 32;
+
+// the graph's full height is two 60 Hz frames, with a line where one frame's budget runs out
+constexpr std::uint32_t graph_full_us = 33333;
+constexpr std::uint32_t budget_us = 16667;
+
+// 5x7 glyphs for ' ' to '_', one byte per row from the top, bit 4 is the leftmost pixel
+constexpr char first_glyph = ' ';
+constexpr char last_glyph = '_';
+constexpr std::uint8_t font[last_glyph - first_glyph + 1][7]{
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+    {0x04, 0x04, 0x04, 0x04, 0x00, 0x00, 0x04}, // !
+    {0x0a, 0x0a, 0x0a, 0x00, 0x00, 0x00, 0x00}, // "
+    {0x0a, 0x0a, 0x1f, 0x0a, 0x1f, 0x0a, 0x0a}, // #
+    {0x04, 0x0f, 0x14, 0x0e, 0x05, 0x1e, 0x04}, // $
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}, // %
+    {0x0c, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0d}, // &
+    {0x0c, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00}, // '
+    {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}, // (
+    {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}, // )
+    {0x00, 0x04, 0x15, 0x0e, 0x15, 0x04, 0x00}, // *
+    {0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00}, // +
+    {0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08}, // ,
+    {0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00}, // -
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c}, // .
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}, // /
+    {0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e}, // 0
+    {0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e}, // 1
+    {0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f}, // 2
+    {0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e}, // 3
+    {0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02}, // 4
+    {0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e}, // 5
+    {0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e}, // 6
+    {0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // 7
+    {0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e}, // 8
+    {0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c}, // 9
+    {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00}, // :
+    {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x04, 0x08}, // ;
+    {0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02}, // <
+    {0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00}, // =
+    {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}, // >
+    {0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04}, // ?
+    {0x0e, 0x11, 0x01, 0x0d, 0x15, 0x15, 0x0e}, // @
+    {0x0e, 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11}, // A
+    {0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e}, // B
+    {0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e}, // C
+    {0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c}, // D
+    {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f}, // E
+    {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10}, // F
+    {0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f}, // G
+    {0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11}, // H
+    {0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e}, // I
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c}, // J
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, // K
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f}, // L
+    {0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11}, // M
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, // N
+    {0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}, // O
+    {0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10}, // P
+    {0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d}, // Q
+    {0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11}, // R
+    {0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e}, // S
+    {0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // T
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}, // U
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04}, // V
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a}, // W
+    {0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11}, // X
+    {0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04}, // Y
+    {0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f}, // Z
+    {0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0e}, // [
+    {0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00}, // backslash
+    {0x0e, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0e}, // ]
+    {0x04, 0x0a, 0x11, 0x00, 0x00, 0x00, 0x00}, // ^
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f}, // _
+};
+
+const std::uint8_t *glyph_for(char c)
+{
+    if (c >= 'a' && c <= 'z')
+    {
+        c = static_cast<char>(c - 'a' + 'A');
+    }
+    if (c < first_glyph || c > last_glyph)
+    {
+        c = '?';
+    }
+    return font[c - first_glyph];
+}
+
+// caller clips, little endian like everything the raster code writes
+void put_pixel(const raster_surface &target, std::int32_t x, std::int32_t y, std::uint32_t color)
+{
+    const auto bytes = bytes_per_pixel(target.format);
+    std::memcpy(target.pixels + static_cast<std::ptrdiff_t>(y) * target.pitch + x * bytes, &color, bytes);
+}
+
+std::uint32_t closest_entry(std::span<const palette_entry, 256> palette, int red, int green, int blue)
+{
+    auto best = 0u;
+    auto best_distance = std::numeric_limits<int>::max();
+    for (auto i = 0u; i < palette.size(); ++i)
+    {
+        const auto dr = palette[i].red - red;
+        const auto dg = palette[i].green - green;
+        const auto db = palette[i].blue - blue;
+        const auto distance = dr * dr + dg * dg + db * db;
+        if (distance < best_distance)
+        {
+            best = i;
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
+std::uint32_t pack_color(
+    pixel_format format,
+    std::span<const palette_entry, 256> palette,
+    std::uint32_t red,
+    std::uint32_t green,
+    std::uint32_t blue)
+{
+    switch (format)
+    {
+        case pixel_format::rgb555: return (red >> 3) << 10 | (green >> 3) << 5 | blue >> 3;
+        case pixel_format::rgb565: return (red >> 3) << 11 | (green >> 2) << 5 | blue >> 3;
+        case pixel_format::rgb888:
+        case pixel_format::argb8888: return red << 16 | green << 8 | blue;
+        case pixel_format::indexed8:
+            return closest_entry(palette, static_cast<int>(red), static_cast<int>(green), static_cast<int>(blue));
+    }
+    return 0;
+}
+
+// the panel where it would be on a surface big enough for it
+raster_rect panel_rect()
+{
+    return {
+        margin,
+        margin,
+        margin + padding * 2 + static_cast<std::int32_t>(overlay_history),
+        margin + padding * 3 + text_lines * overlay_glyph_height + graph_height};
+}
+
+void fill(const raster_surface &target, raster_rect rect, std::uint32_t color)
+{
+    const auto clipped = raster_intersect(rect, overlay_rect(target.width, target.height));
+    if (!raster_rect_empty(clipped))
+    {
+        raster_fill(target, &clipped, color);
+    }
+}
+
+}
+
+void overlay_frame(overlay_stats &stats, std::uint64_t now_ns)
+{
+    if (stats.last_frame_ns != 0)
+    {
+        const auto elapsed_us = (now_ns - stats.last_frame_ns) / 1000;
+        const auto us = static_cast<std::uint32_t>(std::min<std::uint64_t>(elapsed_us, UINT32_MAX));
+        stats.frame_us[stats.frames % overlay_history] = us;
+        ++stats.frames;
+        ++stats.window_frames;
+        stats.window_worst_us = std::max(stats.window_worst_us, us);
+    }
+    stats.last_frame_ns = now_ns;
+
+    if (stats.window_start_ns == 0)
+    {
+        stats.window_start_ns = now_ns;
+    }
+    else if (now_ns - stats.window_start_ns >= 1'000'000'000)
+    {
+        const auto elapsed = static_cast<double>(now_ns - stats.window_start_ns);
+        stats.fps = static_cast<double>(stats.window_frames) * 1e9 / elapsed;
+        stats.worst_us = stats.window_worst_us;
+        stats.window_start_ns = now_ns;
+        stats.window_frames = 0;
+        stats.window_worst_us = 0;
+    }
+
+    stats.blits = std::exchange(stats.frame_blits, 0);
+    stats.bytes = stats.presented_bytes.exchange(0, std::memory_order_relaxed);
+}
+
+overlay_colors overlay_colors_for(pixel_format format, std::span<const palette_entry, 256> palette)
+{
+    return {
+        .background = pack_color(format, palette, 0, 0, 0),
+        .text = pack_color(format, palette, 224, 224, 224),
+        .graph = pack_color(format, palette, 64, 200, 64),
+        .slow = pack_color(format, palette, 224, 64, 64),
+        .budget = pack_color(format, palette, 224, 200, 64)};
+}
+
+raster_rect overlay_rect(std::uint32_t width, std::uint32_t height)
+{
+    return raster_intersect(panel_rect(), {0, 0, static_cast<std::int32_t>(width), static_cast<std::int32_t>(height)});
+}
+
+void overlay_draw(const raster_surface &target, const overlay_stats &stats, const overlay_colors &colors)
+{
+    const auto panel = panel_rect();
+    fill(target, panel, colors.background);
+
+    char lines[text_lines][48]{};
+    std::snprintf(lines[0], sizeof(lines[0]), "%.1f FPS  MAX %.1f MS", stats.fps, stats.worst_us / 1000.0);
+    std::snprintf(
+        lines[1],
+        sizeof(lines[1]),
+        "BLITS %" PRIu32 "  PRESENT %" PRIu64 " KB",
+        stats.blits,
+        (stats.bytes + 1023) / 1024);
+    std::snprintf(lines[2], sizeof(lines[2]), "OVERLAY %.2f MS", static_cast<double>(stats.overlay_ns) / 1e6);
+
+    const auto left = panel.left + padding;
+    for (auto line = 0; line < text_lines; ++line)
+    {
+        overlay_text(target, left, panel.top + padding + line * overlay_glyph_height, lines[line], colors.text);
+    }
+
+    // oldest frame on the left, columns for frames not seen yet stay empty
+    const auto bottom = panel.bottom - padding;
+    const auto shown = static_cast<std::uint32_t>(std::min<std::uint64_t>(stats.frames, overlay_history));
+    for (auto column = overlay_history - shown; column < overlay_history; ++column)
+    {
+        const auto us = stats.frame_us[(stats.frames + column) % overlay_history];
+        const auto height = static_cast<std::int32_t>(std::min(us, graph_full_us) * graph_height / graph_full_us);
+        const auto x = left + static_cast<std::int32_t>(column);
+        fill(target, {x, bottom - height, x + 1, bottom}, us > budget_us ? colors.slow : colors.graph);
+    }
+
+    const auto budget = bottom - static_cast<std::int32_t>(budget_us * graph_height / graph_full_us);
+    fill(target, {left, budget, left + static_cast<std::int32_t>(overlay_history), budget + 1}, colors.budget);
+}
+
+void overlay_text(
+    const raster_surface &target,
+    std::int32_t x,
+    std::int32_t y,
+    std::string_view text,
+    std::uint32_t color)
+{
+    const auto width = static_cast<std::int32_t>(target.width);
+    const auto height = static_cast<std::int32_t>(target.height);
+    for (const auto c : text)
+    {
+        const auto *glyph = glyph_for(c);
+        for (std::int32_t row = 0; row < 7; ++row)
+        {
+            const auto py = y + row;
+            if (py < 0 || py >= height || glyph[row] == 0)
+            {
+                continue;
+            }
+
+            for (std::int32_t column = 0; column < 5; ++column)
+            {
+                const auto px = x + column;
+                if ((glyph[row] & (0x10 >> column)) != 0 && px >= 0 && px < width)
+                {
+                    put_pixel(target, px, py, color);
+                }
+            }
+        }
+        x += overlay_glyph_width;
+    }
+}
+
+void overlay_save(overlay_backup &backup, const raster_surface &source, const raster_rect &rect)
+{
+    backup.rect = rect;
+    if (raster_rect_empty(rect))
+    {
+        return;
+    }
+
+    const auto bytes = bytes_per_pixel(source.format);
+    backup.row_bytes = static_cast<std::size_t>(rect.right - rect.left) * bytes;
+    backup.pixels.resize(backup.row_bytes * static_cast<std::size_t>(rect.bottom - rect.top));
+    for (auto y = rect.top; y < rect.bottom; ++y)
+    {
+        std::memcpy(
+            backup.pixels.data() + static_cast<std::size_t>(y - rect.top) * backup.row_bytes,
+            source.pixels + static_cast<std::ptrdiff_t>(y) * source.pitch + rect.left * bytes,
+            backup.row_bytes);
+    }
+}
+
+void overlay_restore(const overlay_backup &backup, const raster_surface &target)
+{
+    const auto &rect = backup.rect;
+    if (raster_rect_empty(rect))
+    {
+        return;
+    }
+
+    const auto bytes = bytes_per_pixel(target.format);
+    for (auto y = rect.top; y < rect.bottom; ++y)
+    {
+        std::memcpy(
+            target.pixels + static_cast<std::ptrdiff_t>(y) * target.pitch + rect.left * bytes,
+            backup.pixels.data() + static_cast<std::size_t>(y - rect.top) * backup.row_bytes,
+            backup.row_bytes);
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "palette_convert.h"
+#include "raster.h"
+
+// the [overlay] heads-up display, drawn by Flip into the back buffer just before it is presented
+// fps, the worst frame of the last second, a graph of recent frame times, the game's blits and the bytes presented
+// per frame, and what drawing the overlay itself cost, all rendered from a built in 5x7 font with no GDI involved
+
+// frames in the graph, one column each
+inline constexpr std::uint32_t overlay_history = 160;
+
+// glyphs are 5x7 in a 6x8 cell
+inline constexpr std::int32_t overlay_glyph_width = 6;
+inline constexpr std::int32_t overlay_glyph_height = 8;
+
+struct overlay_stats
+{
+    // counted by the hooks while a frame is drawn and presented, presented_bytes from the present thread too
+    std::uint32_t frame_blits{};
+    std::atomic<std::uint64_t> presented_bytes{};
+
+    // frame times in microseconds, frame_us[frames % overlay_history] is the newest
+    std::array<std::uint32_t, overlay_history> frame_us{};
+    std::uint64_t frames{};
+    std::uint64_t last_frame_ns{};
+
+    // the last finished frame
+    std::uint32_t blits{};
+    std::uint64_t bytes{};
+    // drawing and removing the overlay, set by the caller once it knows
+    std::uint64_t overlay_ns{};
+
+    // averaged over the last second or so
+    double fps{};
+    std::uint32_t worst_us{};
+    std::uint64_t window_start_ns{};
+    std::uint64_t window_frames{};
+    std::uint32_t window_worst_us{};
+};
+
+// raw pixel values in the target's format, palette indices for 8 bit surfaces
+struct overlay_colors
+{
+    std::uint32_t background;
+    std::uint32_t text;
+    std::uint32_t graph;
+    std::uint32_t slow;
+    std::uint32_t budget;
+};
+
+// a frame was finished at now_ns (steady clock), takes the frame's counts and starts counting the next one
+void overlay_frame(overlay_stats &stats, std::uint64_t now_ns);
+
+// the overlay's colours for a surface in format, 8 bit ones get the closest entries of palette
+overlay_colors overlay_colors_for(pixel_format format, std::span<const palette_entry, 256> palette);
+
+// where overlay_draw puts the panel on a width x height surface, clipped to it
+raster_rect overlay_rect(std::uint32_t width, std::uint32_t height);
+
+void overlay_draw(const raster_surface &target, const overlay_stats &stats, const overlay_colors &colors);
+
+// text at (x, y), lower case drawn as upper case and anything the font lacks as '?', clipped to the surface
+void overlay_text(
+    const raster_surface &target,
+    std::int32_t x,
+    std::int32_t y,
+    std::string_view text,
+    std::uint32_t color);
+
+// the pixels under the panel, so they can be put back once the frame is presented and the game never sees it
+struct overlay_backup
+{
+    raster_rect rect{};
+    std::size_t row_bytes{};
+    std::vector<std::uint8_t> pixels{};
+};
+
+void overlay_save(overlay_backup &backup, const raster_surface &source, const raster_rect &rect);
+
+void overlay_restore(const overlay_backup &backup, const raster_surface &target);
@@ -0,0 +1,215 @@
+#include "palette_convert.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+using row_kernel = void (*)(const std::uint8_t *, std::uint32_t *, std::size_t, const std::uint32_t *);
+
+void convert_row_scalar(const std::uint8_t *src, std::uint32_t *dst, std::size_t count, const std::uint32_t *lut)
+{
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        dst[i + 0] = lut[src[i + 0]];
+        dst[i + 1] = lut[src[i + 1]];
+        dst[i + 2] = lut[src[i + 2]];
+        dst[i + 3] = lut[src[i + 3]];
+    }
+    for (; i < count; ++i)
+    {
+        dst[i] = lut[src[i]];
+    }
+}
+
+#if BLOCKS_X86
+
+// there's no gather before avx2 so the lookups stay scalar, but the stores go out 16 bytes at a time
+BLOCKS_TARGET_SSE2 void convert_row_sse2(
+    const std::uint8_t *src,
+    std::uint32_t *dst,
+    std::size_t count,
+    const std::uint32_t *lut)
+{
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const auto *s = src + i;
+        const auto a = _mm_setr_epi32(
+            static_cast<int>(lut[s[0]]),
+            static_cast<int>(lut[s[1]]),
+            static_cast<int>(lut[s[2]]),
+            static_cast<int>(lut[s[3]]));
+        const auto b = _mm_setr_epi32(
+            static_cast<int>(lut[s[4]]),
+            static_cast<int>(lut[s[5]]),
+            static_cast<int>(lut[s[6]]),
+            static_cast<int>(lut[s[7]]));
+        const auto c = _mm_setr_epi32(
+            static_cast<int>(lut[s[8]]),
+            static_cast<int>(lut[s[9]]),
+            static_cast<int>(lut[s[10]]),
+            static_cast<int>(lut[s[11]]));
+        const auto d = _mm_setr_epi32(
+            static_cast<int>(lut[s[12]]),
+            static_cast<int>(lut[s[13]]),
+            static_cast<int>(lut[s[14]]),
+            static_cast<int>(lut[s[15]]));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 0), a);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 4), b);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 8), c);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 12), d);
+    }
+    convert_row_scalar(src + i, dst + i, count - i, lut);
+}
+
+// widen 8 indices to 32 bits and gather straight out of the lut, 32 pixels per iteration
+BLOCKS_TARGET_AVX2 void convert_row_avx2(
+    const std::uint8_t *src,
+    std::uint32_t *dst,
+    std::size_t count,
+    const std::uint32_t *lut)
+{
+    const auto *table = reinterpret_cast<const int *>(lut);
+
+    std::size_t i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        const auto *s = src + i;
+        const auto i0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(s + 0)));
+        const auto i1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(s + 8)));
+        const auto i2 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(s + 16)));
+        const auto i3 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(s + 24)));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 0), _mm256_i32gather_epi32(table, i0, 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 8), _mm256_i32gather_epi32(table, i1, 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 16), _mm256_i32gather_epi32(table, i2, 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 24), _mm256_i32gather_epi32(table, i3, 4));
+    }
+    convert_row_scalar(src + i, dst + i, count - i, lut);
+}
+
+#endif
+
+row_kernel kernel_for(simd_level level)
+{
+#if BLOCKS_X86
+    switch (level)
+    {
+        case simd_level::avx2: return convert_row_avx2;
+        case simd_level::sse2: return convert_row_sse2;
+        case simd_level::scalar: return convert_row_scalar;
+    }
+#endif
+    return convert_row_scalar;
+}
+
+row_kernel best_kernel()
+{
+    static const auto kernel = kernel_for(detect_simd_level());
+    return kernel;
+}
+
+void convert_with(const indexed_view &src, const bgra_view &dst, const palette_lut &lut, row_kernel kernel)
+{
+    const auto width = std::min(src.width, dst.width);
+    const auto height = std::min(src.height, dst.height);
+
+    const auto *src_row = src.pixels;
+    auto *dst_row = dst.pixels;
+
+    for (std::uint32_t y = 0; y < height; ++y)
+    {
+        kernel(src_row, reinterpret_cast<std::uint32_t *>(dst_row), width, lut.data());
+        src_row += src.pitch;
+        dst_row += dst.pitch;
+    }
+}
+
+}
+
+std::uint32_t pack_palette_entry(const palette_entry &entry)
+{
+    return (static_cast<std::uint32_t>(entry.red) << 16) | (static_cast<std::uint32_t>(entry.green) << 8) |
+           static_cast<std::uint32_t>(entry.blue);
+}
+
+void build_palette_lut(std::span<const palette_entry, 256> palette, palette_lut &lut)
+{
+    for (std::size_t i = 0; i < lut.size(); ++i)
+    {
+        lut[i] = pack_palette_entry(palette[i]);
+    }
+}
+
+indexed_view bottom_up_view(const std::uint8_t *pixels, std::uint32_t width, std::uint32_t height, std::size_t stride)
+{
+    if (height == 0)
+    {
+        return {pixels, static_cast<std::ptrdiff_t>(stride), width, 0};
+    }
+
+    return {
+        pixels + (height - 1) * stride,
+        -static_cast<std::ptrdiff_t>(stride),
+        width,
+        height,
+    };
+}
+
+indexed_view indexed_subview(
+    const indexed_view &view,
+    std::uint32_t x,
+    std::uint32_t y,
+    std::uint32_t width,
+    std::uint32_t height)
+{
+    return {view.pixels + static_cast<std::ptrdiff_t>(y) * view.pitch + x, view.pitch, width, height};
+}
+
+bgra_view bgra_subview(
+    const bgra_view &view,
+    std::uint32_t x,
+    std::uint32_t y,
+    std::uint32_t width,
+    std::uint32_t height)
+{
+    return {view.pixels + static_cast<std::ptrdiff_t>(y) * view.pitch + x * 4, view.pitch, width, height};
+}
+
+void copy_indexed(
+    const indexed_view &src,
+    std::uint8_t *dst,
+    std::ptrdiff_t dst_pitch,
+    std::uint32_t width,
+    std::uint32_t height)
+{
+    width = std::min(src.width, width);
+    height = std::min(src.height, height);
+
+    const auto *src_row = src.pixels;
+    for (std::uint32_t y = 0; y < height; ++y)
+    {
+        std::memcpy(dst, src_row, width);
+        src_row += src.pitch;
+        dst += dst_pitch;
+    }
+}
+
+void convert_indexed_row(const std::uint8_t *src, std::uint32_t *dst, std::size_t count, const palette_lut &lut)
+{
+    best_kernel()(src, dst, count, lut.data());
+}
+
+void convert_indexed_to_bgra(const indexed_view &src, const bgra_view &dst, const palette_lut &lut)
+{
+    convert_with(src, dst, lut, best_kernel());
+}
+
+void convert_indexed_to_bgra(const indexed_view &src, const bgra_view &dst, const palette_lut &lut, simd_level level)
+{
+    convert_with(src, dst, lut, kernel_for(std::min(level, detect_simd_level())));
+}
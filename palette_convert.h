@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "simd.h"
+
+// layout compatible with PALETTEENTRY so the hooks can hand g_palette straight over
+struct palette_entry
+{
+    std::uint8_t red;
+    std::uint8_t green;
+    std::uint8_t blue;
+    std::uint8_t flags;
+};
+
+// one packed 0x00RRGGBB value per palette index, which is B,G,R,0 in memory - exactly what a 32bpp surface wants
+using palette_lut = std::array<std::uint32_t, 256>;
+
+// an 8bpp index plane, pitch is in bytes and may be negative to walk a bottom-up DIB top to bottom
+struct indexed_view
+{
+    const std::uint8_t *pixels;
+    std::ptrdiff_t pitch;
+    std::uint32_t width;
+    std::uint32_t height;
+};
+
+// a 32bpp BGRA plane, pitch is in bytes (e.g. DDSURFACEDESC2::lPitch)
+struct bgra_view
+{
+    std::uint8_t *pixels;
+    std::ptrdiff_t pitch;
+    std::uint32_t width;
+    std::uint32_t height;
+};
+
+std::uint32_t pack_palette_entry(const palette_entry &entry);
+
+void build_palette_lut(std::span<const palette_entry, 256> palette, palette_lut &lut);
+
+// view a bottom-up DIB (last row first in memory) as a top-down image
+indexed_view bottom_up_view(const std::uint8_t *pixels, std::uint32_t width, std::uint32_t height, std::size_t stride);
+
+// the width x height area at (x, y) of a plane, for converting part of a frame, the caller keeps it inside the plane
+indexed_view indexed_subview(
+    const indexed_view &view,
+    std::uint32_t x,
+    std::uint32_t y,
+    std::uint32_t width,
+    std::uint32_t height);
+
+bgra_view bgra_subview(
+    const bgra_view &view,
+    std::uint32_t x,
+    std::uint32_t y,
+    std::uint32_t width,
+    std::uint32_t height);
+
+// copy min(src, dst) sized area of indices as they are, into an 8bpp plane with the given pitch
+void copy_indexed(
+    const indexed_view &src,
+    std::uint8_t *dst,
+    std::ptrdiff_t dst_pitch,
+    std::uint32_t width,
+    std::uint32_t height);
+
+// convert a single run of indices, the building block for the full and incremental conversions
+void convert_indexed_row(const std::uint8_t *src, std::uint32_t *dst, std::size_t count, const palette_lut &lut);
+
+// convert min(src, dst) sized area using the best kernel for this cpu
+void convert_indexed_to_bgra(const indexed_view &src, const bgra_view &dst, const palette_lut &lut);
+
+// same as above but with an explicit kernel, used by the benchmarks to compare paths
+void convert_indexed_to_bgra(const indexed_view &src, const bgra_view &dst, const palette_lut &lut, simd_level level);
@@ -0,0 +1,120 @@
+#include "palette_index.h"
+
+#include <algorithm>
+
+palette_pixel_index build_palette_pixel_index(const indexed_view &src)
+{
+    palette_pixel_index index{};
+    index.width = src.width;
+    index.height = src.height;
+
+    // two passes: count the runs per palette index, then scatter them into place
+
+    std::array<std::uint32_t, 256> run_counts{};
+
+    const auto for_each_run = [&](auto &&fn)
+    {
+        const auto *row = src.pixels;
+        for (std::uint32_t y = 0; y < src.height; ++y, row += src.pitch)
+        {
+            std::uint32_t x = 0;
+            while (x < src.width)
+            {
+                const auto value = row[x];
+                auto end = x + 1;
+                while (end < src.width && row[end] == value)
+                {
+                    ++end;
+                }
+                fn(value, pixel_span{y, x, end - x});
+                x = end;
+            }
+        }
+    };
+
+    for_each_run(
+        [&](std::uint8_t value, const pixel_span &span)
+        {
+            ++run_counts[value];
+            index.pixel_counts[value] += span.length;
+        });
+
+    for (std::size_t i = 0; i < 256; ++i)
+    {
+        index.starts[i + 1] = index.starts[i] + run_counts[i];
+    }
+
+    index.spans.resize(index.starts[256]);
+
+    auto cursor = index.starts;
+    for_each_run([&](std::uint8_t value, const pixel_span &span) { index.spans[cursor[value]++] = span; });
+
+    return index;
+}
+
+std::span<const pixel_span> spans_for(const palette_pixel_index &index, std::uint8_t palette_index)
+{
+    const auto first = index.starts[palette_index];
+    const auto last = index.starts[palette_index + 1];
+    return std::span<const pixel_span>{index.spans}.subspan(first, last - first);
+}
+
+std::size_t pixels_affected(const palette_pixel_index &index, const palette_changes &changes)
+{
+    std::size_t pixels = 0;
+    for (std::size_t i = 0; i < 256; ++i)
+    {
+        if (changes[i])
+        {
+            pixels += index.pixel_counts[i];
+        }
+    }
+    return pixels;
+}
+
+palette_changes diff_palette(
+    std::span<const palette_entry, 256> current,
+    std::size_t first,
+    std::span<const palette_entry> incoming)
+{
+    palette_changes changes{};
+
+    const auto count = std::min(incoming.size(), current.size() - std::min(first, current.size()));
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        // flags don't reach the screen so only the colour matters
+        if (pack_palette_entry(current[first + i]) != pack_palette_entry(incoming[i]))
+        {
+            changes.set(first + i);
+        }
+    }
+
+    return changes;
+}
+
+void apply_palette_changes(
+    const palette_pixel_index &index,
+    const palette_changes &changes,
+    const palette_lut &lut,
+    const bgra_view &dst)
+{
+    for (std::size_t i = 0; i < 256; ++i)
+    {
+        if (!changes[i])
+        {
+            continue;
+        }
+
+        const auto colour = lut[i];
+        for (const auto &span : spans_for(index, static_cast<std::uint8_t>(i)))
+        {
+            if (span.row >= dst.height || span.column >= dst.width)
+            {
+                continue;
+            }
+
+            auto *row = reinterpret_cast<std::uint32_t *>(dst.pixels + span.row * dst.pitch);
+            std::fill_n(row + span.column, std::min(span.length, dst.width - span.column), colour);
+        }
+    }
+}
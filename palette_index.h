@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "palette_convert.h"
+
+// a horizontal run of pixels that all share one palette index, row is top-down in the indexed_view it came from
+struct pixel_span
+{
+    std::uint32_t row;
+    std::uint32_t column;
+    std::uint32_t length;
+};
+
+// which palette entries differ from the last converted palette
+using palette_changes = std::bitset<256>;
+
+// inverted index from palette index to every span of pixels that uses it, stored CSR style:
+// spans[starts[i]..starts[i + 1]) are the spans for index i
+struct palette_pixel_index
+{
+    std::array<std::uint32_t, 257> starts{};
+    std::array<std::uint32_t, 256> pixel_counts{};
+    std::vector<pixel_span> spans{};
+    std::uint32_t width{};
+    std::uint32_t height{};
+};
+
+palette_pixel_index build_palette_pixel_index(const indexed_view &src);
+
+std::span<const pixel_span> spans_for(const palette_pixel_index &index, std::uint8_t palette_index);
+
+// number of pixels that a set of changed entries would touch
+std::size_t pixels_affected(const palette_pixel_index &index, const palette_changes &changes);
+
+// mark entries of palette (starting at first) that differ from current, without modifying current
+palette_changes diff_palette(
+    std::span<const palette_entry, 256> current,
+    std::size_t first,
+    std::span<const palette_entry> incoming);
+
+// rewrite only the pixels of dst that use a changed entry, lut must already hold the new colours
+void apply_palette_changes(
+    const palette_pixel_index &index,
+    const palette_changes &changes,
+    const palette_lut &lut,
+    const bgra_view &dst);
@@ -0,0 +1,380 @@
+#include "pe_image.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+namespace
+{
+
+constexpr std::size_t file_header_size = 20;
+constexpr std::size_t section_header_size = 40;
+constexpr std::size_t import_descriptor_size = 20;
+constexpr std::uint16_t pe32_magic = 0x10b;
+constexpr std::uint16_t pe32_plus_magic = 0x20b;
+constexpr std::uint32_t import_directory = 1;
+
+// longest dll or function name we believe, anything longer is a broken table rather than a real name
+constexpr std::size_t max_name = 512;
+
+constexpr char cache_magic[] = "blocks_imports";
+constexpr std::uint32_t cache_version = 1;
+
+std::uint16_t read_u16(const std::uint8_t *p)
+{
+    return static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+}
+
+std::uint32_t read_u32(const std::uint8_t *p)
+{
+    return static_cast<std::uint32_t>(p[0]) | (static_cast<std::uint32_t>(p[1]) << 8) |
+           (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+std::uint64_t read_u64(const std::uint8_t *p)
+{
+    return read_u32(p) | (static_cast<std::uint64_t>(read_u32(p + 4)) << 32);
+}
+
+// file offset of size bytes at rva, nullopt when they're not all backed by the file or the mapping
+std::optional<std::size_t> rva_offset(
+    const pe_image &image,
+    std::span<const std::uint8_t> bytes,
+    pe_layout layout,
+    std::uint32_t rva,
+    std::size_t size)
+{
+    std::size_t offset = rva;
+    if (layout == pe_layout::file && rva >= image.size_of_headers)
+    {
+        const auto section = std::ranges::find_if(
+            image.sections,
+            [rva](const pe_section &section)
+            { return rva >= section.rva && rva - section.rva < std::max(section.virtual_size, section.raw_size); });
+        if (section == image.sections.end() || rva - section->rva + size > section->raw_size)
+        {
+            return std::nullopt;
+        }
+        offset = section->raw_offset + static_cast<std::size_t>(rva - section->rva);
+    }
+
+    if (offset > bytes.size() || size > bytes.size() - offset)
+    {
+        return std::nullopt;
+    }
+    return offset;
+}
+
+// a nul terminated name at rva
+std::optional<std::string> read_name(
+    const pe_image &image,
+    std::span<const std::uint8_t> bytes,
+    pe_layout layout,
+    std::uint32_t rva)
+{
+    const auto offset = rva_offset(image, bytes, layout, rva, 1);
+    if (!offset)
+    {
+        return std::nullopt;
+    }
+
+    const auto *start = reinterpret_cast<const char *>(bytes.data() + *offset);
+    const auto length = ::strnlen(start, std::min(bytes.size() - *offset, max_name));
+    if (length == 0 || length == max_name || *offset + length == bytes.size())
+    {
+        return std::nullopt;
+    }
+    return std::string{start, length};
+}
+
+bool same_dll(std::string_view a, std::string_view b)
+{
+    const auto lower = [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; };
+    return std::ranges::equal(a, b, {}, lower, lower);
+}
+
+}
+
+const char *pe_error_name(pe_error error)
+{
+    switch (error)
+    {
+        case pe_error::none: return "none";
+        case pe_error::truncated: return "truncated";
+        case pe_error::not_an_executable: return "not an executable";
+        case pe_error::unsupported_format: return "unsupported format";
+        case pe_error::bad_section_table: return "bad section table";
+        case pe_error::bad_import_table: return "bad import table";
+    }
+    return "?";
+}
+
+pe_error pe_parse(std::span<const std::uint8_t> bytes, pe_layout layout, pe_image &image)
+{
+    if (bytes.size() < 0x40)
+    {
+        return pe_error::truncated;
+    }
+    if (bytes[0] != 'M' || bytes[1] != 'Z')
+    {
+        return pe_error::not_an_executable;
+    }
+
+    const std::size_t nt = read_u32(bytes.data() + 0x3c);
+    if (nt > bytes.size() || bytes.size() - nt < 4 + file_header_size + 2)
+    {
+        return pe_error::truncated;
+    }
+    if (std::memcmp(bytes.data() + nt, "PE\0\0", 4) != 0)
+    {
+        return pe_error::not_an_executable;
+    }
+
+    const auto *file_header = bytes.data() + nt + 4;
+    const auto section_count = read_u16(file_header + 2);
+    const std::size_t optional_size = read_u16(file_header + 16);
+    const auto optional_offset = nt + 4 + file_header_size;
+    if (optional_size > bytes.size() - optional_offset)
+    {
+        return pe_error::truncated;
+    }
+
+    pe_image result{};
+    result.machine = read_u16(file_header);
+    result.timestamp = read_u32(file_header + 4);
+
+    // the fields up to and including the data directory count, which both formats have at a different offset
+    const auto *optional = bytes.data() + optional_offset;
+    const auto magic = read_u16(optional);
+    if ((magic != pe32_magic && magic != pe32_plus_magic) ||
+        optional_size < (magic == pe32_magic ? 96u : 112u))
+    {
+        return pe_error::unsupported_format;
+    }
+    result.pe32_plus = magic == pe32_plus_magic;
+    result.image_base = result.pe32_plus ? read_u64(optional + 24) : read_u32(optional + 28);
+    result.size_of_image = read_u32(optional + 56);
+    result.size_of_headers = read_u32(optional + 60);
+    result.checksum = read_u32(optional + 64);
+
+    const auto table_offset = optional_offset + optional_size;
+    if (static_cast<std::size_t>(section_count) * section_header_size > bytes.size() - table_offset)
+    {
+        return pe_error::bad_section_table;
+    }
+
+    for (std::uint16_t i = 0; i < section_count; ++i)
+    {
+        const auto *header = bytes.data() + table_offset + i * section_header_size;
+        const auto *name = reinterpret_cast<const char *>(header);
+        result.sections.push_back({
+            .name = std::string{name, ::strnlen(name, 8)},
+            .rva = read_u32(header + 12),
+            .virtual_size = read_u32(header + 8),
+            .raw_offset = read_u32(header + 20),
+            .raw_size = read_u32(header + 16),
+            .characteristics = read_u32(header + 36),
+        });
+    }
+
+    // the loader maps every section, in a file a section's raw data has to be there
+    for (const auto &section : result.sections)
+    {
+        const auto end = layout == pe_layout::file
+                             ? static_cast<std::uint64_t>(section.raw_offset) + section.raw_size
+                             : static_cast<std::uint64_t>(section.rva) + section.virtual_size;
+        if (end > bytes.size())
+        {
+            return pe_error::bad_section_table;
+        }
+    }
+
+    image = std::move(result);
+    return pe_error::none;
+}
+
+pe_error pe_read_imports(std::span<const std::uint8_t> bytes, pe_layout layout, pe_image &image)
+{
+    const std::size_t nt = read_u32(bytes.data() + 0x3c);
+    const auto *optional = bytes.data() + nt + 4 + file_header_size;
+    const auto directories = image.pe32_plus ? optional + 112 : optional + 96;
+    const auto directory_count = read_u32(image.pe32_plus ? optional + 108 : optional + 92);
+    const std::size_t optional_size = read_u16(bytes.data() + nt + 4 + 16);
+
+    image.imports.clear();
+    const auto directory_end = static_cast<std::size_t>(directories - optional) + (import_directory + 1) * 8;
+    if (directory_count <= import_directory || directory_end > optional_size)
+    {
+        return pe_error::none;
+    }
+
+    const auto table_rva = read_u32(directories + import_directory * 8);
+    if (table_rva == 0)
+    {
+        return pe_error::none;
+    }
+
+    const auto thunk_size = image.pe32_plus ? 8u : 4u;
+    const auto ordinal_flag = image.pe32_plus ? 1ull << 63 : 1ull << 31;
+
+    for (auto descriptor_rva = table_rva;; descriptor_rva += import_descriptor_size)
+    {
+        const auto descriptor = rva_offset(image, bytes, layout, descriptor_rva, import_descriptor_size);
+        if (!descriptor)
+        {
+            return pe_error::bad_import_table;
+        }
+
+        const auto *entry = bytes.data() + *descriptor;
+        const auto name_table = read_u32(entry);
+        const auto name_rva = read_u32(entry + 12);
+        const auto address_table = read_u32(entry + 16);
+        if (name_rva == 0 && address_table == 0)
+        {
+            break;
+        }
+
+        const auto dll = read_name(image, bytes, layout, name_rva);
+        if (!dll)
+        {
+            return pe_error::bad_import_table;
+        }
+
+        // the loader overwrites the address table with the functions' addresses, once mapped only the name table
+        // still says what they were, some old linkers leave that out
+        const auto names = name_table != 0 ? name_table : layout == pe_layout::file ? address_table : 0;
+
+        for (std::uint32_t i = 0;; ++i)
+        {
+            const auto slot = address_table + i * thunk_size;
+            const auto thunk_rva = names != 0 ? names + i * thunk_size : slot;
+            const auto thunk = rva_offset(image, bytes, layout, thunk_rva, thunk_size);
+            if (!thunk)
+            {
+                return pe_error::bad_import_table;
+            }
+
+            const auto value = image.pe32_plus ? read_u64(bytes.data() + *thunk) : read_u32(bytes.data() + *thunk);
+            if (value == 0)
+            {
+                break;
+            }
+
+            pe_import import{.dll = *dll, .function = {}, .ordinal = 0, .iat_rva = slot};
+            if (names == 0)
+            {
+                // a bound address, nothing to tell which function it is
+            }
+            else if (value & ordinal_flag)
+            {
+                import.ordinal = static_cast<std::uint16_t>(value);
+            }
+            else
+            {
+                // IMAGE_IMPORT_BY_NAME: a hint then the name
+                const auto hint = rva_offset(image, bytes, layout, static_cast<std::uint32_t>(value), 2);
+                const auto function = read_name(image, bytes, layout, static_cast<std::uint32_t>(value) + 2);
+                if (!hint || !function)
+                {
+                    return pe_error::bad_import_table;
+                }
+                import.ordinal = read_u16(bytes.data() + *hint);
+                import.function = *function;
+            }
+            image.imports.push_back(std::move(import));
+        }
+    }
+
+    return pe_error::none;
+}
+
+const pe_section *pe_find_section(const pe_image &image, std::string_view name)
+{
+    const auto found = std::ranges::find(image.sections, name, &pe_section::name);
+    return found != image.sections.end() ? &*found : nullptr;
+}
+
+const pe_import *pe_find_import(const pe_image &image, std::string_view dll, std::string_view function)
+{
+    const auto found = std::ranges::find_if(
+        image.imports,
+        [&](const pe_import &import) { return import.function == function && same_dll(import.dll, dll); });
+    return found != image.imports.end() ? &*found : nullptr;
+}
+
+std::optional<std::vector<pe_import_slot>> pe_import_cache_load(
+    const std::filesystem::path &path,
+    std::uint32_t timestamp,
+    std::uint32_t checksum)
+{
+    std::ifstream file{path};
+    std::string line{};
+    if (!std::getline(file, line))
+    {
+        return std::nullopt;
+    }
+
+    std::istringstream header{line};
+    std::string magic{};
+    std::uint32_t version{};
+    std::uint32_t stored_timestamp{};
+    std::uint32_t stored_checksum{};
+    header >> magic >> std::hex >> version >> stored_timestamp >> stored_checksum;
+    if (!header || magic != cache_magic || version != cache_version || stored_timestamp != timestamp ||
+        stored_checksum != checksum)
+    {
+        return std::nullopt;
+    }
+
+    std::vector<pe_import_slot> slots{};
+    while (std::getline(file, line))
+    {
+        std::istringstream fields{line};
+        pe_import_slot slot{};
+        fields >> slot.dll >> slot.function >> std::hex >> slot.iat_rva;
+        if (!fields)
+        {
+            return std::nullopt;
+        }
+        slots.push_back(std::move(slot));
+    }
+    return slots;
+}
+
+bool pe_import_cache_store(
+    const std::filesystem::path &path,
+    std::uint32_t timestamp,
+    std::uint32_t checksum,
+    std::span<const pe_import_slot> slots)
+{
+    auto temporary = path;
+    temporary += ".tmp";
+
+    auto *file = std::fopen(temporary.string().c_str(), "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    auto ok = std::fprintf(file, "%s %x %x %x\n", cache_magic, cache_version, timestamp, checksum) > 0;
+    for (const auto &slot : slots)
+    {
+        ok = ok && std::fprintf(file, "%s %s %x\n", slot.dll.c_str(), slot.function.c_str(), slot.iat_rva) > 0;
+    }
+    ok = std::fclose(file) == 0 && ok;
+
+    std::error_code error{};
+    if (ok)
+    {
+        std::filesystem::rename(temporary, path, error);
+        ok = !error;
+    }
+    if (!ok)
+    {
+        std::filesystem::remove(temporary, error);
+    }
+    return ok;
+}
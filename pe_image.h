@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// reader for the parts of a PE (.exe/.dll) the patcher needs to find its way around the game: the section table and
+// the import table, from a file on disk or from a module as the loader mapped it
+// nothing here needs windows, so the same code can be pointed at the game's exe on any machine
+
+enum class pe_layout
+{
+    // the bytes of the file, rvas have to be translated through the section table
+    file,
+    // the image as the loader laid it out at its base address, rvas are plain offsets
+    mapped
+};
+
+enum class pe_error
+{
+    none,
+    truncated,
+    not_an_executable,
+    unsupported_format,
+    bad_section_table,
+    bad_import_table
+};
+
+struct pe_section
+{
+    std::string name;
+    std::uint32_t rva;
+    std::uint32_t virtual_size;
+    std::uint32_t raw_offset;
+    std::uint32_t raw_size;
+    std::uint32_t characteristics;
+};
+
+struct pe_import
+{
+    // as the exe spells it, usually upper case
+    std::string dll;
+    // empty when imported by ordinal, or when the import has no name table and the loader already bound it
+    std::string function;
+    std::uint16_t ordinal;
+    // where the loader puts the function's address, relative to the image base
+    std::uint32_t iat_rva;
+};
+
+struct pe_image
+{
+    std::uint16_t machine{};
+    bool pe32_plus{};
+    std::uint32_t timestamp{};
+    std::uint32_t checksum{};
+    std::uint64_t image_base{};
+    std::uint32_t size_of_image{};
+    std::uint32_t size_of_headers{};
+    std::vector<pe_section> sections{};
+    // only filled in by pe_read_imports
+    std::vector<pe_import> imports{};
+};
+
+const char *pe_error_name(pe_error error);
+
+// the headers and the section table, enough to know which build this is, image is left untouched on error
+pe_error pe_parse(std::span<const std::uint8_t> bytes, pe_layout layout, pe_image &image);
+
+// walk the import descriptors of an image pe_parse accepted
+pe_error pe_read_imports(std::span<const std::uint8_t> bytes, pe_layout layout, pe_image &image);
+
+// the section called name (".rsrc", ".text", ...), null if there's none
+const pe_section *pe_find_section(const pe_image &image, std::string_view name);
+
+// the import of function from dll, the dll name is compared without case
+const pe_import *pe_find_import(const pe_image &image, std::string_view dll, std::string_view function);
+
+// resolved iat slots of one build of an executable, so the next start with the same exe can skip the import walk
+// file layout: a "blocks_imports 1 <timestamp> <checksum>" line then one "<dll> <function> <iat rva>" line per
+// import, all numbers in hex, an iat rva of 0 records an import the build doesn't have
+
+struct pe_import_slot
+{
+    std::string dll;
+    std::string function;
+    std::uint32_t iat_rva;
+};
+
+// the slots stored for the build with timestamp and checksum, nullopt on a miss or a damaged file
+std::optional<std::vector<pe_import_slot>> pe_import_cache_load(
+    const std::filesystem::path &path,
+    std::uint32_t timestamp,
+    std::uint32_t checksum);
+
+// false if it couldn't be written, written through a temporary file like the atlas cache
+bool pe_import_cache_store(
+    const std::filesystem::path &path,
+    std::uint32_t timestamp,
+    std::uint32_t checksum,
+    std::span<const pe_import_slot> slots);
@@ -0,0 +1,291 @@
+#include "png.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace
+{
+
+constexpr std::uint8_t png_signature[8]{0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+constexpr std::uint8_t color_type_rgb = 2;
+constexpr std::uint8_t color_type_indexed = 3;
+constexpr std::uint8_t filter_up = 2;
+
+// shortest run worth a match and the longest one deflate can say in one
+constexpr std::size_t min_match = 3;
+constexpr std::size_t max_match = 258;
+
+constexpr std::uint16_t length_base[29]{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr std::uint8_t length_extra[29]{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+const std::array<std::uint32_t, 256> &crc_table()
+{
+    static const auto table = []
+    {
+        std::array<std::uint32_t, 256> result{};
+        for (std::uint32_t n = 0; n < 256; ++n)
+        {
+            auto c = n;
+            for (auto k = 0; k < 8; ++k)
+            {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            result[n] = c;
+        }
+        return result;
+    }();
+    return table;
+}
+
+std::uint32_t crc32(std::span<const std::uint8_t> bytes)
+{
+    const auto &table = crc_table();
+    auto crc = 0xffffffffu;
+    for (const auto byte : bytes)
+    {
+        crc = table[(crc ^ byte) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffffu;
+}
+
+std::uint32_t adler32(std::span<const std::uint8_t> bytes)
+{
+    std::uint32_t a = 1;
+    std::uint32_t b = 0;
+    // 5552 is the most bytes that can be summed before b has to be reduced
+    for (std::size_t first = 0; first < bytes.size(); first += 5552)
+    {
+        const auto last = std::min(bytes.size(), first + 5552);
+        for (auto i = first; i < last; ++i)
+        {
+            a += bytes[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return b << 16 | a;
+}
+
+void put_u32(std::vector<std::uint8_t> &out, std::uint32_t value)
+{
+    out.push_back(static_cast<std::uint8_t>(value >> 24));
+    out.push_back(static_cast<std::uint8_t>(value >> 16));
+    out.push_back(static_cast<std::uint8_t>(value >> 8));
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+void put_chunk(std::vector<std::uint8_t> &out, const char (&type)[5], std::span<const std::uint8_t> data)
+{
+    put_u32(out, static_cast<std::uint32_t>(data.size()));
+    const auto start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put_u32(out, crc32(std::span{out}.subspan(start)));
+}
+
+// deflate's bit order: values go in least significant bit first, huffman codes most significant bit first
+struct bit_writer
+{
+    std::vector<std::uint8_t> &out;
+    std::uint32_t bits{};
+    std::uint32_t count{};
+
+    void put(std::uint32_t value, std::uint32_t length)
+    {
+        bits |= value << count;
+        count += length;
+        while (count >= 8)
+        {
+            out.push_back(static_cast<std::uint8_t>(bits));
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    void put_code(std::uint32_t code, std::uint32_t length)
+    {
+        std::uint32_t reversed = 0;
+        for (std::uint32_t i = 0; i < length; ++i)
+        {
+            reversed |= ((code >> i) & 1) << (length - 1 - i);
+        }
+        put(reversed, length);
+    }
+
+    void flush()
+    {
+        if (count > 0)
+        {
+            out.push_back(static_cast<std::uint8_t>(bits));
+        }
+        bits = 0;
+        count = 0;
+    }
+};
+
+// a literal/length symbol in the fixed code
+void put_symbol(bit_writer &writer, std::uint32_t symbol)
+{
+    if (symbol < 144)
+    {
+        writer.put_code(0x30 + symbol, 8);
+    }
+    else if (symbol < 256)
+    {
+        writer.put_code(0x190 + symbol - 144, 9);
+    }
+    else if (symbol < 280)
+    {
+        writer.put_code(symbol - 256, 7);
+    }
+    else
+    {
+        writer.put_code(0xc0 + symbol - 280, 8);
+    }
+}
+
+// a repeat of the byte before, distance 1 is distance code 0 with no extra bits
+void put_run(bit_writer &writer, std::size_t length)
+{
+    std::size_t code = 28;
+    while (length_base[code] > length)
+    {
+        --code;
+    }
+    put_symbol(writer, static_cast<std::uint32_t>(257 + code));
+    writer.put(static_cast<std::uint32_t>(length - length_base[code]), length_extra[code]);
+    writer.put_code(0, 5);
+}
+
+// zlib stream of one fixed code block
+std::vector<std::uint8_t> compress(std::span<const std::uint8_t> bytes)
+{
+    std::vector<std::uint8_t> out{0x78, 0x01};
+    bit_writer writer{out};
+    writer.put(1, 1); // last block
+    writer.put(1, 2); // fixed code
+
+    for (std::size_t i = 0; i < bytes.size();)
+    {
+        put_symbol(writer, bytes[i]);
+
+        auto run = std::size_t{0};
+        while (i + 1 + run < bytes.size() && run < max_match && bytes[i + 1 + run] == bytes[i])
+        {
+            ++run;
+        }
+
+        if (run >= min_match)
+        {
+            put_run(writer, run);
+            i += 1 + run;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    put_symbol(writer, 256);
+    writer.flush();
+    put_u32(out, adler32(bytes));
+    return out;
+}
+
+// rows of the image as png wants them before filtering, 8 bit indices or r, g, b
+void unpack_row(const raster_surface &image, std::uint32_t y, std::uint8_t *out)
+{
+    const auto *row = image.pixels + static_cast<std::ptrdiff_t>(y) * image.pitch;
+    switch (image.format)
+    {
+        case pixel_format::indexed8: std::memcpy(out, row, image.width); return;
+        case pixel_format::rgb555:
+        case pixel_format::rgb565:
+        {
+            const auto green_bits = image.format == pixel_format::rgb565 ? 6 : 5;
+            const auto green_max = (1 << green_bits) - 1;
+            for (std::uint32_t x = 0; x < image.width; ++x)
+            {
+                std::uint16_t pixel{};
+                std::memcpy(&pixel, row + x * 2, 2);
+                const auto blue = pixel & 0x1f;
+                const auto green = (pixel >> 5) & green_max;
+                const auto red = (pixel >> (5 + green_bits)) & 0x1f;
+                out[x * 3] = static_cast<std::uint8_t>(red * 255 / 31);
+                out[x * 3 + 1] = static_cast<std::uint8_t>(green * 255 / green_max);
+                out[x * 3 + 2] = static_cast<std::uint8_t>(blue * 255 / 31);
+            }
+            return;
+        }
+        case pixel_format::rgb888:
+        case pixel_format::argb8888:
+        {
+            // b, g, r in memory either way
+            const auto step = bytes_per_pixel(image.format);
+            for (std::uint32_t x = 0; x < image.width; ++x)
+            {
+                out[x * 3] = row[x * step + 2];
+                out[x * 3 + 1] = row[x * step + 1];
+                out[x * 3 + 2] = row[x * step];
+            }
+            return;
+        }
+    }
+}
+
+}
+
+std::vector<std::uint8_t> png_encode(const raster_surface &image, std::span<const palette_entry, 256> palette)
+{
+    const auto indexed = image.format == pixel_format::indexed8;
+    const std::size_t row_bytes = static_cast<std::size_t>(image.width) * (indexed ? 1 : 3);
+
+    // each row goes in as its filter byte and its bytes minus the ones above
+    std::vector<std::uint8_t> filtered((row_bytes + 1) * image.height);
+    std::vector<std::uint8_t> above(row_bytes);
+    std::vector<std::uint8_t> current(row_bytes);
+    for (std::uint32_t y = 0; y < image.height; ++y)
+    {
+        unpack_row(image, y, current.data());
+        auto *out = filtered.data() + y * (row_bytes + 1);
+        out[0] = filter_up;
+        for (std::size_t i = 0; i < row_bytes; ++i)
+        {
+            out[1 + i] = static_cast<std::uint8_t>(current[i] - above[i]);
+        }
+        std::swap(above, current);
+    }
+
+    std::vector<std::uint8_t> png(std::begin(png_signature), std::end(png_signature));
+
+    std::vector<std::uint8_t> header;
+    put_u32(header, image.width);
+    put_u32(header, image.height);
+    header.push_back(8); // bits per channel or index
+    header.push_back(indexed ? color_type_indexed : color_type_rgb);
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // not interlaced
+    put_chunk(png, "IHDR", header);
+
+    if (indexed)
+    {
+        std::vector<std::uint8_t> colors;
+        for (const auto &entry : palette)
+        {
+            colors.push_back(entry.red);
+            colors.push_back(entry.green);
+            colors.push_back(entry.blue);
+        }
+        put_chunk(png, "PLTE", colors);
+    }
+
+    put_chunk(png, "IDAT", compress(filtered));
+    put_chunk(png, "IEND", {});
+    return png;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "palette_convert.h"
+#include "raster.h"
+
+// writer for the png files blocks_recording_export makes
+// 8 bit images keep their palette, everything else becomes 24 bit rgb, each row is stored as its difference to the
+// row above and compressed with nothing but runs and the fixed deflate code, a long way off zlib but plenty for
+// game frames with big flat areas and no dependency
+
+std::vector<std::uint8_t> png_encode(const raster_surface &image, std::span<const palette_entry, 256> palette);
@@ -0,0 +1,116 @@
+#include "present_queue.h"
+
+#include <algorithm>
+
+void present_queue_init(
+    present_queue &queue,
+    std::uint32_t depth,
+    present_backpressure backpressure,
+    std::uint32_t width,
+    std::uint32_t height)
+{
+    std::lock_guard lock{queue.mutex};
+
+    queue.depth = std::max<std::uint32_t>(depth, 1);
+    queue.backpressure = backpressure;
+    queue.width = width;
+    queue.height = height;
+
+    const auto slots = present_slot_count(queue.depth);
+    queue.damage.assign(slots, {});
+    queue.free.clear();
+    for (std::uint32_t slot = 0; slot < slots; ++slot)
+    {
+        damage_reset(queue.damage[slot], width, height);
+        queue.free.push_back(slot);
+    }
+    queue.queued.clear();
+    queue.dropped = 0;
+    queue.stopping = false;
+}
+
+bool present_acquire(present_queue &queue, std::uint32_t &slot)
+{
+    std::unique_lock lock{queue.mutex};
+
+    if (queue.backpressure == present_backpressure::block)
+    {
+        queue.changed.wait(lock, [&] { return queue.stopping || queue.queued.size() < queue.depth; });
+    }
+
+    if (queue.stopping)
+    {
+        return false;
+    }
+
+    if (queue.queued.size() >= queue.depth)
+    {
+        // drop the oldest waiting frame and reuse its slot, whatever it changed still has to reach the screen so
+        // its damage moves to the frame that is now next in line, or stays in the slot for the frame replacing it
+        slot = queue.queued.front();
+        queue.queued.pop_front();
+        ++queue.dropped;
+
+        if (!queue.queued.empty())
+        {
+            damage_add_list(queue.damage[queue.queued.front()], queue.damage[slot]);
+            damage_reset(queue.damage[slot], queue.width, queue.height);
+        }
+        return true;
+    }
+
+    // with depth + 2 slots there is always a free one while fewer than depth frames are queued
+    slot = queue.free.back();
+    queue.free.pop_back();
+    damage_reset(queue.damage[slot], queue.width, queue.height);
+    return true;
+}
+
+void present_submit(present_queue &queue, std::uint32_t slot, const damage_list &damage)
+{
+    {
+        std::lock_guard lock{queue.mutex};
+        damage_add_list(queue.damage[slot], damage);
+        queue.queued.push_back(slot);
+    }
+    queue.changed.notify_all();
+}
+
+bool present_next(present_queue &queue, std::uint32_t &slot, damage_list &damage)
+{
+    {
+        std::unique_lock lock{queue.mutex};
+        queue.changed.wait(lock, [&] { return queue.stopping || !queue.queued.empty(); });
+
+        if (queue.stopping)
+        {
+            return false;
+        }
+
+        slot = queue.queued.front();
+        queue.queued.pop_front();
+        damage = queue.damage[slot];
+    }
+
+    // a blocked Flip can go again now the queue is shorter
+    queue.changed.notify_all();
+    return true;
+}
+
+void present_release(present_queue &queue, std::uint32_t slot)
+{
+    {
+        std::lock_guard lock{queue.mutex};
+        queue.free.push_back(slot);
+    }
+    queue.changed.notify_all();
+}
+
+void present_stop(present_queue &queue)
+{
+    {
+        std::lock_guard lock{queue.mutex};
+        queue.stopping = true;
+    }
+    queue.changed.notify_all();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "damage.h"
+
+// hand off between Flip (producer) and the present thread (consumer) for the asynchronous present mode
+// frames live in a fixed set of staging slots owned by the caller, the queue only decides which slot is filled,
+// waiting or presented and carries each frame's damage along with it
+
+enum class present_backpressure
+{
+    // a full queue throws away the oldest frame that hasn't been presented yet, Flip never waits
+    drop_oldest,
+    // a full queue makes Flip wait for the present thread to catch up
+    block
+};
+
+struct present_queue
+{
+    std::mutex mutex{};
+    std::condition_variable changed{};
+
+    std::uint32_t depth{};
+    present_backpressure backpressure{};
+    std::uint32_t width{};
+    std::uint32_t height{};
+
+    // per slot, what changed on the back buffer between the frame in it and the previously queued frame
+    std::vector<damage_list> damage{};
+    std::vector<std::uint32_t> free{};
+    std::deque<std::uint32_t> queued{};
+
+    std::uint64_t dropped{};
+    bool stopping{};
+};
+
+// one slot for Flip to fill, one for the present thread to read and depth frames waiting in between
+constexpr std::uint32_t present_slot_count(std::uint32_t depth)
+{
+    return depth + 2;
+}
+
+// width x height is the back buffer size, used for the damage bounds
+void present_queue_init(
+    present_queue &queue,
+    std::uint32_t depth,
+    present_backpressure backpressure,
+    std::uint32_t width,
+    std::uint32_t height);
+
+// producer: a slot to copy the next frame into, waits under block backpressure
+// returns false once the queue is stopping
+bool present_acquire(present_queue &queue, std::uint32_t &slot);
+
+// producer: queue the filled slot along with the damage since the previous submitted frame
+void present_submit(present_queue &queue, std::uint32_t slot, const damage_list &damage);
+
+// consumer: waits for the oldest queued frame, its damage is everything that changed since the last frame this
+// returned, including any frames dropped in between, returns false once the queue is stopping
+bool present_next(present_queue &queue, std::uint32_t &slot, damage_list &damage);
+
+// consumer: the slot from present_next has been presented and can be refilled
+void present_release(present_queue &queue, std::uint32_t slot);
+
+// wake both sides and make every wait return false, frames still queued are never presented
+void present_stop(present_queue &queue);
@@ -0,0 +1,656 @@
+#include "raster.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "simd.h"
+
+namespace
+{
+
+template <std::size_t Bytes>
+std::uint32_t load_pixel(const std::uint8_t *p)
+{
+    if constexpr (Bytes == 1)
+    {
+        return *p;
+    }
+    else if constexpr (Bytes == 2)
+    {
+        std::uint16_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    else if constexpr (Bytes == 3)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16);
+    }
+    else
+    {
+        std::uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+}
+
+template <std::size_t Bytes>
+void store_pixel(std::uint8_t *p, std::uint32_t value)
+{
+    if constexpr (Bytes == 1)
+    {
+        *p = static_cast<std::uint8_t>(value);
+    }
+    else if constexpr (Bytes == 2)
+    {
+        const auto narrow = static_cast<std::uint16_t>(value);
+        std::memcpy(p, &narrow, sizeof(narrow));
+    }
+    else if constexpr (Bytes == 3)
+    {
+        p[0] = static_cast<std::uint8_t>(value);
+        p[1] = static_cast<std::uint8_t>(value >> 8);
+        p[2] = static_cast<std::uint8_t>(value >> 16);
+    }
+    else
+    {
+        std::memcpy(p, &value, sizeof(value));
+    }
+}
+
+// only the colour bits take part in key comparisons, the spare bit of 555 and the X of X8R8G8B8 are undefined
+std::uint32_t color_mask(pixel_format format)
+{
+    switch (format)
+    {
+        case pixel_format::rgb555: return 0x7fff;
+        case pixel_format::rgb565: return 0xffff;
+        case pixel_format::rgb888: return 0xffffff;
+        case pixel_format::argb8888: return 0xffffff;
+        case pixel_format::indexed8: return 0xff;
+    }
+    return 0xffffffff;
+}
+
+struct blt_job
+{
+    const raster_surface &dst;
+    const raster_surface &src;
+    raster_rect dst_rect;
+    raster_rect src_rect;
+    const raster_color_key *key;
+    std::uint32_t mask;
+    // null unless they describe src for key
+    const raster_span_table *spans;
+};
+
+std::uint8_t *pixel_at(const raster_surface &surface, std::int32_t x, std::int32_t y, std::size_t bytes)
+{
+    return surface.pixels + y * surface.pitch + x * static_cast<std::ptrdiff_t>(bytes);
+}
+
+template <std::size_t Bytes>
+void keyed_row(
+    std::uint8_t *dst,
+    const std::uint8_t *src,
+    std::int32_t width,
+    const raster_color_key &key,
+    std::uint32_t mask)
+{
+    for (std::int32_t x = 0; x < width; ++x, dst += Bytes, src += Bytes)
+    {
+        const auto value = load_pixel<Bytes>(src);
+        const auto colour = value & mask;
+        if (colour < key.low || colour > key.high)
+        {
+            store_pixel<Bytes>(dst, value);
+        }
+    }
+}
+
+#if BLOCKS_X86
+
+// single key value (low == high) rows, compare a vector of pixels against the key and blend with what's there
+
+BLOCKS_TARGET_SSE2 std::int32_t keyed_row_32_sse2(
+    std::uint8_t *dst,
+    const std::uint8_t *src,
+    std::int32_t width,
+    std::uint32_t key,
+    std::uint32_t mask)
+{
+    const auto key_v = _mm_set1_epi32(static_cast<int>(key));
+    const auto mask_v = _mm_set1_epi32(static_cast<int>(mask));
+
+    std::int32_t x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const auto s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+        const auto d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + x * 4));
+        const auto transparent = _mm_cmpeq_epi32(_mm_and_si128(s, mask_v), key_v);
+        const auto out = _mm_or_si128(_mm_and_si128(transparent, d), _mm_andnot_si128(transparent, s));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), out);
+    }
+    return x;
+}
+
+BLOCKS_TARGET_AVX2 std::int32_t keyed_row_32_avx2(
+    std::uint8_t *dst,
+    const std::uint8_t *src,
+    std::int32_t width,
+    std::uint32_t key,
+    std::uint32_t mask)
+{
+    const auto key_v = _mm256_set1_epi32(static_cast<int>(key));
+    const auto mask_v = _mm256_set1_epi32(static_cast<int>(mask));
+
+    std::int32_t x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const auto s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 4));
+        const auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + x * 4));
+        const auto transparent = _mm256_cmpeq_epi32(_mm256_and_si256(s, mask_v), key_v);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 4), _mm256_blendv_epi8(s, d, transparent));
+    }
+    return x;
+}
+
+BLOCKS_TARGET_SSE2 std::int32_t keyed_row_16_sse2(
+    std::uint8_t *dst,
+    const std::uint8_t *src,
+    std::int32_t width,
+    std::uint32_t key,
+    std::uint32_t mask)
+{
+    const auto key_v = _mm_set1_epi16(static_cast<short>(key));
+    const auto mask_v = _mm_set1_epi16(static_cast<short>(mask));
+
+    std::int32_t x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const auto s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2));
+        const auto d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + x * 2));
+        const auto transparent = _mm_cmpeq_epi16(_mm_and_si128(s, mask_v), key_v);
+        const auto out = _mm_or_si128(_mm_and_si128(transparent, d), _mm_andnot_si128(transparent, s));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 2), out);
+    }
+    return x;
+}
+
+// every byte is an index and the mask is 0xff, so there's nothing to mask off
+BLOCKS_TARGET_SSE2 std::int32_t keyed_row_8_sse2(
+    std::uint8_t *dst,
+    const std::uint8_t *src,
+    std::int32_t width,
+    std::uint32_t key)
+{
+    const auto key_v = _mm_set1_epi8(static_cast<char>(key));
+
+    std::int32_t x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        const auto s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+        const auto d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + x));
+        const auto transparent = _mm_cmpeq_epi8(s, key_v);
+        const auto out = _mm_or_si128(_mm_and_si128(transparent, d), _mm_andnot_si128(transparent, s));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), out);
+    }
+    return x;
+}
+
+BLOCKS_TARGET_AVX2 std::int32_t keyed_row_8_avx2(
+    std::uint8_t *dst,
+    const std::uint8_t *src,
+    std::int32_t width,
+    std::uint32_t key)
+{
+    const auto key_v = _mm256_set1_epi8(static_cast<char>(key));
+
+    std::int32_t x = 0;
+    for (; x + 32 <= width; x += 32)
+    {
+        const auto s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x));
+        const auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + x));
+        const auto transparent = _mm256_cmpeq_epi8(s, key_v);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_blendv_epi8(s, d, transparent));
+    }
+    return x;
+}
+
+#endif
+
+// keyed copy of a row, the vector paths handle the bulk of the common single-value key and return how far they got
+template <std::size_t Bytes>
+void keyed_row_fast(
+    std::uint8_t *dst,
+    const std::uint8_t *src,
+    std::int32_t width,
+    const raster_color_key &key,
+    std::uint32_t mask)
+{
+    std::int32_t done = 0;
+
+#if BLOCKS_X86
+    if (key.low == key.high)
+    {
+        static const auto level = detect_simd_level();
+
+        if constexpr (Bytes == 4)
+        {
+            if (level >= simd_level::avx2)
+            {
+                done = keyed_row_32_avx2(dst, src, width, key.low, mask);
+            }
+            else if (level >= simd_level::sse2)
+            {
+                done = keyed_row_32_sse2(dst, src, width, key.low, mask);
+            }
+        }
+        else if constexpr (Bytes == 2)
+        {
+            if (level >= simd_level::sse2)
+            {
+                done = keyed_row_16_sse2(dst, src, width, key.low, mask);
+            }
+        }
+        else if constexpr (Bytes == 1)
+        {
+            if (level >= simd_level::avx2)
+            {
+                done = keyed_row_8_avx2(dst, src, width, key.low);
+            }
+            else if (level >= simd_level::sse2)
+            {
+                done = keyed_row_8_sse2(dst, src, width, key.low);
+            }
+        }
+    }
+#endif
+
+    keyed_row<Bytes>(dst + done * Bytes, src + done * Bytes, width - done, key, mask);
+}
+
+// keyed copy of width pixels starting at src_x of one source row, only the opaque runs are touched
+template <std::size_t Bytes>
+void span_row(
+    std::uint8_t *dst,
+    const std::uint8_t *src,
+    std::int32_t src_x,
+    std::int32_t width,
+    std::span<const raster_span> spans)
+{
+    const auto begin = static_cast<std::uint32_t>(src_x);
+    const auto end = begin + static_cast<std::uint32_t>(width);
+
+    // first run that ends past the start of the copy
+    auto run = std::ranges::lower_bound(
+        spans,
+        begin + 1,
+        {},
+        [](const raster_span &span) { return span.start + span.length; });
+
+    for (; run != spans.end() && run->start < end; ++run)
+    {
+        const auto first = std::max(run->start, begin);
+        const auto last = std::min(run->start + run->length, end);
+        std::memcpy(dst + (first - begin) * Bytes, src + (first - begin) * Bytes, (last - first) * Bytes);
+    }
+}
+
+// 1:1 copy of the part of the blit that lands in piece
+template <std::size_t Bytes>
+void copy_piece(const blt_job &job, const raster_rect &piece)
+{
+    const auto width = piece.right - piece.left;
+    const auto height = piece.bottom - piece.top;
+    const auto src_x = job.src_rect.left + (piece.left - job.dst_rect.left);
+    const auto src_y = job.src_rect.top + (piece.top - job.dst_rect.top);
+
+    // blitting a surface onto itself (scrolling) must not read rows it already overwrote
+    const auto same_surface = job.dst.pixels == job.src.pixels;
+    const auto bottom_up = same_surface && src_y < piece.top;
+
+    for (std::int32_t i = 0; i < height; ++i)
+    {
+        const auto row = bottom_up ? height - 1 - i : i;
+        auto *d = pixel_at(job.dst, piece.left, piece.top + row, Bytes);
+        const auto *s = pixel_at(job.src, src_x, src_y + row, Bytes);
+
+        if (job.key == nullptr)
+        {
+            std::memmove(d, s, static_cast<std::size_t>(width) * Bytes);
+        }
+        else if (job.spans != nullptr && !same_surface)
+        {
+            const auto y = static_cast<std::uint32_t>(src_y + row);
+            const auto spans = std::span{job.spans->spans}.subspan(
+                job.spans->rows[y],
+                job.spans->rows[y + 1] - job.spans->rows[y]);
+            span_row<Bytes>(d, s, src_x, width, spans);
+        }
+        else if (same_surface && d > s && d < s + width * Bytes)
+        {
+            // overlapping keyed copy to the right, walk the row backwards
+            for (auto x = width - 1; x >= 0; --x)
+            {
+                keyed_row<Bytes>(d + x * Bytes, s + x * Bytes, 1, *job.key, job.mask);
+            }
+        }
+        else
+        {
+            keyed_row_fast<Bytes>(d, s, width, *job.key, job.mask);
+        }
+    }
+}
+
+// nearest neighbour stretch, sampling at pixel centres with 16.16 fixed point steps
+template <std::size_t Bytes>
+void stretch_piece(const blt_job &job, const raster_rect &piece)
+{
+    const auto dst_w = static_cast<std::uint64_t>(job.dst_rect.right - job.dst_rect.left);
+    const auto dst_h = static_cast<std::uint64_t>(job.dst_rect.bottom - job.dst_rect.top);
+    const auto src_w = static_cast<std::uint64_t>(job.src_rect.right - job.src_rect.left);
+    const auto src_h = static_cast<std::uint64_t>(job.src_rect.bottom - job.src_rect.top);
+
+    const auto step_x = (src_w << 16) / dst_w;
+    const auto step_y = (src_h << 16) / dst_h;
+
+    const auto start_x = static_cast<std::uint64_t>(piece.left - job.dst_rect.left) * step_x + step_x / 2;
+    auto fy = static_cast<std::uint64_t>(piece.top - job.dst_rect.top) * step_y + step_y / 2;
+
+    const auto width = piece.right - piece.left;
+
+    for (auto y = piece.top; y < piece.bottom; ++y, fy += step_y)
+    {
+        const auto sy = job.src_rect.top + static_cast<std::int32_t>(std::min(fy >> 16, src_h - 1));
+        const auto *s = pixel_at(job.src, job.src_rect.left, sy, Bytes);
+        auto *d = pixel_at(job.dst, piece.left, y, Bytes);
+
+        auto fx = start_x;
+        for (std::int32_t x = 0; x < width; ++x, fx += step_x, d += Bytes)
+        {
+            const auto sx = std::min(fx >> 16, src_w - 1);
+            const auto value = load_pixel<Bytes>(s + sx * Bytes);
+
+            if (job.key != nullptr)
+            {
+                const auto colour = value & job.mask;
+                if (colour >= job.key->low && colour <= job.key->high)
+                {
+                    continue;
+                }
+            }
+
+            store_pixel<Bytes>(d, value);
+        }
+    }
+}
+
+template <std::size_t Bytes>
+void run_piece(const blt_job &job, const raster_rect &piece)
+{
+    const auto stretched = job.dst_rect.right - job.dst_rect.left != job.src_rect.right - job.src_rect.left ||
+                           job.dst_rect.bottom - job.dst_rect.top != job.src_rect.bottom - job.src_rect.top;
+
+    if (stretched)
+    {
+        stretch_piece<Bytes>(job, piece);
+    }
+    else
+    {
+        copy_piece<Bytes>(job, piece);
+    }
+}
+
+template <std::size_t Bytes>
+void fill_piece(const raster_surface &dst, const raster_rect &piece, std::uint32_t color)
+{
+    for (auto y = piece.top; y < piece.bottom; ++y)
+    {
+        auto *d = pixel_at(dst, piece.left, y, Bytes);
+
+        if constexpr (Bytes == 4)
+        {
+            std::fill_n(reinterpret_cast<std::uint32_t *>(d), piece.right - piece.left, color);
+        }
+        else if constexpr (Bytes == 1)
+        {
+            std::memset(d, static_cast<std::uint8_t>(color), static_cast<std::size_t>(piece.right - piece.left));
+        }
+        else if constexpr (Bytes == 2)
+        {
+            const auto narrow = static_cast<std::uint16_t>(color);
+            std::fill_n(reinterpret_cast<std::uint16_t *>(d), piece.right - piece.left, narrow);
+        }
+        else
+        {
+            for (auto x = piece.left; x < piece.right; ++x, d += Bytes)
+            {
+                store_pixel<Bytes>(d, color);
+            }
+        }
+    }
+}
+
+template <std::size_t Bytes>
+void build_spans(const raster_surface &surface, raster_span_table &table)
+{
+    const auto mask = color_mask(surface.format);
+
+    for (std::uint32_t y = 0; y < surface.height; ++y)
+    {
+        const auto *row = surface.pixels + static_cast<std::ptrdiff_t>(y) * surface.pitch;
+
+        std::uint32_t x = 0;
+        while (x < surface.width)
+        {
+            const auto transparent = [&](std::uint32_t at)
+            {
+                const auto colour = load_pixel<Bytes>(row + at * Bytes) & mask;
+                return colour >= table.key.low && colour <= table.key.high;
+            };
+
+            while (x < surface.width && transparent(x))
+            {
+                ++x;
+            }
+
+            const auto start = x;
+            while (x < surface.width && !transparent(x))
+            {
+                ++x;
+            }
+
+            if (x > start)
+            {
+                table.spans.push_back({start, x - start});
+            }
+        }
+
+        table.rows.push_back(static_cast<std::uint32_t>(table.spans.size()));
+    }
+}
+
+raster_rect surface_rect(const raster_surface &surface)
+{
+    return {0, 0, static_cast<std::int32_t>(surface.width), static_cast<std::int32_t>(surface.height)};
+}
+
+// call fn for every non-empty piece of area left after clipping to the surface and the clip list
+template <class F>
+void for_each_piece(const raster_surface &dst, const raster_rect &area, std::span<const raster_rect> clip_list, F &&fn)
+{
+    const auto bounded = raster_intersect(area, surface_rect(dst));
+    if (raster_rect_empty(bounded))
+    {
+        return;
+    }
+
+    if (clip_list.empty())
+    {
+        fn(bounded);
+        return;
+    }
+
+    for (const auto &clip : clip_list)
+    {
+        const auto piece = raster_intersect(bounded, clip);
+        if (!raster_rect_empty(piece))
+        {
+            fn(piece);
+        }
+    }
+}
+
+bool contains(const raster_rect &outer, const raster_rect &inner)
+{
+    return inner.left >= outer.left && inner.top >= outer.top && inner.right <= outer.right &&
+           inner.bottom <= outer.bottom;
+}
+
+}
+
+std::uint32_t bytes_per_pixel(pixel_format format)
+{
+    switch (format)
+    {
+        case pixel_format::rgb555: return 2;
+        case pixel_format::rgb565: return 2;
+        case pixel_format::rgb888: return 3;
+        case pixel_format::argb8888: return 4;
+        case pixel_format::indexed8: return 1;
+    }
+    return 0;
+}
+
+bool raster_rect_empty(const raster_rect &rect)
+{
+    return rect.right <= rect.left || rect.bottom <= rect.top;
+}
+
+raster_rect raster_intersect(const raster_rect &a, const raster_rect &b)
+{
+    return {
+        std::max(a.left, b.left),
+        std::max(a.top, b.top),
+        std::min(a.right, b.right),
+        std::min(a.bottom, b.bottom),
+    };
+}
+
+bool raster_blt(
+    const raster_surface &dst,
+    const raster_rect *dst_rect,
+    const raster_surface &src,
+    const raster_rect *src_rect,
+    const raster_blt_options &options)
+{
+    if (dst.format != src.format)
+    {
+        return false;
+    }
+
+    // spans built for another key or another surface would copy the wrong pixels, those blits test every pixel
+    const auto *spans = options.source_spans;
+    if (spans != nullptr &&
+        (options.source_key == nullptr || spans->width != src.width || spans->height != src.height ||
+         spans->key.low != options.source_key->low || spans->key.high != options.source_key->high))
+    {
+        spans = nullptr;
+    }
+
+    const blt_job job{
+        .dst = dst,
+        .src = src,
+        .dst_rect = dst_rect != nullptr ? *dst_rect : surface_rect(dst),
+        .src_rect = src_rect != nullptr ? *src_rect : surface_rect(src),
+        .key = options.source_key,
+        .mask = color_mask(src.format),
+        .spans = spans,
+    };
+
+    // like DirectDraw the source has to be inside its surface, only the destination gets clipped
+    if (raster_rect_empty(job.dst_rect) || raster_rect_empty(job.src_rect) ||
+        !contains(surface_rect(src), job.src_rect))
+    {
+        return false;
+    }
+
+    for_each_piece(
+        dst,
+        job.dst_rect,
+        options.clip_list,
+        [&](const raster_rect &piece)
+        {
+            switch (bytes_per_pixel(dst.format))
+            {
+                case 1: run_piece<1>(job, piece); break;
+                case 2: run_piece<2>(job, piece); break;
+                case 3: run_piece<3>(job, piece); break;
+                case 4: run_piece<4>(job, piece); break;
+            }
+        });
+
+    return true;
+}
+
+bool raster_blt_fast(
+    const raster_surface &dst,
+    std::int32_t x,
+    std::int32_t y,
+    const raster_surface &src,
+    const raster_rect *src_rect,
+    const raster_color_key *source_key,
+    const raster_span_table *source_spans)
+{
+    const auto source = src_rect != nullptr ? *src_rect : surface_rect(src);
+    const raster_rect dst_rect{x, y, x + (source.right - source.left), y + (source.bottom - source.top)};
+
+    return raster_blt(dst, &dst_rect, src, &source, {.source_key = source_key, .source_spans = source_spans});
+}
+
+raster_span_table raster_build_spans(const raster_surface &surface, const raster_color_key &key)
+{
+    raster_span_table table{.width = surface.width, .height = surface.height, .key = key};
+    table.rows.reserve(surface.height + 1);
+    table.rows.push_back(0);
+
+    switch (bytes_per_pixel(surface.format))
+    {
+        case 1: build_spans<1>(surface, table); break;
+        case 2: build_spans<2>(surface, table); break;
+        case 3: build_spans<3>(surface, table); break;
+        case 4: build_spans<4>(surface, table); break;
+    }
+
+    return table;
+}
+
+bool raster_fill(
+    const raster_surface &dst,
+    const raster_rect *dst_rect,
+    std::uint32_t color,
+    std::span<const raster_rect> clip_list)
+{
+    const auto area = dst_rect != nullptr ? *dst_rect : surface_rect(dst);
+    if (raster_rect_empty(area))
+    {
+        return false;
+    }
+
+    for_each_piece(
+        dst,
+        area,
+        clip_list,
+        [&](const raster_rect &piece)
+        {
+            switch (bytes_per_pixel(dst.format))
+            {
+                case 1: fill_piece<1>(dst, piece, color); break;
+                case 2: fill_piece<2>(dst, piece, color); break;
+                case 3: fill_piece<3>(dst, piece, color); break;
+                case 4: fill_piece<4>(dst, piece, color); break;
+            }
+        });
+
+    return true;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// cpu implementation of the Blt/BltFast subset the game uses, for surfaces living in system memory
+
+// the 15/16/24/32 bit rgb layouts SetColorKey_hook knows about, plus 8 bit palette indices for the indexed back
+// buffer mode, where a colour key is an index
+enum class pixel_format
+{
+    rgb555,
+    rgb565,
+    rgb888,
+    argb8888,
+    indexed8
+};
+
+std::uint32_t bytes_per_pixel(pixel_format format);
+
+// same layout as RECT, right/bottom are exclusive
+struct raster_rect
+{
+    std::int32_t left;
+    std::int32_t top;
+    std::int32_t right;
+    std::int32_t bottom;
+};
+
+struct raster_surface
+{
+    std::uint8_t *pixels;
+    std::ptrdiff_t pitch;
+    std::uint32_t width;
+    std::uint32_t height;
+    pixel_format format;
+};
+
+// a source colour key, a pixel is transparent when low <= value <= high (usually low == high)
+struct raster_color_key
+{
+    std::uint32_t low;
+    std::uint32_t high;
+};
+
+// the opaque runs of every row of a colour keyed surface, so a keyed blit out of it can copy whole runs and skip the
+// transparent ones without testing a single pixel, only valid while the surface's pixels and key stay the same
+struct raster_span
+{
+    std::uint32_t start;
+    std::uint32_t length;
+};
+
+struct raster_span_table
+{
+    std::uint32_t width{};
+    std::uint32_t height{};
+    raster_color_key key{};
+    // the spans of row y are spans[rows[y]] up to spans[rows[y + 1]], left to right
+    std::vector<std::uint32_t> rows{};
+    std::vector<raster_span> spans{};
+};
+
+struct raster_blt_options
+{
+    // destination clip list in surface coordinates, empty means clip to the surface only
+    std::span<const raster_rect> clip_list{};
+    const raster_color_key *source_key{};
+    // spans of the source for source_key, used by unstretched blits when they match the source's size and key
+    const raster_span_table *source_spans{};
+};
+
+bool raster_rect_empty(const raster_rect &rect);
+
+raster_rect raster_intersect(const raster_rect &a, const raster_rect &b);
+
+// Blt: copy src_rect to dst_rect, stretching with nearest neighbour if the sizes differ
+// null rects mean the whole surface, returns false if the rects are invalid or the formats don't match
+bool raster_blt(
+    const raster_surface &dst,
+    const raster_rect *dst_rect,
+    const raster_surface &src,
+    const raster_rect *src_rect,
+    const raster_blt_options &options = {});
+
+// BltFast: unstretched copy of src_rect to (x, y)
+bool raster_blt_fast(
+    const raster_surface &dst,
+    std::int32_t x,
+    std::int32_t y,
+    const raster_surface &src,
+    const raster_rect *src_rect,
+    const raster_color_key *source_key = nullptr,
+    const raster_span_table *source_spans = nullptr);
+
+// scan a surface for the runs of pixels outside key
+raster_span_table raster_build_spans(const raster_surface &surface, const raster_color_key &key);
+
+// DDBLT_COLORFILL: fill dst_rect (or the whole surface) with a raw pixel value
+bool raster_fill(
+    const raster_surface &dst,
+    const raster_rect *dst_rect,
+    std::uint32_t color,
+    std::span<const raster_rect> clip_list = {});
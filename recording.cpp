@@ -0,0 +1,385 @@
+#include "recording.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+
+// an unchanged stretch shorter than this is cheaper to carry along with the literals than to start a new pair for
+constexpr std::size_t min_skip = 4;
+
+void put_count(std::vector<std::uint8_t> &out, std::uint64_t count)
+{
+    while (count >= 0x80)
+    {
+        out.push_back(static_cast<std::uint8_t>(count | 0x80));
+        count >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(count));
+}
+
+bool read_count(std::span<const std::uint8_t> bytes, std::size_t &at, std::uint64_t &count)
+{
+    count = 0;
+    for (auto shift = 0; shift < 64; shift += 7)
+    {
+        if (at >= bytes.size())
+        {
+            return false;
+        }
+
+        const auto byte = bytes[at++];
+        count |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// write one frame against the one before it, caller holds the mutex
+void encode_frame(frame_recorder &recorder, recording_buffer &buffer)
+{
+    const auto keyframe = recorder.keyframe_interval != 0 ? recorder.encoded % recorder.keyframe_interval == 0
+                                                          : recorder.encoded == 0;
+    if (keyframe)
+    {
+        std::ranges::fill(recorder.previous, 0);
+        recorder.previous_palette = {};
+    }
+
+    recorder.palette_changes.clear();
+    if (recorder.format == pixel_format::indexed8)
+    {
+        for (std::size_t i = 0; i < buffer.palette.size(); ++i)
+        {
+            const auto &now = buffer.palette[i];
+            const auto &before = recorder.previous_palette[i];
+            if (now.red != before.red || now.green != before.green || now.blue != before.blue)
+            {
+                recorder.palette_changes.push_back({static_cast<std::uint8_t>(i), now.red, now.green, now.blue});
+            }
+        }
+    }
+
+    recorder.payload.clear();
+    recording_delta(recorder.previous, buffer.pixels, recorder.payload);
+
+    const recording_frame_header header{
+        .frame = buffer.frame,
+        .flags = keyframe ? recording_keyframe : 0,
+        .palette_changes = static_cast<std::uint32_t>(recorder.palette_changes.size()),
+        .payload_bytes = static_cast<std::uint32_t>(recorder.payload.size()),
+        .reserved = 0};
+    std::fwrite(&header, sizeof(header), 1, recorder.file);
+    if (!recorder.palette_changes.empty())
+    {
+        std::fwrite(
+            recorder.palette_changes.data(),
+            sizeof(recording_palette_change),
+            recorder.palette_changes.size(),
+            recorder.file);
+    }
+    std::fwrite(recorder.payload.data(), 1, recorder.payload.size(), recorder.file);
+
+    // the buffer is refilled whole by the next submit, so it can have the old frame
+    std::swap(recorder.previous, buffer.pixels);
+    recorder.previous_palette = buffer.palette;
+    ++recorder.encoded;
+}
+
+// encode everything submitted so far, caller holds the mutex
+void encode_pending(frame_recorder &recorder)
+{
+    auto tail = recorder.tail.load(std::memory_order_relaxed);
+    const auto head = recorder.head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail)
+    {
+        encode_frame(recorder, recorder.buffers[tail % recorder.buffers.size()]);
+        recorder.tail.store(tail + 1, std::memory_order_release);
+    }
+}
+
+}
+
+bool recording_start(
+    frame_recorder &recorder,
+    const char *path,
+    std::uint32_t width,
+    std::uint32_t height,
+    pixel_format format,
+    std::uint32_t buffers,
+    std::uint32_t keyframe_interval)
+{
+    std::lock_guard lock{recorder.mutex};
+    if (recorder.file != nullptr)
+    {
+        return true;
+    }
+
+    recorder.file = std::fopen(path, "wb");
+    if (recorder.file == nullptr)
+    {
+        return false;
+    }
+    std::setvbuf(recorder.file, nullptr, _IOFBF, 1 << 20);
+
+    recorder.width = width;
+    recorder.height = height;
+    recorder.format = format;
+    recorder.row_bytes = static_cast<std::size_t>(width) * bytes_per_pixel(format);
+    recorder.keyframe_interval = keyframe_interval;
+
+    const auto frame_bytes = recorder.row_bytes * height;
+    recorder.buffers.resize(std::max(buffers, 1u));
+    for (auto &buffer : recorder.buffers)
+    {
+        buffer.pixels.assign(frame_bytes, 0);
+    }
+    recorder.previous.assign(frame_bytes, 0);
+    recorder.previous_palette = {};
+    recorder.encoded = 0;
+
+    recording_file_header header{};
+    std::copy(std::begin(recording_magic), std::end(recording_magic), header.magic);
+    header.version = recording_version;
+    header.width = width;
+    header.height = height;
+    header.format = static_cast<std::uint32_t>(format);
+    header.keyframe_interval = keyframe_interval;
+    std::fwrite(&header, sizeof(header), 1, recorder.file);
+
+    recorder.head.store(0, std::memory_order_relaxed);
+    recorder.tail.store(0, std::memory_order_relaxed);
+    recorder.dropped.store(0, std::memory_order_relaxed);
+    recorder.running.store(true, std::memory_order_release);
+    return true;
+}
+
+bool recording_submit(
+    frame_recorder &recorder,
+    const raster_surface &frame,
+    std::span<const palette_entry, 256> palette,
+    std::uint64_t number)
+{
+    if (!recorder.running.load(std::memory_order_acquire) || frame.width != recorder.width ||
+        frame.height != recorder.height || frame.format != recorder.format)
+    {
+        return false;
+    }
+
+    const auto head = recorder.head.load(std::memory_order_relaxed);
+    const auto tail = recorder.tail.load(std::memory_order_acquire);
+    if (head - tail >= recorder.buffers.size())
+    {
+        recorder.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    auto &buffer = recorder.buffers[head % recorder.buffers.size()];
+    if (frame.pitch == static_cast<std::ptrdiff_t>(recorder.row_bytes))
+    {
+        std::memcpy(buffer.pixels.data(), frame.pixels, recorder.row_bytes * frame.height);
+    }
+    else
+    {
+        for (std::uint32_t y = 0; y < frame.height; ++y)
+        {
+            std::memcpy(
+                buffer.pixels.data() + y * recorder.row_bytes,
+                frame.pixels + static_cast<std::ptrdiff_t>(y) * frame.pitch,
+                recorder.row_bytes);
+        }
+    }
+    std::ranges::copy(palette, buffer.palette.begin());
+    buffer.frame = number;
+
+    recorder.head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+void recording_encoder_loop(frame_recorder &recorder)
+{
+    while (recorder.running.load(std::memory_order_acquire))
+    {
+        {
+            std::lock_guard lock{recorder.mutex};
+            if (recorder.file != nullptr)
+            {
+                encode_pending(recorder);
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds{5});
+    }
+}
+
+void recording_stop(frame_recorder &recorder)
+{
+    recorder.running.store(false, std::memory_order_release);
+
+    // like trace_stop, the encoder may have been killed holding the lock at process exit, so only wait for it
+    // briefly and lose the frames still waiting rather than hang the game on the way out
+    std::unique_lock lock{recorder.mutex, std::defer_lock};
+    for (auto attempt = 0; attempt < 100 && !lock.try_lock(); ++attempt)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+
+    if (!lock.owns_lock() || recorder.file == nullptr)
+    {
+        return;
+    }
+
+    encode_pending(recorder);
+    std::fclose(recorder.file);
+    recorder.file = nullptr;
+}
+
+void recording_delta(
+    std::span<const std::uint8_t> previous,
+    std::span<const std::uint8_t> current,
+    std::vector<std::uint8_t> &out)
+{
+    const auto size = current.size();
+    for (std::size_t at = 0; at < size;)
+    {
+        // most of a frame is the same as the one before, so skip through that a word at a time
+        auto same = at;
+        while (same + 8 <= size && std::memcmp(previous.data() + same, current.data() + same, 8) == 0)
+        {
+            same += 8;
+        }
+        while (same < size && previous[same] == current[same])
+        {
+            ++same;
+        }
+
+        // literals up to the next unchanged stretch that's worth a pair of its own
+        auto end = same;
+        while (end < size)
+        {
+            if (previous[end] != current[end])
+            {
+                ++end;
+                continue;
+            }
+
+            auto run = end;
+            while (run < size && run - end < min_skip && previous[run] == current[run])
+            {
+                ++run;
+            }
+            if (run - end >= min_skip || run == size)
+            {
+                break;
+            }
+            end = run;
+        }
+
+        put_count(out, same - at);
+        put_count(out, end - same);
+        out.insert(out.end(), current.begin() + static_cast<std::ptrdiff_t>(same), current.begin() + end);
+        at = end;
+    }
+}
+
+bool recording_apply_delta(std::span<const std::uint8_t> payload, std::span<std::uint8_t> frame)
+{
+    std::size_t at = 0;
+    std::size_t position = 0;
+    while (at < payload.size())
+    {
+        std::uint64_t skip{};
+        std::uint64_t copy{};
+        if (!read_count(payload, at, skip) || !read_count(payload, at, copy) || skip > frame.size() - position)
+        {
+            return false;
+        }
+        position += skip;
+
+        if (copy > frame.size() - position || copy > payload.size() - at)
+        {
+            return false;
+        }
+        std::memcpy(frame.data() + position, payload.data() + at, copy);
+        position += copy;
+        at += copy;
+    }
+    return position == frame.size();
+}
+
+bool recording_open(recording_reader &reader, const char *path)
+{
+    reader.file.open(path, std::ios::binary);
+    if (!reader.file.read(reinterpret_cast<char *>(&reader.header), sizeof(reader.header)))
+    {
+        return false;
+    }
+
+    const auto &header = reader.header;
+    if (!std::equal(std::begin(recording_magic), std::end(recording_magic), header.magic) ||
+        header.version != recording_version || header.format > static_cast<std::uint32_t>(pixel_format::indexed8) ||
+        header.width == 0 || header.height == 0 || header.width > 16384 || header.height > 16384)
+    {
+        return false;
+    }
+
+    const auto format = static_cast<pixel_format>(header.format);
+    reader.row_bytes = static_cast<std::size_t>(header.width) * bytes_per_pixel(format);
+    reader.pixels.assign(reader.row_bytes * header.height, 0);
+    reader.palette = {};
+    return true;
+}
+
+bool recording_read_frame(recording_reader &reader)
+{
+    auto &frame = reader.frame;
+    if (!reader.file.read(reinterpret_cast<char *>(&frame), sizeof(frame)))
+    {
+        return false;
+    }
+
+    // a delta never needs more than two bytes of counts per literal it carries
+    if (frame.palette_changes > 256 || frame.payload_bytes > reader.pixels.size() * 2 + 16)
+    {
+        return false;
+    }
+
+    if (frame.flags & recording_keyframe)
+    {
+        std::ranges::fill(reader.pixels, 0);
+        reader.palette = {};
+    }
+
+    for (std::uint32_t i = 0; i < frame.palette_changes; ++i)
+    {
+        recording_palette_change change{};
+        if (!reader.file.read(reinterpret_cast<char *>(&change), sizeof(change)))
+        {
+            return false;
+        }
+        reader.palette[change.index] = {change.red, change.green, change.blue, 0};
+    }
+
+    reader.payload.resize(frame.payload_bytes);
+    if (!reader.file.read(reinterpret_cast<char *>(reader.payload.data()), frame.payload_bytes))
+    {
+        return false;
+    }
+    return recording_apply_delta(reader.payload, reader.pixels);
+}
+
+raster_surface recording_frame_view(recording_reader &reader)
+{
+    return {
+        reader.pixels.data(),
+        static_cast<std::ptrdiff_t>(reader.row_bytes),
+        reader.header.width,
+        reader.header.height,
+        static_cast<pixel_format>(reader.header.format)};
+}
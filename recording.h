@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "palette_convert.h"
+#include "raster.h"
+
+// session recording for QA and support
+// Flip copies each finished frame into the next free buffer of a fixed ring and an encoder thread writes it to a file
+// as the bytes that changed since the frame before, 8 bit frames along with the palette entries that changed, so a
+// session costs the game thread one copy of the back buffer per frame and the disk a few kb for most frames
+// the game never waits for the encoder, a frame that finds every buffer still waiting to be encoded is dropped
+// blocks_recording_export turns a recording into png files
+
+// file layout: recording_file_header, then per frame a recording_frame_header, its recording_palette_change entries
+// and its payload
+struct recording_file_header
+{
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t width;
+    std::uint32_t height;
+    // pixel_format of every frame
+    std::uint32_t format;
+    // recorded frames from one keyframe to the next
+    std::uint32_t keyframe_interval;
+};
+
+struct recording_frame_header
+{
+    // the game's frame number, gaps are frames dropped while the encoder was behind
+    std::uint64_t frame;
+    std::uint32_t flags;
+    std::uint32_t palette_changes;
+    std::uint32_t payload_bytes;
+    std::uint32_t reserved;
+};
+static_assert(sizeof(recording_frame_header) == 24);
+
+// the frame and its palette are against all zero ones rather than the frame before, so playback can start there
+inline constexpr std::uint32_t recording_keyframe = 1;
+
+// 8 bit frames only
+struct recording_palette_change
+{
+    std::uint8_t index;
+    std::uint8_t red;
+    std::uint8_t green;
+    std::uint8_t blue;
+};
+
+// payload: the frame's rows of width pixels packed without padding, as pairs of leb128 counts of bytes that are the
+// same as in the frame before and bytes that follow as they are, until the frame is covered
+
+inline constexpr char recording_magic[4]{'B', 'R', 'E', 'C'};
+inline constexpr std::uint32_t recording_version = 1;
+
+// one frame waiting to be encoded, packed rows and the palette at the time
+struct recording_buffer
+{
+    std::vector<std::uint8_t> pixels{};
+    std::array<palette_entry, 256> palette{};
+    std::uint64_t frame{};
+};
+
+struct frame_recorder
+{
+    std::uint32_t width{};
+    std::uint32_t height{};
+    pixel_format format{};
+    std::size_t row_bytes{};
+    std::uint32_t keyframe_interval{};
+
+    // buffers[n % size] is frame n of the ring, head is only written by the game thread and tail only by the encoder
+    std::vector<recording_buffer> buffers{};
+    alignas(64) std::atomic<std::uint64_t> head{};
+    alignas(64) std::atomic<std::uint64_t> tail{};
+    std::atomic<std::uint64_t> dropped{};
+    std::atomic<bool> running{};
+
+    // guards everything below, held by whoever is encoding, never taken by the game thread
+    std::mutex mutex{};
+    std::FILE *file{};
+    // what the next frame is a delta against
+    std::vector<std::uint8_t> previous{};
+    std::array<palette_entry, 256> previous_palette{};
+    std::uint64_t encoded{};
+    std::vector<std::uint8_t> payload{};
+    std::vector<recording_palette_change> palette_changes{};
+};
+
+// create path and size the ring for width x height frames in format, false if the file can't be created
+// nothing is encoded until recording_encoder_loop runs on a thread of its own
+bool recording_start(
+    frame_recorder &recorder,
+    const char *path,
+    std::uint32_t width,
+    std::uint32_t height,
+    pixel_format format,
+    std::uint32_t buffers,
+    std::uint32_t keyframe_interval = 600);
+
+// game thread: copy frame into the next free buffer, false if it was dropped or doesn't match the recording
+bool recording_submit(
+    frame_recorder &recorder,
+    const raster_surface &frame,
+    std::span<const palette_entry, 256> palette,
+    std::uint64_t number);
+
+// encode what was submitted every few milliseconds until recording_stop
+void recording_encoder_loop(frame_recorder &recorder);
+
+// encode whatever is still waiting and close the file, safe to call from DLL_PROCESS_DETACH
+void recording_stop(frame_recorder &recorder);
+
+// the delta of current against previous, same size, appended to out
+void recording_delta(
+    std::span<const std::uint8_t> previous,
+    std::span<const std::uint8_t> current,
+    std::vector<std::uint8_t> &out);
+
+// apply a delta to the frame before, false if it is damaged or doesn't cover the frame exactly
+bool recording_apply_delta(std::span<const std::uint8_t> payload, std::span<std::uint8_t> frame);
+
+// reading a recording back, frame by frame
+struct recording_reader
+{
+    std::ifstream file{};
+    recording_file_header header{};
+    std::size_t row_bytes{};
+
+    // the frame last read, packed rows, and the palette that goes with it
+    recording_frame_header frame{};
+    std::vector<std::uint8_t> pixels{};
+    std::array<palette_entry, 256> palette{};
+    std::vector<std::uint8_t> payload{};
+};
+
+// false if path isn't a recording this version can read
+bool recording_open(recording_reader &reader, const char *path);
+
+// the next frame on top of the one before, false at the end of the file or at a damaged frame
+bool recording_read_frame(recording_reader &reader);
+
+// the frame last read as a surface
+raster_surface recording_frame_view(recording_reader &reader);
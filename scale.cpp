@@ -0,0 +1,357 @@
+#include "scale.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+
+// pixel centre sampling in 16.16 fixed point: source position of destination column i is
+// (i + 0.5) * src / dst - 0.5, both kernels use it so a 2x nearest and a 2x bilinear line up
+std::int64_t sample_position(std::uint32_t i, std::uint32_t src_size, std::uint32_t dst_size)
+{
+    return ((2 * static_cast<std::int64_t>(i) + 1) * src_size << 16) / (2 * static_cast<std::int64_t>(dst_size)) -
+           0x8000;
+}
+
+// source index and 0..256 weight of the next pixel along for a bilinear tap, the last pixel is reached as the
+// second tap with full weight so reading index + 1 always stays inside the row
+void bilinear_tap(std::int64_t position, std::uint32_t src_size, std::uint32_t &index, std::uint32_t &weight)
+{
+    position = std::clamp<std::int64_t>(position, 0, static_cast<std::int64_t>(src_size - 1) << 16);
+    index = static_cast<std::uint32_t>(position >> 16);
+    weight = static_cast<std::uint32_t>((position >> 8) & 0xff);
+
+    if (index >= src_size - 1)
+    {
+        index = src_size - 2;
+        weight = 256;
+    }
+}
+
+bool rect_inside(const raster_rect &rect, const raster_surface &surface)
+{
+    return !raster_rect_empty(rect) && rect.left >= 0 && rect.top >= 0 &&
+           rect.right <= static_cast<std::int32_t>(surface.width) &&
+           rect.bottom <= static_cast<std::int32_t>(surface.height);
+}
+
+const std::uint32_t *row_at(const raster_surface &surface, std::int32_t x, std::int32_t y)
+{
+    return reinterpret_cast<const std::uint32_t *>(surface.pixels + y * surface.pitch) + x;
+}
+
+std::uint32_t *row_at_mut(const raster_surface &surface, std::int32_t x, std::int32_t y)
+{
+    return reinterpret_cast<std::uint32_t *>(surface.pixels + y * surface.pitch) + x;
+}
+
+// two channels at a time, each blend tops out at 255 * 256 so it never spills into the channel above
+std::uint32_t lerp_pixel(std::uint32_t a, std::uint32_t b, std::uint32_t weight)
+{
+    const auto inverse = 256 - weight;
+    const auto even = ((a & 0x00ff00ff) * inverse + (b & 0x00ff00ff) * weight) >> 8;
+    const auto odd = ((a >> 8) & 0x00ff00ff) * inverse + ((b >> 8) & 0x00ff00ff) * weight;
+    return (even & 0x00ff00ff) | (odd & 0xff00ff00);
+}
+
+// blend two source rows into one
+using vertical_kernel =
+    void (*)(const std::uint32_t *, const std::uint32_t *, std::uint32_t *, std::size_t, std::uint32_t);
+
+// resample one blended row to the destination width using the per column taps
+using horizontal_kernel =
+    void (*)(const std::uint32_t *, std::uint32_t *, std::size_t, const std::uint32_t *, const std::uint32_t *);
+
+void vertical_scalar(
+    const std::uint32_t *a,
+    const std::uint32_t *b,
+    std::uint32_t *out,
+    std::size_t count,
+    std::uint32_t weight)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        out[i] = lerp_pixel(a[i], b[i], weight);
+    }
+}
+
+void horizontal_scalar(
+    const std::uint32_t *row,
+    std::uint32_t *dst,
+    std::size_t count,
+    const std::uint32_t *index,
+    const std::uint32_t *weight)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        dst[i] = lerp_pixel(row[index[i]], row[index[i] + 1], weight[i]);
+    }
+}
+
+#if BLOCKS_X86
+
+// channels widened to 16 bits, a * (256 - w) + b * w tops out at 255 * 256 so it never leaves the lane
+BLOCKS_TARGET_SSE2 void vertical_sse2(
+    const std::uint32_t *a,
+    const std::uint32_t *b,
+    std::uint32_t *out,
+    std::size_t count,
+    std::uint32_t weight)
+{
+    const auto zero = _mm_setzero_si128();
+    const auto wa = _mm_set1_epi16(static_cast<short>(256 - weight));
+    const auto wb = _mm_set1_epi16(static_cast<short>(weight));
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const auto va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        const auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+
+        const auto lo = _mm_srli_epi16(
+            _mm_add_epi16(
+                _mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb)),
+            8);
+        const auto hi = _mm_srli_epi16(
+            _mm_add_epi16(
+                _mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb)),
+            8);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(lo, hi));
+    }
+    vertical_scalar(a + i, b + i, out + i, count - i, weight);
+}
+
+// one tap pair per pixel: interleave the two source pixels' channels (b0 b1 g0 g1 ...) so a single madd against
+// (256 - w, w) pairs produces every blended channel, two pixels per iteration
+BLOCKS_TARGET_SSE2 void horizontal_sse2(
+    const std::uint32_t *row,
+    std::uint32_t *dst,
+    std::size_t count,
+    const std::uint32_t *index,
+    const std::uint32_t *weight)
+{
+    const auto zero = _mm_setzero_si128();
+
+    const auto blend = [&](std::size_t i)
+    {
+        const auto pair = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(row + index[i]));
+        const auto channels = _mm_unpacklo_epi8(_mm_unpacklo_epi8(pair, _mm_srli_si128(pair, 4)), zero);
+        const auto weights = _mm_set1_epi32(static_cast<int>((weight[i] << 16) | (256 - weight[i])));
+        return _mm_srli_epi32(_mm_madd_epi16(channels, weights), 8);
+    };
+
+    std::size_t i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        const auto packed = _mm_packs_epi32(blend(i), blend(i + 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(packed, zero));
+    }
+    horizontal_scalar(row, dst + i, count - i, index + i, weight + i);
+}
+
+#endif
+
+struct bilinear_kernels
+{
+    vertical_kernel vertical;
+    horizontal_kernel horizontal;
+};
+
+bilinear_kernels kernels_for(simd_level level)
+{
+#if BLOCKS_X86
+    if (level >= simd_level::sse2)
+    {
+        return {vertical_sse2, horizontal_sse2};
+    }
+#endif
+    return {vertical_scalar, horizontal_scalar};
+}
+
+}
+
+raster_rect scale_layout(
+    scale_mode mode,
+    std::uint32_t src_width,
+    std::uint32_t src_height,
+    std::uint32_t dst_width,
+    std::uint32_t dst_height)
+{
+    auto width = src_width;
+    auto height = src_height;
+
+    const auto factor = std::min(dst_width / std::max(src_width, 1u), dst_height / std::max(src_height, 1u));
+
+    // an area smaller than the frame can't take a whole multiple, shrink it to fit instead
+    if (mode != scale_mode::off && mode != scale_mode::fit && factor >= 1)
+    {
+        width = src_width * factor;
+        height = src_height * factor;
+    }
+    else if (mode != scale_mode::off)
+    {
+        // whichever side runs out first decides the size
+        if (static_cast<std::uint64_t>(dst_width) * src_height <= static_cast<std::uint64_t>(dst_height) * src_width)
+        {
+            width = dst_width;
+            height = static_cast<std::uint32_t>(static_cast<std::uint64_t>(dst_width) * src_height / src_width);
+        }
+        else
+        {
+            height = dst_height;
+            width = static_cast<std::uint32_t>(static_cast<std::uint64_t>(dst_height) * src_width / src_height);
+        }
+    }
+    else
+    {
+        return {0, 0, static_cast<std::int32_t>(width), static_cast<std::int32_t>(height)};
+    }
+
+    const auto left = static_cast<std::int32_t>((dst_width - width) / 2);
+    const auto top = static_cast<std::int32_t>((dst_height - height) / 2);
+    return {left, top, left + static_cast<std::int32_t>(width), top + static_cast<std::int32_t>(height)};
+}
+
+bool scale_nearest(
+    const raster_surface &dst,
+    const raster_rect &dst_rect,
+    const raster_surface &src,
+    const raster_rect &src_rect)
+{
+    return scale_nearest_rows(dst, dst_rect, src, src_rect, 0, ~0u);
+}
+
+bool scale_nearest_rows(
+    const raster_surface &dst,
+    const raster_rect &dst_rect,
+    const raster_surface &src,
+    const raster_rect &src_rect,
+    std::uint32_t first_row,
+    std::uint32_t last_row)
+{
+    if (dst.format != pixel_format::argb8888 || src.format != pixel_format::argb8888 || !rect_inside(dst_rect, dst) ||
+        !rect_inside(src_rect, src))
+    {
+        return false;
+    }
+
+    const auto src_width = static_cast<std::uint32_t>(src_rect.right - src_rect.left);
+    const auto src_height = static_cast<std::uint32_t>(src_rect.bottom - src_rect.top);
+    const auto dst_width = static_cast<std::uint32_t>(dst_rect.right - dst_rect.left);
+    const auto dst_height = static_cast<std::uint32_t>(dst_rect.bottom - dst_rect.top);
+
+    std::vector<std::uint32_t> columns(dst_width);
+    for (std::uint32_t x = 0; x < dst_width; ++x)
+    {
+        columns[x] = static_cast<std::uint32_t>((2 * static_cast<std::uint64_t>(x) + 1) * src_width / (2 * dst_width));
+    }
+
+    std::uint32_t previous_row = ~0u;
+    for (auto y = first_row; y < std::min(last_row, dst_height); ++y)
+    {
+        const auto sy =
+            static_cast<std::uint32_t>((2 * static_cast<std::uint64_t>(y) + 1) * src_height / (2 * dst_height));
+        const auto dy = dst_rect.top + static_cast<std::int32_t>(y);
+        auto *out = row_at_mut(dst, dst_rect.left, dy);
+
+        // upscaling repeats each source row, copy the row we just built rather than resampling it again
+        if (sy == previous_row)
+        {
+            std::memcpy(out, row_at(dst, dst_rect.left, dy - 1), dst_width * sizeof(std::uint32_t));
+            continue;
+        }
+
+        const auto *in = row_at(src, src_rect.left, src_rect.top + static_cast<std::int32_t>(sy));
+        for (std::uint32_t x = 0; x < dst_width; ++x)
+        {
+            out[x] = in[columns[x]];
+        }
+        previous_row = sy;
+    }
+
+    return true;
+}
+
+bool scale_bilinear(
+    const raster_surface &dst,
+    const raster_rect &dst_rect,
+    const raster_surface &src,
+    const raster_rect &src_rect)
+{
+    return scale_bilinear_rows(dst, dst_rect, src, src_rect, 0, ~0u, detect_simd_level());
+}
+
+bool scale_bilinear(
+    const raster_surface &dst,
+    const raster_rect &dst_rect,
+    const raster_surface &src,
+    const raster_rect &src_rect,
+    simd_level level)
+{
+    return scale_bilinear_rows(dst, dst_rect, src, src_rect, 0, ~0u, level);
+}
+
+bool scale_bilinear_rows(
+    const raster_surface &dst,
+    const raster_rect &dst_rect,
+    const raster_surface &src,
+    const raster_rect &src_rect,
+    std::uint32_t first_row,
+    std::uint32_t last_row,
+    simd_level level)
+{
+    if (dst.format != pixel_format::argb8888 || src.format != pixel_format::argb8888 || !rect_inside(dst_rect, dst) ||
+        !rect_inside(src_rect, src))
+    {
+        return false;
+    }
+
+    const auto src_width = static_cast<std::uint32_t>(src_rect.right - src_rect.left);
+    const auto src_height = static_cast<std::uint32_t>(src_rect.bottom - src_rect.top);
+    const auto dst_width = static_cast<std::uint32_t>(dst_rect.right - dst_rect.left);
+    const auto dst_height = static_cast<std::uint32_t>(dst_rect.bottom - dst_rect.top);
+
+    // a single row or column has nothing to blend with
+    if (src_width < 2 || src_height < 2)
+    {
+        return scale_nearest_rows(dst, dst_rect, src, src_rect, first_row, last_row);
+    }
+
+    const auto kernels = kernels_for(std::min(level, detect_simd_level()));
+
+    std::vector<std::uint32_t> index(dst_width);
+    std::vector<std::uint32_t> weight(dst_width);
+    for (std::uint32_t x = 0; x < dst_width; ++x)
+    {
+        bilinear_tap(sample_position(x, src_width, dst_width), src_width, index[x], weight[x]);
+    }
+
+    std::vector<std::uint32_t> blended(src_width);
+    for (auto y = first_row; y < std::min(last_row, dst_height); ++y)
+    {
+        std::uint32_t sy{};
+        std::uint32_t fy{};
+        bilinear_tap(sample_position(y, src_height, dst_height), src_height, sy, fy);
+
+        const auto *upper = row_at(src, src_rect.left, src_rect.top + static_cast<std::int32_t>(sy));
+        const auto *lower = row_at(src, src_rect.left, src_rect.top + static_cast<std::int32_t>(sy) + 1);
+
+        // rows that land exactly on a source row don't need blending vertically
+        const auto *row = upper;
+        if (fy != 0)
+        {
+            kernels.vertical(upper, lower, blended.data(), src_width, fy);
+            row = blended.data();
+        }
+
+        auto *out = row_at_mut(dst, dst_rect.left, dst_rect.top + static_cast<std::int32_t>(y));
+        kernels.horizontal(row, out, dst_width, index.data(), weight.data());
+    }
+
+    return true;
+}
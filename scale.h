@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+#include "raster.h"
+#include "simd.h"
+
+// cpu scaling of the finished 640x480 frame up to the window size at present time
+// both kernels only handle 32bpp surfaces, anything else is left to the driver's stretching Blt
+
+enum class scale_mode
+{
+    // copy the frame 1:1 like the original game
+    off,
+    // largest whole multiple of the frame that fits, nearest neighbour so pixels stay square and sharp
+    integer,
+    // as large as fits with the aspect ratio kept, bilinear filtered
+    fit,
+    // the pixel art filters of scale_filter.h, placed like integer, scale2x and scale3x copy neighbouring pixels into
+    // diagonal stair steps, xbr blends along the edges it finds
+    scale2x,
+    scale3x,
+    xbr
+};
+
+// where a src_width x src_height frame goes inside a dst_width x dst_height area, centred with black bars around it
+raster_rect scale_layout(
+    scale_mode mode,
+    std::uint32_t src_width,
+    std::uint32_t src_height,
+    std::uint32_t dst_width,
+    std::uint32_t dst_height);
+
+// nearest neighbour scale of src_rect into dst_rect, false if either rect is outside its surface or a surface
+// isn't 32bpp
+bool scale_nearest(
+    const raster_surface &dst,
+    const raster_rect &dst_rect,
+    const raster_surface &src,
+    const raster_rect &src_rect);
+
+// bilinear scale of src_rect into dst_rect, samples are taken at pixel centres so the edges don't shift
+bool scale_bilinear(
+    const raster_surface &dst,
+    const raster_rect &dst_rect,
+    const raster_surface &src,
+    const raster_rect &src_rect);
+
+// same as above but with an explicit kernel, used by the benchmarks to compare paths
+bool scale_bilinear(
+    const raster_surface &dst,
+    const raster_rect &dst_rect,
+    const raster_surface &src,
+    const raster_rect &src_rect,
+    simd_level level);
+
+// only the rows [first_row, last_row) of dst_rect, counted from its top, sampled exactly as the whole scale would,
+// so bands of one frame can be scaled on different threads
+bool scale_nearest_rows(
+    const raster_surface &dst,
+    const raster_rect &dst_rect,
+    const raster_surface &src,
+    const raster_rect &src_rect,
+    std::uint32_t first_row,
+    std::uint32_t last_row);
+
+bool scale_bilinear_rows(
+    const raster_surface &dst,
+    const raster_rect &dst_rect,
+    const raster_surface &src,
+    const raster_rect &src_rect,
+    std::uint32_t first_row,
+    std::uint32_t last_row,
+    simd_level level);
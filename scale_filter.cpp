@@ -0,0 +1,830 @@
+#include "scale_filter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+
+bool rect_inside(const raster_rect &rect, const raster_surface &surface)
+{
+    return !raster_rect_empty(rect) && rect.left >= 0 && rect.top >= 0 &&
+           rect.right <= static_cast<std::int32_t>(surface.width) &&
+           rect.bottom <= static_cast<std::int32_t>(surface.height);
+}
+
+const std::uint32_t *row_at(const raster_surface &surface, std::int32_t x, std::int32_t y)
+{
+    return reinterpret_cast<const std::uint32_t *>(surface.pixels + y * surface.pitch) + x;
+}
+
+std::uint32_t *row_at_mut(const raster_surface &surface, std::int32_t x, std::int32_t y)
+{
+    return reinterpret_cast<std::uint32_t *>(surface.pixels + y * surface.pitch) + x;
+}
+
+// the source row a filter reads for row, the edge rows repeat past the top and bottom
+const std::uint32_t *clamped_row(const raster_surface &src, const raster_rect &rect, std::int64_t row)
+{
+    const auto height = rect.bottom - rect.top;
+    return row_at(src, rect.left, rect.top + static_cast<std::int32_t>(std::clamp<std::int64_t>(row, 0, height - 1)));
+}
+
+// scale2x (EPX): each pixel becomes 2x2, a corner takes the neighbour on both of its sides when they match and the
+// pixel isn't in the middle of a line, which turns a stair step into a diagonal
+// out rows: 2 of twice width
+using scale2x_kernel = void (*)(
+    const std::uint32_t *above,
+    const std::uint32_t *row,
+    const std::uint32_t *below,
+    std::uint32_t width,
+    std::uint32_t *const *out);
+
+// scale3x (AdvMAME3x): the same rule for the corners of 3x3, the edge pixels between them follow a matching corner
+// unless the diagonal pixel beyond it says the line carries on
+using scale3x_kernel = scale2x_kernel;
+
+void scale2x_scalar_range(
+    const std::uint32_t *above,
+    const std::uint32_t *row,
+    const std::uint32_t *below,
+    std::uint32_t width,
+    std::uint32_t *const *out,
+    std::uint32_t begin,
+    std::uint32_t end)
+{
+    for (auto x = begin; x < end; ++x)
+    {
+        const auto b = above[x];
+        const auto d = row[x > 0 ? x - 1 : 0];
+        const auto e = row[x];
+        const auto f = row[x + 1 < width ? x + 1 : x];
+        const auto h = below[x];
+
+        auto *top = out[0] + 2 * x;
+        auto *bottom = out[1] + 2 * x;
+        if (b != h && d != f)
+        {
+            top[0] = d == b ? d : e;
+            top[1] = b == f ? f : e;
+            bottom[0] = d == h ? d : e;
+            bottom[1] = h == f ? f : e;
+        }
+        else
+        {
+            top[0] = top[1] = bottom[0] = bottom[1] = e;
+        }
+    }
+}
+
+void scale2x_scalar(
+    const std::uint32_t *above,
+    const std::uint32_t *row,
+    const std::uint32_t *below,
+    std::uint32_t width,
+    std::uint32_t *const *out)
+{
+    scale2x_scalar_range(above, row, below, width, out, 0, width);
+}
+
+void scale3x_scalar_range(
+    const std::uint32_t *above,
+    const std::uint32_t *row,
+    const std::uint32_t *below,
+    std::uint32_t width,
+    std::uint32_t *const *out,
+    std::uint32_t begin,
+    std::uint32_t end)
+{
+    for (auto x = begin; x < end; ++x)
+    {
+        const auto left = x > 0 ? x - 1 : 0;
+        const auto right = x + 1 < width ? x + 1 : x;
+        const auto a = above[left];
+        const auto b = above[x];
+        const auto c = above[right];
+        const auto d = row[left];
+        const auto e = row[x];
+        const auto f = row[right];
+        const auto g = below[left];
+        const auto h = below[x];
+        const auto i = below[right];
+
+        auto *top = out[0] + 3 * x;
+        auto *middle = out[1] + 3 * x;
+        auto *bottom = out[2] + 3 * x;
+        if (b != h && d != f)
+        {
+            top[0] = d == b ? d : e;
+            top[1] = (d == b && e != c) || (b == f && e != a) ? b : e;
+            top[2] = b == f ? f : e;
+            middle[0] = (d == b && e != g) || (d == h && e != a) ? d : e;
+            middle[1] = e;
+            middle[2] = (b == f && e != i) || (h == f && e != c) ? f : e;
+            bottom[0] = d == h ? d : e;
+            bottom[1] = (d == h && e != i) || (h == f && e != g) ? h : e;
+            bottom[2] = h == f ? f : e;
+        }
+        else
+        {
+            top[0] = top[1] = top[2] = e;
+            middle[0] = middle[1] = middle[2] = e;
+            bottom[0] = bottom[1] = bottom[2] = e;
+        }
+    }
+}
+
+void scale3x_scalar(
+    const std::uint32_t *above,
+    const std::uint32_t *row,
+    const std::uint32_t *below,
+    std::uint32_t width,
+    std::uint32_t *const *out)
+{
+    scale3x_scalar_range(above, row, below, width, out, 0, width);
+}
+
+#if BLOCKS_X86
+
+// the scalar rules four pixels at a time, every comparison a lane mask and every ?: a select
+BLOCKS_TARGET_SSE2 __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+BLOCKS_TARGET_SSE2 __m128i load(const std::uint32_t *pixels)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels));
+}
+
+BLOCKS_TARGET_SSE2 void store(std::uint32_t *pixels, __m128i value)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels), value);
+}
+
+// lanes where a and b differ
+BLOCKS_TARGET_SSE2 __m128i differ(__m128i a, __m128i b)
+{
+    return _mm_xor_si128(_mm_cmpeq_epi32(a, b), _mm_set1_epi32(-1));
+}
+
+// the columns each side of the row's ends are done by the scalar loop, everything between 4 at a time
+BLOCKS_TARGET_SSE2 void scale2x_sse2(
+    const std::uint32_t *above,
+    const std::uint32_t *row,
+    const std::uint32_t *below,
+    std::uint32_t width,
+    std::uint32_t *const *out)
+{
+    if (width < 6)
+    {
+        scale2x_scalar(above, row, below, width, out);
+        return;
+    }
+
+    scale2x_scalar_range(above, row, below, width, out, 0, 1);
+
+    std::uint32_t x = 1;
+    for (; x + 5 <= width; x += 4)
+    {
+        const auto b = load(above + x);
+        const auto d = load(row + x - 1);
+        const auto e = load(row + x);
+        const auto f = load(row + x + 1);
+        const auto h = load(below + x);
+
+        const auto active = _mm_and_si128(differ(b, h), differ(d, f));
+        const auto top0 = select(_mm_and_si128(active, _mm_cmpeq_epi32(d, b)), d, e);
+        const auto top1 = select(_mm_and_si128(active, _mm_cmpeq_epi32(b, f)), f, e);
+        const auto bottom0 = select(_mm_and_si128(active, _mm_cmpeq_epi32(d, h)), d, e);
+        const auto bottom1 = select(_mm_and_si128(active, _mm_cmpeq_epi32(h, f)), f, e);
+
+        store(out[0] + 2 * x, _mm_unpacklo_epi32(top0, top1));
+        store(out[0] + 2 * x + 4, _mm_unpackhi_epi32(top0, top1));
+        store(out[1] + 2 * x, _mm_unpacklo_epi32(bottom0, bottom1));
+        store(out[1] + 2 * x + 4, _mm_unpackhi_epi32(bottom0, bottom1));
+    }
+
+    scale2x_scalar_range(above, row, below, width, out, x, width);
+}
+
+// three vectors of 4 pixels interleaved into 12: a0 b0 c0 a1 | b1 c1 a2 b2 | c2 a3 b3 c3
+BLOCKS_TARGET_SSE2 void store3(std::uint32_t *pixels, __m128i a, __m128i b, __m128i c)
+{
+    const auto ab_low = _mm_castsi128_ps(_mm_unpacklo_epi32(a, b));
+    const auto ab_high = _mm_castsi128_ps(_mm_unpackhi_epi32(a, b));
+    const auto bc_low = _mm_castsi128_ps(_mm_unpacklo_epi32(b, c));
+    const auto bc_high = _mm_castsi128_ps(_mm_unpackhi_epi32(b, c));
+    const auto ca_low = _mm_castsi128_ps(_mm_unpacklo_epi32(c, a));
+    const auto ca_high = _mm_castsi128_ps(_mm_unpackhi_epi32(c, a));
+
+    store(pixels, _mm_castps_si128(_mm_shuffle_ps(ab_low, ca_low, _MM_SHUFFLE(3, 0, 1, 0))));
+    store(pixels + 4, _mm_castps_si128(_mm_shuffle_ps(bc_low, ab_high, _MM_SHUFFLE(1, 0, 3, 2))));
+    store(pixels + 8, _mm_castps_si128(_mm_shuffle_ps(ca_high, bc_high, _MM_SHUFFLE(3, 2, 3, 0))));
+}
+
+BLOCKS_TARGET_SSE2 void scale3x_sse2(
+    const std::uint32_t *above,
+    const std::uint32_t *row,
+    const std::uint32_t *below,
+    std::uint32_t width,
+    std::uint32_t *const *out)
+{
+    if (width < 6)
+    {
+        scale3x_scalar(above, row, below, width, out);
+        return;
+    }
+
+    scale3x_scalar_range(above, row, below, width, out, 0, 1);
+
+    std::uint32_t x = 1;
+    for (; x + 5 <= width; x += 4)
+    {
+        const auto a = load(above + x - 1);
+        const auto b = load(above + x);
+        const auto c = load(above + x + 1);
+        const auto d = load(row + x - 1);
+        const auto e = load(row + x);
+        const auto f = load(row + x + 1);
+        const auto g = load(below + x - 1);
+        const auto h = load(below + x);
+        const auto i = load(below + x + 1);
+
+        const auto active = _mm_and_si128(differ(b, h), differ(d, f));
+        const auto db = _mm_and_si128(active, _mm_cmpeq_epi32(d, b));
+        const auto bf = _mm_and_si128(active, _mm_cmpeq_epi32(b, f));
+        const auto dh = _mm_and_si128(active, _mm_cmpeq_epi32(d, h));
+        const auto hf = _mm_and_si128(active, _mm_cmpeq_epi32(h, f));
+
+        const auto e0 = select(db, d, e);
+        const auto e1 = select(_mm_or_si128(_mm_and_si128(db, differ(e, c)), _mm_and_si128(bf, differ(e, a))), b, e);
+        const auto e2 = select(bf, f, e);
+        const auto e3 = select(_mm_or_si128(_mm_and_si128(db, differ(e, g)), _mm_and_si128(dh, differ(e, a))), d, e);
+        const auto e5 = select(_mm_or_si128(_mm_and_si128(bf, differ(e, i)), _mm_and_si128(hf, differ(e, c))), f, e);
+        const auto e6 = select(dh, d, e);
+        const auto e7 = select(_mm_or_si128(_mm_and_si128(dh, differ(e, i)), _mm_and_si128(hf, differ(e, g))), h, e);
+        const auto e8 = select(hf, f, e);
+
+        store3(out[0] + 3 * x, e0, e1, e2);
+        store3(out[1] + 3 * x, e3, e, e5);
+        store3(out[2] + 3 * x, e6, e7, e8);
+    }
+
+    scale3x_scalar_range(above, row, below, width, out, x, width);
+}
+
+#endif
+
+scale2x_kernel scale2x_for(simd_level level)
+{
+#if BLOCKS_X86
+    if (level >= simd_level::sse2)
+    {
+        return scale2x_sse2;
+    }
+#endif
+    return scale2x_scalar;
+}
+
+scale3x_kernel scale3x_for(simd_level level)
+{
+#if BLOCKS_X86
+    if (level >= simd_level::sse2)
+    {
+        return scale3x_sse2;
+    }
+#endif
+    return scale3x_scalar;
+}
+
+// xbr, after Hyllian's 2xBR: for each corner of a pixel, an edge runs between it and its diagonal neighbour when the
+// colour differences across that diagonal outweigh the ones along it, the corner then takes a blend of the
+// neighbour on the edge's other side, more of it and into the next pixel along for shallow and steep edges
+// colour differences are taken in yuv with luma weighted highest, as the eye sees them
+
+struct yuv
+{
+    std::int32_t y;
+    std::int32_t u;
+    std::int32_t v;
+};
+
+yuv to_yuv(std::uint32_t pixel)
+{
+    const auto r = static_cast<std::int32_t>((pixel >> 16) & 0xff);
+    const auto g = static_cast<std::int32_t>((pixel >> 8) & 0xff);
+    const auto b = static_cast<std::int32_t>(pixel & 0xff);
+    return {(77 * r + 150 * g + 29 * b) >> 8, (-43 * r - 85 * g + 128 * b) >> 8, (128 * r - 107 * g - 21 * b) >> 8};
+}
+
+std::int32_t difference(const yuv &a, const yuv &b)
+{
+    return 48 * std::abs(a.y - b.y) + 7 * std::abs(a.u - b.u) + 6 * std::abs(a.v - b.v);
+}
+
+// close enough to be the same colour, about a dozen steps of luma
+constexpr std::int32_t same_colour = 48 * 12;
+
+// two channels at a time like the bilinear kernels, weight is 0..256 of b
+std::uint32_t blend(std::uint32_t a, std::uint32_t b, std::uint32_t weight)
+{
+    const auto inverse = 256 - weight;
+    const auto even = ((a & 0x00ff00ff) * inverse + (b & 0x00ff00ff) * weight) >> 8;
+    const auto odd = ((a >> 8) & 0x00ff00ff) * inverse + ((b >> 8) & 0x00ff00ff) * weight;
+    return (even & 0x00ff00ff) | (odd & 0xff00ff00);
+}
+
+// the neighbours one corner's rule reads, named for the bottom right corner of e:
+//       b
+//    d  e  f  f4
+//    g  h  i  i4
+//          h5 i5
+enum xbr_tap
+{
+    tap_i,
+    tap_h,
+    tap_f,
+    tap_g,
+    tap_c,
+    tap_d,
+    tap_b,
+    tap_f4,
+    tap_h5,
+    tap_i4,
+    tap_i5,
+    tap_count
+};
+
+struct xbr_offset
+{
+    std::int32_t dx;
+    std::int32_t dy;
+};
+
+// the rule for each corner is the bottom right one turned a quarter at a time, corners run bottom right, top right,
+// top left, bottom left, each blending into what the ones before left
+struct xbr_corner
+{
+    std::array<xbr_offset, tap_count> taps;
+    // the output pixel in the corner and its neighbours towards d and towards b, 0..3 is tl, tr, bl, br
+    std::uint8_t corner;
+    std::uint8_t toward_d;
+    std::uint8_t toward_b;
+};
+
+constexpr std::array<xbr_corner, 4> xbr_corners = []
+{
+    constexpr std::array<xbr_offset, tap_count> base{
+        {{1, 1}, {0, 1}, {1, 0}, {-1, 1}, {1, -1}, {-1, 0}, {0, -1}, {2, 0}, {0, 2}, {2, 1}, {1, 2}}};
+    const auto quadrant = [](xbr_offset o)
+    { return static_cast<std::uint8_t>((o.dy > 0 ? 2 : 0) + (o.dx > 0 ? 1 : 0)); };
+
+    std::array<xbr_corner, 4> corners{};
+    auto taps = base;
+    xbr_offset corner{1, 1};
+    xbr_offset toward_d{-1, 1};
+    xbr_offset toward_b{1, -1};
+    for (auto &result : corners)
+    {
+        result = {taps, quadrant(corner), quadrant(toward_d), quadrant(toward_b)};
+
+        // a quarter turn, (dx, dy) -> (dy, -dx)
+        for (auto &tap : taps)
+        {
+            tap = {tap.dy, -tap.dx};
+        }
+        corner = {corner.dy, -corner.dx};
+        toward_d = {toward_d.dy, -toward_d.dx};
+        toward_b = {toward_b.dy, -toward_b.dx};
+    }
+    return corners;
+}();
+
+// rows the xbr rule reads around the one being scaled, with two pixels repeated off each end
+constexpr std::int32_t xbr_pad = 2;
+constexpr std::int32_t xbr_rows = 5;
+
+struct xbr_row
+{
+    std::int64_t row{-1000};
+    std::vector<std::uint32_t> pixels{};
+    std::vector<yuv> colours{};
+};
+
+void load_xbr_row(xbr_row &out, const raster_surface &src, const raster_rect &rect, std::int64_t row)
+{
+    const auto width = static_cast<std::int32_t>(rect.right - rect.left);
+    const auto *in = clamped_row(src, rect, row);
+
+    out.row = row;
+    out.pixels.resize(static_cast<std::size_t>(width + 2 * xbr_pad));
+    out.colours.resize(out.pixels.size());
+    for (std::int32_t x = -xbr_pad; x < width + xbr_pad; ++x)
+    {
+        const auto pixel = in[std::clamp(x, 0, width - 1)];
+        out.pixels[static_cast<std::size_t>(x + xbr_pad)] = pixel;
+        out.colours[static_cast<std::size_t>(x + xbr_pad)] = to_yuv(pixel);
+    }
+}
+
+// rows[2] is the row being scaled, every pointer already offset so [x] is column x
+struct xbr_window
+{
+    const std::uint32_t *pixels[xbr_rows];
+    const yuv *colours[xbr_rows];
+};
+
+void xbr_pixel(const xbr_window &window, std::int32_t x, std::uint32_t *top, std::uint32_t *bottom)
+{
+    const auto e = window.pixels[2][x];
+    const auto &e_colour = window.colours[2][x];
+    std::uint32_t out[4]{e, e, e, e};
+
+    for (const auto &corner : xbr_corners)
+    {
+        const auto pixel = [&](xbr_tap tap)
+        { return window.pixels[2 + corner.taps[tap].dy][x + corner.taps[tap].dx]; };
+        const auto colour = [&](xbr_tap tap) -> const yuv &
+        { return window.colours[2 + corner.taps[tap].dy][x + corner.taps[tap].dx]; };
+
+        const auto h = pixel(tap_h);
+        const auto f = pixel(tap_f);
+        if (e == h || e == f)
+        {
+            continue;
+        }
+
+        const auto &ec = e_colour;
+        const auto &ic = colour(tap_i);
+        const auto &hc = colour(tap_h);
+        const auto &fc = colour(tap_f);
+        const auto &gc = colour(tap_g);
+        const auto &cc = colour(tap_c);
+
+        // how strongly colour changes across the e-i diagonal against along it
+        const auto across = difference(ec, cc) + difference(ec, gc) + difference(ic, colour(tap_h5)) +
+                            difference(ic, colour(tap_f4)) + 4 * difference(hc, fc);
+        const auto along = difference(hc, colour(tap_d)) + difference(hc, colour(tap_i5)) +
+                           difference(fc, colour(tap_i4)) + difference(fc, colour(tap_b)) + 4 * difference(ec, ic);
+        if (across > along)
+        {
+            continue;
+        }
+
+        const auto blended = difference(ec, fc) <= difference(ec, hc) ? f : h;
+        const auto same = [](const yuv &a, const yuv &b) { return difference(a, b) < same_colour; };
+
+        // a real edge rather than a corner of two flat areas, worth shaping into a slope
+        const auto edge = across < along &&
+                          ((!same(fc, colour(tap_b)) && !same(hc, colour(tap_d))) ||
+                           (same(ec, ic) && !same(fc, colour(tap_i4)) && !same(hc, colour(tap_i5))) || same(ec, gc) ||
+                           same(ec, cc));
+        if (!edge)
+        {
+            out[corner.corner] = blend(out[corner.corner], blended, 128);
+            continue;
+        }
+
+        const auto g = pixel(tap_g);
+        const auto c = pixel(tap_c);
+        const auto shallow_g = difference(fc, gc);
+        const auto steep_c = difference(hc, cc);
+        const auto shallow = 2 * shallow_g <= steep_c && e != g && pixel(tap_d) != g;
+        const auto steep = shallow_g >= 2 * steep_c && e != c && pixel(tap_b) != c;
+
+        if (shallow && steep)
+        {
+            out[corner.corner] = blend(out[corner.corner], blended, 224);
+            out[corner.toward_d] = blend(out[corner.toward_d], blended, 64);
+            out[corner.toward_b] = out[corner.toward_d];
+        }
+        else if (shallow)
+        {
+            out[corner.corner] = blend(out[corner.corner], blended, 192);
+            out[corner.toward_d] = blend(out[corner.toward_d], blended, 64);
+        }
+        else if (steep)
+        {
+            out[corner.corner] = blend(out[corner.corner], blended, 192);
+            out[corner.toward_b] = blend(out[corner.toward_b], blended, 64);
+        }
+        else
+        {
+            out[corner.corner] = blend(out[corner.corner], blended, 128);
+        }
+    }
+
+    top[2 * x] = out[0];
+    top[2 * x + 1] = out[1];
+    bottom[2 * x] = out[2];
+    bottom[2 * x + 1] = out[3];
+}
+
+void xbr_scalar_range(
+    const xbr_window &window,
+    std::uint32_t *top,
+    std::uint32_t *bottom,
+    std::int32_t begin,
+    std::int32_t end)
+{
+    for (auto x = begin; x < end; ++x)
+    {
+        xbr_pixel(window, x, top, bottom);
+    }
+}
+
+// most of a frame is flat, a pixel matching all four neighbours can't be on an edge and is only copied
+using xbr_kernel = void (*)(const xbr_window &, std::uint32_t *, std::uint32_t *, std::int32_t);
+
+void xbr_scalar(const xbr_window &window, std::uint32_t *top, std::uint32_t *bottom, std::int32_t width)
+{
+    xbr_scalar_range(window, top, bottom, 0, width);
+}
+
+#if BLOCKS_X86
+
+BLOCKS_TARGET_SSE2 void xbr_sse2(
+    const xbr_window &window,
+    std::uint32_t *top,
+    std::uint32_t *bottom,
+    std::int32_t width)
+{
+    std::int32_t x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const auto e = load(window.pixels[2] + x);
+        const auto across = _mm_and_si128(
+            _mm_cmpeq_epi32(e, load(window.pixels[2] + x - 1)),
+            _mm_cmpeq_epi32(e, load(window.pixels[2] + x + 1)));
+        const auto down = _mm_and_si128(
+            _mm_cmpeq_epi32(e, load(window.pixels[1] + x)),
+            _mm_cmpeq_epi32(e, load(window.pixels[3] + x)));
+        const auto flat = _mm_and_si128(across, down);
+
+        if (_mm_movemask_epi8(flat) != 0xffff)
+        {
+            xbr_scalar_range(window, top, bottom, x, x + 4);
+            continue;
+        }
+
+        const auto low = _mm_unpacklo_epi32(e, e);
+        const auto high = _mm_unpackhi_epi32(e, e);
+        store(top + 2 * x, low);
+        store(top + 2 * x + 4, high);
+        store(bottom + 2 * x, low);
+        store(bottom + 2 * x + 4, high);
+    }
+    xbr_scalar_range(window, top, bottom, x, width);
+}
+
+#endif
+
+xbr_kernel xbr_for(simd_level level)
+{
+#if BLOCKS_X86
+    if (level >= simd_level::sse2)
+    {
+        return xbr_sse2;
+    }
+#endif
+    return xbr_scalar;
+}
+
+// output rows of the band that a source row's sub-rows land on, the rest go to scratch
+struct band_rows
+{
+    const raster_surface &dst;
+    std::int32_t x;
+    std::int32_t y;
+    std::uint32_t first;
+    std::uint32_t last;
+    std::uint32_t *scratch;
+
+    std::uint32_t *row(std::uint32_t out_row) const
+    {
+        if (out_row < first || out_row >= last)
+        {
+            return scratch;
+        }
+        return row_at_mut(dst, x, y + static_cast<std::int32_t>(out_row));
+    }
+};
+
+void xbr_band(
+    const band_rows &band,
+    const raster_surface &src,
+    const raster_rect &src_rect,
+    std::uint32_t first_source,
+    std::uint32_t last_source,
+    simd_level level)
+{
+    const auto width = src_rect.right - src_rect.left;
+    const auto kernel = xbr_for(level);
+
+    // the five rows around the one being scaled, slid down a row at a time so each is converted to yuv once
+    std::array<xbr_row, xbr_rows> rows{};
+    for (auto r = first_source; r < last_source; ++r)
+    {
+        xbr_window window{};
+        for (std::int32_t i = 0; i < xbr_rows; ++i)
+        {
+            const auto wanted = static_cast<std::int64_t>(r) + i - 2;
+            auto &slot = rows[static_cast<std::size_t>((wanted + xbr_rows) % xbr_rows)];
+            if (slot.row != wanted)
+            {
+                load_xbr_row(slot, src, src_rect, wanted);
+            }
+            window.pixels[i] = slot.pixels.data() + xbr_pad;
+            window.colours[i] = slot.colours.data() + xbr_pad;
+        }
+
+        kernel(window, band.row(2 * r), band.row(2 * r + 1), width);
+    }
+}
+
+}
+
+std::uint32_t scale_filter_factor(scale_mode mode)
+{
+    switch (mode)
+    {
+        case scale_mode::scale2x:
+        case scale_mode::xbr: return 2;
+        case scale_mode::scale3x: return 3;
+        default: return 1;
+    }
+}
+
+std::uint32_t scale_filter_passes(scale_mode mode, std::uint32_t factor)
+{
+    const auto step = scale_filter_factor(mode);
+    if (step == 1)
+    {
+        return 0;
+    }
+
+    std::uint32_t passes = 0;
+    for (auto scaled = step; scaled <= factor; scaled *= step)
+    {
+        ++passes;
+    }
+    return passes;
+}
+
+bool scale_filter_rows(
+    scale_mode mode,
+    const raster_surface &dst,
+    std::int32_t x,
+    std::int32_t y,
+    const raster_surface &src,
+    const raster_rect &src_rect,
+    std::uint32_t first_row,
+    std::uint32_t last_row,
+    simd_level level)
+{
+    const auto factor = scale_filter_factor(mode);
+    if (factor == 1 || dst.format != pixel_format::argb8888 || src.format != pixel_format::argb8888 ||
+        !rect_inside(src_rect, src))
+    {
+        return false;
+    }
+
+    const auto width = static_cast<std::uint32_t>(src_rect.right - src_rect.left);
+    const auto height = static_cast<std::uint32_t>(src_rect.bottom - src_rect.top);
+    const raster_rect out_rect{
+        x,
+        y,
+        x + static_cast<std::int32_t>(width * factor),
+        y + static_cast<std::int32_t>(height * factor)};
+    if (!rect_inside(out_rect, dst))
+    {
+        return false;
+    }
+
+    last_row = std::min(last_row, height * factor);
+    if (first_row >= last_row)
+    {
+        return true;
+    }
+
+    // a band can start or end partway through a source row's sub-rows
+    std::vector<std::uint32_t> scratch(static_cast<std::size_t>(width) * factor);
+    const band_rows band{dst, x, y, first_row, last_row, scratch.data()};
+    const auto first_source = first_row / factor;
+    const auto last_source = (last_row + factor - 1) / factor;
+    level = std::min(level, detect_simd_level());
+
+    if (mode == scale_mode::xbr)
+    {
+        xbr_band(band, src, src_rect, first_source, last_source, level);
+        return true;
+    }
+
+    const auto kernel = factor == 2 ? scale2x_for(level) : scale3x_for(level);
+    for (auto r = first_source; r < last_source; ++r)
+    {
+        std::uint32_t *out[3]{};
+        for (std::uint32_t sub = 0; sub < factor; ++sub)
+        {
+            out[sub] = band.row(r * factor + sub);
+        }
+
+        kernel(
+            clamped_row(src, src_rect, static_cast<std::int64_t>(r) - 1),
+            clamped_row(src, src_rect, r),
+            clamped_row(src, src_rect, static_cast<std::int64_t>(r) + 1),
+            width,
+            out);
+    }
+
+    return true;
+}
+
+bool scale_filter(
+    thread_pool &pool,
+    scale_filter_frames &frames,
+    scale_mode mode,
+    const raster_surface &dst,
+    const raster_rect &dst_rect,
+    const raster_surface &src,
+    const raster_rect &src_rect,
+    simd_level level)
+{
+    const auto step = scale_filter_factor(mode);
+    if (step == 1 || !rect_inside(dst_rect, dst) || !rect_inside(src_rect, src))
+    {
+        return false;
+    }
+
+    const auto dst_width = static_cast<std::uint32_t>(dst_rect.right - dst_rect.left);
+    const auto dst_height = static_cast<std::uint32_t>(dst_rect.bottom - dst_rect.top);
+    const auto factor = std::min(
+        dst_width / static_cast<std::uint32_t>(src_rect.right - src_rect.left),
+        dst_height / static_cast<std::uint32_t>(src_rect.bottom - src_rect.top));
+    const auto passes = scale_filter_passes(mode, factor);
+
+    std::atomic<bool> ok{true};
+    auto current = src;
+    auto current_rect = src_rect;
+    for (std::uint32_t pass = 0; pass < passes; ++pass)
+    {
+        const auto width = static_cast<std::uint32_t>(current_rect.right - current_rect.left) * step;
+        const auto height = static_cast<std::uint32_t>(current_rect.bottom - current_rect.top) * step;
+
+        // the last pass goes straight into dst when it fills dst_rect, anything else into a frame of its own
+        const auto direct = pass + 1 == passes && width == dst_width && height == dst_height;
+        auto target = dst;
+        auto x = dst_rect.left;
+        auto y = dst_rect.top;
+        if (!direct)
+        {
+            auto &buffer = frames.passes[pass % frames.passes.size()];
+            buffer.resize(static_cast<std::size_t>(width) * height);
+            target = {
+                reinterpret_cast<std::uint8_t *>(buffer.data()),
+                static_cast<std::ptrdiff_t>(width * sizeof(std::uint32_t)),
+                width,
+                height,
+                pixel_format::argb8888};
+            x = 0;
+            y = 0;
+        }
+
+        pool_for_rows(
+            pool,
+            height,
+            static_cast<std::size_t>(width) * sizeof(std::uint32_t),
+            [&](std::uint32_t first, std::uint32_t last)
+            {
+                if (!scale_filter_rows(mode, target, x, y, current, current_rect, first, last, level))
+                {
+                    ok.store(false, std::memory_order_relaxed);
+                }
+            });
+
+        if (!ok.load(std::memory_order_relaxed) || direct)
+        {
+            return ok.load(std::memory_order_relaxed);
+        }
+
+        current = target;
+        current_rect = {0, 0, static_cast<std::int32_t>(width), static_cast<std::int32_t>(height)};
+    }
+
+    // whatever the passes couldn't reach
+    pool_for_rows(
+        pool,
+        dst_height,
+        static_cast<std::size_t>(dst_width) * sizeof(std::uint32_t),
+        [&](std::uint32_t first, std::uint32_t last)
+        {
+            if (!scale_nearest_rows(dst, dst_rect, current, current_rect, first, last))
+            {
+                ok.store(false, std::memory_order_relaxed);
+            }
+        });
+    return ok.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "raster.h"
+#include "scale.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+// edge directed upscalers for the [scale] modes made for pixel art, which keep the game's hard edged sprites sharp
+// without nearest neighbour's blocks or bilinear's blur
+// scale2x and scale3x only ever copy neighbouring pixels, rounding off stair steps in diagonal edges, xbr blends along
+// the edges it finds so slopes come out smooth
+// a pass multiplies the frame's size by the filter's factor, scale_filter runs as many as fit the whole factor the
+// frame is presented at and makes up the rest with nearest neighbour, so 4x is two 2x passes, like AdvMAME4x
+// 32bpp surfaces only, like the other scalers
+
+// the whole factor one pass of mode scales by, 1 for the modes that aren't pixel art filters
+std::uint32_t scale_filter_factor(scale_mode mode);
+
+// passes of mode that fit a frame scaled by a whole factor
+std::uint32_t scale_filter_passes(scale_mode mode, std::uint32_t factor);
+
+// one pass of mode over src_rect, only the rows [first_row, last_row) of its result, written to dst with the
+// result's top left at (x, y), so bands of a pass can run on different threads
+// false if a surface isn't 32bpp, a rect is outside its surface or mode isn't a filter
+bool scale_filter_rows(
+    scale_mode mode,
+    const raster_surface &dst,
+    std::int32_t x,
+    std::int32_t y,
+    const raster_surface &src,
+    const raster_rect &src_rect,
+    std::uint32_t first_row,
+    std::uint32_t last_row,
+    simd_level level);
+
+// where the passes before the last one go, kept from frame to frame
+struct scale_filter_frames
+{
+    std::array<std::vector<std::uint32_t>, 2> passes{};
+};
+
+// scale src_rect into dst_rect with mode's filter, each pass split into bands over pool
+bool scale_filter(
+    thread_pool &pool,
+    scale_filter_frames &frames,
+    scale_mode mode,
+    const raster_surface &dst,
+    const raster_rect &dst_rect,
+    const raster_surface &src,
+    const raster_rect &src_rect,
+    simd_level level);
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "present_queue.h"
+#include "scale.h"
+
+// runtime options, read from blocks_patcher.ini in the game directory when the dll loads (see load_settings in
+// main.cpp), everything defaults to the original behaviour
+
+struct settings
+{
+    // [raster] software=1
+    // keep the back buffer and image surface in system memory and do Blt/BltFast on the cpu instead of the driver
+    bool software_raster{};
+
+    // [raster] indexed=1
+    // keep the back buffer and image surface as 8 bit palette indices like the game was written for, so blits move
+    // a byte per pixel and locks of the back buffer see indices, the palette is applied once per Flip on the way to
+    // the screen so SetEntries shows on the next frame without touching the image, implies software=1
+    bool indexed_back_buffer{};
+
+    // [raster] spans=1
+    // scan the image surface once for the runs of pixels that aren't the colour key, so keyed blits out of it copy
+    // those runs whole and skip the transparent margins of each sprite without looking at them, needs software=1
+    bool sprite_spans{};
+
+    // [raster] batch=1
+    // fills of the back buffer and blits out of the image surface into it are collected and run together when the
+    // game flips or locks, blits drawn over completely by a later one are dropped and the rest run grouped by
+    // position in the image, with software=1 the whole frame is one pass under a single lock of each surface
+    bool blit_batching{};
+
+    // [raster] write_watch=1
+    // put the back buffer on memory that notes which pages get written, so a lock of it counts only the rows the
+    // game really wrote to as drawn instead of all of the locked area, needs software=1 and [present] dirty_rects=1
+    bool write_watch{};
+
+    // [present] dirty_rects=1
+    // only copy the parts of the back buffer that were drawn to since the last Flip to the screen
+    bool dirty_rects{};
+
+    // [present] dirty_rect_max=8
+    // the frame's damage is merged down to at most this many rects before presenting
+    std::uint32_t dirty_rect_max{8};
+
+    // [present] dirty_rect_threshold=50
+    // once the merged rects cover more than this percentage of the back buffer it is copied in one go instead
+    std::uint32_t dirty_rect_threshold{50};
+
+    // [present] async=1
+    // Flip copies the frame into a staging surface and a separate thread puts it on the screen, so driver and
+    // compositor stalls no longer hold up the game
+    bool async_present{};
+
+    // [present] async_queue_depth=2
+    // frames that can be waiting for the present thread
+    std::uint32_t async_queue_depth{2};
+
+    // [present] async_backpressure=drop
+    // what Flip does when async_queue_depth frames are already waiting, drop throws away the oldest one and block
+    // waits for the present thread
+    present_backpressure async_backpressure{present_backpressure::drop_oldest};
+
+    // [scale] mode=off|integer|fit|scale2x|scale3x|xbr
+    // scale the 640x480 frame up to the window on the cpu when presenting, integer keeps square sharp pixels and
+    // fit fills as much of the window as the aspect ratio allows with a bilinear filter, both letterbox the rest
+    // scale2x, scale3x and xbr size the frame like integer but smooth the pixel art's diagonal edges instead
+    // works best together with [raster] software=1, otherwise the back buffer is read back from video memory
+    scale_mode scale{scale_mode::off};
+
+    // [scale] width=1280
+    // [scale] height=960
+    // client area of the window when scaling
+    std::uint32_t window_width{1280};
+    std::uint32_t window_height{960};
+
+    // [parallel] threads=1
+    // threads converting the image and back buffer and scaling the frame, each frame is split into bands of rows
+    // that spread over them, 0 is one per core and 1 keeps everything on the game's thread
+    std::uint32_t threads{1};
+
+    // [cache] atlas=1
+    // keep the image surface as converted on the first present in the cache directory, so the next launch with the
+    // same image and palette copies it in instead of converting it again
+    bool atlas_cache{};
+
+    // [cache] dir=atlas_cache
+    // files are named after the image and palette hashes, stale ones are never read again and can be deleted
+    std::string atlas_cache_dir{"atlas_cache"};
+
+    // [cache] imports=import_cache.txt
+    // where the game's import slots for the hooked functions were found in its exe, keyed by the exe's timestamp
+    // and checksum so a different build walks its import table again, empty always walks it and writes nothing
+    std::string import_cache{"import_cache.txt"};
+
+    // [trace] enabled=1
+    // record every hooked call into a binary trace, decode it with blocks_trace_decode, as text or as a timeline
+    bool trace{};
+
+    // [trace] file=trace.bin
+    std::string trace_file{"trace.bin"};
+
+    // [trace] first_frame=0
+    // frames counted in Flips, 0 traces from the start, loading included
+    std::uint32_t trace_first_frame{};
+
+    // [trace] frames=0
+    // only trace this many frames from first_frame on, 0 traces until the game exits, a few hundred frames is what
+    // blocks_trace_decode --chrome output for ui.perfetto.dev stays comfortable to open with
+    std::uint32_t trace_frames{};
+
+    // [capture] enabled=1
+    // write every call the game makes with everything it points at to a capture file, which blocks_replay can play
+    // back without the game, big: each image file and every pixel written through a lock goes in
+    bool capture{};
+
+    // [capture] file=capture.bin
+    std::string capture_file{"capture.bin"};
+
+    // [record] enabled=1
+    // record the frames the game presents, 8 bit ones as palette indices, for blocks_recording_export to turn into
+    // png files, cheapest with software=1 since otherwise every frame is read back out of video memory
+    bool record{};
+
+    // [record] file=recording.bin
+    std::string record_file{"recording.bin"};
+
+    // [record] buffers=8
+    // frames that can wait for the encoder before the game's frames start being dropped
+    std::uint32_t record_buffers{8};
+
+    // [overlay] enabled=1
+    // draw fps, a frame time graph, the game's blits and the bytes presented per frame in the top left corner, taken
+    // off the back buffer again once the frame is presented so the game never sees it
+    bool overlay{};
+
+    // [stats] enabled=1
+    // time every per frame hook and the driver call inside it, dumped to the stats file when the game exits
+    bool stats{};
+
+    // [stats] file=hook_stats.txt
+    // dumps are appended so one file can hold several sessions
+    std::string stats_file{"hook_stats.txt"};
+
+    // [stats] dump_key=122
+    // virtual key code that dumps the stats while playing, F11 by default, 0 turns it off
+    std::uint32_t stats_dump_key{0x7A};
+};
@@ -0,0 +1,68 @@
+#include "simd.h"
+
+#if BLOCKS_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+
+simd_level query_simd_level()
+{
+#if BLOCKS_X86 && defined(_MSC_VER)
+    int info[4]{};
+    ::__cpuid(info, 0);
+    const auto max_leaf = info[0];
+
+    ::__cpuid(info, 1);
+    const auto has_sse2 = (info[3] & (1 << 26)) != 0;
+    const auto has_osxsave = (info[2] & (1 << 27)) != 0;
+    const auto has_avx = (info[2] & (1 << 28)) != 0;
+
+    auto has_avx2 = false;
+    if (max_leaf >= 7 && has_osxsave && has_avx)
+    {
+        // the os has to save the ymm registers on a context switch or avx2 is unusable
+        const auto xcr0 = ::_xgetbv(0);
+        if ((xcr0 & 0x6) == 0x6)
+        {
+            ::__cpuidex(info, 7, 0);
+            has_avx2 = (info[1] & (1 << 5)) != 0;
+        }
+    }
+
+    if (has_avx2)
+    {
+        return simd_level::avx2;
+    }
+    return has_sse2 ? simd_level::sse2 : simd_level::scalar;
+#elif BLOCKS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return simd_level::avx2;
+    }
+    return __builtin_cpu_supports("sse2") ? simd_level::sse2 : simd_level::scalar;
+#else
+    return simd_level::scalar;
+#endif
+}
+
+}
+
+simd_level detect_simd_level()
+{
+    static const auto level = query_simd_level();
+    return level;
+}
+
+const char *simd_level_name(simd_level level)
+{
+    switch (level)
+    {
+        case simd_level::scalar: return "scalar";
+        case simd_level::sse2: return "sse2";
+        case simd_level::avx2: return "avx2";
+    }
+    return "unknown";
+}
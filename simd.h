@@ -0,0 +1,31 @@
+#pragma once
+
+// shared bits for the vectorised kernels, every kernel has a scalar fallback and picks its path at runtime
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define BLOCKS_X86 1
+#include <immintrin.h>
+#else
+#define BLOCKS_X86 0
+#endif
+
+// msvc lets us use any intrinsic in any function, gcc/clang need the target spelled out per function
+#if BLOCKS_X86 && (defined(__GNUC__) || defined(__clang__))
+#define BLOCKS_TARGET_SSE2 __attribute__((target("sse2")))
+#define BLOCKS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define BLOCKS_TARGET_SSE2
+#define BLOCKS_TARGET_AVX2
+#endif
+
+enum class simd_level
+{
+    scalar,
+    sse2,
+    avx2
+};
+
+// best level supported by both the cpu and the os, detected once and cached
+simd_level detect_simd_level();
+
+const char *simd_level_name(simd_level level);
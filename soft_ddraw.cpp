@@ -0,0 +1,1112 @@
+#include "soft_ddraw.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "ddraw_convert.h"
+#include "ddraw_vtable.h"
+#include "vtable.h"
+
+namespace
+{
+
+// the slots soft_ddraw fills in on top of the ones the hooks use, see ddraw_vtable.h
+
+template <class Interface>
+using query_interface_method = vtable_method<Interface, 0, HRESULT(__stdcall *)(void *, REFIID, LPVOID *)>;
+
+template <class Interface>
+using add_ref_method = vtable_method<Interface, 1, ULONG(__stdcall *)(void *)>;
+
+template <class Interface>
+using release_method = vtable_method<Interface, 2, ULONG(__stdcall *)(void *)>;
+
+namespace soft_ddraw_method
+{
+
+using create_clipper =
+    vtable_method<IDirectDraw, 4, HRESULT(__stdcall *)(void *, DWORD, LPDIRECTDRAWCLIPPER *, IUnknown *)>;
+using flip_to_gdi_surface = vtable_method<IDirectDraw, 10, HRESULT(__stdcall *)(void *)>;
+using get_display_mode = vtable_method<IDirectDraw, 12, HRESULT(__stdcall *)(void *, LPDDSURFACEDESC2)>;
+using restore_display_mode = vtable_method<IDirectDraw, 19, HRESULT(__stdcall *)(void *)>;
+using wait_for_vertical_blank = vtable_method<IDirectDraw, 22, HRESULT(__stdcall *)(void *, DWORD, HANDLE)>;
+
+}
+
+namespace soft_surface_method
+{
+
+using get_clipper = vtable_method<IDirectDrawSurface7, 15, HRESULT(__stdcall *)(void *, LPDIRECTDRAWCLIPPER *)>;
+using get_color_key = vtable_method<IDirectDrawSurface7, 16, HRESULT(__stdcall *)(void *, DWORD, LPDDCOLORKEY)>;
+using get_palette = vtable_method<IDirectDrawSurface7, 20, HRESULT(__stdcall *)(void *, LPDIRECTDRAWPALETTE *)>;
+using get_surface_desc = vtable_method<IDirectDrawSurface7, 22, HRESULT(__stdcall *)(void *, LPDDSURFACEDESC2)>;
+using is_lost = vtable_method<IDirectDrawSurface7, 24, HRESULT(__stdcall *)(void *)>;
+using restore = vtable_method<IDirectDrawSurface7, 27, HRESULT(__stdcall *)(void *)>;
+using set_clipper = vtable_method<IDirectDrawSurface7, 28, HRESULT(__stdcall *)(void *, LPDIRECTDRAWCLIPPER)>;
+
+}
+
+namespace soft_palette_method
+{
+
+using get_caps = vtable_method<IDirectDrawPalette, 3, HRESULT(__stdcall *)(void *, LPDWORD)>;
+using get_entries =
+    vtable_method<IDirectDrawPalette, 4, HRESULT(__stdcall *)(void *, DWORD, DWORD, DWORD, LPPALETTEENTRY)>;
+
+}
+
+namespace soft_clipper_method
+{
+
+using get_clip_list = vtable_method<IDirectDrawClipper, 3, HRESULT(__stdcall *)(void *, LPRECT, LPRGNDATA, LPDWORD)>;
+using get_hwnd = vtable_method<IDirectDrawClipper, 4, HRESULT(__stdcall *)(void *, HWND *)>;
+using is_clip_list_changed = vtable_method<IDirectDrawClipper, 6, HRESULT(__stdcall *)(void *, BOOL *)>;
+using set_clip_list = vtable_method<IDirectDrawClipper, 7, HRESULT(__stdcall *)(void *, LPRGNDATA, DWORD)>;
+using set_hwnd = vtable_method<IDirectDrawClipper, 8, HRESULT(__stdcall *)(void *, DWORD, HWND)>;
+
+}
+
+// every slot that isn't implemented still needs a function taking the right number of arguments, with __stdcall the
+// callee pops them and a mismatch would wreck the caller's stack, every argument of these interfaces is one word
+
+template <std::size_t>
+using stub_word = void *;
+
+template <class Indices>
+struct unsupported_method;
+
+template <std::size_t... I>
+struct unsupported_method<std::index_sequence<I...>>
+{
+    static HRESULT __stdcall call(void *, stub_word<I>...)
+    {
+        return DDERR_UNSUPPORTED;
+    }
+};
+
+// one entry per slot, the values are each method's argument count not counting this
+template <std::size_t... Arguments>
+std::array<void *, sizeof...(Arguments)> unsupported_slots()
+{
+    return {reinterpret_cast<void *>(&unsupported_method<std::make_index_sequence<Arguments>>::call)...};
+}
+
+template <class Method>
+void set_slot(std::span<void *> slots, typename Method::function_type function)
+{
+    slots[Method::index] = reinterpret_cast<void *>(function);
+}
+
+// shared by every object of an interface like a real vtable, so hooking one object hooks them all
+template <std::size_t Slots>
+struct soft_vtable
+{
+    std::array<void *, Slots> slots{};
+    std::array<void *, Slots> pristine{};
+};
+
+struct soft_vtables
+{
+    soft_vtable<23> ddraw{};
+    soft_vtable<49> surface{};
+    soft_vtable<7> palette{};
+    soft_vtable<9> clipper{};
+};
+
+soft_vtables &vtables();
+
+std::size_t g_live_objects{};
+
+// the vtable pointer has to be the first thing in the object, which the base of a standard layout struct is
+struct soft_object
+{
+    void **vtable{};
+    ULONG references{1};
+};
+
+struct soft_ddraw_object;
+
+struct soft_palette : soft_object
+{
+    DWORD caps{};
+    std::array<PALETTEENTRY, 256> entries{};
+};
+
+struct soft_clipper : soft_object
+{
+    soft_ddraw_object *owner{};
+    HWND window{};
+    std::optional<std::vector<RECT>> clip_list{};
+};
+
+struct soft_surface : soft_object
+{
+    soft_ddraw_object *owner{};
+    DWORD caps{};
+    std::vector<std::uint8_t> pixels{};
+    raster_surface view{};
+    std::optional<DDCOLORKEY> source_key{};
+    soft_palette *palette{};
+    soft_clipper *clipper{};
+    // next surface of a flipping chain, a front buffer's back buffer
+    soft_surface *attached{};
+    bool locked{};
+};
+
+struct soft_ddraw_object : soft_object
+{
+    soft_ddraw_options options{};
+    HWND window{};
+    DWORD cooperative_level{};
+};
+
+template <class T, std::size_t Slots>
+T *make_object(soft_vtable<Slots> &table)
+{
+    auto *object = new (std::nothrow) T{};
+    if (object != nullptr)
+    {
+        object->vtable = table.slots.data();
+        ++g_live_objects;
+    }
+    return object;
+}
+
+template <class T>
+T *add_ref(T *object)
+{
+    if (object != nullptr)
+    {
+        ++object->references;
+    }
+    return object;
+}
+
+void release(soft_surface *surface);
+void release(soft_palette *palette);
+void release(soft_clipper *clipper);
+
+template <class T>
+bool release_reference(T *object)
+{
+    if (object == nullptr || --object->references != 0)
+    {
+        return false;
+    }
+
+    --g_live_objects;
+    return true;
+}
+
+void release(soft_palette *palette)
+{
+    if (release_reference(palette))
+    {
+        delete palette;
+    }
+}
+
+void release(soft_clipper *clipper)
+{
+    if (release_reference(clipper))
+    {
+        delete clipper;
+    }
+}
+
+void release(soft_surface *surface)
+{
+    if (release_reference(surface))
+    {
+        release(surface->palette);
+        release(surface->clipper);
+        release(surface->attached);
+        delete surface;
+    }
+}
+
+void release(soft_ddraw_object *ddraw)
+{
+    if (release_reference(ddraw))
+    {
+        delete ddraw;
+    }
+}
+
+template <class T>
+ULONG __stdcall object_add_ref(void *that)
+{
+    return add_ref(static_cast<T *>(that))->references;
+}
+
+template <class T>
+ULONG __stdcall object_release(void *that)
+{
+    auto *object = static_cast<T *>(that);
+    const auto remaining = object->references - 1;
+    release(object);
+    return remaining;
+}
+
+HRESULT __stdcall object_query_interface(void *, REFIID, LPVOID *object)
+{
+    if (object != nullptr)
+    {
+        *object = nullptr;
+    }
+    return E_NOINTERFACE;
+}
+
+// SetDisplayMode only gets a bit count, 16 is taken to mean 565 like most drivers do
+std::optional<pixel_format> format_from_bits(DWORD bits)
+{
+    switch (bits)
+    {
+        case 8: return pixel_format::indexed8;
+        case 15: return pixel_format::rgb555;
+        case 16: return pixel_format::rgb565;
+        case 24: return pixel_format::rgb888;
+        case 32: return pixel_format::argb8888;
+        default: return std::nullopt;
+    }
+}
+
+// the smallest descriptor anyone passes is the DirectDraw 1 DDSURFACEDESC, which is DDSURFACEDESC2 minus the caps
+// words past the first and dwTextureStage, callers only get back as much as their dwSize says they have room for
+constexpr DWORD surface_desc_v1_size = 0x6c;
+
+bool write_surface_desc(LPDDSURFACEDESC2 out, const DDSURFACEDESC2 &desc)
+{
+    if (out == nullptr || out->dwSize < surface_desc_v1_size)
+    {
+        return false;
+    }
+
+    const auto size = std::min<DWORD>(out->dwSize, sizeof(DDSURFACEDESC2));
+    auto copy = desc;
+    copy.dwSize = out->dwSize;
+    std::memcpy(out, &copy, size);
+    return true;
+}
+
+DDSURFACEDESC2 describe_surface(const soft_surface &surface)
+{
+    DDSURFACEDESC2 desc{};
+    desc.dwSize = sizeof(desc);
+    desc.dwFlags = DDSD_CAPS | DDSD_WIDTH | DDSD_HEIGHT | DDSD_PITCH | DDSD_PIXELFORMAT;
+    desc.dwWidth = surface.view.width;
+    desc.dwHeight = surface.view.height;
+    desc.lPitch = static_cast<LONG>(surface.view.pitch);
+    desc.ddpfPixelFormat = to_ddpixelformat(surface.view.format);
+    desc.ddsCaps.dwCaps = surface.caps;
+
+    if (surface.source_key)
+    {
+        desc.dwFlags |= DDSD_CKSRCBLT;
+        desc.ddckCKSrcBlt = *surface.source_key;
+    }
+    return desc;
+}
+
+raster_rect whole(const raster_surface &surface)
+{
+    return {0, 0, static_cast<std::int32_t>(surface.width), static_cast<std::int32_t>(surface.height)};
+}
+
+soft_surface *new_surface(
+    soft_ddraw_object *owner,
+    DWORD caps,
+    std::uint32_t width,
+    std::uint32_t height,
+    pixel_format format)
+{
+    auto *surface = make_object<soft_surface>(vtables().surface);
+    if (surface == nullptr)
+    {
+        return nullptr;
+    }
+
+    // nothing here is ever in video memory, but keep what the caller asked for so GetSurfaceDesc looks familiar
+    surface->owner = owner;
+    surface->caps = (caps & (DDSCAPS_SYSTEMMEMORY | DDSCAPS_VIDEOMEMORY)) ? caps : caps | DDSCAPS_SYSTEMMEMORY;
+
+    const auto pitch = static_cast<std::size_t>(width) * bytes_per_pixel(format);
+    surface->pixels.assign(pitch * height, 0);
+    surface->view = {surface->pixels.data(), static_cast<std::ptrdiff_t>(pitch), width, height, format};
+    return surface;
+}
+
+// surface methods
+
+HRESULT __stdcall surface_blt(
+    void *that,
+    LPRECT dst_rect,
+    LPDIRECTDRAWSURFACE7 source,
+    LPRECT src_rect,
+    DWORD flags,
+    LPDDBLTFX fx)
+{
+    constexpr DWORD supported_flags =
+        DDBLT_WAIT | DDBLT_ASYNC | DDBLT_DONOTWAIT | DDBLT_COLORFILL | DDBLT_KEYSRC | DDBLT_KEYSRCOVERRIDE;
+    if ((flags & ~supported_flags) != 0)
+    {
+        return DDERR_UNSUPPORTED;
+    }
+
+    auto *dst = static_cast<soft_surface *>(that);
+    if (dst->locked)
+    {
+        return DDERR_SURFACEBUSY;
+    }
+
+    // a clipper with a window clips to the display, there's nothing on top of it
+    std::vector<raster_rect> clip_list{};
+    if (dst->clipper != nullptr && dst->clipper->clip_list)
+    {
+        if (dst->clipper->clip_list->empty())
+        {
+            return DD_OK;
+        }
+        std::ranges::transform(*dst->clipper->clip_list, std::back_inserter(clip_list), to_raster_rect);
+    }
+
+    const auto dst_area = dst_rect != nullptr ? std::optional{to_raster_rect(*dst_rect)} : std::nullopt;
+
+    if (flags & DDBLT_COLORFILL)
+    {
+        if (fx == nullptr)
+        {
+            return DDERR_INVALIDPARAMS;
+        }
+        const auto ok = raster_fill(dst->view, dst_area ? &*dst_area : nullptr, fx->dwFillColor, clip_list);
+        return ok ? DD_OK : DDERR_INVALIDRECT;
+    }
+
+    auto *src = reinterpret_cast<soft_surface *>(source);
+    if (src == nullptr || ((flags & DDBLT_KEYSRCOVERRIDE) && fx == nullptr))
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+    if (src != dst && src->locked)
+    {
+        return DDERR_SURFACEBUSY;
+    }
+    if (src->view.format != dst->view.format)
+    {
+        return DDERR_INVALIDPIXELFORMAT;
+    }
+
+    std::optional<raster_color_key> key{};
+    if (flags & DDBLT_KEYSRCOVERRIDE)
+    {
+        key = to_raster_color_key(fx->ddckSrcColorkey);
+    }
+    else if ((flags & DDBLT_KEYSRC) && src->source_key)
+    {
+        key = to_raster_color_key(*src->source_key);
+    }
+
+    const auto src_area = src_rect != nullptr ? std::optional{to_raster_rect(*src_rect)} : std::nullopt;
+    const auto ok = raster_blt(
+        dst->view,
+        dst_area ? &*dst_area : nullptr,
+        src->view,
+        src_area ? &*src_area : nullptr,
+        {.clip_list = clip_list, .source_key = key ? &*key : nullptr});
+    return ok ? DD_OK : DDERR_INVALIDRECT;
+}
+
+HRESULT __stdcall surface_blt_batch(void *that, LPDDBLTBATCH batch, DWORD count, DWORD)
+{
+    if (batch == nullptr)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    for (const auto &entry : std::span{batch, count})
+    {
+        const auto res = surface_blt(
+            that,
+            entry.lprDest,
+            reinterpret_cast<LPDIRECTDRAWSURFACE7>(entry.lpDDSSrc),
+            entry.lprSrc,
+            entry.dwFlags,
+            entry.lpDDBltFx);
+        if (res != DD_OK)
+        {
+            return res;
+        }
+    }
+    return DD_OK;
+}
+
+HRESULT __stdcall surface_blt_fast(
+    void *that,
+    DWORD x,
+    DWORD y,
+    LPDIRECTDRAWSURFACE7 source,
+    LPRECT src_rect,
+    DWORD flags)
+{
+    constexpr DWORD supported_flags = DDBLTFAST_WAIT | DDBLTFAST_SRCCOLORKEY;
+    if ((flags & ~supported_flags) != 0)
+    {
+        return DDERR_UNSUPPORTED;
+    }
+
+    auto *dst = static_cast<soft_surface *>(that);
+    auto *src = reinterpret_cast<soft_surface *>(source);
+    if (src == nullptr)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+    if (dst->locked || (src != dst && src->locked))
+    {
+        return DDERR_SURFACEBUSY;
+    }
+    if (src->view.format != dst->view.format)
+    {
+        return DDERR_INVALIDPIXELFORMAT;
+    }
+
+    std::optional<raster_color_key> key{};
+    if ((flags & DDBLTFAST_SRCCOLORKEY) && src->source_key)
+    {
+        key = to_raster_color_key(*src->source_key);
+    }
+
+    const auto area = src_rect != nullptr ? to_raster_rect(*src_rect) : whole(src->view);
+    const auto ok = raster_blt_fast(
+        dst->view,
+        static_cast<std::int32_t>(x),
+        static_cast<std::int32_t>(y),
+        src->view,
+        &area,
+        key ? &*key : nullptr);
+    return ok ? DD_OK : DDERR_INVALIDRECT;
+}
+
+// the front buffer shows what the first back buffer had, every back buffer moves up one and the last one gets the old
+// front buffer, done by passing the pixel storage along the chain rather than copying
+HRESULT __stdcall surface_flip(void *that, LPDIRECTDRAWSURFACE7, DWORD)
+{
+    auto *front = static_cast<soft_surface *>(that);
+    if (!(front->caps & DDSCAPS_FRONTBUFFER) || front->attached == nullptr)
+    {
+        return DDERR_NOTFLIPPABLE;
+    }
+
+    std::vector<soft_surface *> chain{};
+    for (auto *surface = front; surface != nullptr; surface = surface->attached)
+    {
+        if (surface->locked)
+        {
+            return DDERR_SURFACEBUSY;
+        }
+        chain.push_back(surface);
+    }
+
+    for (std::size_t i = 0; i + 1 < chain.size(); ++i)
+    {
+        std::swap(chain[i]->pixels, chain[i + 1]->pixels);
+        chain[i]->view.pixels = chain[i]->pixels.data();
+    }
+    chain.back()->view.pixels = chain.back()->pixels.data();
+    return DD_OK;
+}
+
+HRESULT __stdcall surface_get_attached_surface(void *that, LPDDSCAPS2 caps, LPDIRECTDRAWSURFACE7 *attached)
+{
+    if (caps == nullptr || attached == nullptr)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    auto *surface = static_cast<soft_surface *>(that);
+    if (!(caps->dwCaps & DDSCAPS_BACKBUFFER) || surface->attached == nullptr)
+    {
+        *attached = nullptr;
+        return DDERR_NOTFOUND;
+    }
+
+    *attached = reinterpret_cast<LPDIRECTDRAWSURFACE7>(add_ref(surface->attached));
+    return DD_OK;
+}
+
+HRESULT __stdcall surface_get_clipper(void *that, LPDIRECTDRAWCLIPPER *clipper)
+{
+    if (clipper == nullptr)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    auto *surface = static_cast<soft_surface *>(that);
+    *clipper = reinterpret_cast<LPDIRECTDRAWCLIPPER>(add_ref(surface->clipper));
+    return surface->clipper != nullptr ? DD_OK : DDERR_NOCLIPPERATTACHED;
+}
+
+HRESULT __stdcall surface_set_clipper(void *that, LPDIRECTDRAWCLIPPER clipper)
+{
+    auto *surface = static_cast<soft_surface *>(that);
+    auto *previous = std::exchange(surface->clipper, add_ref(reinterpret_cast<soft_clipper *>(clipper)));
+    release(previous);
+    return DD_OK;
+}
+
+HRESULT __stdcall surface_get_color_key(void *that, DWORD flags, LPDDCOLORKEY key)
+{
+    auto *surface = static_cast<soft_surface *>(that);
+    if (key == nullptr || !(flags & DDCKEY_SRCBLT))
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+    if (!surface->source_key)
+    {
+        return DDERR_NOCOLORKEY;
+    }
+
+    *key = *surface->source_key;
+    return DD_OK;
+}
+
+HRESULT __stdcall surface_set_color_key(void *that, DWORD flags, LPDDCOLORKEY key)
+{
+    // only source blit keys, which is all the raster engine knows how to apply
+    if (flags != DDCKEY_SRCBLT)
+    {
+        return DDERR_UNSUPPORTED;
+    }
+
+    auto *surface = static_cast<soft_surface *>(that);
+    surface->source_key = key != nullptr ? std::optional{*key} : std::nullopt;
+    return DD_OK;
+}
+
+HRESULT __stdcall surface_get_palette(void *that, LPDIRECTDRAWPALETTE *palette)
+{
+    if (palette == nullptr)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    auto *surface = static_cast<soft_surface *>(that);
+    *palette = reinterpret_cast<LPDIRECTDRAWPALETTE>(add_ref(surface->palette));
+    return surface->palette != nullptr ? DD_OK : DDERR_NOPALETTEATTACHED;
+}
+
+// only kept for GetPalette, indexed surfaces are blitted as raw indices and never look at it
+HRESULT __stdcall surface_set_palette(void *that, LPDIRECTDRAWPALETTE palette)
+{
+    auto *surface = static_cast<soft_surface *>(that);
+    auto *previous = std::exchange(surface->palette, add_ref(reinterpret_cast<soft_palette *>(palette)));
+    release(previous);
+    return DD_OK;
+}
+
+HRESULT __stdcall surface_get_pixel_format(void *that, LPDDPIXELFORMAT format)
+{
+    if (format == nullptr)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    *format = to_ddpixelformat(static_cast<soft_surface *>(that)->view.format);
+    return DD_OK;
+}
+
+HRESULT __stdcall surface_get_surface_desc(void *that, LPDDSURFACEDESC2 desc)
+{
+    return write_surface_desc(desc, describe_surface(*static_cast<soft_surface *>(that))) ? DD_OK
+                                                                                          : DDERR_INVALIDPARAMS;
+}
+
+HRESULT __stdcall surface_lock(void *that, LPRECT rect, LPDDSURFACEDESC2 desc, DWORD, HANDLE)
+{
+    auto *surface = static_cast<soft_surface *>(that);
+    if (surface->locked)
+    {
+        return DDERR_SURFACEBUSY;
+    }
+
+    const auto bounds = whole(surface->view);
+    const auto area = rect != nullptr ? to_raster_rect(*rect) : bounds;
+    if (area.left < 0 || area.top < 0 || area.right > bounds.right || area.bottom > bounds.bottom ||
+        area.left >= area.right || area.top >= area.bottom)
+    {
+        return DDERR_INVALIDRECT;
+    }
+
+    // like the real thing lpSurface points at the top left of the locked rect, the size is the whole surface's
+    auto locked = describe_surface(*surface);
+    locked.dwFlags |= DDSD_LPSURFACE;
+    locked.lpSurface = surface->view.pixels + area.top * surface->view.pitch +
+                       area.left * static_cast<std::ptrdiff_t>(bytes_per_pixel(surface->view.format));
+    if (!write_surface_desc(desc, locked))
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    surface->locked = true;
+    return DD_OK;
+}
+
+HRESULT __stdcall surface_unlock(void *that, LPRECT)
+{
+    auto *surface = static_cast<soft_surface *>(that);
+    if (!surface->locked)
+    {
+        return DDERR_NOTLOCKED;
+    }
+
+    surface->locked = false;
+    return DD_OK;
+}
+
+// system memory is never lost
+HRESULT __stdcall surface_is_lost(void *)
+{
+    return DD_OK;
+}
+
+HRESULT __stdcall surface_restore(void *)
+{
+    return DD_OK;
+}
+
+// palette methods
+
+HRESULT __stdcall palette_get_caps(void *that, LPDWORD caps)
+{
+    if (caps == nullptr)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    *caps = static_cast<soft_palette *>(that)->caps;
+    return DD_OK;
+}
+
+HRESULT __stdcall palette_get_entries(void *that, DWORD, DWORD first, DWORD count, LPPALETTEENTRY entries)
+{
+    auto &palette = static_cast<soft_palette *>(that)->entries;
+    if (entries == nullptr || first > palette.size() || count > palette.size() - first)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    std::copy_n(palette.begin() + first, count, entries);
+    return DD_OK;
+}
+
+HRESULT __stdcall palette_set_entries(void *that, DWORD, DWORD first, DWORD count, LPPALETTEENTRY entries)
+{
+    auto &palette = static_cast<soft_palette *>(that)->entries;
+    if (entries == nullptr || first > palette.size() || count > palette.size() - first)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    std::copy_n(entries, count, palette.begin() + first);
+    return DD_OK;
+}
+
+// clipper methods
+
+HRESULT __stdcall clipper_get_clip_list(void *that, LPRECT limit, LPRGNDATA region, LPDWORD size)
+{
+    auto *clipper = static_cast<soft_clipper *>(that);
+    if (size == nullptr)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    // with no other windows around a window's visible region is the whole display
+    std::vector<RECT> rects{};
+    if (clipper->clip_list)
+    {
+        rects = *clipper->clip_list;
+    }
+    else if (clipper->window != nullptr)
+    {
+        const auto &options = clipper->owner->options;
+        rects.push_back(
+            {0, 0, static_cast<LONG>(options.display_width), static_cast<LONG>(options.display_height)});
+    }
+    else
+    {
+        return DDERR_NOCLIPLIST;
+    }
+
+    if (limit != nullptr)
+    {
+        for (auto &rect : rects)
+        {
+            const auto clipped = raster_intersect(to_raster_rect(rect), to_raster_rect(*limit));
+            rect = {clipped.left, clipped.top, clipped.right, clipped.bottom};
+        }
+        std::erase_if(rects, [](const RECT &rect) { return rect.left >= rect.right || rect.top >= rect.bottom; });
+    }
+
+    const auto needed = static_cast<DWORD>(sizeof(RGNDATAHEADER) + rects.size() * sizeof(RECT));
+    if (region == nullptr)
+    {
+        *size = needed;
+        return DD_OK;
+    }
+    if (*size < needed)
+    {
+        *size = needed;
+        return DDERR_INVALIDPARAMS;
+    }
+
+    RECT bound{};
+    if (!rects.empty())
+    {
+        bound = rects.front();
+        for (const auto &rect : rects)
+        {
+            bound = {
+                std::min(bound.left, rect.left),
+                std::min(bound.top, rect.top),
+                std::max(bound.right, rect.right),
+                std::max(bound.bottom, rect.bottom)};
+        }
+    }
+
+    region->rdh = {
+        .dwSize = sizeof(RGNDATAHEADER),
+        .iType = 1, // RDH_RECTANGLES
+        .nCount = static_cast<DWORD>(rects.size()),
+        .nRgnSize = static_cast<DWORD>(rects.size() * sizeof(RECT)),
+        .rcBound = bound};
+    std::memcpy(region->Buffer, rects.data(), rects.size() * sizeof(RECT));
+    return DD_OK;
+}
+
+HRESULT __stdcall clipper_get_hwnd(void *that, HWND *window)
+{
+    if (window == nullptr)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    *window = static_cast<soft_clipper *>(that)->window;
+    return DD_OK;
+}
+
+HRESULT __stdcall clipper_is_clip_list_changed(void *, BOOL *changed)
+{
+    if (changed == nullptr)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    *changed = 0;
+    return DD_OK;
+}
+
+HRESULT __stdcall clipper_set_clip_list(void *that, LPRGNDATA region, DWORD)
+{
+    auto *clipper = static_cast<soft_clipper *>(that);
+    if (region == nullptr)
+    {
+        clipper->clip_list.reset();
+        return DD_OK;
+    }
+
+    const auto *rects = reinterpret_cast<const RECT *>(region->Buffer);
+    clipper->clip_list.emplace(rects, rects + region->rdh.nCount);
+    return DD_OK;
+}
+
+HRESULT __stdcall clipper_set_hwnd(void *that, DWORD, HWND window)
+{
+    static_cast<soft_clipper *>(that)->window = window;
+    return DD_OK;
+}
+
+// DirectDraw methods
+
+HRESULT __stdcall ddraw_create_clipper(void *that, DWORD, LPDIRECTDRAWCLIPPER *clipper, IUnknown *)
+{
+    if (clipper == nullptr)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    auto *created = make_object<soft_clipper>(vtables().clipper);
+    if (created == nullptr)
+    {
+        return DDERR_OUTOFMEMORY;
+    }
+
+    created->owner = static_cast<soft_ddraw_object *>(that);
+    *clipper = reinterpret_cast<LPDIRECTDRAWCLIPPER>(created);
+    return DD_OK;
+}
+
+HRESULT __stdcall ddraw_create_palette(
+    void *,
+    DWORD caps,
+    LPPALETTEENTRY entries,
+    LPDIRECTDRAWPALETTE *palette,
+    IUnknown *)
+{
+    if (palette == nullptr)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+    if (!(caps & DDPCAPS_8BIT))
+    {
+        return DDERR_UNSUPPORTED;
+    }
+
+    auto *created = make_object<soft_palette>(vtables().palette);
+    if (created == nullptr)
+    {
+        return DDERR_OUTOFMEMORY;
+    }
+
+    created->caps = caps;
+    if (entries != nullptr)
+    {
+        std::copy_n(entries, created->entries.size(), created->entries.begin());
+    }
+
+    *palette = reinterpret_cast<LPDIRECTDRAWPALETTE>(created);
+    return DD_OK;
+}
+
+HRESULT __stdcall ddraw_create_surface(void *that, LPDDSURFACEDESC2 desc, LPDIRECTDRAWSURFACE7 *surface, IUnknown *)
+{
+    if (desc == nullptr || surface == nullptr || !(desc->dwFlags & DDSD_CAPS))
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    auto *ddraw = static_cast<soft_ddraw_object *>(that);
+    const auto caps = desc->ddsCaps.dwCaps;
+    const auto primary = (caps & DDSCAPS_PRIMARYSURFACE) != 0;
+    const auto sized = (desc->dwFlags & (DDSD_WIDTH | DDSD_HEIGHT)) == (DDSD_WIDTH | DDSD_HEIGHT);
+
+    // the primary surface is the display, anything else has to say how big it is
+    if (primary ? (desc->dwFlags & (DDSD_WIDTH | DDSD_HEIGHT)) != 0
+                : !sized || desc->dwWidth == 0 || desc->dwHeight == 0)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    auto format = std::optional{ddraw->options.display_format};
+    if (!primary && (desc->dwFlags & DDSD_PIXELFORMAT))
+    {
+        format = to_pixel_format(desc->ddpfPixelFormat);
+    }
+    if (!format)
+    {
+        return DDERR_INVALIDPIXELFORMAT;
+    }
+
+    const auto width = primary ? ddraw->options.display_width : desc->dwWidth;
+    const auto height = primary ? ddraw->options.display_height : desc->dwHeight;
+
+    // a flipping chain is a front buffer with dwBackBufferCount back buffers hanging off it
+    const auto flipping = (caps & DDSCAPS_FLIP) != 0;
+    const auto back_buffers = flipping && (desc->dwFlags & DDSD_BACKBUFFERCOUNT) ? desc->dwBackBufferCount : 0;
+    if (flipping && (back_buffers == 0 || !(caps & DDSCAPS_COMPLEX)))
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    auto *created = new_surface(ddraw, flipping ? caps | DDSCAPS_FRONTBUFFER : caps, width, height, *format);
+    if (created == nullptr)
+    {
+        return DDERR_OUTOFMEMORY;
+    }
+
+    if (desc->dwFlags & DDSD_CKSRCBLT)
+    {
+        created->source_key = desc->ddckCKSrcBlt;
+    }
+
+    const auto back_caps = (caps & ~(DDSCAPS_PRIMARYSURFACE | DDSCAPS_FRONTBUFFER)) | DDSCAPS_BACKBUFFER;
+    auto *last = created;
+    for (DWORD i = 0; i < back_buffers; ++i)
+    {
+        last->attached = new_surface(ddraw, back_caps, width, height, *format);
+        if (last->attached == nullptr)
+        {
+            release(created);
+            return DDERR_OUTOFMEMORY;
+        }
+        last = last->attached;
+    }
+
+    *surface = reinterpret_cast<LPDIRECTDRAWSURFACE7>(created);
+    return DD_OK;
+}
+
+HRESULT __stdcall ddraw_set_cooperative_level(void *that, HWND window, DWORD flags)
+{
+    auto *ddraw = static_cast<soft_ddraw_object *>(that);
+    ddraw->window = window;
+    ddraw->cooperative_level = flags;
+    return DD_OK;
+}
+
+// surfaces keep the format they were created with, only new ones see the new mode
+HRESULT __stdcall ddraw_set_display_mode(void *that, DWORD width, DWORD height, DWORD bits)
+{
+    const auto format = format_from_bits(bits);
+    if (!format || width == 0 || height == 0)
+    {
+        return DDERR_UNSUPPORTED;
+    }
+
+    auto &options = static_cast<soft_ddraw_object *>(that)->options;
+    options.display_width = width;
+    options.display_height = height;
+    options.display_format = *format;
+    return DD_OK;
+}
+
+HRESULT __stdcall ddraw_get_display_mode(void *that, LPDDSURFACEDESC2 desc)
+{
+    const auto &options = static_cast<soft_ddraw_object *>(that)->options;
+
+    DDSURFACEDESC2 mode{};
+    mode.dwSize = sizeof(mode);
+    mode.dwFlags = DDSD_WIDTH | DDSD_HEIGHT | DDSD_PITCH | DDSD_PIXELFORMAT;
+    mode.dwWidth = options.display_width;
+    mode.dwHeight = options.display_height;
+    mode.lPitch = static_cast<LONG>(options.display_width * bytes_per_pixel(options.display_format));
+    mode.ddpfPixelFormat = to_ddpixelformat(options.display_format);
+    return write_surface_desc(desc, mode) ? DD_OK : DDERR_INVALIDPARAMS;
+}
+
+HRESULT __stdcall ddraw_nothing_to_do(void *)
+{
+    return DD_OK;
+}
+
+HRESULT __stdcall ddraw_wait_for_vertical_blank(void *, DWORD, HANDLE)
+{
+    return DD_OK;
+}
+
+soft_vtables build_vtables()
+{
+    soft_vtables result{};
+
+    // IDirectDraw, the DirectDraw 1 interface DirectDrawCreate hands out, which is what the hooks are written against
+    result.ddraw.slots = unsupported_slots<2, 0, 0, 0, 3, 4, 3, 2, 4, 4, 0, 2, 1, 2, 1, 1, 1, 1, 1, 0, 2, 3, 2>();
+    set_slot<query_interface_method<IDirectDraw>>(result.ddraw.slots, object_query_interface);
+    set_slot<add_ref_method<IDirectDraw>>(result.ddraw.slots, object_add_ref<soft_ddraw_object>);
+    set_slot<release_method<IDirectDraw>>(result.ddraw.slots, object_release<soft_ddraw_object>);
+    set_slot<soft_ddraw_method::create_clipper>(result.ddraw.slots, ddraw_create_clipper);
+    set_slot<ddraw_method::create_palette>(result.ddraw.slots, ddraw_create_palette);
+    set_slot<ddraw_method::create_surface>(result.ddraw.slots, ddraw_create_surface);
+    set_slot<soft_ddraw_method::flip_to_gdi_surface>(result.ddraw.slots, ddraw_nothing_to_do);
+    set_slot<soft_ddraw_method::get_display_mode>(result.ddraw.slots, ddraw_get_display_mode);
+    set_slot<soft_ddraw_method::restore_display_mode>(result.ddraw.slots, ddraw_nothing_to_do);
+    set_slot<ddraw_method::set_cooperative_level>(result.ddraw.slots, ddraw_set_cooperative_level);
+    set_slot<ddraw_method::set_display_mode>(result.ddraw.slots, ddraw_set_display_mode);
+    set_slot<soft_ddraw_method::wait_for_vertical_blank>(result.ddraw.slots, ddraw_wait_for_vertical_blank);
+
+    // IDirectDrawSurface7, the first 36 slots are the same in every surface interface version
+    result.surface.slots = unsupported_slots<
+        2, 0, 0, 1, 1, 5, 3, 5, 2, 2, 3, 2, 2, 1, 1, 1, 2, 1, 1, 2, 1, 1, 1, 2, 0,
+        4, 1, 0, 1, 2, 2, 1, 1, 5, 1, 2, 1, 1, 1, 2, 4, 3, 1, 1, 0, 1, 1, 1, 1>();
+    set_slot<query_interface_method<IDirectDrawSurface7>>(result.surface.slots, object_query_interface);
+    set_slot<add_ref_method<IDirectDrawSurface7>>(result.surface.slots, object_add_ref<soft_surface>);
+    set_slot<release_method<IDirectDrawSurface7>>(result.surface.slots, object_release<soft_surface>);
+    set_slot<surface_method::blt>(result.surface.slots, surface_blt);
+    set_slot<surface_method::blt_batch>(result.surface.slots, surface_blt_batch);
+    set_slot<surface_method::blt_fast>(result.surface.slots, surface_blt_fast);
+    set_slot<surface_method::flip>(result.surface.slots, surface_flip);
+    set_slot<surface_method::get_attached_surface>(result.surface.slots, surface_get_attached_surface);
+    set_slot<soft_surface_method::get_clipper>(result.surface.slots, surface_get_clipper);
+    set_slot<soft_surface_method::get_color_key>(result.surface.slots, surface_get_color_key);
+    set_slot<soft_surface_method::get_palette>(result.surface.slots, surface_get_palette);
+    set_slot<surface_method::get_pixel_format>(result.surface.slots, surface_get_pixel_format);
+    set_slot<soft_surface_method::get_surface_desc>(result.surface.slots, surface_get_surface_desc);
+    set_slot<soft_surface_method::is_lost>(result.surface.slots, surface_is_lost);
+    set_slot<surface_method::lock>(result.surface.slots, surface_lock);
+    set_slot<soft_surface_method::restore>(result.surface.slots, surface_restore);
+    set_slot<soft_surface_method::set_clipper>(result.surface.slots, surface_set_clipper);
+    set_slot<surface_method::set_color_key>(result.surface.slots, surface_set_color_key);
+    set_slot<surface_method::set_palette>(result.surface.slots, surface_set_palette);
+    set_slot<surface_method::unlock>(result.surface.slots, surface_unlock);
+
+    result.palette.slots = unsupported_slots<2, 0, 0, 1, 4, 3, 4>();
+    set_slot<query_interface_method<IDirectDrawPalette>>(result.palette.slots, object_query_interface);
+    set_slot<add_ref_method<IDirectDrawPalette>>(result.palette.slots, object_add_ref<soft_palette>);
+    set_slot<release_method<IDirectDrawPalette>>(result.palette.slots, object_release<soft_palette>);
+    set_slot<soft_palette_method::get_caps>(result.palette.slots, palette_get_caps);
+    set_slot<soft_palette_method::get_entries>(result.palette.slots, palette_get_entries);
+    set_slot<palette_method::set_entries>(result.palette.slots, palette_set_entries);
+
+    result.clipper.slots = unsupported_slots<2, 0, 0, 3, 1, 2, 1, 2, 2>();
+    set_slot<query_interface_method<IDirectDrawClipper>>(result.clipper.slots, object_query_interface);
+    set_slot<add_ref_method<IDirectDrawClipper>>(result.clipper.slots, object_add_ref<soft_clipper>);
+    set_slot<release_method<IDirectDrawClipper>>(result.clipper.slots, object_release<soft_clipper>);
+    set_slot<soft_clipper_method::get_clip_list>(result.clipper.slots, clipper_get_clip_list);
+    set_slot<soft_clipper_method::get_hwnd>(result.clipper.slots, clipper_get_hwnd);
+    set_slot<soft_clipper_method::is_clip_list_changed>(result.clipper.slots, clipper_is_clip_list_changed);
+    set_slot<soft_clipper_method::set_clip_list>(result.clipper.slots, clipper_set_clip_list);
+    set_slot<soft_clipper_method::set_hwnd>(result.clipper.slots, clipper_set_hwnd);
+
+    result.ddraw.pristine = result.ddraw.slots;
+    result.surface.pristine = result.surface.slots;
+    result.palette.pristine = result.palette.slots;
+    result.clipper.pristine = result.clipper.slots;
+    return result;
+}
+
+soft_vtables &vtables()
+{
+    static soft_vtables instance = build_vtables();
+    return instance;
+}
+
+}
+
+LPDIRECTDRAW soft_ddraw_create(const soft_ddraw_options &options)
+{
+    auto *ddraw = make_object<soft_ddraw_object>(vtables().ddraw);
+    if (ddraw != nullptr)
+    {
+        ddraw->options = options;
+    }
+    return reinterpret_cast<LPDIRECTDRAW>(ddraw);
+}
+
+HRESULT __stdcall soft_direct_draw_create(GUID *, LPDIRECTDRAW *ddraw, IUnknown *)
+{
+    if (ddraw == nullptr)
+    {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    *ddraw = soft_ddraw_create();
+    return *ddraw != nullptr ? DD_OK : DDERR_OUTOFMEMORY;
+}
+
+void soft_ddraw_reset_vtables()
+{
+    auto &tables = vtables();
+    tables.ddraw.slots = tables.ddraw.pristine;
+    tables.surface.slots = tables.surface.pristine;
+    tables.palette.slots = tables.palette.pristine;
+    tables.clipper.slots = tables.clipper.pristine;
+}
+
+std::size_t soft_ddraw_live_objects()
+{
+    return g_live_objects;
+}
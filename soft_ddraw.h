@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ddraw_compat.h"
+#include "raster.h"
+
+// a DirectDraw that only exists in system memory
+// IDirectDraw, IDirectDrawSurface7, IDirectDrawPalette and IDirectDrawClipper look-alikes whose vtables have the same
+// slots as the real ones (the ones in ddraw_vtable.h included), so the hooks and vtable_hooks can be pointed at them
+// on a machine without ddraw.dll, blits go through the raster engine
+// everything the game and the hooks call is implemented, the rest of the slots return DDERR_UNSUPPORTED
+
+struct soft_ddraw_options
+{
+    std::uint32_t display_width{640};
+    std::uint32_t display_height{480};
+    pixel_format display_format{pixel_format::argb8888};
+};
+
+// a new DirectDraw object holding one reference, released through its vtable like the real one
+// its surfaces, palettes and clippers must be released before it is
+LPDIRECTDRAW soft_ddraw_create(const soft_ddraw_options &options = {});
+
+// drop-in for ::DirectDrawCreate with the default options
+HRESULT __stdcall soft_direct_draw_create(GUID *guid, LPDIRECTDRAW *ddraw, IUnknown *outer);
+
+// put the original functions back in every slot, undoing whatever was hooked since
+// the vtables are plain writable memory unlike the real ones, hook sets commit to them with g_writable_memory
+void soft_ddraw_reset_vtables();
+
+// objects not released yet, for leak checks
+std::size_t soft_ddraw_live_objects();
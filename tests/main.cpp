@@ -0,0 +1,40 @@
+#include <cstdio>
+#include <string_view>
+
+#include "../simd.h"
+#include "test.h"
+
+std::vector<test_suite> &test_suites()
+{
+    static std::vector<test_suite> suites{};
+    return suites;
+}
+
+// usage: blocks_tests [filter], runs every suite whose name contains filter, fails if any check did or none ran
+int main(int argc, char **argv)
+{
+    const std::string_view filter = argc > 1 ? argv[1] : "";
+
+    std::printf("simd level: %s\n", simd_level_name(detect_simd_level()));
+
+    auto ran = 0;
+    for (const auto &suite : test_suites())
+    {
+        if (!std::string_view{suite.name}.contains(filter))
+        {
+            continue;
+        }
+
+        const auto failures = g_test_failures;
+        suite.run();
+        std::printf("[%s] %s\n", suite.name, g_test_failures == failures ? "ok" : "failed");
+        ++ran;
+    }
+
+    if (ran == 0)
+    {
+        std::printf("no suite matches %.*s\n", static_cast<int>(filter.size()), filter.data());
+        return 1;
+    }
+    return g_test_failures == 0 ? 0 : 1;
+}
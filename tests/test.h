@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// tiny test harness, each test_*.cpp registers a suite which main() runs (optionally filtered by name), a failed
+// check prints where it was and fails the run but the suite carries on
+
+struct test_suite
+{
+    const char *name;
+    void (*run)();
+};
+
+std::vector<test_suite> &test_suites();
+
+struct test_registrar
+{
+    test_registrar(const char *name, void (*run)())
+    {
+        test_suites().push_back({name, run});
+    }
+};
+
+#define BLOCKS_TEST_SUITE(name, fn) static const test_registrar name##_registrar{#name, fn}
+
+inline int g_test_failures{};
+
+inline bool test_check(bool ok, const char *expression, const char *file, int line)
+{
+    if (!ok)
+    {
+        std::printf("%s:%d: check failed: %s\n", file, line, expression);
+        ++g_test_failures;
+    }
+    return ok;
+}
+
+#define BLOCKS_CHECK(expression) test_check(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
+
+// the random cases are the same on every run, a failure can be stepped through
+inline std::mt19937 test_rng()
+{
+    return std::mt19937{20240601};
+}
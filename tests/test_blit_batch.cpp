@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <vector>
+
+#include "../blit_batch.h"
+#include "../raster.h"
+#include "test.h"
+
+namespace
+{
+
+struct test_surface
+{
+    std::vector<std::uint8_t> storage;
+    raster_surface view;
+
+    test_surface(std::uint32_t width, std::uint32_t height)
+        : storage(static_cast<std::size_t>(width) * height * 4)
+        , view{storage.data(), static_cast<std::ptrdiff_t>(width * 4), width, height, pixel_format::argb8888}
+    {
+    }
+
+    test_surface(const test_surface &other)
+        : storage(other.storage)
+        , view{other.view}
+    {
+        view.pixels = storage.data();
+    }
+};
+
+// a wide and a tall back buffer reaching past the 64 cell grid (2048 pixels) and a sprite sheet, every one of
+// them is drawn to and read from
+std::vector<test_surface> make_surfaces()
+{
+    return {test_surface{2176, 72}, test_surface{72, 2176}, test_surface{160, 160}};
+}
+
+// few colours, so keys hit often
+constexpr std::uint32_t colours[]{0x00ff00ff, 0x00102030, 0x00405060, 0x00708090};
+
+// the commands name the surfaces of handles, run them on the same surfaces in surfaces
+void run(
+    std::vector<test_surface> &surfaces,
+    const std::vector<test_surface> &handles,
+    std::span<const blit_command> commands)
+{
+    const auto view = [&](const void *handle)
+    { return surfaces[static_cast<std::size_t>(static_cast<const test_surface *>(handle) - handles.data())].view; };
+
+    for (const auto &command : commands)
+    {
+        if (command.src == nullptr)
+        {
+            BLOCKS_CHECK(raster_fill(view(command.dst), &command.dst_rect, command.fill_color));
+        }
+        else
+        {
+            const auto *key = command.keyed ? &command.key : nullptr;
+            BLOCKS_CHECK(raster_blt(
+                view(command.dst),
+                &command.dst_rect,
+                view(command.src),
+                &command.src_rect,
+                {.source_key = key}));
+        }
+    }
+}
+
+raster_rect random_rect(std::mt19937 &rng, const raster_surface &surface, std::int32_t width, std::int32_t height)
+{
+    const auto span = [&](std::uint32_t size, std::int32_t length)
+    {
+        // now and then right across the last grid cell's edge
+        const auto limit = static_cast<std::int32_t>(size) - length;
+        if (size > 2048 && rng() % 3 == 0)
+        {
+            return std::min(limit, 2048 - length / 2 + static_cast<std::int32_t>(rng() % 9) - 4);
+        }
+        return static_cast<std::int32_t>(rng() % static_cast<std::uint32_t>(limit + 1));
+    };
+    const auto left = span(surface.width, width);
+    const auto top = span(surface.height, height);
+    return {left, top, left + width, top + height};
+}
+
+blit_command random_command(std::mt19937 &rng, const std::vector<test_surface> &surfaces)
+{
+    const auto dst_index = rng() % surfaces.size();
+    const auto &dst = surfaces[dst_index];
+    blit_command command{.dst = const_cast<test_surface *>(&dst)};
+
+    const auto size = [&](std::uint32_t limit) { return 1 + static_cast<std::int32_t>(rng() % std::min(limit, 96u)); };
+    const auto kind = rng() % 8;
+
+    // a fill of all of the surface or a big part of it, drawing over whatever came before
+    if (kind == 0)
+    {
+        command.dst_rect = rng() % 2 == 0 ? raster_rect{0, 0, static_cast<std::int32_t>(dst.view.width),
+                                                        static_cast<std::int32_t>(dst.view.height)}
+                                          : random_rect(rng, dst.view, size(dst.view.width), size(dst.view.height));
+        command.fill_color = colours[rng() % 4];
+        command.opaque = true;
+        return command;
+    }
+
+    const auto src_index = (dst_index + 1 + rng() % (surfaces.size() - 1)) % surfaces.size();
+    const auto &src = surfaces[src_index];
+    command.src = const_cast<test_surface *>(&src);
+
+    const auto width = size(std::min(dst.view.width, src.view.width));
+    const auto height = size(std::min(dst.view.height, src.view.height));
+    command.src_rect = random_rect(rng, src.view, width, height);
+
+    // mostly unstretched, some stretched to a different size
+    command.dst_rect = kind == 1 ? random_rect(rng, dst.view, size(dst.view.width), size(dst.view.height))
+                                 : random_rect(rng, dst.view, width, height);
+
+    // keyed blits leave pixels of what's below showing and so never hide an earlier blit
+    command.keyed = kind >= 5;
+    command.key = {colours[0], colours[0]};
+    command.opaque = !command.keyed;
+    return command;
+}
+
+void run_blit_batch_tests()
+{
+    auto rng = test_rng();
+    blit_batch batch{};
+    std::size_t dropped = 0;
+    std::size_t reordered = 0;
+
+    for (auto round = 0; round < 150; ++round)
+    {
+        auto expected = make_surfaces();
+        for (auto &surface : expected)
+        {
+            for (std::size_t i = 0; i < surface.storage.size(); i += 4)
+            {
+                const auto colour = colours[rng() % 4];
+                for (std::size_t byte = 0; byte < 4; ++byte)
+                {
+                    surface.storage[i + byte] = static_cast<std::uint8_t>(colour >> (byte * 8));
+                }
+            }
+        }
+        auto actual = expected;
+
+        std::vector<blit_command> commands{};
+        const auto count = 1 + rng() % 120;
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            commands.push_back(random_command(rng, expected));
+        }
+
+        for (const auto &command : commands)
+        {
+            batch_add(batch, command);
+        }
+        const auto scheduled = batch_schedule(batch);
+        BLOCKS_CHECK(batch.commands.empty());
+        dropped += commands.size() - scheduled.size();
+        const auto moved = [&](std::size_t i)
+        {
+            return scheduled[i].dst != commands[i].dst || scheduled[i].dst_rect.left != commands[i].dst_rect.left ||
+                   scheduled[i].dst_rect.top != commands[i].dst_rect.top;
+        };
+        for (std::size_t i = 0; scheduled.size() == commands.size() && i < scheduled.size(); ++i)
+        {
+            if (moved(i))
+            {
+                ++reordered;
+                break;
+            }
+        }
+
+        // the scheduled order draws the same picture on every surface as the order the calls were made in
+        run(actual, expected, scheduled);
+        run(expected, expected, commands);
+        for (std::size_t i = 0; i < expected.size(); ++i)
+        {
+            if (!BLOCKS_CHECK(actual[i].storage == expected[i].storage))
+            {
+                std::printf("    round %d, surface %zu, %zu of %zu blits kept\n",
+                            round,
+                            i,
+                            scheduled.size(),
+                            commands.size());
+                return;
+            }
+        }
+    }
+
+    // the batches have to have given the scheduler something to do
+    BLOCKS_CHECK(dropped > 0 && reordered > 0);
+}
+
+}
+
+BLOCKS_TEST_SUITE(blit_batch, run_blit_batch_tests);
@@ -0,0 +1,178 @@
+#include <cstdint>
+#include <vector>
+
+#include "../bmp.h"
+#include "test.h"
+
+namespace
+{
+
+void put_u16(std::vector<std::uint8_t> &file, std::size_t at, std::uint32_t value)
+{
+    file[at] = static_cast<std::uint8_t>(value);
+    file[at + 1] = static_cast<std::uint8_t>(value >> 8);
+}
+
+void put_u32(std::vector<std::uint8_t> &file, std::size_t at, std::uint32_t value)
+{
+    put_u16(file, at, value);
+    put_u16(file, at + 2, value >> 16);
+}
+
+// offsets of the fields the parser reads, file header then BITMAPINFOHEADER
+constexpr std::size_t pixel_offset_at = 10;
+constexpr std::size_t header_size_at = 14;
+constexpr std::size_t width_at = 18;
+constexpr std::size_t height_at = 22;
+constexpr std::size_t planes_at = 26;
+constexpr std::size_t bits_at = 28;
+constexpr std::size_t compression_at = 30;
+constexpr std::size_t colors_used_at = 46;
+
+// an 8bpp file the way paint writes one, pixel (x, y) of the stored rows holds x + 16 * y
+std::vector<std::uint8_t> make_bmp(std::int32_t width, std::int32_t height, std::uint32_t colors = 256)
+{
+    const auto rows = static_cast<std::size_t>(height < 0 ? -height : height);
+    const auto stride = (static_cast<std::size_t>(width) + 3) / 4 * 4;
+    const auto pixel_offset = 14 + 40 + colors * 4;
+
+    std::vector<std::uint8_t> file(pixel_offset + stride * rows);
+    file[0] = 'B';
+    file[1] = 'M';
+    put_u32(file, 2, static_cast<std::uint32_t>(file.size()));
+    put_u32(file, pixel_offset_at, static_cast<std::uint32_t>(pixel_offset));
+    put_u32(file, header_size_at, 40);
+    put_u32(file, width_at, static_cast<std::uint32_t>(width));
+    put_u32(file, height_at, static_cast<std::uint32_t>(height));
+    put_u16(file, planes_at, 1);
+    put_u16(file, bits_at, 8);
+    put_u32(file, colors_used_at, colors == 256 ? 0 : colors);
+
+    for (std::uint32_t i = 0; i < colors; ++i)
+    {
+        file[54 + i * 4] = static_cast<std::uint8_t>(i);
+        file[54 + i * 4 + 2] = static_cast<std::uint8_t>(255 - i);
+    }
+    for (std::size_t y = 0; y < rows; ++y)
+    {
+        for (std::size_t x = 0; x < static_cast<std::size_t>(width); ++x)
+        {
+            file[pixel_offset + y * stride + x] = static_cast<std::uint8_t>(x + 16 * y);
+        }
+    }
+    return file;
+}
+
+bmp_error parse(const std::vector<std::uint8_t> &file)
+{
+    bmp_image image{};
+    return parse_bmp(file, image);
+}
+
+void check_valid()
+{
+    // bottom-up, the stored rows come out last first
+    {
+        const auto file = make_bmp(5, 3);
+        bmp_image image{};
+        BLOCKS_CHECK(parse_bmp(file, image) == bmp_error::none);
+        BLOCKS_CHECK(image.width == 5 && image.height == 3 && image.bottom_up && image.stride == 8);
+        BLOCKS_CHECK(image.pixel_offset == 14 + 40 + 1024);
+        BLOCKS_CHECK(image.palette.size() == 256 && image.palette[3].blue == 3 && image.palette[3].red == 252);
+        BLOCKS_CHECK(image.pixels.width == 5 && image.pixels.height == 3);
+        BLOCKS_CHECK(image.pixels.pixels[0] == 32 && image.pixels.pixels[4] == 36);
+        BLOCKS_CHECK(image.pixels.pixels[2 * image.pixels.pitch + 1] == 1);
+    }
+
+    // top-down, and a short colour table
+    {
+        const auto file = make_bmp(7, -2, 16);
+        bmp_image image{};
+        BLOCKS_CHECK(parse_bmp(file, image) == bmp_error::none);
+        BLOCKS_CHECK(image.width == 7 && image.height == 2 && !image.bottom_up && image.palette.size() == 16);
+        BLOCKS_CHECK(image.pixels.pitch == 8 && image.pixels.pixels[image.pixels.pitch + 6] == 22);
+    }
+
+    // a larger header version, the colour table follows wherever it ends
+    {
+        auto file = make_bmp(4, 4);
+        file.insert(file.begin() + 54, 84, 0);
+        put_u32(file, header_size_at, 124);
+        put_u32(file, pixel_offset_at, 14 + 124 + 1024);
+        BLOCKS_CHECK(parse(file) == bmp_error::none);
+    }
+}
+
+void check_malformed()
+{
+    const auto valid = make_bmp(9, 5);
+
+    // every cut short file is refused, whichever part it ends in
+    for (std::size_t size = 0; size < valid.size(); ++size)
+    {
+        const std::vector<std::uint8_t> cut{valid.begin(), valid.begin() + static_cast<std::ptrdiff_t>(size)};
+        if (!BLOCKS_CHECK(parse(cut) != bmp_error::none))
+        {
+            std::printf("    accepted %zu of %zu bytes\n", size, valid.size());
+            break;
+        }
+    }
+
+    const auto with = [&](std::size_t at, std::uint32_t value, bool wide = true)
+    {
+        auto file = valid;
+        wide ? put_u32(file, at, value) : put_u16(file, at, value);
+        return parse(file);
+    };
+
+    BLOCKS_CHECK(with(0, 0x4d43, false) == bmp_error::not_a_bitmap);
+    BLOCKS_CHECK(with(header_size_at, 12) == bmp_error::unsupported_header);
+    BLOCKS_CHECK(with(header_size_at, static_cast<std::uint32_t>(valid.size())) == bmp_error::unsupported_header);
+    BLOCKS_CHECK(with(width_at, 0) == bmp_error::unsupported_format);
+    BLOCKS_CHECK(with(width_at, static_cast<std::uint32_t>(-9)) == bmp_error::unsupported_format);
+    BLOCKS_CHECK(with(height_at, 0) == bmp_error::unsupported_format);
+    BLOCKS_CHECK(with(height_at, 0x80000000u) == bmp_error::unsupported_format);
+    BLOCKS_CHECK(with(planes_at, 2, false) == bmp_error::unsupported_format);
+    BLOCKS_CHECK(with(bits_at, 24, false) == bmp_error::unsupported_format);
+    BLOCKS_CHECK(with(compression_at, 1) == bmp_error::unsupported_format);
+    BLOCKS_CHECK(with(colors_used_at, 257) == bmp_error::bad_palette);
+    BLOCKS_CHECK(with(pixel_offset_at, 14 + 40 + 1000) == bmp_error::bad_pixel_offset);
+    BLOCKS_CHECK(with(pixel_offset_at, static_cast<std::uint32_t>(valid.size()) + 1) == bmp_error::bad_pixel_offset);
+
+    // more rows than the file holds
+    BLOCKS_CHECK(with(height_at, 6) == bmp_error::bad_pixel_offset);
+    BLOCKS_CHECK(with(height_at, static_cast<std::uint32_t>(-6)) == bmp_error::bad_pixel_offset);
+}
+
+void check_overflow()
+{
+    // stride * rows of these wraps around to 0 or next to it in 32 bits, none of them may pass for a small image
+    const std::pair<std::uint32_t, std::uint32_t> sizes[]{
+        {0x40000000, 4},
+        {0x40000000, 0x7fffffff},
+        {0x7fffffff, 2},
+        {0x10000000, 16},
+        {0x20000000, 8}};
+
+    for (const auto &[width, height] : sizes)
+    {
+        auto file = make_bmp(4, 4);
+        put_u32(file, width_at, width);
+        put_u32(file, height_at, height);
+        if (!BLOCKS_CHECK(parse(file) == bmp_error::bad_pixel_offset))
+        {
+            std::printf("    accepted %#x x %#x\n", width, height);
+        }
+    }
+}
+
+void run_bmp_tests()
+{
+    check_valid();
+    check_malformed();
+    check_overflow();
+}
+
+}
+
+BLOCKS_TEST_SUITE(bmp, run_bmp_tests);
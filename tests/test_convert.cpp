@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "../palette_convert.h"
+#include "../scale.h"
+#include "../scale_filter.h"
+#include "../thread_pool.h"
+#include "test.h"
+
+namespace
+{
+
+// every vector path against the scalar one, on whatever this cpu supports
+std::vector<simd_level> vector_levels()
+{
+    std::vector<simd_level> levels;
+    for (const auto level : {simd_level::sse2, simd_level::avx2})
+    {
+        if (level <= detect_simd_level())
+        {
+            levels.push_back(level);
+        }
+    }
+    return levels;
+}
+
+struct test_frame
+{
+    std::vector<std::uint32_t> storage;
+    raster_surface view;
+
+    test_frame(std::uint32_t width, std::uint32_t height)
+        : storage(static_cast<std::size_t>(width) * height)
+        , view{
+              reinterpret_cast<std::uint8_t *>(storage.data()),
+              static_cast<std::ptrdiff_t>(width * sizeof(std::uint32_t)),
+              width,
+              height,
+              pixel_format::argb8888}
+    {
+    }
+};
+
+void check_palette_conversion()
+{
+    auto rng = test_rng();
+    palette_lut lut{};
+    for (auto &entry : lut)
+    {
+        entry = rng() & 0xffffff;
+    }
+
+    for (auto round = 0; round < 50; ++round)
+    {
+        const auto width = 1 + static_cast<std::uint32_t>(rng() % 200);
+        const auto height = 1 + static_cast<std::uint32_t>(rng() % 10);
+        std::vector<std::uint8_t> indices(static_cast<std::size_t>(width) * height);
+        for (auto &index : indices)
+        {
+            index = static_cast<std::uint8_t>(rng());
+        }
+
+        // bottom-up too, the negative pitch walks the rows backwards
+        const auto src = round % 2 == 0
+                             ? indexed_view{indices.data(), static_cast<std::ptrdiff_t>(width), width, height}
+                             : bottom_up_view(indices.data(), width, height, width);
+
+        // one spare pixel per row that no kernel may touch
+        const auto pitch = static_cast<std::ptrdiff_t>((width + 1) * sizeof(std::uint32_t));
+        std::vector<std::uint32_t> expected((width + 1) * height, 0xdeadbeef);
+        convert_indexed_to_bgra(
+            src,
+            {reinterpret_cast<std::uint8_t *>(expected.data()), pitch, width, height},
+            lut,
+            simd_level::scalar);
+
+        for (std::uint32_t y = 0; y < height; ++y)
+        {
+            const auto *row = src.pixels + static_cast<std::ptrdiff_t>(y) * src.pitch;
+            BLOCKS_CHECK(expected[y * (width + 1)] == lut[row[0]]);
+            BLOCKS_CHECK(expected[y * (width + 1) + width] == 0xdeadbeef);
+        }
+
+        for (const auto level : vector_levels())
+        {
+            std::vector<std::uint32_t> actual((width + 1) * height, 0xdeadbeef);
+            const bgra_view dst{reinterpret_cast<std::uint8_t *>(actual.data()), pitch, width, height};
+            convert_indexed_to_bgra(src, dst, lut, level);
+            BLOCKS_CHECK(actual == expected);
+        }
+    }
+}
+
+void check_bilinear()
+{
+    auto rng = test_rng();
+    test_frame src{61, 47};
+    for (auto &pixel : src.storage)
+    {
+        pixel = rng();
+    }
+
+    for (const auto &[width, height] : {std::pair{122u, 94u}, std::pair{200u, 131u}, std::pair{40u, 30u}})
+    {
+        const raster_rect dst_rect{3, 2, 3 + static_cast<std::int32_t>(width), 2 + static_cast<std::int32_t>(height)};
+        test_frame expected{width + 6, height + 4};
+        BLOCKS_CHECK(scale_bilinear(expected.view, dst_rect, src.view, {0, 0, 61, 47}, simd_level::scalar));
+
+        for (const auto level : vector_levels())
+        {
+            test_frame actual{width + 6, height + 4};
+            BLOCKS_CHECK(scale_bilinear(actual.view, dst_rect, src.view, {0, 0, 61, 47}, level));
+            BLOCKS_CHECK(actual.storage == expected.storage);
+        }
+    }
+}
+
+void check_scale_filters()
+{
+    auto rng = test_rng();
+
+    // a 3 pixel L scaled 2x, the inside corner is rounded off and nothing else changes
+    {
+        test_frame src{3, 3};
+        src.storage = {1, 1, 2, 1, 2, 2, 2, 2, 2};
+        test_frame dst{6, 6};
+        const raster_rect src_rect{0, 0, 3, 3};
+        BLOCKS_CHECK(
+            scale_filter_rows(scale_mode::scale2x, dst.view, 0, 0, src.view, src_rect, 0, 6, simd_level::scalar));
+        const std::vector<std::uint32_t> expected{
+            1, 1, 1, 1, 2, 2, //
+            1, 1, 1, 2, 2, 2, //
+            1, 1, 1, 2, 2, 2, //
+            1, 2, 2, 2, 2, 2, //
+            2, 2, 2, 2, 2, 2, //
+            2, 2, 2, 2, 2, 2};
+        BLOCKS_CHECK(dst.storage == expected);
+    }
+
+    // the vector kernels, and bands of any size, give the same frame as the scalar rule in one go
+    for (const auto mode : {scale_mode::scale2x, scale_mode::scale3x, scale_mode::xbr})
+    {
+        for (auto round = 0; round < 20; ++round)
+        {
+            const auto width = 1 + static_cast<std::uint32_t>(rng() % 40);
+            const auto height = 1 + static_cast<std::uint32_t>(rng() % 20);
+            test_frame src{width, height};
+            for (auto &pixel : src.storage)
+            {
+                pixel = 0xff000000u | (rng() % 3) * 0x405060u;
+            }
+
+            const auto factor = scale_filter_factor(mode);
+            const raster_rect src_rect{0, 0, static_cast<std::int32_t>(width), static_cast<std::int32_t>(height)};
+            test_frame expected{width * factor + 3, height * factor + 2};
+            const auto rows = height * factor;
+            BLOCKS_CHECK(
+                scale_filter_rows(mode, expected.view, 1, 2, src.view, src_rect, 0, rows, simd_level::scalar));
+
+            for (const auto level : vector_levels())
+            {
+                test_frame actual{width * factor + 3, height * factor + 2};
+                for (std::uint32_t first = 0; first < rows;)
+                {
+                    const auto last = std::min(rows, first + 1 + static_cast<std::uint32_t>(rng() % 5));
+                    BLOCKS_CHECK(scale_filter_rows(mode, actual.view, 1, 2, src.view, src_rect, first, last, level));
+                    first = last;
+                }
+                BLOCKS_CHECK(actual.storage == expected.storage);
+            }
+        }
+    }
+
+    // 5x is a 2x or 3x pass made up to size with nearest neighbour, all of dst_rect gets written
+    thread_pool pool{};
+    scale_filter_frames frames{};
+    test_frame src{64, 48};
+    for (auto &pixel : src.storage)
+    {
+        pixel = 0xff000000u | (rng() % 2) * 0xffffffu;
+    }
+    for (const auto mode : {scale_mode::scale2x, scale_mode::scale3x, scale_mode::xbr})
+    {
+        test_frame dst{64 * 5, 48 * 5};
+        std::fill(dst.storage.begin(), dst.storage.end(), 0x12345678u);
+        const auto rect = scale_layout(mode, 64, 48, 64 * 5, 48 * 5);
+        BLOCKS_CHECK(rect.right - rect.left == 64 * 5 && rect.bottom - rect.top == 48 * 5);
+        BLOCKS_CHECK(scale_filter(pool, frames, mode, dst.view, rect, src.view, {0, 0, 64, 48}, detect_simd_level()));
+        BLOCKS_CHECK(std::find(dst.storage.begin(), dst.storage.end(), 0x12345678u) == dst.storage.end());
+    }
+    BLOCKS_CHECK(scale_filter_passes(scale_mode::scale2x, 4) == 2);
+    BLOCKS_CHECK(scale_filter_passes(scale_mode::scale3x, 5) == 1);
+    BLOCKS_CHECK(scale_filter_passes(scale_mode::xbr, 1) == 0);
+}
+
+void run_convert_tests()
+{
+    check_palette_conversion();
+    check_bilinear();
+    check_scale_filters();
+}
+
+}
+
+BLOCKS_TEST_SUITE(convert, run_convert_tests);
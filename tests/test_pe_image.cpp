@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "../pe_image.h"
+#include "test.h"
+
+namespace
+{
+
+void put_u16(std::vector<std::uint8_t> &file, std::size_t at, std::uint32_t value)
+{
+    file[at] = static_cast<std::uint8_t>(value);
+    file[at + 1] = static_cast<std::uint8_t>(value >> 8);
+}
+
+void put_u32(std::vector<std::uint8_t> &file, std::size_t at, std::uint32_t value)
+{
+    put_u16(file, at, value);
+    put_u16(file, at + 2, value >> 16);
+}
+
+void put_name(std::vector<std::uint8_t> &file, std::size_t at, const char *name)
+{
+    std::memcpy(file.data() + at, name, std::strlen(name) + 1);
+}
+
+// offsets of the fields the parser reads, the headers start at 0x40 right after the dos header
+constexpr std::size_t nt_at = 0x40;
+constexpr std::size_t section_count_at = nt_at + 4 + 2;
+constexpr std::size_t optional_size_at = nt_at + 4 + 16;
+constexpr std::size_t optional_at = nt_at + 4 + 20;
+constexpr std::size_t directory_count_at = optional_at + 92;
+constexpr std::size_t import_directory_at = optional_at + 96 + 8;
+constexpr std::size_t sections_at = optional_at + 224;
+
+// the sections: .text at rva 0x1000 and .idata at rva 0x2000, each 0x200 bytes of file
+constexpr std::size_t text_raw = 0x200;
+constexpr std::size_t idata_raw = 0x400;
+constexpr std::uint32_t idata_rva = 0x2000;
+
+// file offsets of the rvas in .idata
+constexpr std::size_t idata(std::uint32_t rva)
+{
+    return idata_raw + (rva - idata_rva);
+}
+
+constexpr std::uint32_t descriptor_rva = 0x2000;
+constexpr std::uint32_t name_table_rva = 0x2040;
+constexpr std::uint32_t address_table_rva = 0x2060;
+constexpr std::uint32_t hint_name_rva = 0x2080;
+constexpr std::uint32_t dll_name_rva = 0x2100;
+
+// a 32 bit exe the way the game's looks, importing DirectDrawCreate by name and ordinal 16 from DDRAW.dll
+std::vector<std::uint8_t> make_exe()
+{
+    std::vector<std::uint8_t> file(0x600);
+    file[0] = 'M';
+    file[1] = 'Z';
+    put_u32(file, 0x3c, nt_at);
+    put_name(file, nt_at, "PE");
+
+    put_u16(file, nt_at + 4, 0x14c);
+    put_u16(file, section_count_at, 2);
+    put_u32(file, nt_at + 4 + 4, 0x3a2b1c0d);
+    put_u16(file, optional_size_at, 224);
+
+    put_u16(file, optional_at, 0x10b);
+    put_u32(file, optional_at + 28, 0x400000);
+    put_u32(file, optional_at + 56, 0x3000);
+    put_u32(file, optional_at + 60, 0x200);
+    put_u32(file, optional_at + 64, 0xc0ffee);
+    put_u32(file, directory_count_at, 16);
+    put_u32(file, import_directory_at, descriptor_rva);
+    put_u32(file, import_directory_at + 4, 40);
+
+    const auto section = [&](std::size_t index, const char *name, std::uint32_t rva, std::size_t raw)
+    {
+        const auto at = sections_at + index * 40;
+        std::memcpy(file.data() + at, name, std::strlen(name));
+        put_u32(file, at + 8, 0x100);
+        put_u32(file, at + 12, rva);
+        put_u32(file, at + 16, 0x200);
+        put_u32(file, at + 20, static_cast<std::uint32_t>(raw));
+        put_u32(file, at + 36, 0x40000040);
+    };
+    section(0, ".text", 0x1000, text_raw);
+    section(1, ".idata", idata_rva, idata_raw);
+
+    put_u32(file, idata(descriptor_rva), name_table_rva);
+    put_u32(file, idata(descriptor_rva) + 12, dll_name_rva);
+    put_u32(file, idata(descriptor_rva) + 16, address_table_rva);
+    for (const auto table : {name_table_rva, address_table_rva})
+    {
+        put_u32(file, idata(table), hint_name_rva);
+        put_u32(file, idata(table) + 4, 0x80000010);
+    }
+    put_u16(file, idata(hint_name_rva), 5);
+    put_name(file, idata(hint_name_rva) + 2, "DirectDrawCreate");
+    put_name(file, idata(dll_name_rva), "DDRAW.dll");
+    return file;
+}
+
+// the same exe as the loader lays it out, with the address table overwritten by the bound addresses
+std::vector<std::uint8_t> map_exe(const std::vector<std::uint8_t> &file)
+{
+    std::vector<std::uint8_t> mapped(0x3000);
+    std::copy_n(file.begin(), 0x200, mapped.begin());
+    std::copy_n(file.begin() + text_raw, 0x200, mapped.begin() + 0x1000);
+    std::copy_n(file.begin() + idata_raw, 0x200, mapped.begin() + idata_rva);
+    put_u32(mapped, address_table_rva, 0x77001234);
+    put_u32(mapped, address_table_rva + 4, 0x77005678);
+    return mapped;
+}
+
+pe_error parse(const std::vector<std::uint8_t> &bytes, pe_layout layout = pe_layout::file)
+{
+    pe_image image{};
+    return pe_parse(bytes, layout, image);
+}
+
+pe_error read_imports(const std::vector<std::uint8_t> &bytes, pe_layout layout = pe_layout::file)
+{
+    pe_image image{};
+    const auto error = pe_parse(bytes, layout, image);
+    return error != pe_error::none ? error : pe_read_imports(bytes, layout, image);
+}
+
+void check_valid()
+{
+    const auto file = make_exe();
+    for (const auto layout : {pe_layout::file, pe_layout::mapped})
+    {
+        const auto bytes = layout == pe_layout::file ? file : map_exe(file);
+        pe_image image{};
+        BLOCKS_CHECK(pe_parse(bytes, layout, image) == pe_error::none);
+        BLOCKS_CHECK(image.machine == 0x14c && !image.pe32_plus && image.timestamp == 0x3a2b1c0d);
+        BLOCKS_CHECK(image.image_base == 0x400000 && image.size_of_image == 0x3000 && image.checksum == 0xc0ffee);
+        BLOCKS_CHECK(image.sections.size() == 2 && pe_find_section(image, ".idata") == &image.sections[1]);
+        BLOCKS_CHECK(image.sections[1].rva == idata_rva && image.sections[1].raw_offset == idata_raw);
+        BLOCKS_CHECK(pe_find_section(image, ".rsrc") == nullptr);
+
+        BLOCKS_CHECK(pe_read_imports(bytes, layout, image) == pe_error::none);
+        BLOCKS_CHECK(image.imports.size() == 2);
+        const auto *create = pe_find_import(image, "ddraw.dll", "DirectDrawCreate");
+        BLOCKS_CHECK(create != nullptr && create->ordinal == 5 && create->iat_rva == address_table_rva);
+        BLOCKS_CHECK(image.imports[1].function.empty() && image.imports[1].ordinal == 16);
+        BLOCKS_CHECK(image.imports[1].iat_rva == address_table_rva + 4);
+    }
+
+    // an old linker's exe without a name table, once mapped only the bound addresses are left
+    {
+        auto file_without = file;
+        put_u32(file_without, idata(descriptor_rva), 0);
+        BLOCKS_CHECK(read_imports(file_without) == pe_error::none);
+
+        const auto mapped = map_exe(file_without);
+        pe_image image{};
+        BLOCKS_CHECK(pe_parse(mapped, pe_layout::mapped, image) == pe_error::none);
+        BLOCKS_CHECK(pe_read_imports(mapped, pe_layout::mapped, image) == pe_error::none);
+        BLOCKS_CHECK(image.imports.size() == 2 && image.imports[0].function.empty());
+        BLOCKS_CHECK(image.imports[0].dll == "DDRAW.dll" && image.imports[1].iat_rva == address_table_rva + 4);
+    }
+
+    // no import directory at all is no imports rather than an error
+    {
+        auto without = file;
+        put_u32(without, directory_count_at, 1);
+        pe_image image{};
+        BLOCKS_CHECK(pe_parse(without, pe_layout::file, image) == pe_error::none);
+        BLOCKS_CHECK(pe_read_imports(without, pe_layout::file, image) == pe_error::none && image.imports.empty());
+    }
+}
+
+void check_headers()
+{
+    const auto valid = make_exe();
+
+    // every cut short file is refused, whichever header or section it ends in
+    for (std::size_t size = 0; size < valid.size(); ++size)
+    {
+        const std::vector<std::uint8_t> cut{valid.begin(), valid.begin() + static_cast<std::ptrdiff_t>(size)};
+        if (!BLOCKS_CHECK(parse(cut) != pe_error::none))
+        {
+            std::printf("    accepted %zu of %zu bytes\n", size, valid.size());
+            break;
+        }
+    }
+
+    const auto with = [&](std::size_t at, std::uint32_t value, bool wide = true)
+    {
+        auto file = valid;
+        wide ? put_u32(file, at, value) : put_u16(file, at, value);
+        return parse(file);
+    };
+
+    BLOCKS_CHECK(with(0, 0x4d5a, false) == pe_error::not_an_executable);
+    BLOCKS_CHECK(with(nt_at, 0x4c45) == pe_error::not_an_executable);
+    BLOCKS_CHECK(with(0x3c, 0xffffffff) == pe_error::truncated);
+    BLOCKS_CHECK(with(0x3c, 0x600 - 4) == pe_error::truncated);
+    BLOCKS_CHECK(with(0x3c, 0x80000000) == pe_error::truncated);
+    BLOCKS_CHECK(with(optional_size_at, 0xffff, false) == pe_error::truncated);
+    BLOCKS_CHECK(with(optional_at, 0x107, false) == pe_error::unsupported_format);
+    BLOCKS_CHECK(with(optional_size_at, 95, false) == pe_error::unsupported_format);
+    BLOCKS_CHECK(with(section_count_at, 0xffff, false) == pe_error::bad_section_table);
+    BLOCKS_CHECK(with(section_count_at, 31, false) == pe_error::bad_section_table);
+
+    // raw data past the end of the file, in the last two offset + size wraps around to a small number in 32 bits
+    BLOCKS_CHECK(with(sections_at + 40 + 16, 0x201) == pe_error::bad_section_table);
+    BLOCKS_CHECK(with(sections_at + 40 + 20, 0xffffff00) == pe_error::bad_section_table);
+    {
+        auto file = valid;
+        put_u32(file, sections_at + 40 + 20, 0xffffff00);
+        put_u32(file, sections_at + 40 + 16, 0x100);
+        BLOCKS_CHECK(parse(file) == pe_error::bad_section_table);
+    }
+
+    // mapped, the sections have to fit in the mapping instead
+    auto mapped = map_exe(valid);
+    put_u32(mapped, sections_at + 40 + 8, 0x1001);
+    BLOCKS_CHECK(parse(mapped, pe_layout::mapped) == pe_error::bad_section_table);
+    put_u32(mapped, sections_at + 40 + 12, 0xffffff00);
+    BLOCKS_CHECK(parse(mapped, pe_layout::mapped) == pe_error::bad_section_table);
+
+    // a refused file leaves the image as it was
+    auto file = valid;
+    put_u16(file, section_count_at, 0xffff);
+    pe_image image{};
+    image.machine = 0x1234;
+    BLOCKS_CHECK(pe_parse(file, pe_layout::file, image) == pe_error::bad_section_table);
+    BLOCKS_CHECK(image.machine == 0x1234 && image.sections.empty());
+}
+
+void check_imports()
+{
+    const auto valid = make_exe();
+    const auto with = [&](std::size_t at, std::uint32_t value)
+    {
+        auto file = valid;
+        put_u32(file, at, value);
+        return read_imports(file);
+    };
+
+    // tables outside every section, or running off the end of theirs
+    BLOCKS_CHECK(with(import_directory_at, 0x5000) == pe_error::bad_import_table);
+    BLOCKS_CHECK(with(import_directory_at, 0xfffffff0) == pe_error::bad_import_table);
+    BLOCKS_CHECK(with(import_directory_at, idata_rva + 0x200 - 8) == pe_error::bad_import_table);
+    BLOCKS_CHECK(with(idata(descriptor_rva), idata_rva + 0x1fe) == pe_error::bad_import_table);
+    BLOCKS_CHECK(with(idata(descriptor_rva) + 12, 0x7000) == pe_error::bad_import_table);
+    BLOCKS_CHECK(with(idata(name_table_rva), 0x7ffffffe) == pe_error::bad_import_table);
+    BLOCKS_CHECK(with(idata(name_table_rva), idata_rva + 0x1ff) == pe_error::bad_import_table);
+
+    // dll names that end at the end of the file, run on past what any real name would, or are empty
+    {
+        auto file = valid;
+        std::fill(file.end() - 16, file.end(), 'a');
+        put_u32(file, idata(descriptor_rva) + 12, idata_rva + 0x200 - 16);
+        BLOCKS_CHECK(read_imports(file) == pe_error::bad_import_table);
+    }
+    {
+        auto file = valid;
+        std::fill(file.begin() + text_raw, file.begin() + text_raw + 0x200, 'a');
+        put_u32(file, idata(descriptor_rva) + 12, 0x1000);
+        BLOCKS_CHECK(read_imports(file) == pe_error::bad_import_table);
+    }
+    {
+        auto file = valid;
+        file[idata(dll_name_rva)] = 0;
+        BLOCKS_CHECK(read_imports(file) == pe_error::bad_import_table);
+    }
+}
+
+void check_import_cache()
+{
+    const auto path = std::filesystem::temp_directory_path() / "blocks_test_imports.txt";
+
+    // an import the build doesn't have is stored as rva 0, so the next start knows it's missing without a walk
+    const std::vector<pe_import_slot> slots{
+        {"DDRAW.dll", "DirectDrawCreate", address_table_rva},
+        {"USER32.dll", "LoadImageA", 0}};
+    BLOCKS_CHECK(pe_import_cache_store(path, 0x3a2b1c0d, 0xc0ffee, slots));
+
+    const auto loaded = pe_import_cache_load(path, 0x3a2b1c0d, 0xc0ffee);
+    BLOCKS_CHECK(loaded && loaded->size() == 2);
+    if (loaded && loaded->size() == 2)
+    {
+        BLOCKS_CHECK((*loaded)[0].function == "DirectDrawCreate" && (*loaded)[0].iat_rva == address_table_rva);
+        BLOCKS_CHECK((*loaded)[1].dll == "USER32.dll" && (*loaded)[1].iat_rva == 0);
+    }
+
+    // another build of the exe misses
+    BLOCKS_CHECK(!pe_import_cache_load(path, 0x3a2b1c0e, 0xc0ffee));
+    BLOCKS_CHECK(!pe_import_cache_load(path, 0x3a2b1c0d, 0));
+
+    std::error_code error{};
+    std::filesystem::remove(path, error);
+}
+
+void run_pe_image_tests()
+{
+    check_valid();
+    check_headers();
+    check_imports();
+    check_import_cache();
+}
+
+}
+
+BLOCKS_TEST_SUITE(pe_image, run_pe_image_tests);
@@ -0,0 +1,401 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "../raster.h"
+#include "test.h"
+
+namespace
+{
+
+struct test_surface
+{
+    std::vector<std::uint8_t> storage;
+    raster_surface view;
+
+    // a few bytes of slack on each row, so a kernel writing past its width shows up as changed padding
+    test_surface(std::uint32_t width, std::uint32_t height, pixel_format format)
+        : storage(static_cast<std::size_t>(width * bytes_per_pixel(format) + 7) * height)
+        , view{storage.data(), static_cast<std::ptrdiff_t>(width * bytes_per_pixel(format) + 7), width, height, format}
+    {
+    }
+};
+
+std::uint32_t color_mask(pixel_format format)
+{
+    switch (format)
+    {
+        case pixel_format::rgb555: return 0x7fff;
+        case pixel_format::rgb565: return 0xffff;
+        case pixel_format::rgb888: return 0xffffff;
+        case pixel_format::argb8888: return 0xffffff;
+        case pixel_format::indexed8: return 0xff;
+    }
+    return 0xffffffff;
+}
+
+std::uint32_t load(const raster_surface &surface, std::int32_t x, std::int32_t y)
+{
+    const auto bytes = bytes_per_pixel(surface.format);
+    std::uint32_t value = 0;
+    std::memcpy(&value, surface.pixels + y * surface.pitch + x * static_cast<std::int32_t>(bytes), bytes);
+    return value;
+}
+
+void store(const raster_surface &surface, std::int32_t x, std::int32_t y, std::uint32_t value)
+{
+    const auto bytes = bytes_per_pixel(surface.format);
+    std::memcpy(surface.pixels + y * surface.pitch + x * static_cast<std::int32_t>(bytes), &value, bytes);
+}
+
+// sprite-sheet like content, long runs of the key between runs of colour so the span and vector paths get whole
+// runs and partial ones, with the bits outside the colour mask set at random
+void fill_random(test_surface &surface, std::mt19937 &rng, std::uint32_t key)
+{
+    std::fill(surface.storage.begin(), surface.storage.end(), static_cast<std::uint8_t>(rng()));
+    const auto mask = color_mask(surface.view.format);
+    for (std::uint32_t y = 0; y < surface.view.height; ++y)
+    {
+        auto keyed = rng() % 2 == 0;
+        for (std::uint32_t x = 0; x < surface.view.width; ++x)
+        {
+            if (rng() % 9 == 0)
+            {
+                keyed = !keyed;
+            }
+            const auto colour = keyed ? key : rng() & mask;
+            store(surface.view, static_cast<std::int32_t>(x), static_cast<std::int32_t>(y), colour | (rng() & ~mask));
+        }
+    }
+}
+
+// the blit one pixel at a time, the way the Blt documentation describes it
+void reference_blt(
+    const raster_surface &dst,
+    const raster_rect &dst_rect,
+    const raster_surface &src,
+    const raster_rect &src_rect,
+    std::span<const raster_rect> clip_list,
+    const raster_color_key *key)
+{
+    const auto dst_w = static_cast<std::uint64_t>(dst_rect.right - dst_rect.left);
+    const auto dst_h = static_cast<std::uint64_t>(dst_rect.bottom - dst_rect.top);
+    const auto src_w = static_cast<std::uint64_t>(src_rect.right - src_rect.left);
+    const auto src_h = static_cast<std::uint64_t>(src_rect.bottom - src_rect.top);
+    const auto step_x = (src_w << 16) / dst_w;
+    const auto step_y = (src_h << 16) / dst_h;
+    const auto stretched = dst_w != src_w || dst_h != src_h;
+
+    for (auto y = std::max(dst_rect.top, 0); y < std::min(dst_rect.bottom, static_cast<std::int32_t>(dst.height)); ++y)
+    {
+        for (auto x = std::max(dst_rect.left, 0); x < std::min(dst_rect.right, static_cast<std::int32_t>(dst.width));
+             ++x)
+        {
+            const auto clipped = !clip_list.empty() && std::none_of(
+                                                           clip_list.begin(),
+                                                           clip_list.end(),
+                                                           [&](const raster_rect &clip)
+                                                           {
+                                                               return x >= clip.left && x < clip.right &&
+                                                                      y >= clip.top && y < clip.bottom;
+                                                           });
+            if (clipped)
+            {
+                continue;
+            }
+
+            const auto dx = static_cast<std::uint64_t>(x - dst_rect.left);
+            const auto dy = static_cast<std::uint64_t>(y - dst_rect.top);
+            const auto sx = src_rect.left +
+                            static_cast<std::int32_t>(stretched ? std::min((dx * step_x + step_x / 2) >> 16, src_w - 1)
+                                                                : dx);
+            const auto sy = src_rect.top +
+                            static_cast<std::int32_t>(stretched ? std::min((dy * step_y + step_y / 2) >> 16, src_h - 1)
+                                                                : dy);
+
+            const auto value = load(src, sx, sy);
+            const auto colour = value & color_mask(src.format);
+            if (key != nullptr && colour >= key->low && colour <= key->high)
+            {
+                continue;
+            }
+            store(dst, x, y, value);
+        }
+    }
+}
+
+// a rect anywhere from a bit outside the surface to a bit past it
+raster_rect random_rect(std::mt19937 &rng, std::uint32_t width, std::uint32_t height, std::int32_t slack)
+{
+    const auto coordinate = [&](std::uint32_t size)
+    { return static_cast<std::int32_t>(rng() % (size + 2 * slack)) - slack; };
+
+    auto left = coordinate(width);
+    auto right = coordinate(width);
+    auto top = coordinate(height);
+    auto bottom = coordinate(height);
+    if (left > right)
+    {
+        std::swap(left, right);
+    }
+    if (top > bottom)
+    {
+        std::swap(top, bottom);
+    }
+    return {left, top, right + 1, bottom + 1};
+}
+
+// clip lists are disjoint like a region's, cells of a grid with some left out
+std::vector<raster_rect> random_clip_list(std::mt19937 &rng, std::uint32_t width, std::uint32_t height)
+{
+    std::vector<raster_rect> clips;
+    if (rng() % 2 == 0)
+    {
+        return clips;
+    }
+
+    const auto columns = 1 + static_cast<std::int32_t>(rng() % 3);
+    const auto rows = 1 + static_cast<std::int32_t>(rng() % 3);
+    const auto cell_width = static_cast<std::int32_t>(width) / columns + 1;
+    const auto cell_height = static_cast<std::int32_t>(height) / rows + 1;
+    for (std::int32_t row = 0; row < rows; ++row)
+    {
+        for (std::int32_t column = 0; column < columns; ++column)
+        {
+            if (rng() % 3 != 0)
+            {
+                clips.push_back(
+                    {column * cell_width,
+                     row * cell_height,
+                     (column + 1) * cell_width,
+                     (row + 1) * cell_height});
+            }
+        }
+    }
+
+    // a list that leaves nothing still clips everything away, make sure there is something
+    if (clips.empty())
+    {
+        clips.push_back({0, 0, cell_width, cell_height});
+    }
+    return clips;
+}
+
+void check_blts()
+{
+    auto rng = test_rng();
+    constexpr pixel_format formats[]{
+        pixel_format::rgb555,
+        pixel_format::rgb565,
+        pixel_format::rgb888,
+        pixel_format::argb8888,
+        pixel_format::indexed8};
+
+    for (const auto format : formats)
+    {
+        for (auto round = 0; round < 300; ++round)
+        {
+            // wide enough for the 32 and 64 byte kernels to run several iterations and leave a tail
+            const auto width = 1 + static_cast<std::uint32_t>(rng() % 150);
+            const auto height = 1 + static_cast<std::uint32_t>(rng() % 40);
+            const auto key_value = static_cast<std::uint32_t>(rng()) & color_mask(format);
+            const raster_color_key key{key_value, key_value};
+
+            test_surface src{width, height, format};
+            fill_random(src, rng, key_value);
+            test_surface expected{width, height, format};
+            fill_random(expected, rng, key_value);
+            test_surface actual{width, height, format};
+            actual.storage = expected.storage;
+
+            // src_rect stays inside the source, dst_rect may hang off the destination, half the blits are 1:1
+            auto src_rect = random_rect(rng, width, height, 0);
+            src_rect.right = std::min(src_rect.right, static_cast<std::int32_t>(width));
+            src_rect.bottom = std::min(src_rect.bottom, static_cast<std::int32_t>(height));
+            auto dst_rect = random_rect(rng, width, height, 8);
+            if (rng() % 2 == 0)
+            {
+                dst_rect.right = dst_rect.left + (src_rect.right - src_rect.left);
+                dst_rect.bottom = dst_rect.top + (src_rect.bottom - src_rect.top);
+            }
+
+            const auto clips = random_clip_list(rng, width, height);
+            const auto keyed = rng() % 3 != 0;
+            const auto spans = raster_build_spans(src.view, key);
+            const auto use_spans = keyed && rng() % 2 == 0;
+
+            reference_blt(expected.view, dst_rect, src.view, src_rect, clips, keyed ? &key : nullptr);
+            const auto ok = raster_blt(
+                actual.view,
+                &dst_rect,
+                src.view,
+                &src_rect,
+                {.clip_list = clips,
+                 .source_key = keyed ? &key : nullptr,
+                 .source_spans = use_spans ? &spans : nullptr});
+
+            BLOCKS_CHECK(ok);
+            if (!BLOCKS_CHECK(actual.storage == expected.storage))
+            {
+                std::printf(
+                    "    format %d %ux%u dst %d,%d %d,%d src %d,%d %d,%d clips %zu keyed %d spans %d\n",
+                    static_cast<int>(format),
+                    width,
+                    height,
+                    dst_rect.left,
+                    dst_rect.top,
+                    dst_rect.right,
+                    dst_rect.bottom,
+                    src_rect.left,
+                    src_rect.top,
+                    src_rect.right,
+                    src_rect.bottom,
+                    clips.size(),
+                    keyed,
+                    use_spans);
+                return;
+            }
+        }
+    }
+}
+
+void check_spans()
+{
+    auto rng = test_rng();
+    test_surface surface{97, 13, pixel_format::rgb565};
+    fill_random(surface, rng, 0xf81f);
+    const raster_color_key key{0xf81f, 0xf81f};
+    const auto table = raster_build_spans(surface.view, key);
+
+    BLOCKS_CHECK(table.width == 97 && table.height == 13);
+    BLOCKS_CHECK(table.rows.size() == 14 && table.rows.front() == 0 && table.rows.back() == table.spans.size());
+
+    // the spans cover exactly the pixels outside the key, ascending and never touching each other
+    for (std::uint32_t y = 0; y < 13; ++y)
+    {
+        std::vector<bool> opaque(97);
+        std::uint32_t end = 0;
+        for (auto i = table.rows[y]; i < table.rows[y + 1]; ++i)
+        {
+            const auto &span = table.spans[i];
+            BLOCKS_CHECK(span.length > 0 && span.start + span.length <= 97);
+            BLOCKS_CHECK(i == table.rows[y] || span.start > end);
+            end = span.start + span.length;
+            std::fill(opaque.begin() + span.start, opaque.begin() + end, true);
+        }
+        for (std::uint32_t x = 0; x < 97; ++x)
+        {
+            const auto colour = load(surface.view, static_cast<std::int32_t>(x), static_cast<std::int32_t>(y));
+            BLOCKS_CHECK(opaque[x] == (colour != 0xf81f));
+        }
+    }
+
+    // a table built for another key is ignored rather than trusted
+    test_surface expected{97, 13, pixel_format::rgb565};
+    test_surface actual{97, 13, pixel_format::rgb565};
+    const raster_color_key other{0x001f, 0x001f};
+    reference_blt(expected.view, {0, 0, 97, 13}, surface.view, {0, 0, 97, 13}, {}, &other);
+    raster_blt(actual.view, nullptr, surface.view, nullptr, {.source_key = &other, .source_spans = &table});
+    BLOCKS_CHECK(actual.storage == expected.storage);
+}
+
+void check_rejects()
+{
+    test_surface a{16, 16, pixel_format::argb8888};
+    test_surface b{16, 16, pixel_format::rgb565};
+
+    // formats have to match and the source rect has to be inside its surface and not empty
+    BLOCKS_CHECK(!raster_blt(a.view, nullptr, b.view, nullptr));
+    const raster_rect outside{8, 8, 17, 12};
+    BLOCKS_CHECK(!raster_blt(a.view, nullptr, a.view, &outside));
+    const raster_rect empty{4, 4, 4, 8};
+    BLOCKS_CHECK(!raster_blt(a.view, nullptr, a.view, &empty));
+    BLOCKS_CHECK(!raster_blt(a.view, &empty, a.view, nullptr));
+    BLOCKS_CHECK(!raster_fill(a.view, &empty, 0));
+
+    // a destination entirely off the surface is clipped away, not an error
+    const raster_rect off{-20, -20, -4, -4};
+    const auto before = a.storage;
+    BLOCKS_CHECK(raster_blt(a.view, &off, a.view, nullptr));
+    BLOCKS_CHECK(a.storage == before);
+}
+
+void check_overlapping()
+{
+    // scrolling a surface onto itself reads every pixel before it is overwritten, in every direction
+    auto rng = test_rng();
+    for (const auto &[dx, dy] : {std::pair{3, 0}, std::pair{-3, 0}, std::pair{0, 2}, std::pair{0, -2}, std::pair{2, 1}})
+    {
+        test_surface surface{40, 20, pixel_format::argb8888};
+        fill_random(surface, rng, 0);
+        const auto original = surface.storage;
+        const raster_surface copy{
+            const_cast<std::uint8_t *>(original.data()),
+            surface.view.pitch,
+            40,
+            20,
+            pixel_format::argb8888};
+
+        const raster_rect src_rect{5, 5, 30, 15};
+        const raster_rect dst_rect{5 + dx, 5 + dy, 30 + dx, 15 + dy};
+        BLOCKS_CHECK(raster_blt(surface.view, &dst_rect, surface.view, &src_rect));
+
+        test_surface expected{40, 20, pixel_format::argb8888};
+        expected.storage = original;
+        reference_blt(expected.view, dst_rect, copy, src_rect, {}, nullptr);
+        BLOCKS_CHECK(surface.storage == expected.storage);
+    }
+}
+
+void check_fills()
+{
+    auto rng = test_rng();
+    for (auto round = 0; round < 100; ++round)
+    {
+        const auto format = static_cast<pixel_format>(rng() % 5);
+        test_surface actual{37, 23, format};
+        fill_random(actual, rng, 0);
+        auto expected = actual.storage;
+
+        const auto rect = random_rect(rng, 37, 23, 6);
+        const auto clips = random_clip_list(rng, 37, 23);
+        const auto bits = bytes_per_pixel(format) * 8;
+        const auto colour = static_cast<std::uint32_t>(rng()) & (bits == 32 ? 0xffffffffu : (1u << bits) - 1);
+        BLOCKS_CHECK(raster_fill(actual.view, &rect, colour, clips));
+
+        const raster_surface view{expected.data(), actual.view.pitch, 37, 23, format};
+        for (auto y = std::max(rect.top, 0); y < std::min(rect.bottom, 23); ++y)
+        {
+            for (auto x = std::max(rect.left, 0); x < std::min(rect.right, 37); ++x)
+            {
+                const auto inside = clips.empty() || std::any_of(
+                                                         clips.begin(),
+                                                         clips.end(),
+                                                         [&](const raster_rect &clip)
+                                                         {
+                                                             return x >= clip.left && x < clip.right &&
+                                                                    y >= clip.top && y < clip.bottom;
+                                                         });
+                if (inside)
+                {
+                    store(view, x, y, colour);
+                }
+            }
+        }
+        BLOCKS_CHECK(actual.storage == expected);
+    }
+}
+
+void run_raster_tests()
+{
+    check_blts();
+    check_spans();
+    check_rejects();
+    check_overlapping();
+    check_fills();
+}
+
+}
+
+BLOCKS_TEST_SUITE(raster, run_raster_tests);
@@ -0,0 +1,246 @@
+#include <cstdint>
+
+#include "../ddraw_convert.h"
+#include "../ddraw_vtable.h"
+#include "../soft_ddraw.h"
+#include "test.h"
+
+namespace
+{
+
+template <class Method, class... Args>
+HRESULT call(void *object, Args... args)
+{
+    const auto *vtable = *reinterpret_cast<void *const *const *>(object);
+    return reinterpret_cast<typename Method::function_type>(vtable[Method::index])(object, args...);
+}
+
+using release = vtable_method<IUnknown, 2, ULONG(__stdcall *)(void *)>;
+
+// the slots in ddraw_vtable.h against the x86 byte offsets they are documented with
+// the static_asserts there only run on an x86 build, these run everywhere
+template <class Method>
+bool slot_at(std::size_t x86_offset)
+{
+    return Method::index * 4 == x86_offset && Method::offset == Method::index * sizeof(void *);
+}
+
+void check_slots()
+{
+    BLOCKS_CHECK(slot_at<ddraw_method::create_palette>(0x14));
+    BLOCKS_CHECK(slot_at<ddraw_method::create_surface>(0x18));
+    BLOCKS_CHECK(slot_at<ddraw_method::set_cooperative_level>(0x50));
+    BLOCKS_CHECK(slot_at<ddraw_method::set_display_mode>(0x54));
+    BLOCKS_CHECK(slot_at<surface_method::blt>(0x14));
+    BLOCKS_CHECK(slot_at<surface_method::blt_batch>(0x18));
+    BLOCKS_CHECK(slot_at<surface_method::blt_fast>(0x1c));
+    BLOCKS_CHECK(slot_at<surface_method::flip>(0x2c));
+    BLOCKS_CHECK(slot_at<surface_method::get_attached_surface>(0x30));
+    BLOCKS_CHECK(slot_at<surface_method::get_pixel_format>(0x54));
+    BLOCKS_CHECK(slot_at<surface_method::lock>(0x64));
+    BLOCKS_CHECK(slot_at<surface_method::set_color_key>(0x74));
+    BLOCKS_CHECK(slot_at<surface_method::set_palette>(0x7c));
+    BLOCKS_CHECK(slot_at<surface_method::unlock>(0x80));
+    BLOCKS_CHECK(slot_at<palette_method::set_entries>(0x18));
+}
+
+LPDIRECTDRAWSURFACE7 create_offscreen(LPDIRECTDRAW ddraw, DWORD width, DWORD height, const DDPIXELFORMAT *format)
+{
+    DDSURFACEDESC2 desc{};
+    desc.dwSize = sizeof(desc);
+    desc.dwFlags = DDSD_CAPS | DDSD_WIDTH | DDSD_HEIGHT | (format != nullptr ? DDSD_PIXELFORMAT : 0);
+    desc.dwWidth = width;
+    desc.dwHeight = height;
+    desc.ddsCaps.dwCaps = DDSCAPS_OFFSCREENPLAIN;
+    if (format != nullptr)
+    {
+        desc.ddpfPixelFormat = *format;
+    }
+    LPDIRECTDRAWSURFACE7 surface{};
+    BLOCKS_CHECK(call<ddraw_method::create_surface>(ddraw, &desc, &surface, nullptr) == DD_OK);
+    return surface;
+}
+
+std::uint32_t pixel_at(LPDIRECTDRAWSURFACE7 surface, LONG x, LONG y)
+{
+    DDSURFACEDESC2 locked{};
+    locked.dwSize = sizeof(locked);
+    if (!BLOCKS_CHECK(call<surface_method::lock>(surface, nullptr, &locked, DDLOCK_WAIT, nullptr) == DD_OK))
+    {
+        return 0;
+    }
+    const auto *row = static_cast<const std::uint8_t *>(locked.lpSurface) + y * locked.lPitch;
+    const auto pixel = reinterpret_cast<const std::uint32_t *>(row)[x];
+    call<surface_method::unlock>(surface, nullptr);
+    return pixel;
+}
+
+HRESULT fill(LPDIRECTDRAWSURFACE7 surface, RECT *rect, DWORD color)
+{
+    DDBLTFX fx{};
+    fx.dwSize = sizeof(fx);
+    fx.dwFillColor = color;
+    return call<surface_method::blt>(surface, rect, nullptr, nullptr, DDBLT_COLORFILL | DDBLT_WAIT, &fx);
+}
+
+void check_lock(LPDIRECTDRAWSURFACE7 surface)
+{
+    DDSURFACEDESC2 locked{};
+    locked.dwSize = sizeof(locked);
+    BLOCKS_CHECK(call<surface_method::lock>(surface, nullptr, &locked, DDLOCK_WAIT, nullptr) == DD_OK);
+    BLOCKS_CHECK(locked.dwWidth == 40 && locked.dwHeight == 30 && locked.lPitch == 40 * 4);
+    BLOCKS_CHECK(locked.ddpfPixelFormat.dwRGBBitCount == 32 && (locked.dwFlags & DDSD_LPSURFACE));
+    const auto *base = static_cast<std::uint8_t *>(locked.lpSurface);
+
+    // one lock at a time, and nothing blits into a locked surface
+    DDSURFACEDESC2 again{};
+    again.dwSize = sizeof(again);
+    BLOCKS_CHECK(call<surface_method::lock>(surface, nullptr, &again, DDLOCK_WAIT, nullptr) == DDERR_SURFACEBUSY);
+    BLOCKS_CHECK(fill(surface, nullptr, 0) == DDERR_SURFACEBUSY);
+    BLOCKS_CHECK(call<surface_method::unlock>(surface, nullptr) == DD_OK);
+    BLOCKS_CHECK(call<surface_method::unlock>(surface, nullptr) == DDERR_NOTLOCKED);
+
+    // a rect lock points at its top left corner, the pitch is still the whole row's
+    RECT rect{3, 5, 10, 9};
+    BLOCKS_CHECK(call<surface_method::lock>(surface, &rect, &locked, DDLOCK_WAIT, nullptr) == DD_OK);
+    BLOCKS_CHECK(static_cast<std::uint8_t *>(locked.lpSurface) == base + 5 * 40 * 4 + 3 * 4);
+    BLOCKS_CHECK(locked.lPitch == 40 * 4);
+    BLOCKS_CHECK(call<surface_method::unlock>(surface, nullptr) == DD_OK);
+
+    for (RECT bad : {RECT{-1, 0, 4, 4}, RECT{0, 0, 41, 4}, RECT{0, 0, 4, 31}, RECT{5, 5, 5, 6}, RECT{5, 6, 6, 5}})
+    {
+        BLOCKS_CHECK(call<surface_method::lock>(surface, &bad, &locked, DDLOCK_WAIT, nullptr) == DDERR_INVALIDRECT);
+    }
+    BLOCKS_CHECK(call<surface_method::unlock>(surface, nullptr) == DDERR_NOTLOCKED);
+}
+
+void check_blt(LPDIRECTDRAW ddraw, LPDIRECTDRAWSURFACE7 dst)
+{
+    auto *src = create_offscreen(ddraw, 8, 8, nullptr);
+
+    // colour fill of a rect leaves the rest alone
+    BLOCKS_CHECK(fill(dst, nullptr, 0x11111111) == DD_OK);
+    RECT area{2, 2, 6, 4};
+    BLOCKS_CHECK(fill(dst, &area, 0x22222222) == DD_OK);
+    BLOCKS_CHECK(pixel_at(dst, 2, 2) == 0x22222222 && pixel_at(dst, 5, 3) == 0x22222222);
+    BLOCKS_CHECK(pixel_at(dst, 6, 3) == 0x11111111 && pixel_at(dst, 2, 4) == 0x11111111);
+
+    // a source with a keyed left half, Blt with DDBLT_KEYSRC and BltFast with SRCCOLORKEY both skip it
+    BLOCKS_CHECK(fill(src, nullptr, 0x00ff00ff) == DD_OK);
+    RECT right{4, 0, 8, 8};
+    BLOCKS_CHECK(fill(src, &right, 0x00333333) == DD_OK);
+    DDCOLORKEY key{0x00ff00ff, 0x00ff00ff};
+    BLOCKS_CHECK(call<surface_method::set_color_key>(src, DDCKEY_SRCBLT, &key) == DD_OK);
+
+    RECT dst_rect{10, 10, 18, 18};
+    BLOCKS_CHECK(call<surface_method::blt>(dst, &dst_rect, src, nullptr, DDBLT_KEYSRC | DDBLT_WAIT, nullptr) == DD_OK);
+    BLOCKS_CHECK(pixel_at(dst, 10, 10) == 0x11111111 && pixel_at(dst, 14, 10) == 0x00333333);
+
+    BLOCKS_CHECK(call<surface_method::blt_fast>(dst, 20, 20, src, nullptr, DDBLTFAST_SRCCOLORKEY) == DD_OK);
+    BLOCKS_CHECK(pixel_at(dst, 23, 27) == 0x11111111 && pixel_at(dst, 24, 27) == 0x00333333);
+
+    // without the key the whole source is copied, stretched to the destination rect
+    RECT stretched{0, 20, 16, 28};
+    BLOCKS_CHECK(call<surface_method::blt>(dst, &stretched, src, nullptr, DDBLT_WAIT, nullptr) == DD_OK);
+    BLOCKS_CHECK(pixel_at(dst, 7, 20) == 0x00ff00ff && pixel_at(dst, 8, 27) == 0x00333333);
+
+    // source rects past the edge of the source are refused, BltFast hanging off the destination is clipped
+    RECT outside{4, 4, 9, 8};
+    BLOCKS_CHECK(call<surface_method::blt>(dst, &dst_rect, src, &outside, DDBLT_WAIT, nullptr) == DDERR_INVALIDRECT);
+    BLOCKS_CHECK(call<surface_method::blt_fast>(dst, 0, 0, src, &outside, 0) == DDERR_INVALIDRECT);
+    BLOCKS_CHECK(call<surface_method::blt_fast>(dst, 36, 0, src, nullptr, 0) == DD_OK);
+    BLOCKS_CHECK(pixel_at(dst, 35, 0) == 0x11111111 && pixel_at(dst, 39, 7) == 0x00ff00ff);
+
+    // a source being locked, a format to convert, a flag nobody implemented and a fill without its colour
+    DDSURFACEDESC2 locked{};
+    locked.dwSize = sizeof(locked);
+    BLOCKS_CHECK(call<surface_method::lock>(src, nullptr, &locked, DDLOCK_WAIT, nullptr) == DD_OK);
+    BLOCKS_CHECK(call<surface_method::blt>(dst, &dst_rect, src, nullptr, DDBLT_WAIT, nullptr) == DDERR_SURFACEBUSY);
+    BLOCKS_CHECK(call<surface_method::blt_fast>(dst, 0, 0, src, nullptr, 0) == DDERR_SURFACEBUSY);
+    call<surface_method::unlock>(src, nullptr);
+
+    const auto format = to_ddpixelformat(pixel_format::rgb565);
+    auto *other = create_offscreen(ddraw, 8, 8, &format);
+    BLOCKS_CHECK(call<surface_method::blt>(dst, &dst_rect, other, nullptr, 0, nullptr) == DDERR_INVALIDPIXELFORMAT);
+    BLOCKS_CHECK(call<surface_method::blt_fast>(dst, 0, 0, other, nullptr, 0) == DDERR_INVALIDPIXELFORMAT);
+    constexpr DWORD rop = 0x00020000; // DDBLT_ROP, ddraw_compat.h only has the flags soft_ddraw implements
+    BLOCKS_CHECK(call<surface_method::blt>(dst, &dst_rect, src, nullptr, rop, nullptr) == DDERR_UNSUPPORTED);
+    BLOCKS_CHECK(call<surface_method::blt>(dst, &dst_rect, nullptr, nullptr, DDBLT_COLORFILL, nullptr) ==
+                 DDERR_INVALIDPARAMS);
+
+    call<release>(other);
+    call<release>(src);
+}
+
+void check_flip(LPDIRECTDRAW ddraw)
+{
+    DDSURFACEDESC2 desc{};
+    desc.dwSize = sizeof(desc);
+    desc.dwFlags = DDSD_CAPS | DDSD_BACKBUFFERCOUNT;
+    desc.ddsCaps.dwCaps = DDSCAPS_PRIMARYSURFACE | DDSCAPS_FLIP | DDSCAPS_COMPLEX;
+    desc.dwBackBufferCount = 1;
+    LPDIRECTDRAWSURFACE7 primary{};
+    BLOCKS_CHECK(call<ddraw_method::create_surface>(ddraw, &desc, &primary, nullptr) == DD_OK);
+
+    DDSCAPS2 caps{};
+    caps.dwCaps = DDSCAPS_BACKBUFFER;
+    LPDIRECTDRAWSURFACE7 back_buffer{};
+    BLOCKS_CHECK(call<surface_method::get_attached_surface>(primary, &caps, &back_buffer) == DD_OK);
+
+    BLOCKS_CHECK(fill(primary, nullptr, 0x00000001) == DD_OK);
+    BLOCKS_CHECK(fill(back_buffer, nullptr, 0x00000002) == DD_OK);
+    BLOCKS_CHECK(call<surface_method::flip>(primary, nullptr, DDFLIP_WAIT) == DD_OK);
+    BLOCKS_CHECK(pixel_at(primary, 0, 0) == 2 && pixel_at(back_buffer, 63, 47) == 1);
+    BLOCKS_CHECK(call<surface_method::flip>(back_buffer, nullptr, DDFLIP_WAIT) == DDERR_NOTFLIPPABLE);
+
+    call<release>(back_buffer);
+    call<release>(primary);
+}
+
+// a hook committed to a soft_ddraw vtable is called in place of the original and forwards to it
+int g_hooked_locks{};
+
+HRESULT __stdcall counting_lock(void *that, LPRECT rect, LPDDSURFACEDESC2 desc, DWORD flags, HANDLE event)
+{
+    ++g_hooked_locks;
+    return surface_method::lock::original(that, rect, desc, flags, event);
+}
+
+void check_hooks(LPDIRECTDRAWSURFACE7 surface)
+{
+    hook_set set{};
+    vtable_hooks<vtable_hook<surface_method::lock, counting_lock>>::add(set, surface);
+    BLOCKS_CHECK(hook_set_commit(set, g_writable_memory) == hook_set_error::none);
+
+    DDSURFACEDESC2 locked{};
+    locked.dwSize = sizeof(locked);
+    BLOCKS_CHECK(call<surface_method::lock>(surface, nullptr, &locked, DDLOCK_WAIT, nullptr) == DD_OK);
+    BLOCKS_CHECK(g_hooked_locks == 1 && locked.dwWidth == 40);
+    BLOCKS_CHECK(call<surface_method::unlock>(surface, nullptr) == DD_OK);
+
+    BLOCKS_CHECK(hook_set_rollback(set, g_writable_memory) == hook_set_error::none);
+    call<surface_method::lock>(surface, nullptr, &locked, DDLOCK_WAIT, nullptr);
+    call<surface_method::unlock>(surface, nullptr);
+    BLOCKS_CHECK(g_hooked_locks == 1);
+    soft_ddraw_reset_vtables();
+}
+
+void run_soft_ddraw_tests()
+{
+    check_slots();
+
+    auto *ddraw = soft_ddraw_create({.display_width = 64, .display_height = 48});
+    auto *surface = create_offscreen(ddraw, 40, 30, nullptr);
+    check_lock(surface);
+    check_blt(ddraw, surface);
+    check_flip(ddraw);
+    check_hooks(surface);
+
+    call<release>(surface);
+    call<release>(ddraw);
+    BLOCKS_CHECK(soft_ddraw_live_objects() == 0);
+}
+
+}
+
+BLOCKS_TEST_SUITE(soft_ddraw, run_soft_ddraw_tests);
@@ -0,0 +1,78 @@
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "../write_watch.h"
+#include "test.h"
+
+namespace
+{
+
+bool only(const damage_list &damage, const raster_rect &rect)
+{
+    return !damage.full && damage.rects.size() == 1 && damage.rects[0].left == rect.left &&
+           damage.rects[0].top == rect.top && damage.rects[0].right == rect.right &&
+           damage.rects[0].bottom == rect.bottom;
+}
+
+// what Unlock_hook records for a lock of rect after the game poked the given rows
+damage_list poke(
+    write_watch &watch,
+    std::size_t pitch,
+    std::uint32_t width,
+    std::uint32_t height,
+    const raster_rect &rect,
+    std::initializer_list<std::uint32_t> rows)
+{
+    write_watch_reset(watch);
+    for (const auto row : rows)
+    {
+        watch.data[row * pitch + 8] = 1;
+    }
+
+    damage_list damage{};
+    damage_reset(damage, width, height);
+    std::vector<std::size_t> pages;
+    write_watch_damage(watch, pitch, width, height, rect, damage, pages);
+    return damage;
+}
+
+void run_write_watch_tests()
+{
+    write_watch watch{};
+    if (!write_watch_alloc(watch, 1))
+    {
+        std::printf("    no write watch here, skipped\n");
+        return;
+    }
+
+    // one page per row, every row written shows up on its own
+    const auto pitch = watch.page_size;
+    const auto width = static_cast<std::uint32_t>(pitch / 4);
+    constexpr std::uint32_t height = 16;
+    BLOCKS_CHECK(write_watch_alloc(watch, pitch * height));
+    const raster_rect whole{0, 0, static_cast<std::int32_t>(width), height};
+
+    // a lock the game wrote one row of pixels into is that row and nothing else
+    BLOCKS_CHECK(only(poke(watch, pitch, width, height, whole, {5}), {0, 5, whole.right, 6}));
+
+    // a lock nothing was written into, or only outside the locked rect, draws nothing
+    BLOCKS_CHECK(poke(watch, pitch, width, height, whole, {}).rects.empty());
+    const raster_rect locked{4, 2, 20, 10};
+    BLOCKS_CHECK(poke(watch, pitch, width, height, locked, {12}).rects.empty());
+    BLOCKS_CHECK(only(poke(watch, pitch, width, height, locked, {7}), {4, 7, 20, 8}));
+
+    // neighbouring rows come out as one rect, apart ones stay apart
+    BLOCKS_CHECK(only(poke(watch, pitch, width, height, whole, {3, 4}), {0, 3, whole.right, 5}));
+    BLOCKS_CHECK(poke(watch, pitch, width, height, whole, {1, 9}).rects.size() == 2);
+
+    // two rows to a page, a write anywhere in the page damages both
+    const auto half = pitch / 2;
+    const auto half_width = static_cast<std::uint32_t>(half / 4);
+    const raster_rect half_whole{0, 0, static_cast<std::int32_t>(half_width), height};
+    BLOCKS_CHECK(only(poke(watch, half, half_width, height, half_whole, {5}), {0, 4, half_whole.right, 6}));
+}
+
+}
+
+BLOCKS_TEST_SUITE(write_watch, run_write_watch_tests);
@@ -0,0 +1,192 @@
+#include "thread_pool.h"
+
+#include <thread>
+
+namespace
+{
+
+std::uint64_t pack_range(std::uint32_t next, std::uint32_t end)
+{
+    return static_cast<std::uint64_t>(end) << 32 | next;
+}
+
+std::uint32_t range_next(std::uint64_t range)
+{
+    return static_cast<std::uint32_t>(range);
+}
+
+std::uint32_t range_end(std::uint64_t range)
+{
+    return static_cast<std::uint32_t>(range >> 32);
+}
+
+// take the front task of a share, false once it's empty
+bool pop_task(thread_pool_share &share, std::uint32_t &task)
+{
+    auto range = share.range.load(std::memory_order_relaxed);
+    while (range_next(range) < range_end(range))
+    {
+        if (share.range.compare_exchange_weak(range, range + 1, std::memory_order_acq_rel))
+        {
+            task = range_next(range);
+            return true;
+        }
+    }
+    return false;
+}
+
+// move the back half of the fullest other share into own, which is empty, false once there's nothing left anywhere
+bool steal_tasks(thread_pool &pool, std::uint32_t self)
+{
+    while (true)
+    {
+        std::uint32_t victim = self;
+        std::uint32_t most = 0;
+        for (std::uint32_t i = 0; i < pool.threads; ++i)
+        {
+            const auto range = pool.shares[i].range.load(std::memory_order_relaxed);
+            const auto left = range_end(range) > range_next(range) ? range_end(range) - range_next(range) : 0;
+            if (i != self && left > most)
+            {
+                victim = i;
+                most = left;
+            }
+        }
+
+        if (victim == self)
+        {
+            return false;
+        }
+
+        auto range = pool.shares[victim].range.load(std::memory_order_relaxed);
+        const auto next = range_next(range);
+        const auto end = range_end(range);
+        if (next >= end)
+        {
+            continue;
+        }
+
+        // a single task left is taken whole, the owner finds its share empty on the next pop
+        const auto middle = next + (end - next) / 2;
+        if (pool.shares[victim].range.compare_exchange_strong(
+                range,
+                pack_range(next, middle),
+                std::memory_order_acq_rel))
+        {
+            // nobody steals from an empty share, so nothing else can be writing own
+            pool.shares[self].range.store(pack_range(middle, end), std::memory_order_release);
+            return true;
+        }
+    }
+}
+
+void work(thread_pool &pool, std::uint32_t self)
+{
+    do
+    {
+        std::uint32_t task{};
+        while (pop_task(pool.shares[self], task))
+        {
+            pool.task(pool.context, task);
+        }
+    } while (steal_tasks(pool, self));
+}
+
+void worker(thread_pool &pool, std::uint32_t self)
+{
+    std::uint64_t seen = 0;
+
+    std::unique_lock lock{pool.mutex};
+    while (true)
+    {
+        pool.wake.wait(lock, [&] { return pool.stopping || pool.generation != seen; });
+        if (pool.stopping)
+        {
+            break;
+        }
+        seen = pool.generation;
+
+        lock.unlock();
+        work(pool, self);
+        lock.lock();
+
+        if (--pool.busy == 0)
+        {
+            pool.finished.notify_all();
+        }
+    }
+
+    if (--pool.busy == 0)
+    {
+        pool.finished.notify_all();
+    }
+}
+
+}
+
+void pool_start(thread_pool &pool, std::uint32_t threads)
+{
+    if (threads == 0)
+    {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    pool.threads = threads;
+    pool.shares = std::make_unique<thread_pool_share[]>(threads);
+    pool.stopping = false;
+
+    // detached like the present thread, a dll can't wait for threads while it's being unloaded
+    for (std::uint32_t i = 1; i < threads; ++i)
+    {
+        std::thread{worker, std::ref(pool), i}.detach();
+    }
+}
+
+void pool_stop(thread_pool &pool)
+{
+    std::unique_lock lock{pool.mutex};
+    pool.finished.wait(lock, [&] { return pool.busy == 0; });
+
+    pool.busy = pool.threads - 1;
+    pool.stopping = true;
+    pool.wake.notify_all();
+    pool.finished.wait(lock, [&] { return pool.busy == 0; });
+
+    pool.threads = 1;
+}
+
+void pool_run(thread_pool &pool, std::uint32_t tasks, void (*task)(void *, std::uint32_t), void *context)
+{
+    std::unique_lock run{pool.run_mutex, std::try_to_lock};
+    if (pool.threads < 2 || tasks < 2 || !run.owns_lock())
+    {
+        for (std::uint32_t i = 0; i < tasks; ++i)
+        {
+            task(context, i);
+        }
+        return;
+    }
+
+    // contiguous shares, the first few one task bigger when it doesn't divide evenly
+    std::uint32_t next = 0;
+    for (std::uint32_t i = 0; i < pool.threads; ++i)
+    {
+        const auto count = tasks / pool.threads + (i < tasks % pool.threads ? 1 : 0);
+        pool.shares[i].range.store(pack_range(next, next + count), std::memory_order_relaxed);
+        next += count;
+    }
+
+    {
+        std::lock_guard lock{pool.mutex};
+        pool.task = task;
+        pool.context = context;
+        pool.busy = pool.threads - 1;
+        ++pool.generation;
+    }
+    pool.wake.notify_all();
+
+    work(pool, 0);
+
+    std::unique_lock lock{pool.mutex};
+    pool.finished.wait(lock, [&] { return pool.busy == 0; });
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+// a few worker threads for splitting surface wide work (palette conversion, scaling) across cores
+// a job is a count of tasks, every thread starts on its own contiguous share of them and one that runs out steals
+// the back half of the biggest share left, so a slow band or a busy core evens out without a shared queue
+// the thread calling pool_run works on the job too and only returns once every task has finished
+
+struct thread_pool_share
+{
+    // next task in the low 32 bits, end in the high 32, only ever changed by compare exchange on the whole word
+    alignas(64) std::atomic<std::uint64_t> range{};
+};
+
+struct thread_pool
+{
+    std::mutex mutex{};
+    std::condition_variable wake{};
+    std::condition_variable finished{};
+
+    // workers plus the calling thread, share 0 is the caller's
+    std::uint32_t threads{1};
+    std::unique_ptr<thread_pool_share[]> shares{};
+
+    // the job being run
+    void (*task)(void *, std::uint32_t){};
+    void *context{};
+    std::uint64_t generation{};
+    // workers that haven't finished the current job, or haven't left after pool_stop
+    std::uint32_t busy{};
+    bool stopping{};
+
+    // taken by pool_run, a second caller (the present thread while Flip is converting) runs its job on its own
+    std::mutex run_mutex{};
+};
+
+// rows per band are picked so a band's pixels stay around this size, small enough to sit in l2 while it's worked on
+inline constexpr std::size_t pool_band_bytes = 128 * 1024;
+
+// less than this much work isn't worth waking anybody for
+inline constexpr std::size_t pool_serial_bytes = 256 * 1024;
+
+// threads counts the caller, 0 is one per core and 1 starts nothing so every job runs on the caller
+void pool_start(thread_pool &pool, std::uint32_t threads);
+
+// wait for the workers to leave, jobs run on the caller afterwards
+void pool_stop(thread_pool &pool);
+
+// task(context, i) for every i in [0, tasks), in any order and on any thread
+void pool_run(thread_pool &pool, std::uint32_t tasks, void (*task)(void *, std::uint32_t), void *context);
+
+template <class F>
+void pool_for(thread_pool &pool, std::uint32_t tasks, F &&fn)
+{
+    using function = std::remove_reference_t<F>;
+    pool_run(
+        pool,
+        tasks,
+        [](void *context, std::uint32_t i) { (*static_cast<function *>(context))(i); },
+        const_cast<void *>(static_cast<const void *>(&fn)));
+}
+
+// fn(first, last) over bands of rows [first, last) covering [0, rows), one band on the caller when the whole
+// thing is too small to split
+template <class F>
+void pool_for_rows(thread_pool &pool, std::uint32_t rows, std::size_t row_bytes, F &&fn)
+{
+    if (rows == 0)
+    {
+        return;
+    }
+
+    if (pool.threads < 2 || rows < 2 || static_cast<std::size_t>(rows) * row_bytes < pool_serial_bytes)
+    {
+        fn(0u, rows);
+        return;
+    }
+
+    const auto band_rows = pool_band_bytes / std::max<std::size_t>(row_bytes, 1);
+    const auto band = static_cast<std::uint32_t>(std::clamp<std::size_t>(band_rows, 1, rows));
+    const auto bands = (rows + band - 1) / band;
+    pool_for(
+        pool,
+        bands,
+        [&](std::uint32_t i)
+        {
+            const auto first = i * band;
+            fn(first, std::min(first + band, rows));
+        });
+}
@@ -0,0 +1,66 @@
+// checks a .bmp with the same parser the patcher uses and prints what it found
+// usage: blocks_bmp_info file.bmp...
+
+#include <cstdio>
+
+#include "../bmp.h"
+#include "../mapped_file.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s file.bmp...\n", argv[0]);
+        return 1;
+    }
+
+    auto failed = 0;
+    for (auto i = 1; i < argc; ++i)
+    {
+        mapped_file file{};
+        if (!map_file(argv[i], file))
+        {
+            std::fprintf(stderr, "%s: can't open\n", argv[i]);
+            ++failed;
+            continue;
+        }
+
+        bmp_image image{};
+        if (const auto error = parse_bmp(file.bytes(), image); error != bmp_error::none)
+        {
+            std::fprintf(stderr, "%s: %s\n", argv[i], bmp_error_name(error));
+            ++failed;
+            continue;
+        }
+
+        // which palette entries the picture actually uses, handy when checking a palette animation
+        std::size_t counts[256]{};
+        for (std::uint32_t y = 0; y < image.height; ++y)
+        {
+            const auto *row = image.pixels.pixels + static_cast<std::ptrdiff_t>(y) * image.pixels.pitch;
+            for (std::uint32_t x = 0; x < image.width; ++x)
+            {
+                ++counts[row[x]];
+            }
+        }
+
+        auto used = 0;
+        for (const auto count : counts)
+        {
+            used += count != 0;
+        }
+
+        std::printf(
+            "%s: %ux%u 8bpp %s, stride %zu, pixels at %zu, %zu colours in the table, %d used\n",
+            argv[i],
+            image.width,
+            image.height,
+            image.bottom_up ? "bottom-up" : "top-down",
+            image.stride,
+            image.pixel_offset,
+            image.palette.size(),
+            used);
+    }
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+// checks an .exe or .dll with the same parser the patcher runs over the game at startup and prints its sections and
+// imports, the iat rvas are what ends up in the import cache
+// usage: blocks_pe_info file.exe...
+
+#include <cstdio>
+
+#include "../mapped_file.h"
+#include "../pe_image.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s file.exe...\n", argv[0]);
+        return 1;
+    }
+
+    auto failed = 0;
+    for (auto i = 1; i < argc; ++i)
+    {
+        mapped_file file{};
+        if (!map_file(argv[i], file))
+        {
+            std::fprintf(stderr, "%s: can't open\n", argv[i]);
+            ++failed;
+            continue;
+        }
+
+        pe_image image{};
+        auto error = pe_parse(file.bytes(), pe_layout::file, image);
+        if (error == pe_error::none)
+        {
+            error = pe_read_imports(file.bytes(), pe_layout::file, image);
+        }
+        if (error != pe_error::none)
+        {
+            std::fprintf(stderr, "%s: %s\n", argv[i], pe_error_name(error));
+            ++failed;
+            continue;
+        }
+
+        std::printf(
+            "%s: %s machine %#x, timestamp %#x, checksum %#x, base %#llx, %#x bytes mapped\n",
+            argv[i],
+            image.pe32_plus ? "pe32+" : "pe32",
+            image.machine,
+            image.timestamp,
+            image.checksum,
+            static_cast<unsigned long long>(image.image_base),
+            image.size_of_image);
+
+        for (const auto &section : image.sections)
+        {
+            std::printf(
+                "  section %-8s rva %#8x size %#8x raw %#8x+%#x flags %#x\n",
+                section.name.c_str(),
+                section.rva,
+                section.virtual_size,
+                section.raw_offset,
+                section.raw_size,
+                section.characteristics);
+        }
+
+        for (const auto &import : image.imports)
+        {
+            if (import.function.empty())
+            {
+                std::printf("  import %s #%u iat %#x\n", import.dll.c_str(), import.ordinal, import.iat_rva);
+            }
+            else
+            {
+                std::printf("  import %s %s iat %#x\n", import.dll.c_str(), import.function.c_str(), import.iat_rva);
+            }
+        }
+    }
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+// writes the frames of a session recording ([record] enabled=1) as numbered png files
+// usage: blocks_recording_export recording.bin out_dir [first_frame [frame_count]]
+// files are named after the game's frame numbers, so frames dropped while recording show up as gaps
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "../png.h"
+#include "../recording.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::fprintf(stderr, "usage: %s recording.bin out_dir [first_frame [frame_count]]\n", argv[0]);
+        return 1;
+    }
+
+    const std::filesystem::path out_dir{argv[2]};
+    const auto first = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 0;
+    const auto count = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : UINT64_MAX;
+
+    recording_reader reader{};
+    if (!recording_open(reader, argv[1]))
+    {
+        std::fprintf(stderr, "%s: not a recording\n", argv[1]);
+        return 1;
+    }
+
+    std::error_code error{};
+    std::filesystem::create_directories(out_dir, error);
+    if (error)
+    {
+        std::fprintf(stderr, "%s: %s\n", out_dir.string().c_str(), error.message().c_str());
+        return 1;
+    }
+
+    std::printf(
+        "%ux%u %s, keyframe every %u frames\n",
+        reader.header.width,
+        reader.header.height,
+        reader.header.format == static_cast<std::uint32_t>(pixel_format::indexed8) ? "8 bit" : "rgb",
+        reader.header.keyframe_interval);
+
+    // every frame is read since each is a delta on the one before, only the ones asked for are written
+    std::uint64_t read = 0;
+    std::uint64_t written = 0;
+    std::uint64_t dropped = 0;
+    std::uint64_t last_frame = 0;
+    while (written < count && recording_read_frame(reader))
+    {
+        if (read > 0 && reader.frame.frame > last_frame + 1)
+        {
+            dropped += reader.frame.frame - last_frame - 1;
+        }
+        last_frame = reader.frame.frame;
+        ++read;
+
+        if (reader.frame.frame < first)
+        {
+            continue;
+        }
+
+        char name[32]{};
+        std::snprintf(name, sizeof(name), "frame_%06" PRIu64 ".png", reader.frame.frame);
+        const auto png = png_encode(recording_frame_view(reader), reader.palette);
+
+        std::ofstream out{out_dir / name, std::ios::binary};
+        if (!out.write(reinterpret_cast<const char *>(png.data()), static_cast<std::streamsize>(png.size())))
+        {
+            std::fprintf(stderr, "%s: can't write %s\n", out_dir.string().c_str(), name);
+            return 1;
+        }
+        ++written;
+    }
+
+    std::printf(
+        "%" PRIu64 " frames read, %" PRIu64 " written, %" PRIu64 " dropped while recording\n",
+        read,
+        written,
+        dropped);
+    return 0;
+}
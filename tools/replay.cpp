@@ -0,0 +1,402 @@
+// plays a capture written by the patcher ([capture] enabled=1) back through the cpu raster engine as fast as it can,
+// printing a hash of every presented frame and how long each kind of call took to replay
+// usage: blocks_replay [-q] capture.bin
+//   -q  only print the summary, not every frame hash
+// two replays of the same capture must print the same digest, a change in it after touching the raster or palette
+// code means the output changed
+
+#include <array>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../bmp.h"
+#include "../capture.h"
+#include "../hash.h"
+#include "../hook_stats.h"
+#include "../mapped_file.h"
+#include "../palette_convert.h"
+#include "../palette_index.h"
+#include "../raster.h"
+#include "../trace.h"
+
+namespace
+{
+
+struct replay_surface
+{
+    capture_surface_role role{};
+    std::vector<std::uint8_t> pixels{};
+    raster_surface view{};
+    std::optional<raster_color_key> key{};
+};
+
+// the patcher's state for one run, the same steps main.cpp takes minus everything that talks to DirectDraw
+struct replayer
+{
+    std::unordered_map<capture_handle, replay_surface> surfaces{};
+    capture_handle back_buffer{};
+    capture_handle image_surface{};
+
+    std::array<palette_entry, 256> palette{};
+    palette_changes changes{};
+    palette_lut lut{};
+
+    std::optional<bmp_image> image{};
+    palette_pixel_index image_index{};
+    bool image_converted{};
+
+    bool print_frames{true};
+    std::uint64_t frames{};
+    std::uint64_t digest{};
+    // calls against something the replayer doesn't have, e.g. a surface in a format the raster engine can't do
+    std::uint64_t skipped{};
+};
+
+replay_surface *find_surface(replayer &r, capture_handle handle)
+{
+    const auto found = r.surfaces.find(handle);
+    return found != r.surfaces.end() ? &found->second : nullptr;
+}
+
+raster_rect whole(const raster_surface &surface)
+{
+    return {0, 0, static_cast<std::int32_t>(surface.width), static_cast<std::int32_t>(surface.height)};
+}
+
+bool replay_create_surface(replayer &r, const capture_create_surface &args)
+{
+    if (args.format == capture_unknown_format)
+    {
+        return false;
+    }
+
+    auto &surface = r.surfaces[args.surface];
+    surface.role = args.role;
+
+    const auto format = static_cast<pixel_format>(args.format);
+    const auto pitch = static_cast<std::size_t>(args.width) * bytes_per_pixel(format);
+    surface.pixels.assign(pitch * args.height, 0);
+    surface.view = {surface.pixels.data(), static_cast<std::ptrdiff_t>(pitch), args.width, args.height, format};
+
+    if (args.role == capture_surface_role::back_buffer)
+    {
+        r.back_buffer = args.surface;
+    }
+    else if (args.role == capture_surface_role::image)
+    {
+        r.image_surface = args.surface;
+    }
+    return true;
+}
+
+bool replay_set_entries(replayer &r, const capture_set_entries &args, std::span<const std::uint8_t> payload)
+{
+    if (args.first > r.palette.size() || args.count > r.palette.size() - args.first ||
+        payload.size() < args.count * sizeof(palette_entry))
+    {
+        return false;
+    }
+
+    const std::span incoming{reinterpret_cast<const palette_entry *>(payload.data()), args.count};
+    r.changes |= diff_palette(r.palette, args.first, incoming);
+    std::memcpy(r.palette.data() + args.first, incoming.data(), incoming.size_bytes());
+    return true;
+}
+
+bool replay_blt(replayer &r, const capture_blt &args)
+{
+    auto *dst = find_surface(r, args.dst);
+    if (dst == nullptr)
+    {
+        return false;
+    }
+
+    const auto *dst_rect = (args.rects & capture_has_dst_rect) ? &args.dst_rect : nullptr;
+    if (args.flags & capture_blt_colorfill)
+    {
+        return raster_fill(dst->view, dst_rect, args.fill_color);
+    }
+
+    auto *src = find_surface(r, args.src);
+    if (src == nullptr)
+    {
+        return false;
+    }
+
+    const auto *key = (args.flags & capture_blt_keysrcoverride) ? &args.key
+                      : (args.flags & capture_blt_keysrc) && src->key ? &*src->key
+                                                                      : nullptr;
+    const auto *src_rect = (args.rects & capture_has_src_rect) ? &args.src_rect : nullptr;
+    return raster_blt(dst->view, dst_rect, src->view, src_rect, {.source_key = key});
+}
+
+bool replay_blt_fast(replayer &r, const capture_blt_fast &args)
+{
+    auto *dst = find_surface(r, args.dst);
+    auto *src = find_surface(r, args.src);
+    if (dst == nullptr || src == nullptr)
+    {
+        return false;
+    }
+
+    const auto src_rect = (args.rects & capture_has_src_rect) ? args.src_rect : whole(src->view);
+    const auto *key = (args.flags & capture_bltfast_srccolorkey) && src->key ? &*src->key : nullptr;
+    return raster_blt_fast(dst->view, args.x, args.y, src->view, &src_rect, key);
+}
+
+bool replay_unlock(replayer &r, const capture_unlock &args, std::span<const std::uint8_t> payload)
+{
+    auto *surface = find_surface(r, args.surface);
+    if (surface == nullptr)
+    {
+        return false;
+    }
+
+    const auto &view = surface->view;
+    const auto &rect = args.rect;
+    const auto bpp = bytes_per_pixel(view.format);
+    const auto inside = rect.left >= 0 && rect.top >= 0 && rect.left <= rect.right && rect.top <= rect.bottom &&
+                        rect.right <= static_cast<std::int32_t>(view.width) &&
+                        rect.bottom <= static_cast<std::int32_t>(view.height);
+    if (!inside || args.row_bytes != static_cast<std::uint32_t>(rect.right - rect.left) * bpp ||
+        args.rows != static_cast<std::uint32_t>(rect.bottom - rect.top) ||
+        payload.size() < static_cast<std::size_t>(args.row_bytes) * args.rows)
+    {
+        return false;
+    }
+
+    for (std::uint32_t y = 0; y < args.rows; ++y)
+    {
+        auto *row = view.pixels + (rect.top + static_cast<std::ptrdiff_t>(y)) * view.pitch + rect.left * bpp;
+        std::memcpy(row, payload.data() + static_cast<std::size_t>(y) * args.row_bytes, args.row_bytes);
+    }
+    return true;
+}
+
+bool replay_load_image(replayer &r, const capture_load_image &args, std::span<const std::uint8_t> payload)
+{
+    if (payload.size() < static_cast<std::size_t>(args.name_length) + args.file_size)
+    {
+        return false;
+    }
+
+    // the image views point into the capture, which stays mapped for the whole replay
+    bmp_image image{};
+    if (parse_bmp(payload.subspan(args.name_length, args.file_size), image) != bmp_error::none)
+    {
+        return false;
+    }
+
+    r.image = image;
+    r.image_index = build_palette_pixel_index(image.pixels);
+    r.image_converted = false;
+    return true;
+}
+
+// Flip_hook: bring the image surface up to date with the palette, then the back buffer is the finished frame
+bool replay_flip(replayer &r)
+{
+    auto *image_surface = find_surface(r, r.image_surface);
+    if (r.image && image_surface != nullptr && image_surface->view.format == pixel_format::argb8888 &&
+        (!r.image_converted || r.changes.any()))
+    {
+        build_palette_lut(r.palette, r.lut);
+
+        const auto &view = image_surface->view;
+        const bgra_view dst{view.pixels, view.pitch, view.width, view.height};
+        const auto total_pixels = static_cast<std::size_t>(view.width) * view.height;
+
+        const auto incremental = r.image_converted && r.image_index.width == view.width &&
+                                 r.image_index.height == view.height &&
+                                 pixels_affected(r.image_index, r.changes) * 2 < total_pixels;
+        if (incremental)
+        {
+            apply_palette_changes(r.image_index, r.changes, r.lut, dst);
+        }
+        else
+        {
+            convert_indexed_to_bgra(r.image->pixels, dst, r.lut);
+        }
+
+        r.image_converted = true;
+        r.changes.reset();
+    }
+
+    // [raster] indexed=1 copies the image's indices in as they are and applies the palette after the back buffer,
+    // which leaves the frames hashed here as indices
+    if (r.image && image_surface != nullptr && image_surface->view.format == pixel_format::indexed8 &&
+        !r.image_converted)
+    {
+        const auto &view = image_surface->view;
+        copy_indexed(r.image->pixels, view.pixels, view.pitch, view.width, view.height);
+        r.image_converted = true;
+    }
+
+    const auto *back_buffer = find_surface(r, r.back_buffer);
+    if (back_buffer == nullptr)
+    {
+        return false;
+    }
+
+    const auto hash = hash_bytes(back_buffer->pixels);
+    r.digest = hash_bytes(capture_bytes(hash), r.digest);
+    if (r.print_frames)
+    {
+        std::printf("frame %" PRIu64 " %016" PRIx64 "\n", r.frames, hash);
+    }
+    ++r.frames;
+    return true;
+}
+
+template <class T, class F>
+bool replay_with(const capture_entry &entry, F &&replay)
+{
+    T args{};
+    std::span<const std::uint8_t> payload{};
+    return capture_args(entry, args, payload) && replay(args, payload);
+}
+
+bool replay(replayer &r, const capture_entry &entry)
+{
+    switch (entry.record.call)
+    {
+        case capture_call::create_surface:
+            return replay_with<capture_create_surface>(
+                entry,
+                [&](const auto &args, auto) { return replay_create_surface(r, args); });
+        case capture_call::set_entries:
+            return replay_with<capture_set_entries>(
+                entry,
+                [&](const auto &args, auto payload) { return replay_set_entries(r, args, payload); });
+        case capture_call::blt:
+            return replay_with<capture_blt>(entry, [&](const auto &args, auto) { return replay_blt(r, args); });
+        case capture_call::blt_fast:
+            return replay_with<capture_blt_fast>(
+                entry,
+                [&](const auto &args, auto) { return replay_blt_fast(r, args); });
+        case capture_call::flip: return replay_flip(r);
+        case capture_call::unlock:
+            return replay_with<capture_unlock>(
+                entry,
+                [&](const auto &args, auto payload) { return replay_unlock(r, args, payload); });
+        case capture_call::set_color_key:
+            return replay_with<capture_set_color_key>(
+                entry,
+                [&](const auto &args, auto)
+                {
+                    auto *surface = find_surface(r, args.surface);
+                    if (surface != nullptr)
+                    {
+                        surface->key = args.key;
+                    }
+                    return surface != nullptr;
+                });
+        case capture_call::load_image:
+            return replay_with<capture_load_image>(
+                entry,
+                [&](const auto &args, auto payload) { return replay_load_image(r, args, payload); });
+
+        // nothing to do without a window or a driver, the palette object itself doesn't matter since the patcher
+        // keeps one palette for everything, and a lock's pixels arrive with its unlock
+        case capture_call::create_window:
+        case capture_call::direct_draw_create:
+        case capture_call::create_palette:
+        case capture_call::lock: return true;
+
+        case capture_call::count: break;
+    }
+    return false;
+}
+
+std::array<latency_histogram, static_cast<std::size_t>(capture_call::count)> g_latencies{};
+
+}
+
+int main(int argc, char **argv)
+{
+    replayer r{};
+
+    auto arg = 1;
+    if (arg < argc && std::string_view{argv[arg]} == "-q")
+    {
+        r.print_frames = false;
+        ++arg;
+    }
+
+    if (arg + 1 != argc)
+    {
+        std::fprintf(stderr, "usage: %s [-q] capture.bin\n", argv[0]);
+        return 1;
+    }
+
+    mapped_file file{};
+    std::span<const std::uint8_t> records{};
+    if (!map_file(argv[arg], file) || !capture_open(file.bytes(), records))
+    {
+        std::fprintf(stderr, "%s: not a capture\n", argv[arg]);
+        return 1;
+    }
+
+    const auto start = trace_now();
+
+    capture_entry entry{};
+    std::uint64_t calls = 0;
+    while (capture_next(records, entry))
+    {
+        if (entry.record.call >= capture_call::count)
+        {
+            ++r.skipped;
+            continue;
+        }
+
+        const auto call_start = trace_now();
+        const auto ok = replay(r, entry);
+        latency_record(g_latencies[static_cast<std::size_t>(entry.record.call)], trace_now() - call_start);
+
+        r.skipped += !ok;
+        ++calls;
+    }
+
+    const auto elapsed = static_cast<double>(trace_now() - start) / 1e6;
+
+    if (!records.empty())
+    {
+        std::fprintf(stderr, "%s: truncated, %zu bytes left over\n", argv[arg], records.size());
+    }
+
+    std::printf("%-16s %10s %10s %10s %10s %10s\n", "call", "count", "total ms", "p50 us", "p99 us", "max us");
+    for (std::size_t i = 0; i < g_latencies.size(); ++i)
+    {
+        const auto &latencies = g_latencies[i];
+        const auto count = latencies.count.load(std::memory_order_relaxed);
+        if (count == 0)
+        {
+            continue;
+        }
+
+        std::printf(
+            "%-16s %10" PRIu64 " %10.3f %10.3f %10.3f %10.3f\n",
+            capture_call_name(static_cast<capture_call>(i)),
+            count,
+            static_cast<double>(latencies.total.load(std::memory_order_relaxed)) / 1e6,
+            static_cast<double>(latency_percentile(latencies, 0.5)) / 1e3,
+            static_cast<double>(latency_percentile(latencies, 0.99)) / 1e3,
+            static_cast<double>(latencies.max.load(std::memory_order_relaxed)) / 1e3);
+    }
+
+    std::printf(
+        "%" PRIu64 " calls, %" PRIu64 " frames in %.3f ms (%.1f fps), %" PRIu64 " skipped\n",
+        calls,
+        r.frames,
+        elapsed,
+        elapsed > 0 ? static_cast<double>(r.frames) * 1000.0 / elapsed : 0.0,
+        r.skipped);
+    std::printf("digest %016" PRIx64 "\n", r.digest);
+
+    return records.empty() ? 0 : 1;
+}
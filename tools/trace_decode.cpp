@@ -0,0 +1,333 @@
+// renders a binary trace written by the patcher ([trace] enabled=1) as text, or with --chrome as chrome trace event
+// json, which ui.perfetto.dev and chrome://tracing open as a timeline of every thread's hook calls and the frames
+// usage: blocks_trace_decode [--chrome] trace.bin > trace.txt
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../flags.h"
+#include "../trace.h"
+
+namespace
+{
+
+std::string render_arg(trace_arg kind, std::uint64_t value)
+{
+    char buffer[64]{};
+
+    switch (kind)
+    {
+        case trace_arg::none: return {};
+        case trace_arg::u32:
+            std::snprintf(buffer, sizeof(buffer), "%" PRIu32, static_cast<std::uint32_t>(value));
+            break;
+        case trace_arg::i32:
+            std::snprintf(buffer, sizeof(buffer), "%" PRId32, static_cast<std::int32_t>(value));
+            break;
+        case trace_arg::hex:
+            std::snprintf(buffer, sizeof(buffer), "%#" PRIx32, static_cast<std::uint32_t>(value));
+            break;
+        case trace_arg::ptr:
+            std::snprintf(buffer, sizeof(buffer), "%#" PRIx64, value);
+            break;
+        case trace_arg::hresult:
+            std::snprintf(buffer, sizeof(buffer), "%#010" PRIx32, static_cast<std::uint32_t>(value));
+            break;
+        case trace_arg::ddcaps: return ddcaps_to_string(static_cast<std::uint32_t>(value));
+        case trace_arg::fuload: return fuload_to_string(static_cast<std::uint32_t>(value));
+        case trace_arg::palette_caps: return palette_caps_to_string(static_cast<std::uint32_t>(value));
+        case trace_arg::event:
+            return value < trace_events.size() ? trace_events[value].name : std::string{"?"};
+    }
+
+    return buffer;
+}
+
+void print_json_string(std::string_view text)
+{
+    std::putchar('"');
+    for (const auto c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            std::printf("\\%c", c);
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            std::printf("\\u%04x", c);
+        }
+        else
+        {
+            std::putchar(c);
+        }
+    }
+    std::putchar('"');
+}
+
+// chrome's tid for the track the frames go on, past any ring the patcher can hand out
+constexpr std::uint32_t frame_track = 0x10000;
+
+struct chrome_writer
+{
+    std::uint64_t start{};
+    double ticks_per_us{};
+    bool first{true};
+
+    void begin_event()
+    {
+        std::printf(first ? "\n" : ",\n");
+        first = false;
+    }
+
+    double micros(std::uint64_t timestamp) const
+    {
+        return static_cast<double>(timestamp - start) / ticks_per_us;
+    }
+
+    // a hook call, complete when its end was recorded and an instant when it wasn't
+    void call(const trace_record &r, const trace_record *end, const trace_record *returned)
+    {
+        const auto &info = trace_events[static_cast<std::size_t>(r.event)];
+        begin_event();
+        std::printf("{\"name\":");
+        print_json_string(info.name);
+        std::printf(",\"cat\":\"hook\",\"pid\":1,\"tid\":%u,\"ts\":%.3f", r.thread, micros(r.timestamp));
+        if (end != nullptr)
+        {
+            std::printf(",\"ph\":\"X\",\"dur\":%.3f", micros(end->timestamp) - micros(r.timestamp));
+        }
+        else
+        {
+            std::printf(",\"ph\":\"i\",\"s\":\"t\"");
+        }
+
+        std::printf(",\"args\":{");
+        auto separator = "";
+        for (std::size_t i = 0; i < std::min<std::size_t>(r.arg_count, trace_max_args); ++i)
+        {
+            const auto &arg = info.args[i];
+            if (arg.kind == trace_arg::none)
+            {
+                continue;
+            }
+            std::printf("%s\"%s\":", separator, arg.name);
+            print_json_string(render_arg(arg.kind, r.args[i]));
+            separator = ",";
+        }
+        if (returned != nullptr)
+        {
+            std::printf("%s\"result\":", separator);
+            print_json_string(render_arg(trace_arg::hresult, returned->args[1]));
+        }
+        std::printf("}}");
+    }
+
+    void frame(std::uint64_t number, std::uint64_t from, std::uint64_t to)
+    {
+        begin_event();
+        std::printf(
+            "{\"name\":\"frame %" PRIu64 "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,"
+            "\"dur\":%.3f}",
+            number,
+            frame_track,
+            micros(from),
+            micros(to) - micros(from));
+    }
+
+    void thread_name(std::uint32_t thread, const char *name)
+    {
+        begin_event();
+        std::printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", thread);
+        print_json_string(name);
+        std::printf("}}");
+    }
+};
+
+// a call waiting for its end record
+struct open_call
+{
+    const trace_record *call;
+    const trace_record *returned;
+};
+
+void write_chrome_trace(const trace_file_header &header, const std::vector<trace_record> &records)
+{
+    chrome_writer out{
+        .start = records.empty() ? 0 : records.front().timestamp,
+        .ticks_per_us = static_cast<double>(header.frequency) / 1e6};
+
+    std::printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    out.thread_name(frame_track, "frames");
+
+    // hooks only leave an end record when they have a hook_scope, and a ring that filled up drops records, so a
+    // call's end is looked for among the calls its thread still has open and whatever it skips over never ended
+    std::map<std::uint16_t, std::vector<open_call>> open{};
+    std::uint64_t frames = 0;
+    std::uint64_t frame_start = 0;
+    std::uint16_t frame_thread = 0;
+    std::uint64_t frame_thread_last = 0;
+    for (const auto &r : records)
+    {
+        const auto event = static_cast<std::size_t>(r.event);
+        if (event >= trace_events.size())
+        {
+            continue;
+        }
+
+        if (!open.contains(r.thread))
+        {
+            char name[32]{};
+            std::snprintf(name, sizeof(name), "thread %u", r.thread);
+            out.thread_name(r.thread, name);
+        }
+        auto &calls = open[r.thread];
+        if (frames > 0 && r.thread == frame_thread)
+        {
+            frame_thread_last = r.timestamp;
+        }
+
+        const auto matching = [&](std::uint64_t call)
+        {
+            return std::ranges::find_if(
+                calls.rbegin(),
+                calls.rend(),
+                [&](const open_call &c) { return static_cast<std::uint64_t>(c.call->event) == call; });
+        };
+
+        if (r.event == trace_event::returned)
+        {
+            if (const auto it = matching(r.args[0]); it != calls.rend())
+            {
+                it->returned = &r;
+            }
+        }
+        else if (r.event == trace_event::end)
+        {
+            const auto it = matching(r.args[0]);
+            if (it == calls.rend())
+            {
+                continue;
+            }
+
+            const auto index = static_cast<std::size_t>(calls.rend() - it) - 1;
+            for (auto i = index + 1; i < calls.size(); ++i)
+            {
+                out.call(*calls[i].call, nullptr, calls[i].returned);
+            }
+            out.call(*calls[index].call, &r, calls[index].returned);
+            calls.resize(index);
+        }
+        else
+        {
+            calls.push_back({&r, nullptr});
+
+            // a frame runs from one Flip to the next
+            if (r.event == trace_event::flip)
+            {
+                if (frames > 0)
+                {
+                    out.frame(frames - 1, frame_start, r.timestamp);
+                }
+                frame_start = r.timestamp;
+                frame_thread = r.thread;
+                ++frames;
+            }
+        }
+    }
+
+    // the last frame has no Flip after it, it ends with whatever its thread recorded last
+    if (frames > 0)
+    {
+        out.frame(frames - 1, frame_start, std::max(frame_start, frame_thread_last));
+    }
+
+    for (const auto &[thread, calls] : open)
+    {
+        for (const auto &c : calls)
+        {
+            out.call(*c.call, nullptr, c.returned);
+        }
+    }
+
+    std::printf("\n]}\n");
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    const auto chrome = argc > 1 && std::string_view{argv[1]} == "--chrome";
+    if (argc < 2 + chrome)
+    {
+        std::fprintf(stderr, "usage: %s [--chrome] trace.bin\n", argv[0]);
+        return 1;
+    }
+
+    const auto *path = argv[1 + chrome];
+    auto *file = std::fopen(path, "rb");
+    if (file == nullptr)
+    {
+        std::fprintf(stderr, "can't open %s\n", path);
+        return 1;
+    }
+
+    trace_file_header header{};
+    if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, trace_magic, sizeof(trace_magic)) != 0 || header.version != trace_version)
+    {
+        std::fprintf(stderr, "%s is not a version %u trace\n", path, trace_version);
+        return 1;
+    }
+
+    std::vector<trace_record> records{};
+    trace_record record{};
+    while (std::fread(&record, sizeof(record), 1, file) == 1)
+    {
+        records.push_back(record);
+    }
+    std::fclose(file);
+
+    // the writer drains one thread's ring at a time, put the threads back together
+    std::ranges::stable_sort(records, {}, &trace_record::timestamp);
+
+    if (chrome)
+    {
+        write_chrome_trace(header, records);
+        return 0;
+    }
+
+    const auto start = records.empty() ? 0 : records.front().timestamp;
+    const auto ticks_per_ms = static_cast<double>(header.frequency) / 1000.0;
+
+    for (const auto &r : records)
+    {
+        const auto event = static_cast<std::size_t>(r.event);
+        if (event >= trace_events.size())
+        {
+            std::printf("%14.6f ms  t%u  unknown event %zu\n", (r.timestamp - start) / ticks_per_ms, r.thread, event);
+            continue;
+        }
+
+        const auto &info = trace_events[event];
+        std::printf("%14.6f ms  t%u  %s", (r.timestamp - start) / ticks_per_ms, r.thread, info.name);
+
+        for (std::size_t i = 0; i < std::min<std::size_t>(r.arg_count, trace_max_args); ++i)
+        {
+            const auto &arg = info.args[i];
+            if (arg.kind == trace_arg::none)
+            {
+                continue;
+            }
+            std::printf(" %s=%s", arg.name, render_arg(arg.kind, r.args[i]).c_str());
+        }
+        std::printf("\n");
+    }
+
+    return 0;
+}
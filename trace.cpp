@@ -0,0 +1,202 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr std::uint32_t ring_capacity = 4096; // records, must be a power of two
+
+struct trace_ring
+{
+    trace_record records[ring_capacity];
+
+    // head is only written by the owning thread, tail only by the writer
+    alignas(64) std::atomic<std::uint32_t> head{};
+    alignas(64) std::atomic<std::uint32_t> tail{};
+
+    std::uint16_t thread{};
+};
+
+struct trace_state
+{
+    // guards rings (registration) and file (draining), never taken on the push path once a thread has its ring
+    std::mutex mutex{};
+    std::vector<std::unique_ptr<trace_ring>> rings{};
+    std::FILE *file{};
+    std::atomic<bool> running{};
+    bool writer_started{};
+    std::atomic<std::uint64_t> dropped{};
+};
+
+trace_state &state()
+{
+    static trace_state instance{};
+    return instance;
+}
+
+thread_local trace_ring *t_ring{};
+
+void writer_loop();
+
+trace_ring *register_thread()
+{
+    auto &s = state();
+    std::lock_guard lock{s.mutex};
+
+    auto ring = std::make_unique<trace_ring>();
+    ring->thread = static_cast<std::uint16_t>(s.rings.size());
+    s.rings.push_back(std::move(ring));
+
+    // the writer is started by the first traced call rather than trace_start, which runs inside DllMain where
+    // creating and waiting on threads is asking for a loader lock deadlock
+    // never joined: at process exit windows has already killed it, and joining under the loader lock would hang
+    if (!s.writer_started && s.running.load(std::memory_order_acquire))
+    {
+        s.writer_started = true;
+        std::thread{writer_loop}.detach();
+    }
+
+    return s.rings.back().get();
+}
+
+// write out everything published so far, caller holds the mutex
+void drain_locked(trace_state &s)
+{
+    for (const auto &ring : s.rings)
+    {
+        const auto tail = ring->tail.load(std::memory_order_relaxed);
+        const auto head = ring->head.load(std::memory_order_acquire);
+        if (head == tail)
+        {
+            continue;
+        }
+
+        // at most two contiguous runs when the published range wraps around the end of the buffer
+        const auto first = tail & (ring_capacity - 1);
+        const auto count = head - tail;
+        const auto until_end = std::min(count, ring_capacity - first);
+
+        std::fwrite(&ring->records[first], sizeof(trace_record), until_end, s.file);
+        if (count > until_end)
+        {
+            std::fwrite(&ring->records[0], sizeof(trace_record), count - until_end, s.file);
+        }
+
+        ring->tail.store(head, std::memory_order_release);
+    }
+}
+
+void writer_loop()
+{
+    auto &s = state();
+
+    while (s.running.load(std::memory_order_acquire))
+    {
+        {
+            std::lock_guard lock{s.mutex};
+            if (s.file != nullptr)
+            {
+                drain_locked(s);
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds{5});
+    }
+}
+
+}
+
+bool trace_start(const char *path)
+{
+    auto &s = state();
+
+    {
+        std::lock_guard lock{s.mutex};
+        if (s.file != nullptr)
+        {
+            return true;
+        }
+
+        s.file = std::fopen(path, "wb");
+        if (s.file == nullptr)
+        {
+            return false;
+        }
+
+        std::setvbuf(s.file, nullptr, _IOFBF, 1 << 20);
+
+        trace_file_header header{};
+        std::copy(std::begin(trace_magic), std::end(trace_magic), header.magic);
+        header.version = trace_version;
+        header.frequency = 1'000'000'000;
+        std::fwrite(&header, sizeof(header), 1, s.file);
+    }
+
+    s.running.store(true, std::memory_order_release);
+    g_trace_enabled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void trace_stop()
+{
+    auto &s = state();
+
+    g_trace_enabled.store(false, std::memory_order_relaxed);
+    s.running.store(false, std::memory_order_release);
+
+    // the writer may have been killed while holding the lock at process exit, so only wait for it briefly and
+    // lose the tail of the trace rather than hang the game on the way out
+    std::unique_lock lock{s.mutex, std::defer_lock};
+    for (auto attempt = 0; attempt < 100 && !lock.try_lock(); ++attempt)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+
+    if (!lock.owns_lock() || s.file == nullptr)
+    {
+        return;
+    }
+
+    drain_locked(s);
+    std::fclose(s.file);
+    s.file = nullptr;
+}
+
+void trace_pause(bool paused)
+{
+    g_trace_enabled.store(!paused && state().running.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+std::uint64_t trace_dropped()
+{
+    return state().dropped.load(std::memory_order_relaxed);
+}
+
+void trace_push(trace_record &record)
+{
+    auto *ring = t_ring;
+    if (ring == nullptr)
+    {
+        ring = t_ring = register_thread();
+    }
+
+    const auto head = ring->head.load(std::memory_order_relaxed);
+    const auto tail = ring->tail.load(std::memory_order_acquire);
+
+    // drop rather than wait, the game thread must never block on the writer
+    if (head - tail >= ring_capacity)
+    {
+        state().dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    record.thread = ring->thread;
+    ring->records[head & (ring_capacity - 1)] = record;
+    ring->head.store(head + 1, std::memory_order_release);
+}
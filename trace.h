@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+
+#include "trace_events.h"
+
+// binary tracing for the hooks
+// each hooking thread pushes fixed size records into its own single producer/single consumer ring, a writer thread
+// drains the rings into a file and tools/trace_decode.cpp turns that into text later, so tracing a call costs a
+// timestamp and a few stores instead of a format and a file write
+
+// one traced call, 64 bytes
+struct trace_record
+{
+    std::uint64_t timestamp;
+    trace_event event;
+    std::uint16_t thread;
+    std::uint16_t arg_count;
+    std::uint16_t reserved;
+    std::uint64_t args[trace_max_args];
+};
+static_assert(sizeof(trace_record) == 64);
+
+// file layout: trace_file_header followed by trace_record until the end of the file
+struct trace_file_header
+{
+    char magic[4];
+    std::uint32_t version;
+    // timestamp ticks per second
+    std::uint64_t frequency;
+};
+
+inline constexpr char trace_magic[4]{'B', 'T', 'R', 'C'};
+inline constexpr std::uint32_t trace_version = 1;
+
+inline std::atomic<bool> g_trace_enabled{};
+
+// open path and start the writer thread, returns false if the file can't be created
+bool trace_start(const char *path);
+
+// drain whatever is left and close the file, safe to call from DLL_PROCESS_DETACH
+void trace_stop();
+
+// stop and resume recording between trace_start and trace_stop, e.g. to trace only some frames
+void trace_pause(bool paused);
+
+// records that didn't fit in a full ring
+std::uint64_t trace_dropped();
+
+void trace_push(trace_record &record);
+
+inline std::uint64_t trace_now()
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+template <class T>
+std::uint64_t trace_word(const T &value)
+{
+    if constexpr (std::is_null_pointer_v<T>)
+    {
+        return 0;
+    }
+    else if constexpr (std::is_pointer_v<T>)
+    {
+        return reinterpret_cast<std::uintptr_t>(value);
+    }
+    else if constexpr (std::is_enum_v<T>)
+    {
+        return static_cast<std::uint64_t>(value);
+    }
+    else if constexpr (std::is_signed_v<T>)
+    {
+        return static_cast<std::uint64_t>(static_cast<std::int64_t>(value));
+    }
+    else
+    {
+        return static_cast<std::uint64_t>(value);
+    }
+}
+
+template <class... Args>
+void trace(trace_event event, const Args &...args)
+{
+    static_assert(sizeof...(Args) <= trace_max_args);
+
+    if (!g_trace_enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    trace_record record{
+        .timestamp = trace_now(),
+        .event = event,
+        .thread = 0,
+        .arg_count = static_cast<std::uint16_t>(sizeof...(Args)),
+        .reserved = 0,
+        .args = {trace_word(args)...}};
+
+    trace_push(record);
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// the events the hooks can trace and how the decoder should render their arguments
+// records only carry raw argument words, all the naming and formatting happens offline
+
+inline constexpr std::size_t trace_max_args = 6;
+
+enum class trace_event : std::uint16_t
+{
+    create_window_ex,
+    direct_draw_create,
+    set_cooperative_level,
+    set_display_mode,
+    create_surface,
+    create_palette,
+    set_entries,
+    get_attached_surface,
+    blt,
+    blt_batch,
+    blt_fast,
+    flip,
+    lock,
+    unlock,
+    set_palette,
+    get_pixel_format,
+    set_color_key,
+    get_system_metrics,
+    load_image,
+    // (event, result) for a hook returning, e.g. "Blt returned 0"
+    returned,
+    // (event) a hook's hook_scope closing, the end of the call for timeline exports
+    end,
+    count
+};
+
+enum class trace_arg : std::uint8_t
+{
+    none,
+    u32,
+    i32,
+    hex,
+    ptr,
+    hresult,
+    ddcaps,
+    fuload,
+    palette_caps,
+    event
+};
+
+struct trace_arg_info
+{
+    const char *name;
+    trace_arg kind;
+};
+
+struct trace_event_info
+{
+    const char *name;
+    std::array<trace_arg_info, trace_max_args> args;
+};
+
+inline constexpr std::array<trace_event_info, static_cast<std::size_t>(trace_event::count)> trace_events{{
+    {"CreateWindowExA",
+     {{{"ex_style", trace_arg::hex},
+       {"style", trace_arg::hex},
+       {"x", trace_arg::i32},
+       {"y", trace_arg::i32},
+       {"width", trace_arg::i32},
+       {"height", trace_arg::i32}}}},
+    {"DirectDrawCreate", {{{"guid", trace_arg::ptr}, {"out", trace_arg::ptr}, {"outer", trace_arg::ptr}}}},
+    {"SetCooperativeLevel", {{{"this", trace_arg::ptr}, {"window", trace_arg::ptr}, {"flags", trace_arg::hex}}}},
+    {"SetDisplayMode",
+     {{{"this", trace_arg::ptr}, {"width", trace_arg::u32}, {"height", trace_arg::u32}, {"bpp", trace_arg::u32}}}},
+    {"CreateSurface",
+     {{{"this", trace_arg::ptr},
+       {"desc", trace_arg::ptr},
+       {"width", trace_arg::u32},
+       {"height", trace_arg::u32},
+       {"flags", trace_arg::hex},
+       {"caps", trace_arg::ddcaps}}}},
+    {"CreatePalette",
+     {{{"this", trace_arg::ptr},
+       {"flags", trace_arg::palette_caps},
+       {"entries", trace_arg::ptr},
+       {"out", trace_arg::ptr}}}},
+    {"SetEntries",
+     {{{"this", trace_arg::ptr},
+       {"flags", trace_arg::hex},
+       {"first", trace_arg::u32},
+       {"count", trace_arg::u32},
+       {"entries", trace_arg::ptr}}}},
+    {"GetAttachedSurface", {{{"this", trace_arg::ptr}, {"caps", trace_arg::ddcaps}, {"out", trace_arg::ptr}}}},
+    {"Blt",
+     {{{"this", trace_arg::ptr},
+       {"dst_rect", trace_arg::ptr},
+       {"src", trace_arg::ptr},
+       {"src_rect", trace_arg::ptr},
+       {"flags", trace_arg::hex},
+       {"fx", trace_arg::ptr}}}},
+    {"BltBatch",
+     {{{"this", trace_arg::ptr}, {"batch", trace_arg::ptr}, {"count", trace_arg::u32}, {"flags", trace_arg::hex}}}},
+    {"BltFast",
+     {{{"this", trace_arg::ptr},
+       {"x", trace_arg::u32},
+       {"y", trace_arg::u32},
+       {"src", trace_arg::ptr},
+       {"src_rect", trace_arg::ptr},
+       {"flags", trace_arg::hex}}}},
+    {"Flip", {{{"this", trace_arg::ptr}, {"target", trace_arg::ptr}, {"flags", trace_arg::hex}}}},
+    {"Lock",
+     {{{"this", trace_arg::ptr}, {"rect", trace_arg::ptr}, {"desc", trace_arg::ptr}, {"flags", trace_arg::hex}}}},
+    {"Unlock", {{{"this", trace_arg::ptr}, {"rect", trace_arg::ptr}}}},
+    {"SetPalette", {{{"this", trace_arg::ptr}, {"palette", trace_arg::ptr}}}},
+    {"GetPixelFormat", {{{"this", trace_arg::ptr}, {"format", trace_arg::ptr}}}},
+    {"SetColorKey", {{{"this", trace_arg::ptr}, {"flags", trace_arg::hex}, {"key", trace_arg::ptr}}}},
+    {"GetSystemMetrics", {{{"index", trace_arg::i32}}}},
+    {"LoadImageA",
+     {{{"instance", trace_arg::ptr},
+       {"name", trace_arg::ptr},
+       {"type", trace_arg::u32},
+       {"cx", trace_arg::i32},
+       {"cy", trace_arg::i32},
+       {"load", trace_arg::fuload}}}},
+    {"returned", {{{"call", trace_arg::event}, {"result", trace_arg::hresult}}}},
+    {"end", {{{"call", trace_arg::event}}}},
+}};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hook_set.h"
+
+// compile time description of COM vtable slots and the hooks we put in them
+// every method gets its own type, so the original function it had before patching lives in a typed static and
+// calling through to it is a plain indirect call rather than a string keyed map lookup
+
+// Interface only keeps methods of different interfaces apart, Index is the slot number in the vtable
+template <class Interface, std::size_t Index, class Function>
+struct vtable_method
+{
+    using interface_type = Interface;
+    using function_type = Function;
+
+    static constexpr std::size_t index = Index;
+    static constexpr std::size_t offset = Index * sizeof(void *);
+
+    // what was in the slot before we patched it
+    static inline Function original{};
+};
+
+// address of a method's slot in the vtable of a COM object (the first thing in the object is the vtable pointer)
+template <class Method>
+std::uintptr_t vtable_slot_address(void *object)
+{
+    return reinterpret_cast<std::uintptr_t>(*reinterpret_cast<void **>(object)) + Method::offset;
+}
+
+// a hook function bound to the method it replaces
+template <class Method, typename Method::function_type Hook>
+struct vtable_hook
+{
+    using method = Method;
+    static constexpr auto function = Hook;
+};
+
+template <class Hook>
+void add_vtable_hook(hook_set &set, void *object)
+{
+    using method = typename Hook::method;
+
+    const auto slot = vtable_slot_address<method>(object);
+    const auto replacement = reinterpret_cast<std::uintptr_t>(Hook::function);
+
+    // objects of one interface normally share a vtable, so the second surface finds our hook already in place
+    // patching it again would save our own hook as the original and recurse forever
+    if (*reinterpret_cast<const std::uintptr_t *>(slot) == replacement)
+    {
+        return;
+    }
+
+    // the slot isn't written until the set is committed, but nothing can call through it to the hook before then
+    method::original = *reinterpret_cast<const typename method::function_type *>(slot);
+    hook_set_add(set, slot, replacement);
+}
+
+// a set of hooks installed together on one object, queued into a hook_set to commit with the rest
+template <class... Hooks>
+struct vtable_hooks
+{
+    static void add(hook_set &set, void *object)
+    {
+        (add_vtable_hook<Hooks>(set, object), ...);
+    }
+};
@@ -0,0 +1,285 @@
+#include "write_watch.h"
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <mutex>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+write_watch::~write_watch()
+{
+    write_watch_free(*this);
+}
+
+#if defined(_WIN32)
+
+bool write_watch_alloc(write_watch &watch, std::size_t size)
+{
+    write_watch_free(watch);
+
+    SYSTEM_INFO info{};
+    ::GetSystemInfo(&info);
+    watch.page_size = info.dwPageSize;
+    watch.size = (size + watch.page_size - 1) / watch.page_size * watch.page_size;
+
+    watch.data = static_cast<std::uint8_t *>(
+        ::VirtualAlloc(nullptr, watch.size, MEM_RESERVE | MEM_COMMIT | MEM_WRITE_WATCH, PAGE_READWRITE));
+    if (watch.data == nullptr)
+    {
+        watch.size = 0;
+        return false;
+    }
+    return true;
+}
+
+void write_watch_free(write_watch &watch)
+{
+    if (watch.data != nullptr)
+    {
+        ::VirtualFree(watch.data, 0, MEM_RELEASE);
+    }
+
+    watch.data = nullptr;
+    watch.size = 0;
+}
+
+void write_watch_reset(write_watch &watch)
+{
+    if (watch.data != nullptr)
+    {
+        ::ResetWriteWatch(watch.data, watch.size);
+    }
+}
+
+void write_watch_pages(write_watch &watch, std::vector<std::size_t> &pages)
+{
+    pages.clear();
+    if (watch.data == nullptr)
+    {
+        return;
+    }
+
+    std::vector<void *> addresses(watch.size / watch.page_size);
+    ULONG_PTR count = addresses.size();
+    ULONG granularity{};
+    if (::GetWriteWatch(0, watch.data, watch.size, addresses.data(), &count, &granularity) != 0)
+    {
+        // no telling what was written, so all of it was
+        for (std::size_t page = 0; page < addresses.size(); ++page)
+        {
+            pages.push_back(page);
+        }
+        return;
+    }
+
+    for (ULONG_PTR i = 0; i < count; ++i)
+    {
+        const auto offset = static_cast<std::size_t>(static_cast<std::uint8_t *>(addresses[i]) - watch.data);
+        pages.push_back(offset / granularity);
+    }
+    std::ranges::sort(pages);
+}
+
+#else
+
+namespace
+{
+
+std::atomic<write_watch *> g_watches[write_watch_max]{};
+
+struct sigaction g_previous_handler{};
+std::once_flag g_handler_installed;
+
+// the first write to a protected page of a watch lands here, note the page and open it so the write goes through
+// when it's retried, any other fault goes to whoever handled SIGSEGV before us
+void on_fault(int signal, siginfo_t *info, void *context)
+{
+    const auto address = reinterpret_cast<std::uintptr_t>(info->si_addr);
+    for (auto &slot : g_watches)
+    {
+        auto *watch = slot.load(std::memory_order_acquire);
+        if (watch == nullptr)
+        {
+            continue;
+        }
+
+        const auto base = reinterpret_cast<std::uintptr_t>(watch->data);
+        if (address >= base && address < base + watch->size)
+        {
+            const auto page = (address - base) / watch->page_size;
+            std::atomic_ref<std::uint8_t>{watch->written[page]}.store(1, std::memory_order_relaxed);
+            ::mprotect(watch->data + page * watch->page_size, watch->page_size, PROT_READ | PROT_WRITE);
+            return;
+        }
+    }
+
+    if (g_previous_handler.sa_flags & SA_SIGINFO)
+    {
+        g_previous_handler.sa_sigaction(signal, info, context);
+    }
+    else if (g_previous_handler.sa_handler != SIG_DFL && g_previous_handler.sa_handler != SIG_IGN)
+    {
+        g_previous_handler.sa_handler(signal);
+    }
+    else
+    {
+        // the faulting instruction runs again on return and this time gets the default, a crash
+        struct sigaction fallback{};
+        fallback.sa_handler = SIG_DFL;
+        ::sigaction(signal, &fallback, nullptr);
+    }
+}
+
+void install_fault_handler()
+{
+    struct sigaction handler{};
+    handler.sa_sigaction = on_fault;
+    handler.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&handler.sa_mask);
+    ::sigaction(SIGSEGV, &handler, &g_previous_handler);
+}
+
+}
+
+bool write_watch_alloc(write_watch &watch, std::size_t size)
+{
+    write_watch_free(watch);
+    std::call_once(g_handler_installed, install_fault_handler);
+
+    watch.page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    watch.size = (size + watch.page_size - 1) / watch.page_size * watch.page_size;
+
+    auto *view = ::mmap(nullptr, watch.size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (view == MAP_FAILED)
+    {
+        watch.size = 0;
+        return false;
+    }
+    watch.data = static_cast<std::uint8_t *>(view);
+    watch.written.assign(watch.size / watch.page_size, 0);
+
+    for (auto &slot : g_watches)
+    {
+        write_watch *expected{};
+        if (slot.compare_exchange_strong(expected, &watch, std::memory_order_acq_rel))
+        {
+            return true;
+        }
+    }
+
+    write_watch_free(watch);
+    return false;
+}
+
+void write_watch_free(write_watch &watch)
+{
+    for (auto &slot : g_watches)
+    {
+        auto *expected = &watch;
+        slot.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+    }
+
+    if (watch.data != nullptr)
+    {
+        ::munmap(watch.data, watch.size);
+    }
+
+    watch.data = nullptr;
+    watch.size = 0;
+    watch.written.clear();
+}
+
+void write_watch_reset(write_watch &watch)
+{
+    if (watch.data == nullptr)
+    {
+        return;
+    }
+
+    ::mprotect(watch.data, watch.size, PROT_READ);
+    for (auto &page : watch.written)
+    {
+        std::atomic_ref<std::uint8_t>{page}.store(0, std::memory_order_relaxed);
+    }
+}
+
+void write_watch_pages(write_watch &watch, std::vector<std::size_t> &pages)
+{
+    pages.clear();
+    for (std::size_t page = 0; page < watch.written.size(); ++page)
+    {
+        if (std::atomic_ref<std::uint8_t>{watch.written[page]}.load(std::memory_order_relaxed) != 0)
+        {
+            pages.push_back(page);
+        }
+    }
+}
+
+#endif
+
+std::vector<raster_rect> write_watch_rows(
+    std::span<const std::size_t> pages,
+    std::size_t page_size,
+    std::size_t pitch,
+    std::uint32_t width,
+    std::uint32_t height)
+{
+    std::vector<raster_rect> rows;
+    if (pitch == 0)
+    {
+        return rows;
+    }
+
+    for (const auto page : pages)
+    {
+        const auto top = static_cast<std::int32_t>(std::min<std::size_t>(page * page_size / pitch, height));
+        const auto bottom =
+            static_cast<std::int32_t>(std::min<std::size_t>(((page + 1) * page_size - 1) / pitch + 1, height));
+        if (top >= bottom)
+        {
+            continue;
+        }
+
+        if (!rows.empty() && top <= rows.back().bottom)
+        {
+            rows.back().bottom = std::max(rows.back().bottom, bottom);
+        }
+        else
+        {
+            rows.push_back({0, top, static_cast<std::int32_t>(width), bottom});
+        }
+    }
+    return rows;
+}
+
+std::size_t write_watch_damage(
+    write_watch &watch,
+    std::size_t pitch,
+    std::uint32_t width,
+    std::uint32_t height,
+    const raster_rect &rect,
+    damage_list &damage,
+    std::vector<std::size_t> &pages)
+{
+    write_watch_pages(watch, pages);
+
+    const auto rows = write_watch_rows(pages, watch.page_size, pitch, width, height);
+    for (const auto &row : rows)
+    {
+        const auto written = raster_intersect(row, rect);
+        if (written.left < written.right && written.top < written.bottom)
+        {
+            damage_add(damage, written);
+        }
+    }
+    return rows.size();
+}
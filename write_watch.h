@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "damage.h"
+#include "raster.h"
+
+// memory that keeps track of which of its pages were written since the last reset, so a surface the game locks and
+// pokes a few pixels into only has to be copied where it actually changed
+// windows allocates it with MEM_WRITE_WATCH and asks GetWriteWatch, elsewhere the pages are write protected and
+// a SIGSEGV handler notes the first write to each one before letting it through
+
+struct write_watch
+{
+    std::uint8_t *data{};
+    // whole pages
+    std::size_t size{};
+    std::size_t page_size{};
+
+    // not windows: one byte per page, set by the fault handler
+    std::vector<std::uint8_t> written{};
+
+    write_watch() = default;
+    // the fault handler finds watches by address, so they stay where they were allocated
+    write_watch(const write_watch &) = delete;
+    write_watch &operator=(const write_watch &) = delete;
+    ~write_watch();
+};
+
+// at most this many watches at once, the fault handler can't take a lock to walk a growing list
+inline constexpr std::size_t write_watch_max = 8;
+
+// size bytes rounded up to whole pages, zeroed and with nothing counted as written yet, false if the memory or a
+// watch slot isn't available
+bool write_watch_alloc(write_watch &watch, std::size_t size);
+
+void write_watch_free(write_watch &watch);
+
+// forget what was written so far, nothing may be writing to the watch meanwhile
+void write_watch_reset(write_watch &watch);
+
+// indices of the pages written since the last reset, ascending
+void write_watch_pages(write_watch &watch, std::vector<std::size_t> &pages);
+
+// full width rects of the rows of a surface at the start of the watch that the pages overlap, adjacent and
+// overlapping ones merged, clipped to height
+std::vector<raster_rect> write_watch_rows(
+    std::span<const std::size_t> pages,
+    std::size_t page_size,
+    std::size_t pitch,
+    std::uint32_t width,
+    std::uint32_t height);
+
+// add the parts of rect in the rows written since the last reset to damage, rect being what was locked of a
+// width x height surface at the start of the watch, pages is scratch space, returns how many row ranges were written
+std::size_t write_watch_damage(
+    write_watch &watch,
+    std::size_t pitch,
+    std::uint32_t width,
+    std::uint32_t height,
+    const raster_rect &rect,
+    damage_list &damage,
+    std::vector<std::size_t> &pages);